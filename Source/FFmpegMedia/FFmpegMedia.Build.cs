@@ -49,6 +49,8 @@ public class FFmpegMedia : ModuleRules
 				"MediaUtils",
 				"RenderCore",
 				"Projects",
+				"Sockets",
+				"HTTP",
 				"FFmpegMediaFactory"
 				// ... add private dependencies that you statically link with here ...	
 			}
@@ -0,0 +1,62 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "FFmpeg/FFmpegArchiveSource.h"
+#include "FFmpegMedia.h"
+extern  "C" {
+#include "libavutil/error.h"
+}
+
+FFmpegArchiveSource::FFmpegArchiveSource(const TSharedPtr<FArchive, ESPMode::ThreadSafe>& InArchive)
+    : Archive(InArchive)
+{
+    this->Size = this->Archive->TotalSize();
+    this->Position = 0;
+    this->BytesRead = 0;
+    this->Seeks = 0;
+}
+
+int FFmpegArchiveSource::Read(uint8_t* buf, int buf_size)
+{
+    const int64 Remaining = this->Size - this->Position;
+    if (Remaining <= 0) {
+        return AVERROR_EOF;
+    }
+    const int BytesToRead = (int)FMath::Min<int64>(buf_size, Remaining);
+    //同一个FArchive可能被其他对象读取过，只在位置不一致时跳转
+    if (this->Archive->Tell() != this->Position) {
+        this->Archive->Seek(this->Position);
+        this->Seeks++;
+    }
+    this->Archive->Serialize(buf, BytesToRead);
+    if (this->Archive->IsError()) {
+        UE_LOG(LogFFmpegMedia, Error, TEXT("ArchiveSource: read %d bytes at %lld failed"), BytesToRead, this->Position);
+        return AVERROR(EIO);
+    }
+    this->Position += BytesToRead;
+    this->BytesRead += BytesToRead;
+    return BytesToRead;
+}
+
+int64_t FFmpegArchiveSource::SeekTo(int64_t pos)
+{
+    //允许跳转到结尾之后，读取时返回AVERROR_EOF
+    this->Position = pos;
+    return pos;
+}
+
+int64_t FFmpegArchiveSource::GetSize() const
+{
+    return this->Size;
+}
+
+int64_t FFmpegArchiveSource::GetPosition() const
+{
+    return this->Position;
+}
+
+FString FFmpegArchiveSource::GetStats() const
+{
+    return FString::Printf(TEXT("archive, %lld / %lld bytes, read %.1f MB, %d seeks"),
+        this->Position, this->Size, this->BytesRead / (1024.0 * 1024.0), this->Seeks);
+}
@@ -0,0 +1,29 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "FFmpegIOSource.h"
+
+/**
+ * 从FArchive读取的AVIO数据源(Open(Archive, ...)打开的媒体)
+ * FArchive只支持同步读取，能够通过地址直接打开的文件优先使用FFmpegAsyncFileSource
+ */
+class FFmpegArchiveSource : public FFmpegIOSource
+{
+public:
+	FFmpegArchiveSource(const TSharedPtr<FArchive, ESPMode::ThreadSafe>& InArchive);
+
+	virtual int Read(uint8_t* buf, int buf_size) override;
+	virtual int64_t SeekTo(int64_t pos) override;
+	virtual int64_t GetSize() const override;
+	virtual int64_t GetPosition() const override;
+	virtual FString GetStats() const override;
+
+private:
+	TSharedPtr<FArchive, ESPMode::ThreadSafe> Archive;
+	int64 Size;
+	int64 Position;
+	int64 BytesRead; //读取的总字节数
+	int Seeks; //实际跳转FArchive的次数
+};
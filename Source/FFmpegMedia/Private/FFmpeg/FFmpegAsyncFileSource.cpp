@@ -0,0 +1,169 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "FFmpeg/FFmpegAsyncFileSource.h"
+#include "FFmpegMedia.h"
+#include "Async/AsyncFileHandle.h"
+#include "HAL/PlatformFileManager.h"
+extern  "C" {
+#include "libavutil/error.h"
+}
+
+FFmpegAsyncFileSource* FFmpegAsyncFileSource::Open(const FString& Path, int BlockSize, int ReadAhead)
+{
+    IAsyncReadFileHandle* Handle = FPlatformFileManager::Get().GetPlatformFile().OpenAsyncRead(*Path);
+    if (!Handle) {
+        return nullptr;
+    }
+    //文件不存在时大小为-1
+    int64 Size = -1;
+    IAsyncReadRequest* SizeRequest = Handle->SizeRequest();
+    if (SizeRequest) {
+        SizeRequest->WaitCompletion();
+        Size = SizeRequest->GetSizeResults();
+        delete SizeRequest;
+    }
+    if (Size <= 0) {
+        UE_LOG(LogFFmpegMedia, Verbose, TEXT("AsyncFileSource: could not open %s"), *Path);
+        delete Handle;
+        return nullptr;
+    }
+    return new FFmpegAsyncFileSource(Handle, Size, FMath::Max(BlockSize, 4096), FMath::Max(ReadAhead, 0));
+}
+
+FFmpegAsyncFileSource::FFmpegAsyncFileSource(IAsyncReadFileHandle* InHandle, int64 InSize, int InBlockSize, int InReadAhead)
+{
+    this->Handle = InHandle;
+    this->Size = InSize;
+    this->Position = 0;
+    this->BlockSize = InBlockSize;
+    this->ReadAhead = InReadAhead;
+    this->Requests = 0;
+    this->Hits = 0;
+    this->Stalls = 0;
+    this->Discards = 0;
+}
+
+FFmpegAsyncFileSource::~FFmpegAsyncFileSource()
+{
+    //所有请求完成之后才能删除文件句柄
+    for (TUniquePtr<FBlock>& Block : this->Blocks) {
+        this->ReleaseBlock(*Block);
+    }
+    this->Blocks.Reset();
+    delete this->Handle;
+}
+
+int FFmpegAsyncFileSource::Read(uint8_t* buf, int buf_size)
+{
+    if (this->Position >= this->Size) {
+        return AVERROR_EOF;
+    }
+    const int64 BlockOffset = this->Position / this->BlockSize * this->BlockSize;
+    this->UpdateWindow(BlockOffset);
+
+    FBlock& Block = *this->Blocks[0];
+    if (Block.Request) {
+        if (Block.Request->PollCompletion()) {
+            this->Hits++;
+        }
+        else {
+            this->Stalls++;
+        }
+        this->WaitBlock(Block);
+    }
+    if (Block.Failed) {
+        UE_LOG(LogFFmpegMedia, Error, TEXT("AsyncFileSource: read %lld bytes at %lld failed"), Block.Size, Block.Offset);
+        this->ReleaseBlock(Block);
+        this->Blocks.RemoveAt(0); //下次读取时重新请求
+        return AVERROR(EIO);
+    }
+
+    const int64 BlockPos = this->Position - Block.Offset;
+    const int BytesToRead = (int)FMath::Min<int64>(buf_size, Block.Size - BlockPos);
+    FMemory::Memcpy(buf, Block.Data.GetData() + BlockPos, BytesToRead);
+    this->Position += BytesToRead;
+    return BytesToRead;
+}
+
+int64_t FFmpegAsyncFileSource::SeekTo(int64_t pos)
+{
+    //只记录位置，读取时再调整请求窗口，窗口内的块可以继续使用
+    this->Position = pos;
+    return pos;
+}
+
+int64_t FFmpegAsyncFileSource::GetSize() const
+{
+    return this->Size;
+}
+
+int64_t FFmpegAsyncFileSource::GetPosition() const
+{
+    return this->Position;
+}
+
+FString FFmpegAsyncFileSource::GetStats() const
+{
+    return FString::Printf(TEXT("async file, %lld / %lld bytes, block %d KB x %d, %d requests, %d hits, %d stalls, %d discarded"),
+        this->Position, this->Size, this->BlockSize / 1024, this->ReadAhead + 1, this->Requests, this->Hits, this->Stalls, this->Discards);
+}
+
+void FFmpegAsyncFileSource::UpdateWindow(int64 Offset)
+{
+    const int64 WindowEnd = FMath::Min<int64>(Offset + (int64)(this->ReadAhead + 1) * this->BlockSize, this->Size);
+
+    //释放窗口之外的块(跳转之后或者已经读取完的块)
+    for (int i = this->Blocks.Num() - 1; i >= 0; i--) {
+        FBlock& Block = *this->Blocks[i];
+        if (Block.Offset < Offset || Block.Offset >= WindowEnd) {
+            if (Block.Offset > Offset || Block.Request) { //还没有读取就被丢弃
+                this->Discards++;
+            }
+            this->ReleaseBlock(Block);
+            this->Blocks.RemoveAt(i);
+        }
+    }
+
+    //按顺序请求窗口内缺少的块
+    int Index = 0;
+    for (int64 BlockOffset = Offset; BlockOffset < WindowEnd; BlockOffset += this->BlockSize, Index++) {
+        if (Index < this->Blocks.Num() && this->Blocks[Index]->Offset == BlockOffset) {
+            continue;
+        }
+        TUniquePtr<FBlock> Block = MakeUnique<FBlock>();
+        Block->Offset = BlockOffset;
+        Block->Size = FMath::Min<int64>(this->BlockSize, this->Size - BlockOffset);
+        Block->Data.SetNumUninitialized(Block->Size);
+        Block->Failed = false;
+        Block->Request = this->Handle->ReadRequest(Block->Offset, Block->Size, AIOP_Normal, nullptr, Block->Data.GetData());
+        if (!Block->Request) {
+            Block->Failed = true;
+        }
+        this->Requests++;
+        this->Blocks.Insert(MoveTemp(Block), Index);
+    }
+}
+
+void FFmpegAsyncFileSource::WaitBlock(FBlock& Block)
+{
+    if (!Block.Request) {
+        return;
+    }
+    Block.Request->WaitCompletion();
+    //使用自己的内存时返回的就是该内存，读取失败时为空
+    Block.Failed = Block.Request->GetReadResults() == nullptr;
+    delete Block.Request;
+    Block.Request = nullptr;
+}
+
+void FFmpegAsyncFileSource::ReleaseBlock(FBlock& Block)
+{
+    if (!Block.Request) {
+        return;
+    }
+    Block.Request->Cancel();
+    Block.Request->WaitCompletion();
+    delete Block.Request;
+    Block.Request = nullptr;
+}
@@ -0,0 +1,71 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "FFmpegIOSource.h"
+
+class IAsyncReadFileHandle;
+class IAsyncReadRequest;
+
+/**
+ * 通过IAsyncReadFileHandle读取的AVIO数据源
+ * 使用引擎的平台文件层，可以直接读取pak/IoStore中的文件，不需要解压到临时文件
+ * 文件按照块读取，当前块之后始终保持若干个异步读取请求，FFmpeg解复用时后面的数据已经在读取中
+ * 跳转到已经请求的范围内时直接使用，跳出范围时取消其他请求
+ */
+class FFmpegAsyncFileSource : public FFmpegIOSource
+{
+public:
+	/**
+	 * 打开文件
+	 * @param Path 文件路径(可以是pak中的文件)
+	 * @param BlockSize 每次异步读取的大小(字节)
+	 * @param ReadAhead 当前块之后同时进行的异步读取数量
+	 * @return 文件不存在或者无法读取时返回空
+	 */
+	static FFmpegAsyncFileSource* Open(const FString& Path, int BlockSize, int ReadAhead);
+
+	virtual ~FFmpegAsyncFileSource();
+
+	virtual int Read(uint8_t* buf, int buf_size) override;
+	virtual int64_t SeekTo(int64_t pos) override;
+	virtual int64_t GetSize() const override;
+	virtual int64_t GetPosition() const override;
+	virtual FString GetStats() const override;
+
+private:
+	FFmpegAsyncFileSource(IAsyncReadFileHandle* InHandle, int64 InSize, int InBlockSize, int InReadAhead);
+
+	/** 读取块 */
+	struct FBlock
+	{
+		int64 Offset;
+		int64 Size;
+		TArray<uint8> Data; //读取请求使用的内存，请求完成之前不能修改
+		IAsyncReadRequest* Request; //正在进行的读取请求，完成之后为空
+		bool Failed;
+	};
+
+	/** 请求从Offset开始的块，释放窗口之外的块 */
+	void UpdateWindow(int64 Offset);
+
+	/** 等待块读取完成 */
+	void WaitBlock(FBlock& Block);
+
+	/** 取消并释放块 */
+	void ReleaseBlock(FBlock& Block);
+
+private:
+	IAsyncReadFileHandle* Handle;
+	int64 Size;
+	int64 Position;
+	int BlockSize;
+	int ReadAhead;
+	TArray<TUniquePtr<FBlock>> Blocks; //按照位置排序的块，第一个为当前位置所在的块
+	//统计
+	int Requests; //读取请求数
+	int Hits; //读取时块已经完成的次数
+	int Stalls; //读取时需要等待块完成的次数
+	int Discards; //跳转时丢弃的块数
+};
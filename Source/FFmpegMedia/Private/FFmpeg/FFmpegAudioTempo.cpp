@@ -0,0 +1,208 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "FFmpeg/FFmpegAudioTempo.h"
+#include "FFmpegMedia.h"
+extern  "C" {
+#include "libavfilter/avfilter.h"
+#include "libavfilter/buffersink.h"
+#include "libavfilter/buffersrc.h"
+#include "libavutil/frame.h"
+#include "libavutil/opt.h"
+}
+
+/* 单个atempo滤镜支持的最小速率，更小的速率需要串联多个滤镜 */
+#define ATEMPO_MIN 0.5
+
+FFmpegAudioTempo::FFmpegAudioTempo()
+{
+    this->graph = NULL;
+    this->src_ctx = NULL;
+    this->sink_ctx = NULL;
+    this->frame = NULL;
+    this->tempo = 1.0;
+    this->sample_rate = 0;
+    memset(&this->ch_layout, 0, sizeof(this->ch_layout));
+    this->format = AV_SAMPLE_FMT_NONE;
+    this->next_pts = 0;
+}
+
+FFmpegAudioTempo::~FFmpegAudioTempo()
+{
+    this->Close();
+}
+
+int FFmpegAudioTempo::Configure(double tempo_, int sample_rate_, const AVChannelLayout* ch_layout_, enum AVSampleFormat format_)
+{
+    if (this->graph && this->tempo == tempo_ && this->sample_rate == sample_rate_ && this->format == format_
+        && !av_channel_layout_compare(&this->ch_layout, ch_layout_)) {
+        return 0;
+    }
+    if (this->graph && tempo_ >= ATEMPO_MIN && this->tempo >= ATEMPO_MIN && this->sample_rate == sample_rate_ && this->format == format_
+        && !av_channel_layout_compare(&this->ch_layout, ch_layout_)) {
+        char arg[32] = { 0 };
+        snprintf(arg, sizeof(arg), "%f", tempo_);
+        if (avfilter_graph_send_command(this->graph, "atempo", "tempo", arg, NULL, 0, 0) >= 0) {
+            this->tempo = tempo_;
+            return 0;
+        }
+    }
+    this->Close();
+
+    int ret;
+    char layout[64] = { 0 };
+    char args[256] = { 0 };
+    char filters[128] = { 0 };
+    AVFilterInOut* outputs = NULL;
+    AVFilterInOut* inputs = NULL;
+    const enum AVSampleFormat sample_fmts[] = { format_, AV_SAMPLE_FMT_NONE };
+    const int sample_rates[] = { sample_rate_, -1 };
+
+    this->graph = avfilter_graph_alloc();
+    if (!this->graph) {
+        return AVERROR(ENOMEM);
+    }
+    this->graph->nb_threads = 1; //播放器数量很多时，避免每个滤镜图都创建线程
+
+    av_channel_layout_describe(ch_layout_, layout, sizeof(layout));
+    snprintf(args, sizeof(args), "sample_rate=%d:sample_fmt=%s:time_base=1/%d:channel_layout=%s",
+        sample_rate_, av_get_sample_fmt_name(format_), sample_rate_, layout);
+    if ((ret = avfilter_graph_create_filter(&this->src_ctx, avfilter_get_by_name("abuffer"), "in", args, NULL, this->graph)) < 0)
+        goto fail;
+    if ((ret = avfilter_graph_create_filter(&this->sink_ctx, avfilter_get_by_name("abuffersink"), "out", NULL, NULL, this->graph)) < 0)
+        goto fail;
+    if ((ret = av_opt_set_int_list(this->sink_ctx, "sample_fmts", sample_fmts, AV_SAMPLE_FMT_NONE, AV_OPT_SEARCH_CHILDREN)) < 0)
+        goto fail;
+    if ((ret = av_opt_set_int_list(this->sink_ctx, "sample_rates", sample_rates, -1, AV_OPT_SEARCH_CHILDREN)) < 0)
+        goto fail;
+    if ((ret = av_opt_set(this->sink_ctx, "ch_layouts", layout, AV_OPT_SEARCH_CHILDREN)) < 0)
+        goto fail;
+
+    //atempo单个滤镜最小支持0.5，更小的速率串联两个滤镜
+    if (tempo_ < ATEMPO_MIN) {
+        double t = sqrt(tempo_);
+        snprintf(filters, sizeof(filters), "atempo=%f,atempo=%f", t, t);
+    }
+    else {
+        snprintf(filters, sizeof(filters), "atempo=%f", tempo_);
+    }
+
+    outputs = avfilter_inout_alloc();
+    inputs = avfilter_inout_alloc();
+    if (!outputs || !inputs) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    outputs->name = av_strdup("in");
+    outputs->filter_ctx = this->src_ctx;
+    outputs->pad_idx = 0;
+    outputs->next = NULL;
+    inputs->name = av_strdup("out");
+    inputs->filter_ctx = this->sink_ctx;
+    inputs->pad_idx = 0;
+    inputs->next = NULL;
+    if ((ret = avfilter_graph_parse_ptr(this->graph, filters, &inputs, &outputs, NULL)) < 0)
+        goto fail;
+    if ((ret = avfilter_graph_config(this->graph, NULL)) < 0)
+        goto fail;
+
+    this->frame = av_frame_alloc();
+    if (!this->frame) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    this->tempo = tempo_;
+    this->sample_rate = sample_rate_;
+    this->format = format_;
+    av_channel_layout_copy(&this->ch_layout, ch_layout_);
+    this->next_pts = 0;
+    avfilter_inout_free(&outputs);
+    avfilter_inout_free(&inputs);
+    UE_LOG(LogFFmpegMedia, Verbose, TEXT("AudioTempo: %p: configure %s"), this, UTF8_TO_TCHAR(filters));
+    return 0;
+fail:
+    UE_LOG(LogFFmpegMedia, Error, TEXT("AudioTempo: %p: configure atempo %f fail"), this, tempo_);
+    avfilter_inout_free(&outputs);
+    avfilter_inout_free(&inputs);
+    this->Close();
+    return ret;
+}
+
+int FFmpegAudioTempo::Process(const uint8_t* data, int nb_samples, TArray<uint8>& OutBuffer)
+{
+    int ret;
+    OutBuffer.Reset();
+    if (!this->graph) {
+        return AVERROR(EINVAL);
+    }
+
+    //输入数据包装成帧
+    this->frame->nb_samples = nb_samples;
+    this->frame->format = this->format;
+    this->frame->sample_rate = this->sample_rate;
+    this->frame->pts = this->next_pts;
+    av_channel_layout_copy(&this->frame->ch_layout, &this->ch_layout);
+    if ((ret = av_frame_get_buffer(this->frame, 0)) < 0) {
+        av_frame_unref(this->frame);
+        return ret;
+    }
+    memcpy(this->frame->data[0], data, av_samples_get_buffer_size(NULL, this->ch_layout.nb_channels, nb_samples, this->format, 1));
+    this->next_pts += nb_samples;
+    ret = av_buffersrc_add_frame(this->src_ctx, this->frame); //成功之后帧的引用转移给滤镜
+    av_frame_unref(this->frame);
+    if (ret < 0) {
+        return ret;
+    }
+
+    //取出所有已经处理的数据
+    for (;;) {
+        ret = av_buffersink_get_frame(this->sink_ctx, this->frame);
+        if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
+            break;
+        }
+        if (ret < 0) {
+            return ret;
+        }
+        int size = av_samples_get_buffer_size(NULL, this->frame->ch_layout.nb_channels, this->frame->nb_samples, (enum AVSampleFormat)this->frame->format, 1);
+        OutBuffer.Append(this->frame->data[0], size);
+        av_frame_unref(this->frame);
+    }
+    return OutBuffer.Num();
+}
+
+void FFmpegAudioTempo::Flush()
+{
+    //atempo没有清空缓存的接口，重新创建滤镜图
+    if (this->graph) {
+        double tempo_ = this->tempo;
+        int sample_rate_ = this->sample_rate;
+        enum AVSampleFormat format_ = this->format;
+        AVChannelLayout layout_ = { };
+        av_channel_layout_copy(&layout_, &this->ch_layout);
+        this->Close();
+        this->Configure(tempo_, sample_rate_, &layout_, format_);
+        av_channel_layout_uninit(&layout_);
+    }
+}
+
+void FFmpegAudioTempo::Close()
+{
+    avfilter_graph_free(&this->graph);
+    this->src_ctx = NULL;
+    this->sink_ctx = NULL;
+    av_frame_free(&this->frame);
+    av_channel_layout_uninit(&this->ch_layout);
+    this->tempo = 1.0;
+    this->sample_rate = 0;
+    this->format = AV_SAMPLE_FMT_NONE;
+}
+
+double FFmpegAudioTempo::GetTempo() const
+{
+    return this->tempo;
+}
+
+bool FFmpegAudioTempo::IsOpen() const
+{
+    return this->graph != NULL;
+}
@@ -0,0 +1,63 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+extern "C" {
+#include "libavutil/channel_layout.h"
+#include "libavutil/samplefmt.h"
+}
+
+struct AVFilterGraph;
+struct AVFilterContext;
+struct AVFrame;
+
+/**
+ * 音频变速不变调(libavfilter atempo)
+ * 输入和输出都是交错格式的音频，每个播放器只在速率不为1时创建一个单线程的滤镜图
+ */
+class FFmpegAudioTempo
+{
+public:
+	FFmpegAudioTempo();
+	~FFmpegAudioTempo();
+public:
+	/**
+	 * 设置速率，音频格式改变时重新创建滤镜图
+	 * 只有速率改变并且单个atempo滤镜能够处理时通过滤镜命令修改速率，滤镜中缓存的数据不会丢失(用于实时流的平滑追赶)
+	 * @param tempo 速率(0.25 ~ 4)
+	 * @return 成功返回0
+	 */
+	int Configure(double tempo, int sample_rate, const AVChannelLayout* ch_layout, enum AVSampleFormat format);
+
+	/**
+	 * 变速处理
+	 * @param data 输入音频数据
+	 * @param nb_samples 输入样本数(每个声道)
+	 * @param OutBuffer 输出音频数据
+	 * @return 输出的字节数，滤镜缓存了数据时可能为0，失败返回负数
+	 */
+	int Process(const uint8_t* data, int nb_samples, TArray<uint8>& OutBuffer);
+
+	/** 清空滤镜中缓存的数据(seek之后调用) */
+	void Flush();
+
+	/** 释放滤镜图 */
+	void Close();
+
+	/** 当前速率 */
+	double GetTempo() const;
+
+	/** 滤镜图是否已经创建 */
+	bool IsOpen() const;
+private:
+	AVFilterGraph* graph;
+	AVFilterContext* src_ctx;
+	AVFilterContext* sink_ctx;
+	AVFrame* frame;
+	double tempo;
+	int sample_rate;
+	AVChannelLayout ch_layout;
+	enum AVSampleFormat format;
+	int64_t next_pts;
+};
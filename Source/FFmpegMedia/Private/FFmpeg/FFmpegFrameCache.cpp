@@ -0,0 +1,166 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "FFmpeg/FFmpegFrameCache.h"
+
+/* 查找时允许的误差(秒)，pts换算成秒之后可能存在精度误差 */
+#define FRAME_CACHE_PTS_EPSILON 0.0005
+
+FFmpegFrameCache::FFmpegFrameCache()
+{
+    this->Budget = 0;
+    this->Size = 0;
+    this->Hits = 0;
+    this->Misses = 0;
+    this->Evictions = 0;
+}
+
+FFmpegFrameCache::~FFmpegFrameCache()
+{
+}
+
+void FFmpegFrameCache::SetBudget(int64 bytes)
+{
+    FScopeLock Lock(&Mutex);
+    this->Budget = FMath::Max<int64>(bytes, 0);
+    this->Evict();
+}
+
+bool FFmpegFrameCache::IsEnabled() const
+{
+    FScopeLock Lock(&Mutex);
+    return this->Budget > 0;
+}
+
+void FFmpegFrameCache::Add(double pts, double duration, const TSharedRef<IMediaTextureSample, ESPMode::ThreadSafe>& Sample)
+{
+    FScopeLock Lock(&Mutex);
+    int64 SampleSize = (int64)Sample->GetStride() * Sample->GetDim().Y;
+    if (this->Budget <= 0 || SampleSize > this->Budget || FMath::IsNaN(pts)) {
+        return;
+    }
+
+    int index = this->FindIndex(pts);
+    if (index >= 0 && FMath::Abs(this->Entries[index].Pts - pts) < FRAME_CACHE_PTS_EPSILON) { //已经存在，替换
+        FCacheEntry& Entry = this->Entries[index];
+        this->Size -= Entry.Size;
+        Entry.Duration = duration;
+        Entry.Size = SampleSize;
+        Entry.Sample = Sample;
+        this->Touch(Entry);
+    }
+    else {
+        FCacheEntry Entry;
+        Entry.Pts = pts;
+        Entry.Duration = duration;
+        Entry.Size = SampleSize;
+        Entry.Sample = Sample;
+        this->LruList.AddHead(pts);
+        Entry.LruNode = this->LruList.GetHead();
+        this->Entries.Insert(Entry, index + 1);
+    }
+    this->Size += SampleSize;
+    this->Evict();
+}
+
+TSharedPtr<IMediaTextureSample, ESPMode::ThreadSafe> FFmpegFrameCache::Find(double time)
+{
+    FScopeLock Lock(&Mutex);
+    int index = this->FindIndex(time + FRAME_CACHE_PTS_EPSILON);
+    if (index >= 0) {
+        FCacheEntry& Entry = this->Entries[index];
+        if (time < Entry.Pts + FMath::Max(Entry.Duration, FRAME_CACHE_PTS_EPSILON)) {
+            this->Touch(Entry);
+            this->Hits++;
+            return Entry.Sample;
+        }
+    }
+    this->Misses++;
+    return nullptr;
+}
+
+TSharedPtr<IMediaTextureSample, ESPMode::ThreadSafe> FFmpegFrameCache::FindRelative(double time, int offset, double& OutPts)
+{
+    FScopeLock Lock(&Mutex);
+    int index = this->FindIndex(time + FRAME_CACHE_PTS_EPSILON);
+    int target = index + offset;
+    //当前帧必须在缓存中，并且和目标帧之间是连续的(相邻帧的间隔不超过帧时长的1.5倍)
+    if (index < 0 || target < 0 || target >= this->Entries.Num()
+        || time >= this->Entries[index].Pts + FMath::Max(this->Entries[index].Duration, FRAME_CACHE_PTS_EPSILON)) {
+        this->Misses++;
+        return nullptr;
+    }
+    int first = FMath::Min(index, target), last = FMath::Max(index, target);
+    for (int i = first; i < last; i++) {
+        double gap = this->Entries[i + 1].Pts - this->Entries[i].Pts;
+        if (this->Entries[i].Duration > 0 && gap > this->Entries[i].Duration * 1.5) {
+            this->Misses++;
+            return nullptr;
+        }
+    }
+    FCacheEntry& Entry = this->Entries[target];
+    this->Touch(Entry);
+    this->Hits++;
+    OutPts = Entry.Pts;
+    return Entry.Sample;
+}
+
+bool FFmpegFrameCache::Contains(double time) const
+{
+    FScopeLock Lock(&Mutex);
+    int index = this->FindIndex(time + FRAME_CACHE_PTS_EPSILON);
+    return index >= 0 && time < this->Entries[index].Pts + FMath::Max(this->Entries[index].Duration, FRAME_CACHE_PTS_EPSILON);
+}
+
+void FFmpegFrameCache::Clear()
+{
+    FScopeLock Lock(&Mutex);
+    this->Entries.Empty();
+    this->LruList.Empty();
+    this->Size = 0;
+}
+
+FString FFmpegFrameCache::GetStats() const
+{
+    FScopeLock Lock(&Mutex);
+    return FString::Printf(TEXT("%d frames, %.1f / %.1f MB, hits %lld, misses %lld, evictions %lld"),
+        this->Entries.Num(), this->Size / (1024.0 * 1024.0), this->Budget / (1024.0 * 1024.0), this->Hits, this->Misses, this->Evictions);
+}
+
+int FFmpegFrameCache::FindIndex(double time) const
+{
+    int low = 0, high = this->Entries.Num() - 1, found = -1;
+    while (low <= high) {
+        int mid = (low + high) / 2;
+        if (this->Entries[mid].Pts <= time) {
+            found = mid;
+            low = mid + 1;
+        }
+        else {
+            high = mid - 1;
+        }
+    }
+    return found;
+}
+
+void FFmpegFrameCache::Touch(FCacheEntry& Entry)
+{
+    if (this->LruList.GetHead() != Entry.LruNode) {
+        this->LruList.RemoveNode(Entry.LruNode, false);
+        this->LruList.AddHead(Entry.LruNode);
+    }
+}
+
+void FFmpegFrameCache::Evict()
+{
+    //链表尾部是最久没有使用的帧，按照pts二分查找对应的缓存项
+    while (this->Size > this->Budget && this->LruList.Num() > 0) {
+        FLruNode* oldest = this->LruList.GetTail();
+        int index = this->FindIndex(oldest->GetValue());
+        check(index >= 0 && this->Entries[index].LruNode == oldest);
+        this->Size -= this->Entries[index].Size;
+        this->Entries.RemoveAt(index);
+        this->LruList.RemoveNode(oldest);
+        this->Evictions++;
+    }
+}
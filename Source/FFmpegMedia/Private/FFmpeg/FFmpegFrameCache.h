@@ -0,0 +1,90 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/List.h"
+#include "IMediaTextureSample.h"
+
+/**
+ * 已转换视频帧(纹理样本)的LRU缓存
+ * 保存播放头附近已经显示或者预取的帧，回退、逐帧后退或者重复拖动到同一区域时只需要查找，不需要重新解码
+ * 缓存按照pts排序，超出内存预算时淘汰最久没有使用的帧(使用顺序保存在链表中，添加和查找时不需要遍历缓存)
+ * 只在播放器中预取向后方向(向后seek时目标位置之前的帧)；向前方向不预取，暂停时解码器停在当前帧之后，
+ * 帧队列中已经解码的帧就是向前逐帧需要的帧，提前解码更多帧会让解码位置离开当前帧
+ */
+class FFmpegFrameCache
+{
+public:
+	FFmpegFrameCache();
+	~FFmpegFrameCache();
+public:
+	/** 
+	 * 设置内存预算(字节)，0表示关闭缓存
+	 */
+	void SetBudget(int64 bytes);
+
+	/** 缓存是否开启 */
+	bool IsEnabled() const;
+
+	/**
+	 * 添加帧，pts已经存在时替换
+	 * @param pts 帧显示时间(秒)
+	 * @param duration 帧时长(秒)
+	 * @param Sample 纹理样本
+	 */
+	void Add(double pts, double duration, const TSharedRef<IMediaTextureSample, ESPMode::ThreadSafe>& Sample);
+
+	/**
+	 * 查找包含指定时间的帧
+	 * @param time 时间(秒)
+	 * @return 没有找到时返回空指针
+	 */
+	TSharedPtr<IMediaTextureSample, ESPMode::ThreadSafe> Find(double time);
+
+	/**
+	 * 查找指定时间之前(offset < 0)或者之后(offset > 0)第offset个帧
+	 * @param time 当前帧时间(秒)
+	 * @param offset 帧偏移
+	 * @param OutPts 找到的帧的pts
+	 */
+	TSharedPtr<IMediaTextureSample, ESPMode::ThreadSafe> FindRelative(double time, int offset, double& OutPts);
+
+	/** 是否包含指定时间的帧 */
+	bool Contains(double time) const;
+
+	/** 清空缓存(切换视频流或者关闭时调用) */
+	void Clear();
+
+	/** 获取统计信息 */
+	FString GetStats() const;
+private:
+	typedef TDoubleLinkedList<double>::TDoubleLinkedListNode FLruNode;
+
+	struct FCacheEntry
+	{
+		double Pts;
+		double Duration;
+		int64 Size;
+		FLruNode* LruNode; //在使用顺序链表中的节点，值为Pts
+		TSharedPtr<IMediaTextureSample, ESPMode::ThreadSafe> Sample;
+	};
+
+	/** 二分查找最后一个 Pts <= time 的帧，没有时返回-1 */
+	int FindIndex(double time) const;
+
+	/** 标记为最近使用(移动到链表头部) */
+	void Touch(FCacheEntry& Entry);
+
+	/** 淘汰最久没有使用的帧，直到缓存大小不超过预算 */
+	void Evict();
+private:
+	mutable FCriticalSection Mutex;
+	TArray<FCacheEntry> Entries; //按照pts排序
+	TDoubleLinkedList<double> LruList; //使用顺序，头部为最近使用，尾部最先淘汰
+	int64 Budget;
+	int64 Size;
+	int64 Hits;
+	int64 Misses;
+	int64 Evictions;
+};
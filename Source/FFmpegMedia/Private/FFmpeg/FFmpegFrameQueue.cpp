@@ -5,8 +5,9 @@
 
 FFmpegFrameQueue::FFmpegFrameQueue()
 {
+    //节点在Init中按需创建，未使用的队列(比如纯音频模式下的视频队列)不占用内存
     for (int i = 0; i < FRAME_QUEUE_SIZE; i++) {
-        queue[i] = new FFmpegFrame();
+        queue[i] = nullptr;
     }
     rindex = 0;
     windex = 0;
@@ -39,9 +40,12 @@ int FFmpegFrameQueue::Init(FFmpegPacketQueue* pktq_, int max_size_, int keep_las
     this->pktq = pktq_;
     this->max_size = FFMIN(max_size_, FRAME_QUEUE_SIZE);
     this->keep_last = !!keep_last_;
-    for (i = 0; i < this->max_size; i++)
+    for (i = 0; i < this->max_size; i++) {
+        if (!this->queue[i])
+            this->queue[i] = new FFmpegFrame();
         if (!(this->queue[i]->Init()))
             return AVERROR(ENOMEM);
+    }
     return 0;
 }
 
@@ -50,10 +54,9 @@ void FFmpegFrameQueue::Destory()
     int i;
     for (i = 0; i < this->max_size; i++) {
         FFmpegFrame* vp = this->queue[i];
-        if (vp != nullptr) {
+        if (vp != nullptr && vp->frame != nullptr) {
             vp->UnrefItem();
-            AVFrame* frame = vp->GetFrame();
-            av_frame_free(&frame);
+            av_frame_free(&vp->frame); //同时置空，防止重复释放
         }
     }
     //与ffplay不同, 因为会重复利用，所以此处尽可能重置所有字段
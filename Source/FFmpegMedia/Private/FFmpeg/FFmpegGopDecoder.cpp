@@ -0,0 +1,272 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "FFmpeg/FFmpegGopDecoder.h"
+#include "FFmpegMedia.h"
+#include "LambdaFunctionRunnable.h"
+extern  "C" {
+#include "libavutil/time.h"
+}
+
+FFmpegGopDecoder::FFmpegGopDecoder()
+{
+    this->avctx = NULL;
+    this->time_base = { 0, 1 };
+    this->frame = NULL;
+    this->decoder_thread = nullptr;
+    this->abort_request = 0;
+    this->cond = nullptr;
+    this->decoding = 0;
+    this->gop_count = 0;
+    this->frame_count = 0;
+    this->decode_time_total = 0.0;
+}
+
+FFmpegGopDecoder::~FFmpegGopDecoder()
+{
+    this->Stop();
+}
+
+int FFmpegGopDecoder::Start(AVStream* st, bool keyframes_only)
+{
+    int ret;
+    const AVCodec* codec = avcodec_find_decoder(st->codecpar->codec_id);
+    if (!codec) {
+        return AVERROR(EINVAL);
+    }
+    this->avctx = avcodec_alloc_context3(codec);
+    if (!this->avctx) {
+        return AVERROR(ENOMEM);
+    }
+    if ((ret = avcodec_parameters_to_context(this->avctx, st->codecpar)) < 0) {
+        goto fail;
+    }
+    this->avctx->pkt_timebase = st->time_base;
+    this->avctx->thread_count = 0; //自动设置解码线程数
+    if (keyframes_only) {
+        this->avctx->skip_frame = AVDISCARD_NONKEY;
+    }
+    if ((ret = avcodec_open2(this->avctx, codec, NULL)) < 0) {
+        goto fail;
+    }
+    this->frame = av_frame_alloc();
+    if (!this->frame) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    this->time_base = st->time_base;
+    this->abort_request = 0;
+    this->cond = new FFmpegCond();
+    this->decoder_thread = LambdaFunctionRunnable::RunThreaded(TEXT("GopDecoderThread"), [this] {
+        DecodeThread();
+    });
+    if (!this->decoder_thread) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    return 0;
+fail:
+    UE_LOG(LogFFmpegMedia, Error, TEXT("GopDecoder: %p: start fail"), this);
+    this->Stop();
+    return ret;
+}
+
+void FFmpegGopDecoder::Stop()
+{
+    {
+        FScopeLock Lock(&Mutex);
+        this->abort_request = 1;
+        if (this->cond) {
+            this->cond->signal();
+        }
+    }
+    if (this->decoder_thread) {
+        this->decoder_thread->WaitForCompletion();
+        this->decoder_thread = nullptr;
+    }
+
+    FScopeLock Lock(&Mutex);
+    for (FGop& Gop : this->Gops) {
+        FreeGop(Gop);
+    }
+    this->Gops.Empty();
+    for (TArray<AVFrame*>& Chunk : this->Chunks) {
+        FreeFrames(Chunk);
+    }
+    this->Chunks.Empty();
+    av_frame_free(&this->frame);
+    avcodec_free_context(&this->avctx);
+    if (this->cond) {
+        delete this->cond;
+        this->cond = nullptr;
+    }
+    this->decoding = 0;
+}
+
+bool FFmpegGopDecoder::CanPushGop()
+{
+    FScopeLock Lock(&Mutex);
+    return this->Gops.Num() < GOP_DECODER_MAX_PENDING_GOPS;
+}
+
+void FFmpegGopDecoder::PushGop(TArray<AVPacket*>& Packets, double Start, double End)
+{
+    FScopeLock Lock(&Mutex);
+    FGop& Gop = this->Gops.AddDefaulted_GetRef();
+    Gop.Packets = MoveTemp(Packets);
+    Gop.Start = Start;
+    Gop.End = End;
+    Packets.Reset();
+    if (this->cond) {
+        this->cond->signal();
+    }
+}
+
+bool FFmpegGopDecoder::PopChunk(TArray<AVFrame*>& OutFrames)
+{
+    FScopeLock Lock(&Mutex);
+    if (this->Chunks.Num() == 0) {
+        return false;
+    }
+    OutFrames = MoveTemp(this->Chunks[0]);
+    this->Chunks.RemoveAt(0);
+    if (this->cond) {
+        this->cond->signal(); //唤醒等待输出空间的解码线程
+    }
+    return true;
+}
+
+bool FFmpegGopDecoder::IsIdle()
+{
+    FScopeLock Lock(&Mutex);
+    return this->Gops.Num() == 0 && this->Chunks.Num() == 0 && !this->decoding;
+}
+
+FString FFmpegGopDecoder::GetStats() const
+{
+    FScopeLock Lock(&Mutex);
+    return FString::Printf(TEXT("%d GOPs, %d frames, avg %.1f ms per GOP"),
+        this->gop_count, this->frame_count, this->gop_count > 0 ? this->decode_time_total / this->gop_count * 1000.0 : 0.0);
+}
+
+void FFmpegGopDecoder::DecodeThread()
+{
+    for (;;) {
+        FGop Gop;
+        {
+            FScopeLock Lock(&Mutex);
+            while (!this->abort_request && this->Gops.Num() == 0) {
+                this->cond->waitTimeout(Mutex, 10);
+            }
+            if (this->abort_request) {
+                break;
+            }
+            Gop = MoveTemp(this->Gops[0]);
+            this->Gops.RemoveAt(0);
+            this->decoding = 1;
+        }
+
+        double start = av_gettime_relative() / 1000000.0;
+        //收集GOP中需要输出的帧的pts，按照每块最多GOP_DECODER_MAX_CHUNK_FRAMES帧分块
+        TArray<double> Times;
+        for (AVPacket* pkt : Gop.Packets) {
+            int64_t pts = pkt->pts != AV_NOPTS_VALUE ? pkt->pts : pkt->dts;
+            if (pts == AV_NOPTS_VALUE) {
+                continue;
+            }
+            double t = pts * av_q2d(this->time_base);
+            if (t >= Gop.Start && t < Gop.End) {
+                Times.Add(t);
+            }
+        }
+        Times.Sort();
+
+        //从后往前解码每个块，每次都需要从关键帧开始解码
+        int chunk_end_index = Times.Num();
+        while (chunk_end_index > 0 && !this->abort_request) {
+            int chunk_start_index = FMath::Max(0, chunk_end_index - GOP_DECODER_MAX_CHUNK_FRAMES);
+            double chunk_start = chunk_start_index == 0 ? Gop.Start : Times[chunk_start_index]; //open GOP中关键帧之前的帧属于前一个GOP，不输出
+            double chunk_end = chunk_end_index == Times.Num() ? Gop.End : Times[chunk_end_index];
+            TArray<AVFrame*> Frames;
+            if (this->DecodeChunk(Gop, chunk_start, chunk_end, chunk_end_index - chunk_start_index, Frames) < 0) {
+                FreeFrames(Frames);
+                break;
+            }
+
+            FScopeLock Lock(&Mutex);
+            //等待显示线程取走已经解码的块，限制内存占用
+            while (!this->abort_request && this->Chunks.Num() >= GOP_DECODER_MAX_READY_CHUNKS) {
+                this->cond->waitTimeout(Mutex, 10);
+            }
+            if (this->abort_request) {
+                FreeFrames(Frames);
+                break;
+            }
+            this->frame_count += Frames.Num();
+            this->Chunks.Add(MoveTemp(Frames));
+            chunk_end_index = chunk_start_index;
+        }
+        FreeGop(Gop);
+
+        FScopeLock Lock(&Mutex);
+        this->gop_count++;
+        this->decode_time_total += av_gettime_relative() / 1000000.0 - start;
+        this->decoding = 0;
+    }
+    UE_LOG(LogFFmpegMedia, Log, TEXT("GopDecoder: %p: GopDecoderThread exit"), this);
+}
+
+int FFmpegGopDecoder::DecodeChunk(FGop& Gop, double ChunkStart, double ChunkEnd, int ExpectedFrames, TArray<AVFrame*>& OutFrames)
+{
+    int ret = 0;
+    avcodec_flush_buffers(this->avctx);
+    for (int i = 0; i <= Gop.Packets.Num() && !this->abort_request; i++) {
+        //最后发送空包，取出解码器中剩余的帧
+        ret = avcodec_send_packet(this->avctx, i < Gop.Packets.Num() ? Gop.Packets[i] : NULL);
+        if (ret < 0 && ret != AVERROR(EAGAIN)) {
+            //跳过损坏的数据包
+            continue;
+        }
+        for (;;) {
+            ret = avcodec_receive_frame(this->avctx, this->frame);
+            if (ret < 0) {
+                break;
+            }
+            int64_t pts = this->frame->best_effort_timestamp;
+            double t = pts == AV_NOPTS_VALUE ? NAN : pts * av_q2d(this->time_base);
+            if (!isnan(t) && t >= ChunkStart && t < ChunkEnd) {
+                this->frame->pts = pts;
+                OutFrames.Add(av_frame_clone(this->frame));
+            }
+            av_frame_unref(this->frame);
+        }
+        if (ret == AVERROR_EOF) {
+            break;
+        }
+        //已经得到块中所有的帧，后面的数据包不需要再解码
+        if (OutFrames.Num() >= ExpectedFrames) {
+            break;
+        }
+    }
+    if (this->abort_request) {
+        return AVERROR_EXIT;
+    }
+    OutFrames.Sort([](const AVFrame& A, const AVFrame& B) { return A.pts < B.pts; });
+    return 0;
+}
+
+void FFmpegGopDecoder::FreeGop(FGop& Gop)
+{
+    for (AVPacket*& pkt : Gop.Packets) {
+        av_packet_free(&pkt);
+    }
+    Gop.Packets.Empty();
+}
+
+void FFmpegGopDecoder::FreeFrames(TArray<AVFrame*>& Frames)
+{
+    for (AVFrame*& f : Frames) {
+        av_frame_free(&f);
+    }
+    Frames.Empty();
+}
@@ -0,0 +1,95 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "FFmpegCond.h"
+extern "C" {
+    #include <libavcodec/avcodec.h>
+    #include <libavformat/avformat.h>
+}
+
+/* 同时存在的GOP数量(一个等待解码，一个正在解码)，读取线程在此之外不会再读取新的GOP */
+#define GOP_DECODER_MAX_PENDING_GOPS 1
+/* 已经解码完成等待显示的块数量 */
+#define GOP_DECODER_MAX_READY_CHUNKS 2
+/* 每个块最多保留的帧数，GOP超过该帧数时分多次解码，限制内存占用 */
+#define GOP_DECODER_MAX_CHUNK_FRAMES 60
+
+/**
+ * 倒放使用的GOP解码器
+ * 读取线程按照从后往前的顺序提交整个GOP的数据包，解码线程(使用独立的解码器上下文)把GOP解码成帧，
+ * 按照从后往前的顺序输出帧块，每个块中的帧按照pts升序排列，显示时从块的末尾往前取
+ */
+class FFmpegGopDecoder
+{
+public:
+    FFmpegGopDecoder();
+    ~FFmpegGopDecoder();
+public:
+    /** 
+     * 打开解码器并启动解码线程
+     * @param st 视频流
+     * @param keyframes_only 只解码关键帧(快进快退时使用)
+     */
+    int Start(AVStream* st, bool keyframes_only = false);
+
+    /** 停止解码线程，释放所有数据包和帧 */
+    void Stop();
+
+    /** 是否可以提交新的GOP */
+    bool CanPushGop();
+
+    /**
+     * 提交一个GOP，数据包的所有权转移给解码器
+     * @param Packets GOP中的数据包(解码顺序，第一个为关键帧)
+     * @param Start GOP起始时间(关键帧pts，秒)
+     * @param End 只输出小于该时间的帧(秒)
+     */
+    void PushGop(TArray<AVPacket*>& Packets, double Start, double End);
+
+    /**
+     * 取出一个解码完成的块，帧的所有权转移给调用者
+     * @param OutFrames 帧(按照pts升序)
+     * @return 没有解码完成的块时返回false
+     */
+    bool PopChunk(TArray<AVFrame*>& OutFrames);
+
+    /** 是否还有没有输出的GOP或者块 */
+    bool IsIdle();
+
+    /** 获取统计信息 */
+    FString GetStats() const;
+private:
+    struct FGop
+    {
+        TArray<AVPacket*> Packets;
+        double Start;
+        double End;
+    };
+
+    /** 解码线程 */
+    void DecodeThread();
+
+    /** 解码GOP中[ChunkStart, ChunkEnd)范围内的帧 */
+    int DecodeChunk(FGop& Gop, double ChunkStart, double ChunkEnd, int ExpectedFrames, TArray<AVFrame*>& OutFrames);
+
+    static void FreeGop(FGop& Gop);
+    static void FreeFrames(TArray<AVFrame*>& Frames);
+private:
+    AVCodecContext* avctx;
+    AVRational time_base;
+    AVFrame* frame;
+    FRunnableThread* decoder_thread;
+    int abort_request;
+    mutable FCriticalSection Mutex;
+    FFmpegCond* cond;
+    TArray<FGop> Gops;
+    TArray<TArray<AVFrame*>> Chunks;
+    int decoding;
+
+    //统计
+    int gop_count;
+    int frame_count;
+    double decode_time_total;
+};
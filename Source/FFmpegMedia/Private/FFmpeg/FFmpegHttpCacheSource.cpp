@@ -0,0 +1,376 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "FFmpeg/FFmpegHttpCacheSource.h"
+#include "FFmpegMedia.h"
+#include "HAL/FileManager.h"
+#include "HAL/PlatformFileManager.h"
+#include "HAL/PlatformProcess.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Misc/SecureHash.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+#include "HttpModule.h"
+#include "Interfaces/IHttpRequest.h"
+#include "Interfaces/IHttpResponse.h"
+extern  "C" {
+#include "libavutil/error.h"
+}
+
+/* 缓存类别和索引版本，索引格式修改之后需要增加版本号 */
+#define HTTP_CACHE_CATEGORY TEXT("HttpCache")
+#define HTTP_CACHE_MAGIC 0x48434646 // "FFCH"
+#define HTTP_CACHE_VERSION 2
+/* 验证缓存的HEAD请求的超时(秒) */
+#define HTTP_CACHE_VALIDATE_TIMEOUT 5.0
+/* 新缓存的数据超过该大小时保存一次索引，异常退出时最多丢失这部分缓存 */
+#define HTTP_CACHE_SAVE_INTERVAL (8 * 1024 * 1024)
+
+/** 正在使用的缓存文件，同一个地址同时只能由一个播放器缓存 */
+static FCriticalSection InUseMutex;
+static TSet<FString> InUseFiles;
+
+FFmpegHttpCacheSource* FFmpegHttpCacheSource::Open(const FString& Url, FFmpegIOSource* InSource, int64 MaxCacheSize, const int* abort_flag)
+{
+    const int64 Size = InSource->GetSize();
+    if (MaxCacheSize <= 0 || Size <= 0 || Size > MaxCacheSize) {
+        return nullptr;
+    }
+    //HLS/DASH播放列表的内容会变化，不缓存
+    FString Path = Url;
+    int32 QueryIndex = INDEX_NONE;
+    if (Path.FindChar(TEXT('?'), QueryIndex)) {
+        Path.LeftInline(QueryIndex);
+    }
+    if (Path.EndsWith(TEXT(".m3u8")) || Path.EndsWith(TEXT(".m3u")) || Path.EndsWith(TEXT(".mpd"))) {
+        return nullptr;
+    }
+
+    const FString Directory = FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("FFmpegMedia"), HTTP_CACHE_CATEGORY);
+    const FString CacheFile = FPaths::Combine(Directory, FMD5::HashAnsiString(*Url) + TEXT(".data"));
+    {
+        FScopeLock Lock(&InUseMutex);
+        if (InUseFiles.Contains(CacheFile)) {
+            UE_LOG(LogFFmpegMedia, Verbose, TEXT("HttpCache: %s is already cached by another player"), *Url);
+            return nullptr;
+        }
+        InUseFiles.Add(CacheFile);
+    }
+
+    //为当前文件预留空间
+    Trim(Directory, CacheFile, MaxCacheSize - Size);
+    IFileManager::Get().MakeDirectory(*Directory, true);
+    IFileHandle* File = FPlatformFileManager::Get().GetPlatformFile().OpenWrite(*CacheFile, true, true);
+    if (!File) {
+        UE_LOG(LogFFmpegMedia, Warning, TEXT("HttpCache: could not open cache file %s"), *CacheFile);
+        FScopeLock Lock(&InUseMutex);
+        InUseFiles.Remove(CacheFile);
+        return nullptr;
+    }
+    FFmpegHttpCacheSource* Source = new FFmpegHttpCacheSource(Url, CacheFile, InSource, File);
+    //请求失败时验证头为空，索引中保存了验证头的缓存不再使用
+    if (!QueryValidators(Url, abort_flag, Source->ETag, Source->LastModified)) {
+        UE_LOG(LogFFmpegMedia, Verbose, TEXT("HttpCache: could not query validators of %s"), *Url);
+    }
+    if (!Source->LoadIndex()) {
+        Source->Ranges.Reset();
+    }
+    IFileManager::Get().SetTimeStamp(*CacheFile, FDateTime::UtcNow()); //记录最近使用时间
+    UE_LOG(LogFFmpegMedia, Verbose, TEXT("HttpCache: %s -> %s (%d cached ranges, ETag %s, Last-Modified %s)"), *Url, *CacheFile, Source->Ranges.Num(), *Source->ETag, *Source->LastModified);
+    return Source;
+}
+
+FFmpegHttpCacheSource::FFmpegHttpCacheSource(const FString& InUrl, const FString& InCacheFile, FFmpegIOSource* InSource, IFileHandle* InFile)
+    : Url(InUrl)
+    , CacheFile(InCacheFile)
+{
+    this->Source = InSource;
+    this->File = InFile;
+    this->Size = InSource->GetSize();
+    this->Position = 0;
+    this->WriteFailed = false;
+    this->UnsavedBytes = 0;
+    this->DiskBytes = 0;
+    this->NetworkBytes = 0;
+    this->NetworkSeeks = 0;
+}
+
+FFmpegHttpCacheSource::~FFmpegHttpCacheSource()
+{
+    this->SaveIndex();
+    delete this->File;
+    delete this->Source;
+    FScopeLock Lock(&InUseMutex);
+    InUseFiles.Remove(this->CacheFile);
+}
+
+int FFmpegHttpCacheSource::Read(uint8_t* buf, int buf_size)
+{
+    if (this->Position >= this->Size) {
+        return AVERROR_EOF;
+    }
+    int64 Next = this->Size;
+    const int64 CachedEnd = this->FindRange(this->Position, Next);
+    if (CachedEnd > this->Position) {
+        const int BytesToRead = (int)FMath::Min<int64>(buf_size, CachedEnd - this->Position);
+        if (this->File->Seek(this->Position) && this->File->Read(buf, BytesToRead)) {
+            this->Position += BytesToRead;
+            this->DiskBytes += BytesToRead;
+            return BytesToRead;
+        }
+        //缓存文件损坏，之后全部从网络读取
+        UE_LOG(LogFFmpegMedia, Warning, TEXT("HttpCache: read cache file %s failed"), *this->CacheFile);
+        {
+            FScopeLock Lock(&this->Mutex);
+            this->Ranges.Reset();
+        }
+        this->WriteFailed = true;
+        Next = this->Size;
+    }
+
+    //只从网络读取到下一个缓存范围之前
+    if (this->Source->GetPosition() != this->Position) {
+        const int64_t ret = this->Source->SeekTo(this->Position);
+        if (ret < 0) {
+            return (int)ret;
+        }
+        this->NetworkSeeks++;
+    }
+    const int ret = this->Source->Read(buf, (int)FMath::Min<int64>(buf_size, Next - this->Position));
+    if (ret <= 0) {
+        return ret;
+    }
+    if (!this->WriteFailed) {
+        if (this->File->Seek(this->Position) && this->File->Write(buf, ret)) {
+            this->AddRange(this->Position, this->Position + ret);
+            this->UnsavedBytes += ret;
+            if (this->UnsavedBytes >= HTTP_CACHE_SAVE_INTERVAL) {
+                this->SaveIndex();
+            }
+        }
+        else {
+            UE_LOG(LogFFmpegMedia, Warning, TEXT("HttpCache: write cache file %s failed"), *this->CacheFile);
+            this->WriteFailed = true;
+        }
+    }
+    this->Position += ret;
+    this->NetworkBytes += ret;
+    return ret;
+}
+
+int64_t FFmpegHttpCacheSource::SeekTo(int64_t pos)
+{
+    //只记录位置，读取到缓存之外的范围时网络数据源再跳转
+    this->Position = pos;
+    return pos;
+}
+
+int64_t FFmpegHttpCacheSource::GetSize() const
+{
+    return this->Size;
+}
+
+int64_t FFmpegHttpCacheSource::GetPosition() const
+{
+    return this->Position;
+}
+
+FString FFmpegHttpCacheSource::GetStats() const
+{
+    int64 Cached = 0;
+    {
+        FScopeLock Lock(&this->Mutex);
+        for (const TPair<int64, int64>& Range : this->Ranges) {
+            Cached += Range.Value - Range.Key;
+        }
+    }
+    return FString::Printf(TEXT("http cache%s, cached %.1f / %.1f MB, disk %.1f MB, network %.1f MB, %d network seeks; %s"),
+        this->WriteFailed ? TEXT(" (write failed)") : TEXT(""), Cached / (1024.0 * 1024.0), this->Size / (1024.0 * 1024.0),
+        this->DiskBytes / (1024.0 * 1024.0), this->NetworkBytes / (1024.0 * 1024.0), this->NetworkSeeks, *this->Source->GetStats());
+}
+
+bool FFmpegHttpCacheSource::GetCachedRanges(TArray<TPair<int64, int64>>& OutRanges) const
+{
+    FScopeLock Lock(&this->Mutex);
+    OutRanges = this->Ranges;
+    return true;
+}
+
+void FFmpegHttpCacheSource::Abort()
+{
+    this->Source->Abort();
+}
+
+bool FFmpegHttpCacheSource::QueryValidators(const FString& Url, const int* abort_flag, FString& OutETag, FString& OutLastModified)
+{
+    OutETag.Reset();
+    OutLastModified.Reset();
+    const FHttpRequestRef Request = FHttpModule::Get().CreateRequest();
+    Request->SetURL(Url);
+    Request->SetVerb(TEXT("HEAD"));
+    if (!Request->ProcessRequest()) {
+        return false;
+    }
+    //在打开媒体的工作线程中等待，HTTP模块在自己的线程(或者游戏线程)中处理请求
+    const double Timeout = FPlatformTime::Seconds() + HTTP_CACHE_VALIDATE_TIMEOUT;
+    while (!EHttpRequestStatus::IsFinished(Request->GetStatus())) {
+        if ((abort_flag && *abort_flag) || FPlatformTime::Seconds() > Timeout) {
+            Request->CancelRequest();
+            return false;
+        }
+        FPlatformProcess::Sleep(0.005f);
+    }
+    const FHttpResponsePtr Response = Request->GetResponse();
+    if (Request->GetStatus() != EHttpRequestStatus::Succeeded || !Response.IsValid() || !EHttpResponseCodes::IsOk(Response->GetResponseCode())) {
+        return false;
+    }
+    OutETag = Response->GetHeader(TEXT("ETag"));
+    OutLastModified = Response->GetHeader(TEXT("Last-Modified"));
+    return true;
+}
+
+bool FFmpegHttpCacheSource::LoadIndex()
+{
+    TArray<uint8> Data;
+    if (!FFileHelper::LoadFileToArray(Data, *FPaths::ChangeExtension(this->CacheFile, TEXT("ranges")), FILEREAD_Silent)) {
+        return false;
+    }
+    FMemoryReader Reader(Data);
+    uint32 Magic = 0, Version = 0;
+    FString CachedUrl, CachedETag, CachedLastModified;
+    int64 CachedSize = -1;
+    int32 Num = 0;
+    Reader << Magic << Version << CachedUrl << CachedSize << CachedETag << CachedLastModified << Num;
+    if (Reader.IsError() || Magic != HTTP_CACHE_MAGIC || Version != HTTP_CACHE_VERSION || CachedUrl != this->Url || Num < 0) {
+        UE_LOG(LogFFmpegMedia, Verbose, TEXT("HttpCache: ignore invalid cache %s"), *this->CacheFile);
+        return false;
+    }
+    //优先比较ETag，没有ETag时比较Last-Modified，都没有时只能比较文件大小
+    bool Modified = CachedSize != this->Size;
+    if (!CachedETag.IsEmpty() || !this->ETag.IsEmpty()) {
+        Modified |= CachedETag != this->ETag;
+    }
+    else if (!CachedLastModified.IsEmpty() || !this->LastModified.IsEmpty()) {
+        Modified |= CachedLastModified != this->LastModified;
+    }
+    if (Modified) {
+        UE_LOG(LogFFmpegMedia, Verbose, TEXT("HttpCache: %s was modified (ETag %s -> %s, Last-Modified %s -> %s, %lld -> %lld bytes), drop cache"),
+            *this->Url, *CachedETag, *this->ETag, *CachedLastModified, *this->LastModified, CachedSize, this->Size);
+        return false;
+    }
+    const int64 FileSize = this->File->Size();
+    for (int32 i = 0; i < Num; i++) {
+        int64 Start = 0, End = 0;
+        Reader << Start << End;
+        if (Reader.IsError()) {
+            return false;
+        }
+        if (Start >= 0 && Start < End && End <= FileSize && End <= this->Size) {
+            this->AddRange(Start, End);
+        }
+    }
+    return true;
+}
+
+void FFmpegHttpCacheSource::SaveIndex()
+{
+    //先写入数据再保存索引，索引中的范围总是已经写入缓存文件
+    this->File->Flush();
+    TArray<uint8> Data;
+    FMemoryWriter Writer(Data);
+    uint32 Magic = HTTP_CACHE_MAGIC, Version = HTTP_CACHE_VERSION;
+    FString CachedUrl = this->Url;
+    int64 CachedSize = this->Size;
+    FString CachedETag = this->ETag;
+    FString CachedLastModified = this->LastModified;
+    Writer << Magic << Version << CachedUrl << CachedSize << CachedETag << CachedLastModified;
+    {
+        FScopeLock Lock(&this->Mutex);
+        int32 Num = this->Ranges.Num();
+        Writer << Num;
+        for (TPair<int64, int64> Range : this->Ranges) {
+            Writer << Range.Key << Range.Value;
+        }
+    }
+    if (!FFileHelper::SaveArrayToFile(Data, *FPaths::ChangeExtension(this->CacheFile, TEXT("ranges")))) {
+        UE_LOG(LogFFmpegMedia, Warning, TEXT("HttpCache: save cache index %s fail"), *this->CacheFile);
+    }
+    this->UnsavedBytes = 0;
+}
+
+void FFmpegHttpCacheSource::AddRange(int64 Start, int64 End)
+{
+    FScopeLock Lock(&this->Mutex);
+    //第一个结束位置不小于Start的范围开始，合并所有重叠或者相邻的范围
+    int32 First = 0;
+    while (First < this->Ranges.Num() && this->Ranges[First].Value < Start) {
+        First++;
+    }
+    int32 Last = First;
+    while (Last < this->Ranges.Num() && this->Ranges[Last].Key <= End) {
+        Start = FMath::Min(Start, this->Ranges[Last].Key);
+        End = FMath::Max(End, this->Ranges[Last].Value);
+        Last++;
+    }
+    this->Ranges.RemoveAt(First, Last - First);
+    this->Ranges.Insert(TPair<int64, int64>(Start, End), First);
+}
+
+int64 FFmpegHttpCacheSource::FindRange(int64 Pos, int64& OutNext) const
+{
+    FScopeLock Lock(&this->Mutex);
+    OutNext = this->Size;
+    for (const TPair<int64, int64>& Range : this->Ranges) {
+        if (Pos < Range.Key) {
+            OutNext = Range.Key;
+            return -1;
+        }
+        if (Pos < Range.Value) {
+            return Range.Value;
+        }
+    }
+    return -1;
+}
+
+void FFmpegHttpCacheSource::Trim(const FString& Directory, const FString& Keep, int64 MaxCacheSize)
+{
+    IFileManager& FileManager = IFileManager::Get();
+    TArray<FString> Files;
+    FileManager.FindFiles(Files, *FPaths::Combine(Directory, TEXT("*.data")), true, false);
+
+    struct FEntry
+    {
+        FString Path;
+        int64 Size;
+        FDateTime TimeStamp;
+    };
+    TArray<FEntry> Entries;
+    int64 TotalSize = 0;
+    for (const FString& Name : Files) {
+        FEntry& Entry = Entries.AddDefaulted_GetRef();
+        Entry.Path = FPaths::Combine(Directory, Name);
+        Entry.Size = FMath::Max<int64>(FileManager.FileSize(*Entry.Path), 0);
+        Entry.TimeStamp = FileManager.GetTimeStamp(*Entry.Path);
+        TotalSize += Entry.Size;
+    }
+    if (TotalSize <= MaxCacheSize) {
+        return;
+    }
+    Entries.Sort([](const FEntry& A, const FEntry& B) { return A.TimeStamp < B.TimeStamp; });
+
+    FScopeLock Lock(&InUseMutex);
+    for (const FEntry& Entry : Entries) {
+        if (TotalSize <= MaxCacheSize) {
+            break;
+        }
+        if (Entry.Path == Keep || InUseFiles.Contains(Entry.Path)) {
+            continue;
+        }
+        FileManager.Delete(*FPaths::ChangeExtension(Entry.Path, TEXT("ranges")), false, false, true);
+        if (FileManager.Delete(*Entry.Path, false, false, true)) {
+            TotalSize -= Entry.Size;
+            UE_LOG(LogFFmpegMedia, Verbose, TEXT("HttpCache: evict %s (%lld bytes)"), *Entry.Path, Entry.Size);
+        }
+    }
+}
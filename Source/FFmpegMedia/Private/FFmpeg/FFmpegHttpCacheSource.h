@@ -0,0 +1,93 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "FFmpegIOSource.h"
+
+class IFileHandle;
+
+/**
+ * http/https地址的磁盘缓存数据源
+ * 读取的数据同时写入本地缓存文件(保存在 Saved/FFmpegMedia/HttpCache/ 目录下)，并记录已经缓存的字节范围
+ * 读取已经缓存的范围时直接读取磁盘，只有缺少的范围才从网络获取，再次播放或者跳转时不需要重新下载
+ * 缓存以地址为键值，缓存目录超出大小上限时删除最久未使用的缓存
+ * 打开时通过HEAD请求获取ETag和Last-Modified，和索引中保存的值不同(或者网络文件大小变化)时缓存失效
+ */
+class FFmpegHttpCacheSource : public FFmpegIOSource
+{
+public:
+	/**
+	 * 创建缓存
+	 * @param Url 网络地址
+	 * @param InSource 网络数据源，创建成功之后由本对象释放
+	 * @param MaxCacheSize 缓存目录的大小上限(字节)
+	 * @param abort_flag 验证缓存期间使用的中断标记，不为0时中断HEAD请求(可以为空)
+	 * @return 大小未知(直播流)、播放列表、同一个地址正在被其他播放器缓存或者缓存文件无法创建时返回空，此时InSource不会被释放
+	 */
+	static FFmpegHttpCacheSource* Open(const FString& Url, FFmpegIOSource* InSource, int64 MaxCacheSize, const int* abort_flag);
+
+	virtual ~FFmpegHttpCacheSource();
+
+	virtual int Read(uint8_t* buf, int buf_size) override;
+	virtual int64_t SeekTo(int64_t pos) override;
+	virtual int64_t GetSize() const override;
+	virtual int64_t GetPosition() const override;
+	virtual FString GetStats() const override;
+	virtual bool GetCachedRanges(TArray<TPair<int64, int64>>& OutRanges) const override;
+	virtual void Abort() override;
+
+	/** 从缓存读取的字节数 */
+	int64 GetDiskBytes() const { return this->DiskBytes; }
+
+	/** 从网络读取的字节数 */
+	int64 GetNetworkBytes() const { return this->NetworkBytes; }
+
+private:
+	FFmpegHttpCacheSource(const FString& InUrl, const FString& InCacheFile, FFmpegIOSource* InSource, IFileHandle* InFile);
+
+	/**
+	 * 通过HEAD请求获取网络文件的ETag和Last-Modified(服务器没有返回时为空)
+	 * @return 请求失败、超时或者被中断时返回false
+	 */
+	static bool QueryValidators(const FString& Url, const int* abort_flag, FString& OutETag, FString& OutLastModified);
+
+	/** 读取缓存索引，索引无效或者网络文件已经修改时返回false */
+	bool LoadIndex();
+
+	/** 保存缓存索引 */
+	void SaveIndex();
+
+	/** 添加已经缓存的范围[Start, End)，合并相邻的范围 */
+	void AddRange(int64 Start, int64 End);
+
+	/**
+	 * 查找位置所在的缓存范围
+	 * @param OutNext 不在缓存范围内时返回之后第一个缓存范围的开始位置(没有时为文件大小)
+	 * @return 缓存范围的结束位置，不在缓存范围内时返回-1
+	 */
+	int64 FindRange(int64 Pos, int64& OutNext) const;
+
+	/** 删除最久未使用的缓存，直到缓存目录小于上限 */
+	static void Trim(const FString& Directory, const FString& Keep, int64 MaxCacheSize);
+
+private:
+	FString Url;
+	FString CacheFile; //缓存数据文件，索引文件为同名的.ranges
+	FFmpegIOSource* Source;
+	IFileHandle* File;
+	int64 Size;
+	FString ETag; //打开时服务器返回的ETag，保存在索引中
+	FString LastModified; //打开时服务器返回的Last-Modified，保存在索引中
+	int64 Position;
+	bool WriteFailed; //写入失败之后不再缓存新的数据
+	int64 UnsavedBytes; //上次保存索引之后新缓存的数据大小
+
+	mutable FCriticalSection Mutex; //保护Ranges
+	TArray<TPair<int64, int64>> Ranges; //按照位置排序的缓存范围[Key, Value)
+
+	//统计
+	int64 DiskBytes; //从缓存读取的字节数
+	int64 NetworkBytes; //从网络读取的字节数
+	int NetworkSeeks; //网络数据源跳转的次数
+};
@@ -0,0 +1,82 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "FFmpeg/FFmpegIOSource.h"
+#include "FFmpegMedia.h"
+extern  "C" {
+#include "libavformat/avio.h"
+#include "libavutil/mem.h"
+#include "libavutil/error.h"
+}
+#include <stdio.h>
+
+AVIOContext* FFmpegIOSource::CreateContext(FFmpegIOSource* Source, int BufferSize)
+{
+    if (!Source) {
+        return nullptr;
+    }
+    unsigned char* buffer = (unsigned char*)av_malloc(BufferSize);
+    AVIOContext* pb = buffer ? avio_alloc_context(buffer, BufferSize, 0, Source, ReadCallback, NULL, SeekCallback) : nullptr;
+    if (!pb) {
+        UE_LOG(LogFFmpegMedia, Error, TEXT("IOSource: could not allocate AVIOContext (%d bytes)"), BufferSize);
+        av_free(buffer);
+        delete Source;
+        return nullptr;
+    }
+    //数据源大小已知时允许FFmpeg直接跳转，而不是读取之后丢弃
+    pb->seekable = Source->GetSize() >= 0 ? AVIO_SEEKABLE_NORMAL : 0;
+    return pb;
+}
+
+void FFmpegIOSource::FreeContext(AVIOContext** pb)
+{
+    FFmpegIOSource* Source = pb ? FromContext(*pb) : nullptr;
+    if (!Source) {
+        return;
+    }
+    av_freep(&(*pb)->buffer); //缓冲区可能被FFmpeg重新分配过，需要从AVIOContext中释放
+    avio_context_free(pb);
+    delete Source;
+}
+
+FFmpegIOSource* FFmpegIOSource::FromContext(const AVIOContext* pb)
+{
+    if (!pb || pb->read_packet != ReadCallback) {
+        return nullptr;
+    }
+    return static_cast<FFmpegIOSource*>(pb->opaque);
+}
+
+int FFmpegIOSource::ReadCallback(void* opaque, uint8_t* buf, int buf_size)
+{
+    return static_cast<FFmpegIOSource*>(opaque)->Read(buf, buf_size);
+}
+
+int64_t FFmpegIOSource::SeekCallback(void* opaque, int64_t offset, int whence)
+{
+    FFmpegIOSource* Source = static_cast<FFmpegIOSource*>(opaque);
+    const int64_t Size = Source->GetSize();
+    int64_t pos;
+    switch (whence & ~AVSEEK_FORCE) {
+    case AVSEEK_SIZE:
+        return Size >= 0 ? Size : AVERROR(ENOSYS);
+    case SEEK_SET:
+        pos = offset;
+        break;
+    case SEEK_CUR:
+        pos = Source->GetPosition() + offset;
+        break;
+    case SEEK_END:
+        if (Size < 0) {
+            return AVERROR(ENOSYS);
+        }
+        pos = Size + offset;
+        break;
+    default:
+        return AVERROR(EINVAL);
+    }
+    if (pos < 0) {
+        return AVERROR(EINVAL);
+    }
+    return Source->SeekTo(pos);
+}
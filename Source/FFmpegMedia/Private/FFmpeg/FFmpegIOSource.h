@@ -0,0 +1,72 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+struct AVIOContext;
+
+/**
+ * 自定义AVIO数据源
+ * 通过CreateContext创建的AVIOContext拥有数据源，关闭上下文之后需要调用FreeContext释放(avformat_close_input不会释放自定义的AVIOContext)
+ * 读取和跳转只在打开媒体的线程或者读取线程中调用，统计信息可以在其他线程中读取
+ */
+class FFmpegIOSource
+{
+public:
+	virtual ~FFmpegIOSource() { }
+
+	/**
+	 * 从当前位置读取数据
+	 * @return 读取的字节数，到达结尾时返回AVERROR_EOF，失败时返回其他负数错误码
+	 */
+	virtual int Read(uint8_t* buf, int buf_size) = 0;
+
+	/**
+	 * 跳转到绝对位置
+	 * @return 新的位置，失败时返回负数错误码
+	 */
+	virtual int64_t SeekTo(int64_t pos) = 0;
+
+	/** 获取数据大小(字节)，未知时返回负数 */
+	virtual int64_t GetSize() const = 0;
+
+	/** 获取当前位置 */
+	virtual int64_t GetPosition() const = 0;
+
+	/** 获取统计信息(单行) */
+	virtual FString GetStats() const = 0;
+
+	/**
+	 * 获取已经缓存在本地(内存或者磁盘)的字节范围
+	 * @param OutRanges 按照位置排序的范围[Key, Value)
+	 * @return 数据源没有缓存时返回false
+	 */
+	virtual bool GetCachedRanges(TArray<TPair<int64, int64>>& OutRanges) const { return false; }
+
+	/** 是否还在后台加载数据 */
+	virtual bool IsLoading() const { return false; }
+
+	/** 中断正在阻塞的读取(关闭媒体时在读取线程之外调用)，之后的读取返回错误 */
+	virtual void Abort() { }
+
+public:
+	/**
+	 * 创建读取数据源的AVIOContext，AVIOContext拥有数据源
+	 * @param Source 数据源
+	 * @param BufferSize AVIO缓冲区大小(字节)
+	 * @return 失败时删除数据源并返回空
+	 */
+	static AVIOContext* CreateContext(FFmpegIOSource* Source, int BufferSize);
+
+	/** 释放CreateContext创建的AVIOContext和数据源，其他AVIOContext不做处理 */
+	static void FreeContext(AVIOContext** pb);
+
+	/** 获取AVIOContext的数据源，不是CreateContext创建的AVIOContext时返回空 */
+	static FFmpegIOSource* FromContext(const AVIOContext* pb);
+
+private:
+	static int ReadCallback(void* opaque, uint8_t* buf, int buf_size);
+	/** 按照whence(SEEK_SET/SEEK_CUR/SEEK_END/AVSEEK_SIZE)计算绝对位置之后跳转 */
+	static int64_t SeekCallback(void* opaque, int64_t offset, int whence);
+};
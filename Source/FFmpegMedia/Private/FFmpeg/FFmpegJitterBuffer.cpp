@@ -0,0 +1,159 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "FFmpeg/FFmpegJitterBuffer.h"
+#include "FFmpegMedia.h"
+
+/* 目标延迟至少为抖动的倍数 */
+#define JITTER_TARGET_FACTOR 3.0
+/* 两个数据包的到达间隔和时间戳间隔相差超过该值(秒)时认为时间戳不连续，不计入抖动 */
+#define JITTER_MAX_DELTA 2.0
+/* 缓存时长的平滑时间常数(秒)，数据包成批到达时缓存时长是锯齿形的 */
+#define JITTER_LATENCY_SMOOTHING 0.5
+/* 缓存时长在目标延迟的该比例范围内时恢复正常速度 */
+#define JITTER_DEAD_BAND 0.1
+/* 偏离目标延迟的比例换算成速度调整的系数 */
+#define JITTER_SPEED_GAIN 0.25
+/* 每秒最多调整的速度，避免音调和画面节奏突变 */
+#define JITTER_SPEED_SLEW 0.02
+/* 速度按照该精度调整，避免频繁修改时钟和音频变速滤镜 */
+#define JITTER_SPEED_QUANTUM 0.001
+
+FFmpegJitterBuffer::FFmpegJitterBuffer()
+{
+    this->Target = 0.0;
+    this->MaxTarget = 0.0;
+    this->MaxSpeedChange = 0.0;
+    this->Reset();
+}
+
+FFmpegJitterBuffer::~FFmpegJitterBuffer()
+{
+}
+
+void FFmpegJitterBuffer::Configure(double InTarget, double InMaxTarget, double InMaxSpeedChange)
+{
+    this->Target = FMath::Max(InTarget, 0.0);
+    this->MaxTarget = FMath::Max(InMaxTarget, 0.0);
+    this->MaxSpeedChange = FMath::Clamp(InMaxSpeedChange, 0.0, 0.5);
+    this->Reset();
+    this->Underruns = 0;
+    this->Packets = 0;
+}
+
+void FFmpegJitterBuffer::Reset()
+{
+    this->Jitter = 0.0;
+    this->LastTransit = NAN;
+    this->Latency = NAN;
+    this->LastLatency = NAN;
+    this->LastUpdate = 0.0;
+    this->Speed = 1.0;
+    this->Underrun = false;
+}
+
+void FFmpegJitterBuffer::OnPacket(double Pts, double Time)
+{
+    if (!this->IsEnabled() || FMath::IsNaN(Pts))
+        return;
+    this->Packets++;
+    const double Transit = Time - Pts;
+    if (!FMath::IsNaN(this->LastTransit)) {
+        const double Delta = FMath::Abs(Transit - this->LastTransit);
+        if (Delta < JITTER_MAX_DELTA) {
+            this->Jitter += (Delta - this->Jitter) / 16.0;
+        }
+    }
+    this->LastTransit = Transit;
+}
+
+double FFmpegJitterBuffer::Update(double InLatency, double Time)
+{
+    if (!this->IsEnabled())
+        return 1.0;
+    if (FMath::IsNaN(InLatency)) { //还没有开始播放或者暂停
+        this->LastUpdate = 0.0;
+        return this->Speed;
+    }
+
+    const double Elapsed = this->LastUpdate > 0.0 ? FMath::Clamp(Time - this->LastUpdate, 0.0, 1.0) : 0.0;
+    this->LastUpdate = Time;
+    this->LastLatency = InLatency;
+
+    if (InLatency <= 0.0) { //缓存已经播放完
+        if (!this->Underrun) {
+            this->Underrun = true;
+            this->Underruns++;
+        }
+    }
+    else {
+        this->Underrun = false;
+    }
+
+    if (FMath::IsNaN(this->Latency)) {
+        this->Latency = InLatency;
+    }
+    else {
+        this->Latency += (InLatency - this->Latency) * FMath::Min(Elapsed / JITTER_LATENCY_SMOOTHING, 1.0);
+    }
+
+    //偏离目标延迟的比例换算成速度，在死区内时恢复正常速度
+    const double CurrentTarget = this->GetTarget();
+    const double Error = (this->Latency - CurrentTarget) / CurrentTarget;
+    double Wanted = 1.0;
+    if (FMath::Abs(Error) > JITTER_DEAD_BAND) {
+        Wanted = 1.0 + FMath::Clamp((Error - FMath::Sign(Error) * JITTER_DEAD_BAND) * JITTER_SPEED_GAIN, -this->MaxSpeedChange, this->MaxSpeedChange);
+    }
+
+    //内部保持连续的速度，每次更新的调整量小于精度时也能累积(每个数据包都会更新，间隔只有几十毫秒)
+    const double Step = JITTER_SPEED_SLEW * Elapsed;
+    this->Speed += FMath::Clamp(Wanted - this->Speed, -Step, Step);
+    return this->GetSpeed();
+}
+
+bool FFmpegJitterBuffer::IsEnabled() const
+{
+    return this->Target > 0.0 && this->MaxSpeedChange > 0.0;
+}
+
+double FFmpegJitterBuffer::GetSpeed() const
+{
+    double Result = FMath::RoundToDouble(this->Speed / JITTER_SPEED_QUANTUM) * JITTER_SPEED_QUANTUM;
+    if (FMath::Abs(Result - 1.0) < JITTER_SPEED_QUANTUM * 0.5) {
+        Result = 1.0;
+    }
+    return Result;
+}
+
+FString FFmpegJitterBuffer::GetStats() const
+{
+    if (!this->IsEnabled()) {
+        return TEXT("disabled");
+    }
+    const double CurrentTarget = this->GetTarget();
+    return FString::Printf(TEXT("latency %.0f ms (smoothed %.0f ms), target %.0f ms, jitter %.1f ms, speed %.3f, health %.0f%%, %d underruns, %d packets"),
+        FMath::IsNaN(this->LastLatency) ? 0.0 : this->LastLatency * 1000.0,
+        FMath::IsNaN(this->Latency) ? 0.0 : this->Latency * 1000.0,
+        CurrentTarget * 1000.0, this->Jitter * 1000.0, this->GetSpeed(),
+        FMath::IsNaN(this->Latency) ? 0.0 : FMath::Max(this->Latency, 0.0) / CurrentTarget * 100.0,
+        this->Underruns, this->Packets);
+}
+
+double FFmpegJitterBuffer::GetLatency() const
+{
+    return this->Latency;
+}
+
+int FFmpegJitterBuffer::GetUnderruns() const
+{
+    return this->Underruns;
+}
+
+double FFmpegJitterBuffer::GetTarget() const
+{
+    double Result = FMath::Max(this->Target, this->Jitter * JITTER_TARGET_FACTOR);
+    if (this->MaxTarget > 0.0) {
+        Result = FMath::Min(Result, this->MaxTarget);
+    }
+    return Result;
+}
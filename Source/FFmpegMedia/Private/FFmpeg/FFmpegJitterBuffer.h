@@ -0,0 +1,78 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * 实时流的抖动缓冲
+ * 根据数据包的到达时间估计网络抖动(RFC 3550中的到达间隔抖动)，目标延迟取设置的目标延迟和抖动的若干倍中较大的值
+ * 已经接收但是还没有播放的时长偏离目标延迟时平滑地调整播放速度(音频做变速不变调处理)，追赶或者放慢，不丢弃数据
+ * OnPacket和Update只能在同一个线程中调用
+ */
+class FFmpegJitterBuffer
+{
+public:
+	FFmpegJitterBuffer();
+	~FFmpegJitterBuffer();
+public:
+	/**
+	 * 设置参数并重置状态
+	 * @param InTarget 目标延迟(秒)，0表示关闭
+	 * @param InMaxTarget 抖动较大时目标延迟的上限(秒)，0表示不限制
+	 * @param InMaxSpeedChange 播放速度的最大调整幅度(比如0.05表示0.95 ~ 1.05)
+	 */
+	void Configure(double InTarget, double InMaxTarget, double InMaxSpeedChange);
+
+	/** 清空抖动估计并恢复正常速度(seek或者清空队列之后调用) */
+	void Reset();
+
+	/**
+	 * 数据包到达
+	 * @param Pts 数据包的时间戳(秒)
+	 * @param Time 到达时间(秒)
+	 */
+	void OnPacket(double Pts, double Time);
+
+	/**
+	 * 更新缓存时长，计算播放速度
+	 * @param Latency 已经接收但是还没有播放的时长(秒)，NAN表示还没有开始播放
+	 * @param Time 当前时间(秒)
+	 * @return 播放速度
+	 */
+	double Update(double Latency, double Time);
+
+	/** 是否开启 */
+	bool IsEnabled() const;
+
+	/** 当前播放速度 */
+	double GetSpeed() const;
+
+	/** 当前的目标延迟(秒) */
+	double GetTarget() const;
+
+	/** 平滑之后的缓存时长(秒)，还没有开始播放时为NAN */
+	double GetLatency() const;
+
+	/** 缓存播放完的次数 */
+	int GetUnderruns() const;
+
+	/** 统计信息 */
+	FString GetStats() const;
+private:
+	double Target;
+	double MaxTarget;
+	double MaxSpeedChange;
+
+	double Jitter; //到达间隔抖动(秒)
+	double LastTransit; //上一个数据包的到达时间减去时间戳，NAN表示没有
+	double Latency; //平滑之后的缓存时长(秒)，NAN表示没有
+	double LastLatency; //最后一次更新的缓存时长(秒)
+	double LastUpdate; //最后一次更新的时间(秒)
+	double Speed;
+
+	//统计
+	bool Underrun; //缓存已经播放完，等待数据
+	int Underruns; //缓存播放完的次数
+	int Packets;
+};
@@ -0,0 +1,254 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "FFmpeg/FFmpegKeyframeIndex.h"
+#include "FFmpegMedia.h"
+#include "FFmpegSidecarCache.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+extern  "C" {
+#include "libavformat/avformat.h"
+#include "libavutil/time.h"
+}
+
+/* 缓存类别和版本，索引格式修改之后需要增加版本号 */
+#define KEYFRAME_INDEX_CATEGORY TEXT("KeyframeIndex")
+#define KEYFRAME_INDEX_VERSION 1
+
+static int index_interrupt_cb(void* ctx)
+{
+    const int* abort_request = (const int*)ctx;
+    return *abort_request;
+}
+
+FFmpegKeyframeIndex::FFmpegKeyframeIndex()
+{
+    this->StreamIndex = -1;
+    this->TimeBase = { 0, 1 };
+    this->Ready = false;
+}
+
+FFmpegKeyframeIndex::~FFmpegKeyframeIndex()
+{
+}
+
+bool FFmpegKeyframeIndex::Load(const FString& MediaPath)
+{
+    TArray<uint8> Data;
+    if (!FFmpegSidecarCache::Load(KEYFRAME_INDEX_CATEGORY, MediaPath, KEYFRAME_INDEX_VERSION, Data)) {
+        return false;
+    }
+
+    FMemoryReader Reader(Data);
+    int32 NewStreamIndex = -1;
+    int32 Num = 0, Den = 1;
+    TArray<FFmpegKeyframeEntry> NewEntries;
+    Reader << NewStreamIndex;
+    Reader << Num;
+    Reader << Den;
+    Reader << NewEntries;
+    if (Reader.IsError() || NewStreamIndex < 0 || Num <= 0 || Den <= 0 || NewEntries.Num() == 0) {
+        return false;
+    }
+
+    FScopeLock Lock(&Mutex);
+    this->StreamIndex = NewStreamIndex;
+    this->TimeBase = { Num, Den };
+    this->Entries = MoveTemp(NewEntries);
+    this->Ready = true;
+    return true;
+}
+
+int FFmpegKeyframeIndex::Build(const FString& MediaPath, const int* abort_request)
+{
+    AVFormatContext* ic = NULL;
+    AVPacket* pkt = NULL;
+    TArray<FFmpegKeyframeEntry> NewEntries;
+    int stream_index = -1;
+    AVRational time_base = { 0, 1 };
+    int ret = 0;
+    double start = av_gettime_relative() / 1000000.0;
+
+    ic = avformat_alloc_context();
+    if (!ic) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    //使用播放器的中断标识，关闭播放器时立即中断扫描
+    ic->interrupt_callback.callback = index_interrupt_cb;
+    ic->interrupt_callback.opaque = (void*)abort_request;
+    if ((ret = avformat_open_input(&ic, TCHAR_TO_UTF8(*MediaPath), NULL, NULL)) < 0) {
+        goto fail;
+    }
+    if ((ret = avformat_find_stream_info(ic, NULL)) < 0) {
+        goto fail;
+    }
+    stream_index = av_find_best_stream(ic, AVMEDIA_TYPE_VIDEO, -1, -1, NULL, 0);
+    if (stream_index < 0) {
+        ret = stream_index;
+        goto fail;
+    }
+    //只读取视频流的数据包
+    for (unsigned int i = 0; i < ic->nb_streams; i++) {
+        ic->streams[i]->discard = (int)i == stream_index ? AVDISCARD_DEFAULT : AVDISCARD_ALL;
+    }
+    time_base = ic->streams[stream_index]->time_base;
+
+    pkt = av_packet_alloc();
+    if (!pkt) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    while (!*abort_request) {
+        ret = av_read_frame(ic, pkt);
+        if (ret < 0) {
+            if (ret == AVERROR_EOF || avio_feof(ic->pb))
+                ret = 0;
+            break;
+        }
+        if (pkt->stream_index == stream_index) {
+            int64_t pts = pkt->pts != AV_NOPTS_VALUE ? pkt->pts : pkt->dts;
+            if ((pkt->flags & AV_PKT_FLAG_KEY) && pts != AV_NOPTS_VALUE) {
+                NewEntries.Add({ pts, pkt->pos, 1 });
+            }
+            else if (NewEntries.Num() > 0) {
+                NewEntries.Last().Distance++;
+            }
+        }
+        av_packet_unref(pkt);
+    }
+    if (*abort_request) {
+        ret = AVERROR_EXIT;
+        goto fail;
+    }
+    if (ret < 0 || NewEntries.Num() == 0) {
+        goto fail;
+    }
+    //关键帧按照解码顺序读取，pts正常情况下是递增的，这里再排序一次保证可以二分查找
+    NewEntries.StableSort([](const FFmpegKeyframeEntry& A, const FFmpegKeyframeEntry& B) { return A.Pts < B.Pts; });
+
+    {
+        FScopeLock Lock(&Mutex);
+        this->StreamIndex = stream_index;
+        this->TimeBase = time_base;
+        this->Entries = NewEntries;
+        this->Ready = true;
+    }
+    UE_LOG(LogFFmpegMedia, Log, TEXT("KeyframeIndex: build %d key frames in %.2f s"), NewEntries.Num(), av_gettime_relative() / 1000000.0 - start);
+
+    //保存到旁路缓存
+    {
+        TArray<uint8> Data;
+        FMemoryWriter Writer(Data);
+        int32 Num = time_base.num, Den = time_base.den;
+        int32 SavedStreamIndex = stream_index;
+        Writer << SavedStreamIndex;
+        Writer << Num;
+        Writer << Den;
+        Writer << NewEntries;
+        FFmpegSidecarCache::Save(KEYFRAME_INDEX_CATEGORY, MediaPath, KEYFRAME_INDEX_VERSION, Data);
+    }
+fail:
+    if (ret < 0 && ret != AVERROR_EXIT) {
+        char errbuf[AV_ERROR_MAX_STRING_SIZE] = { 0 };
+        av_strerror(ret, errbuf, sizeof(errbuf));
+        UE_LOG(LogFFmpegMedia, Warning, TEXT("KeyframeIndex: build fail %s"), UTF8_TO_TCHAR(errbuf));
+    }
+    av_packet_free(&pkt);
+    avformat_close_input(&ic);
+    return ret;
+}
+
+void FFmpegKeyframeIndex::Reset()
+{
+    FScopeLock Lock(&Mutex);
+    this->Entries.Empty();
+    this->StreamIndex = -1;
+    this->TimeBase = { 0, 1 };
+    this->Ready = false;
+}
+
+bool FFmpegKeyframeIndex::IsReady() const
+{
+    FScopeLock Lock(&Mutex);
+    return this->Ready;
+}
+
+int FFmpegKeyframeIndex::GetStreamIndex() const
+{
+    FScopeLock Lock(&Mutex);
+    return this->StreamIndex;
+}
+
+int FFmpegKeyframeIndex::GetNum() const
+{
+    FScopeLock Lock(&Mutex);
+    return this->Entries.Num();
+}
+
+bool FFmpegKeyframeIndex::Find(double time, FFmpegKeyframeEntry& OutEntry, int& OutFrames) const
+{
+    FScopeLock Lock(&Mutex);
+    if (!this->Ready || this->Entries.Num() == 0 || this->TimeBase.num <= 0) {
+        return false;
+    }
+    int64 target = (int64)(time / av_q2d(this->TimeBase));
+    //二分查找最后一个 Pts <= target 的关键帧
+    int low = 0, high = this->Entries.Num() - 1, found = -1;
+    while (low <= high) {
+        int mid = (low + high) / 2;
+        if (this->Entries[mid].Pts <= target) {
+            found = mid;
+            low = mid + 1;
+        }
+        else {
+            high = mid - 1;
+        }
+    }
+    if (found < 0) {
+        return false;
+    }
+    OutEntry = this->Entries[found];
+    //按照到下一个关键帧的距离线性估算需要解码的帧数
+    OutFrames = OutEntry.Distance;
+    if (found + 1 < this->Entries.Num()) {
+        int64 span = this->Entries[found + 1].Pts - OutEntry.Pts;
+        if (span > 0) {
+            double ratio = FMath::Clamp((double)(target - OutEntry.Pts) / span, 0.0, 1.0);
+            OutFrames = FMath::Max(1, (int)ceil(ratio * OutEntry.Distance));
+        }
+    }
+    return true;
+}
+
+bool FFmpegKeyframeIndex::FindAfter(double time, FFmpegKeyframeEntry& OutEntry) const
+{
+    FScopeLock Lock(&Mutex);
+    if (!this->Ready || this->Entries.Num() == 0 || this->TimeBase.num <= 0) {
+        return false;
+    }
+    int64 target = (int64)ceil(time / av_q2d(this->TimeBase));
+    //二分查找第一个 Pts >= target 的关键帧
+    int low = 0, high = this->Entries.Num() - 1, found = -1;
+    while (low <= high) {
+        int mid = (low + high) / 2;
+        if (this->Entries[mid].Pts >= target) {
+            found = mid;
+            high = mid - 1;
+        }
+        else {
+            low = mid + 1;
+        }
+    }
+    if (found < 0) {
+        return false;
+    }
+    OutEntry = this->Entries[found];
+    return true;
+}
+
+double FFmpegKeyframeIndex::ToSeconds(int64 pts) const
+{
+    FScopeLock Lock(&Mutex);
+    return pts * av_q2d(this->TimeBase);
+}
@@ -0,0 +1,85 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+extern  "C" {
+#include "libavutil/rational.h"
+}
+
+/**
+ * 关键帧索引项
+ */
+struct FFmpegKeyframeEntry
+{
+	int64 Pts;      //关键帧pts(流的时间基)
+	int64 Pos;      //关键帧数据包在文件中的字节位置，未知时为-1
+	int32 Distance; //到下一个关键帧之间的帧数
+
+	friend FArchive& operator<<(FArchive& Ar, FFmpegKeyframeEntry& Entry)
+	{
+		return Ar << Entry.Pts << Entry.Pos << Entry.Distance;
+	}
+};
+
+/**
+ * 视频流的关键帧索引(pts -> 字节位置 -> 到下一关键帧的帧数)
+ * 在后台线程中用单独的AVFormatContext读取整个文件(只解复用不解码)生成，并保存到旁路缓存中
+ */
+class FFmpegKeyframeIndex
+{
+public:
+	FFmpegKeyframeIndex();
+	~FFmpegKeyframeIndex();
+public:
+	/** 
+	 * 从旁路缓存中读取索引
+	 * @return 缓存存在并且有效时返回true
+	 */
+	bool Load(const FString& MediaPath);
+
+	/**
+	 * 扫描文件生成索引，完成之后保存到旁路缓存
+	 * @param MediaPath 本地媒体文件路径
+	 * @param abort_request 中断标识，不为0时立即返回
+	 * @return 成功返回0，失败返回ffmpeg错误码
+	 */
+	int Build(const FString& MediaPath, const int* abort_request);
+
+	/** 清空索引 */
+	void Reset();
+
+	/** 索引是否已经可用 */
+	bool IsReady() const;
+
+	/** 索引对应的流 */
+	int GetStreamIndex() const;
+
+	/** 索引项数量 */
+	int GetNum() const;
+
+	/**
+	 * 查找目标时间之前(包含)最近的关键帧
+	 * @param time 目标时间(秒)
+	 * @param OutEntry 找到的关键帧
+	 * @param OutFrames 从关键帧解码到目标时间估计需要解码的帧数
+	 */
+	bool Find(double time, FFmpegKeyframeEntry& OutEntry, int& OutFrames) const;
+
+	/**
+	 * 查找目标时间之后(包含)最近的关键帧
+	 * @param time 目标时间(秒)
+	 * @param OutEntry 找到的关键帧
+	 */
+	bool FindAfter(double time, FFmpegKeyframeEntry& OutEntry) const;
+
+	/** 关键帧pts转换成秒 */
+	double ToSeconds(int64 pts) const;
+private:
+	mutable FCriticalSection Mutex;
+	TArray<FFmpegKeyframeEntry> Entries;
+	int StreamIndex;
+	AVRational TimeBase;
+	bool Ready;
+};
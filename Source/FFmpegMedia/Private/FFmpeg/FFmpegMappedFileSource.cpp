@@ -0,0 +1,132 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "FFmpeg/FFmpegMappedFileSource.h"
+#include "FFmpegMedia.h"
+#include "Async/MappedFileHandle.h"
+#include "HAL/PlatformFileManager.h"
+extern  "C" {
+#include "libavutil/error.h"
+}
+#if PLATFORM_UNIX || PLATFORM_MAC || PLATFORM_ANDROID
+#include <sys/mman.h>
+#include <unistd.h>
+#define MAPPED_FILE_USE_MADVISE 1
+#else
+#define MAPPED_FILE_USE_MADVISE 0
+#endif
+
+FFmpegMappedFileSource* FFmpegMappedFileSource::Open(const FString& Path, int64 ReadAhead)
+{
+    //只映射真实的文件，pak中的文件通过平台文件层读取
+    IMappedFileHandle* Handle = IPlatformFile::GetPlatformPhysical().OpenMapped(*Path);
+    if (!Handle) {
+        return nullptr;
+    }
+    const int64 Size = Handle->GetFileSize();
+#if !PLATFORM_64BITS
+    //32位平台上大文件可能无法映射到地址空间
+    if (Size > MAX_int32) {
+        UE_LOG(LogFFmpegMedia, Verbose, TEXT("MappedFileSource: %s is too large to map (%lld bytes)"), *Path, Size);
+        delete Handle;
+        return nullptr;
+    }
+#endif
+    IMappedFileRegion* Region = Size > 0 ? Handle->MapRegion(0, Size) : nullptr;
+    if (!Region || !Region->GetMappedPtr()) {
+        UE_LOG(LogFFmpegMedia, Verbose, TEXT("MappedFileSource: could not map %s (%lld bytes)"), *Path, Size);
+        delete Region;
+        delete Handle;
+        return nullptr;
+    }
+    return new FFmpegMappedFileSource(Handle, Region, ReadAhead);
+}
+
+FFmpegMappedFileSource::FFmpegMappedFileSource(IMappedFileHandle* InHandle, IMappedFileRegion* InRegion, int64 InReadAhead)
+{
+    this->Handle = InHandle;
+    this->Region = InRegion;
+    this->Data = InRegion->GetMappedPtr();
+    this->Size = InRegion->GetMappedSize();
+    this->Position = 0;
+    this->ReadAhead = FMath::Max<int64>(InReadAhead, 0);
+    this->AdvisedStart = 0;
+    this->AdvisedEnd = 0;
+    this->Hints = 0;
+    this->Seeks = 0;
+    //不对整个映射设置MADV_SEQUENTIAL: 会尽早回收读过的页，seek回去和其他播放器读取同一个文件时需要重新读取磁盘
+    this->AdviseWillNeed(0);
+}
+
+FFmpegMappedFileSource::~FFmpegMappedFileSource()
+{
+    //先释放映射区域，再关闭文件
+    delete this->Region;
+    delete this->Handle;
+}
+
+int FFmpegMappedFileSource::Read(uint8_t* buf, int buf_size)
+{
+    if (this->Position >= this->Size) {
+        return AVERROR_EOF;
+    }
+    //读取位置接近已经提示预读的结尾时，继续提示之后的数据
+    if (this->Position + this->ReadAhead / 2 >= this->AdvisedEnd) {
+        this->AdviseWillNeed(this->Position);
+    }
+    const int BytesToRead = (int)FMath::Min<int64>(buf_size, this->Size - this->Position);
+    FMemory::Memcpy(buf, this->Data + this->Position, BytesToRead);
+    this->Position += BytesToRead;
+    return BytesToRead;
+}
+
+int64_t FFmpegMappedFileSource::SeekTo(int64_t pos)
+{
+    if (pos != this->Position) {
+        this->Seeks++;
+        //跳转到预读窗口之外时提示预读新的位置
+        if (pos < this->Size && (pos < this->AdvisedStart || pos >= this->AdvisedEnd)) {
+            this->AdviseWillNeed(pos);
+        }
+    }
+    this->Position = pos;
+    return pos;
+}
+
+int64_t FFmpegMappedFileSource::GetSize() const
+{
+    return this->Size;
+}
+
+int64_t FFmpegMappedFileSource::GetPosition() const
+{
+    return this->Position;
+}
+
+FString FFmpegMappedFileSource::GetStats() const
+{
+    return FString::Printf(TEXT("mapped file, %lld / %lld bytes, read ahead %lld KB, %d hints, %d seeks%s"),
+        this->Position, this->Size, this->ReadAhead / 1024, this->Hints, this->Seeks,
+        MAPPED_FILE_USE_MADVISE ? TEXT("") : TEXT(" (no madvise)"));
+}
+
+void FFmpegMappedFileSource::AdviseWillNeed(int64 Offset)
+{
+    if (this->ReadAhead <= 0 || Offset >= this->Size) {
+        return;
+    }
+    const int64 End = FMath::Min<int64>(Offset + this->ReadAhead, this->Size);
+    //顺序读取时窗口和上一次提示的范围重叠，只提示新增的部分
+    const int64 Begin = (Offset >= this->AdvisedStart && Offset < this->AdvisedEnd) ? this->AdvisedEnd : Offset;
+#if MAPPED_FILE_USE_MADVISE
+    if (End > Begin) {
+        const int64 PageSize = sysconf(_SC_PAGESIZE);
+        const uintptr_t Start = ((uintptr_t)this->Data + Begin) & ~(uintptr_t)(PageSize - 1);
+        madvise((void*)Start, (size_t)((uintptr_t)this->Data + End - Start), MADV_WILLNEED);
+        this->Hints++;
+    }
+#endif
+    //不支持madvise时由系统自己预读(PreloadHint会在当前线程中逐页访问，和同步读取一样慢)
+    this->AdvisedStart = Offset;
+    this->AdvisedEnd = End;
+}
@@ -0,0 +1,54 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "FFmpegIOSource.h"
+
+class IMappedFileHandle;
+class IMappedFileRegion;
+
+/**
+ * 内存映射的本地文件AVIO数据源
+ * 整个文件映射到地址空间，读取时直接从映射内存拷贝到AVIO缓冲区，不需要每次调用read()
+ * 多个播放器读取同一个文件时共用系统的页缓存
+ * 支持madvise的平台上只对读取位置之后的窗口提示预读(MADV_WILLNEED)，窗口随读取位置移动，跳转之后提示新的位置
+ * 映射期间文件被其他程序截短时访问映射之外的页会触发SIGBUS，所以只在插件设置开启bMapLocalFiles时使用
+ */
+class FFmpegMappedFileSource : public FFmpegIOSource
+{
+public:
+	/**
+	 * 映射文件
+	 * @param Path 本地文件路径(不能是pak中的文件)
+	 * @param ReadAhead 提示系统预读的大小(字节)
+	 * @return 平台不支持内存映射或者文件无法映射(比如超出地址空间)时返回空，此时应该使用普通的文件读取
+	 */
+	static FFmpegMappedFileSource* Open(const FString& Path, int64 ReadAhead);
+
+	virtual ~FFmpegMappedFileSource();
+
+	virtual int Read(uint8_t* buf, int buf_size) override;
+	virtual int64_t SeekTo(int64_t pos) override;
+	virtual int64_t GetSize() const override;
+	virtual int64_t GetPosition() const override;
+	virtual FString GetStats() const override;
+
+private:
+	FFmpegMappedFileSource(IMappedFileHandle* InHandle, IMappedFileRegion* InRegion, int64 InReadAhead);
+
+	/** 提示系统预读[Offset, Offset + ReadAhead)，和上一次的窗口重叠的部分不再提示 */
+	void AdviseWillNeed(int64 Offset);
+
+private:
+	IMappedFileHandle* Handle;
+	IMappedFileRegion* Region;
+	const uint8* Data;
+	int64 Size;
+	int64 Position;
+	int64 ReadAhead;
+	int64 AdvisedStart; //当前预读窗口的开始位置
+	int64 AdvisedEnd; //当前预读窗口的结束位置
+	int Hints; //提示预读的次数
+	int Seeks; //不连续读取的次数
+};
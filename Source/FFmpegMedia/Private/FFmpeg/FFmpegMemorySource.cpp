@@ -0,0 +1,147 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "FFmpeg/FFmpegMemorySource.h"
+#include "FFmpegMedia.h"
+#include "LambdaFunctionRunnable.h"
+#include "HAL/PlatformFileManager.h"
+#include "HAL/PlatformProcess.h"
+extern  "C" {
+#include "libavutil/error.h"
+#include "libavutil/time.h"
+}
+
+/* 每次从文件读取的大小 */
+#define MEMORY_SOURCE_CHUNK_SIZE (4 * 1024 * 1024)
+
+FFmpegMemorySource* FFmpegMemorySource::Open(const FString& Path, int64 MaxSize)
+{
+    IFileHandle* Handle = FPlatformFileManager::Get().GetPlatformFile().OpenRead(*Path);
+    if (!Handle) {
+        return nullptr;
+    }
+    const int64 Size = Handle->Size();
+    if (Size <= 0 || Size > MaxSize) {
+        UE_LOG(LogFFmpegMedia, Warning, TEXT("MemorySource: %s is %lld bytes, not precached (max %lld)"), *Path, Size, MaxSize);
+        delete Handle;
+        return nullptr;
+    }
+    FFmpegMemorySource* Source = new FFmpegMemorySource(Handle, Size);
+    Source->LoadTid = LambdaFunctionRunnable::RunThreaded(TEXT("PrecacheThread"), [Source] {
+        Source->LoadThread();
+    });
+    if (!Source->LoadTid) {
+        delete Source;
+        return nullptr;
+    }
+    return Source;
+}
+
+FFmpegMemorySource::FFmpegMemorySource(IFileHandle* InHandle, int64 InSize)
+    : Loaded(0)
+    , Loading(true)
+    , Failed(false)
+    , AbortRequest(false)
+{
+    this->Handle = InHandle;
+    this->LoadTid = nullptr;
+    this->Size = InSize;
+    this->Position = 0;
+    this->LoadStart = av_gettime_relative();
+    this->LoadTime = 0.0;
+    this->Waits = 0;
+    this->Data.SetNumUninitialized(InSize);
+}
+
+FFmpegMemorySource::~FFmpegMemorySource()
+{
+    this->AbortRequest = true;
+    if (this->LoadTid) {
+        this->LoadTid->WaitForCompletion();
+    }
+    delete this->Handle;
+}
+
+void FFmpegMemorySource::LoadThread()
+{
+    //按顺序加载，播放开始时只需要等待文件头部
+    while (this->Loaded < this->Size && !this->AbortRequest) {
+        const int64 Offset = this->Loaded;
+        const int64 BytesToRead = FMath::Min<int64>(MEMORY_SOURCE_CHUNK_SIZE, this->Size - Offset);
+        if (!this->Handle->Read(this->Data.GetData() + Offset, BytesToRead)) {
+            UE_LOG(LogFFmpegMedia, Error, TEXT("MemorySource: read %lld bytes at %lld failed"), BytesToRead, Offset);
+            this->Failed = true;
+            break;
+        }
+        this->Loaded = Offset + BytesToRead;
+    }
+    this->LoadTime = (av_gettime_relative() - this->LoadStart) / 1000.0;
+    delete this->Handle;
+    this->Handle = nullptr;
+    this->Loading = false;
+    UE_LOG(LogFFmpegMedia, Verbose, TEXT("MemorySource: loaded %lld / %lld bytes in %.1f ms"), (int64)this->Loaded, this->Size, this->LoadTime);
+}
+
+int FFmpegMemorySource::Read(uint8_t* buf, int buf_size)
+{
+    if (this->Position >= this->Size) {
+        return AVERROR_EOF;
+    }
+    const int BytesToRead = (int)FMath::Min<int64>(buf_size, this->Size - this->Position);
+    //还没有加载到读取位置时等待，至少可以读取一部分时直接返回
+    if (this->Loaded <= this->Position) {
+        this->Waits++;
+        while (this->Loaded <= this->Position && this->Loading && !this->AbortRequest) {
+            FPlatformProcess::Sleep(0.001f);
+        }
+        if (this->Loaded <= this->Position) {
+            return AVERROR(EIO);
+        }
+    }
+    const int BytesAvailable = (int)FMath::Min<int64>(BytesToRead, this->Loaded - this->Position);
+    FMemory::Memcpy(buf, this->Data.GetData() + this->Position, BytesAvailable);
+    this->Position += BytesAvailable;
+    return BytesAvailable;
+}
+
+int64_t FFmpegMemorySource::SeekTo(int64_t pos)
+{
+    this->Position = pos;
+    return pos;
+}
+
+int64_t FFmpegMemorySource::GetSize() const
+{
+    return this->Size;
+}
+
+int64_t FFmpegMemorySource::GetPosition() const
+{
+    return this->Position;
+}
+
+FString FFmpegMemorySource::GetStats() const
+{
+    return FString::Printf(TEXT("memory, %lld / %lld bytes, loaded %.1f%%%s, %d waits"),
+        this->Position, this->Size, this->Size > 0 ? (double)this->Loaded * 100.0 / this->Size : 0.0,
+        this->Loading ? TEXT("") : *FString::Printf(TEXT(" in %.1f ms"), this->LoadTime), this->Waits);
+}
+
+bool FFmpegMemorySource::GetCachedRanges(TArray<TPair<int64, int64>>& OutRanges) const
+{
+    const int64 LoadedBytes = this->Loaded;
+    if (LoadedBytes > 0) {
+        OutRanges.Add(TPair<int64, int64>(0, LoadedBytes));
+    }
+    return true;
+}
+
+bool FFmpegMemorySource::IsLoading() const
+{
+    return this->Loading;
+}
+
+void FFmpegMemorySource::Abort()
+{
+    this->AbortRequest = true;
+}
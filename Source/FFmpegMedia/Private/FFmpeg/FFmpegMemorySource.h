@@ -0,0 +1,58 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "FFmpegIOSource.h"
+#include <atomic>
+
+class IFileHandle;
+class FRunnableThread;
+
+/**
+ * 预加载到内存的AVIO数据源(PrecacheFile选项)
+ * 打开之后在后台线程中把整个文件按顺序读取到内存，读取和跳转只访问内存，不再有文件读取调用
+ * 读取位置超过已经加载的部分时等待加载
+ */
+class FFmpegMemorySource : public FFmpegIOSource
+{
+public:
+	/**
+	 * 打开文件并开始在后台加载
+	 * @param Path 文件路径(可以是pak中的文件)
+	 * @param MaxSize 允许加载的最大文件大小(字节)
+	 * @return 文件不存在或者超过MaxSize时返回空
+	 */
+	static FFmpegMemorySource* Open(const FString& Path, int64 MaxSize);
+
+	virtual ~FFmpegMemorySource();
+
+	virtual int Read(uint8_t* buf, int buf_size) override;
+	virtual int64_t SeekTo(int64_t pos) override;
+	virtual int64_t GetSize() const override;
+	virtual int64_t GetPosition() const override;
+	virtual FString GetStats() const override;
+	virtual bool GetCachedRanges(TArray<TPair<int64, int64>>& OutRanges) const override;
+	virtual bool IsLoading() const override;
+	virtual void Abort() override;
+
+private:
+	FFmpegMemorySource(IFileHandle* InHandle, int64 InSize);
+
+	/** 加载线程 */
+	void LoadThread();
+
+private:
+	IFileHandle* Handle; //加载完成之后关闭
+	FRunnableThread* LoadTid;
+	TArray64<uint8> Data; //文件内容，可能超过2GB
+	int64 Size;
+	int64 Position;
+	std::atomic<int64> Loaded; //已经加载的字节数
+	std::atomic<bool> Loading; //是否正在加载
+	std::atomic<bool> Failed; //加载失败
+	std::atomic<bool> AbortRequest;
+	int64 LoadStart; //开始加载的时间(微秒)
+	double LoadTime; //加载耗时(毫秒)
+	int Waits; //读取时等待加载的次数
+};
@@ -0,0 +1,131 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "FFmpeg/FFmpegPacketCache.h"
+extern  "C" {
+#include "libavutil/error.h"
+}
+
+FCriticalSection FFmpegPacketCache::GlobalMutex;
+int64 FFmpegPacketCache::GlobalReserved = 0;
+
+FFmpegPacketCache::FFmpegPacketCache()
+{
+    this->Recording = 0;
+    this->Ready = 0;
+    this->ReadIndex = 0;
+    this->Budget = 0;
+    this->GlobalBudget = 0;
+    this->Size = 0;
+    this->Replays = 0;
+}
+
+FFmpegPacketCache::~FFmpegPacketCache()
+{
+    this->Reset();
+}
+
+void FFmpegPacketCache::Begin(int64 InBudget, int64 InGlobalBudget)
+{
+    this->Reset();
+    if (InBudget <= 0 || InGlobalBudget <= 0) {
+        return;
+    }
+    this->Budget = InBudget;
+    this->GlobalBudget = InGlobalBudget;
+    this->Recording = 1;
+}
+
+bool FFmpegPacketCache::Add(const AVPacket* pkt)
+{
+    if (!this->Recording) {
+        return false;
+    }
+    //数据包本身之外，每个包大约还有一个AVPacket结构体的开销
+    int64 PacketSize = pkt->size + (int64)sizeof(AVPacket);
+    AVPacket* cached = NULL;
+    if (this->Size + PacketSize > this->Budget) {
+        this->Reset();
+        return false;
+    }
+    bool Reserved;
+    {
+        FScopeLock GlobalLock(&GlobalMutex);
+        Reserved = GlobalReserved + PacketSize <= this->GlobalBudget;
+        if (Reserved) {
+            GlobalReserved += PacketSize;
+        }
+    }
+    if (!Reserved) {
+        this->Reset();
+        return false;
+    }
+    this->Size += PacketSize;
+    if (!(cached = av_packet_clone(pkt))) {
+        this->Reset();
+        return false;
+    }
+    this->Packets.Add(cached);
+    return true;
+}
+
+void FFmpegPacketCache::Finish()
+{
+    if (!this->Recording) {
+        return;
+    }
+    this->Recording = 0;
+    this->Ready = this->Packets.Num() > 0;
+}
+
+void FFmpegPacketCache::Reset()
+{
+    for (AVPacket*& pkt : this->Packets) {
+        av_packet_free(&pkt);
+    }
+    this->Packets.Empty();
+    this->Recording = 0;
+    this->Ready = 0;
+    this->ReadIndex = 0;
+    if (this->Size > 0) {
+        FScopeLock GlobalLock(&GlobalMutex);
+        GlobalReserved -= this->Size;
+    }
+    this->Size = 0;
+}
+
+bool FFmpegPacketCache::IsRecording() const
+{
+    return this->Recording != 0;
+}
+
+bool FFmpegPacketCache::IsReady() const
+{
+    return this->Ready != 0;
+}
+
+void FFmpegPacketCache::Rewind()
+{
+    this->ReadIndex = 0;
+    this->Replays++;
+}
+
+int FFmpegPacketCache::Read(AVPacket* pkt)
+{
+    if (!this->Ready || this->ReadIndex >= this->Packets.Num()) {
+        return AVERROR_EOF;
+    }
+    return av_packet_ref(pkt, this->Packets[this->ReadIndex++]);
+}
+
+FString FFmpegPacketCache::GetStats() const
+{
+    int64 Global;
+    {
+        FScopeLock GlobalLock(&GlobalMutex);
+        Global = GlobalReserved;
+    }
+    return FString::Printf(TEXT("%s, %d packets, %.1f / %.1f MB (all players %.1f MB), %d replays"),
+        this->Ready ? TEXT("ready") : (this->Recording ? TEXT("recording") : TEXT("none")),
+        this->Packets.Num(), this->Size / (1024.0 * 1024.0), this->Budget / (1024.0 * 1024.0), Global / (1024.0 * 1024.0), this->Replays);
+}
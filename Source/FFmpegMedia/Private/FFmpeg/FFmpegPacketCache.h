@@ -0,0 +1,69 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+extern "C" {
+#include "libavcodec/packet.h"
+}
+
+/**
+ * 循环播放时的完整数据包缓存
+ * 第一次从头到尾读取文件时保存所有的数据包(引用计数，不拷贝数据)，之后的循环直接从缓存中回放，不再读取和解复用文件
+ * 只在read_thread中使用，不需要加锁；所有播放器共用一个全局内存预算，添加数据包时从全局预算中预留
+ */
+class FFmpegPacketCache
+{
+public:
+	FFmpegPacketCache();
+	~FFmpegPacketCache();
+public:
+	/**
+	 * 开始录制(文件必须从头开始读取)
+	 * @param Budget 内存预算(字节)
+	 * @param GlobalBudget 全局内存预算(字节)
+	 */
+	void Begin(int64 Budget, int64 GlobalBudget);
+
+	/**
+	 * 添加数据包，超出预算或者全局预算时放弃录制
+	 * @return 放弃录制时返回false
+	 */
+	bool Add(const AVPacket* pkt);
+
+	/** 读取到文件结尾，录制完成 */
+	void Finish();
+
+	/** 清空缓存 */
+	void Reset();
+
+	/** 是否正在录制 */
+	bool IsRecording() const;
+
+	/** 是否已经录制完成 */
+	bool IsReady() const;
+
+	/** 从头开始回放 */
+	void Rewind();
+
+	/**
+	 * 回放下一个数据包
+	 * @return 成功返回0，已经回放到结尾返回AVERROR_EOF
+	 */
+	int Read(AVPacket* pkt);
+
+	/** 获取统计信息 */
+	FString GetStats() const;
+private:
+	TArray<AVPacket*> Packets;
+	int Recording;
+	int Ready;
+	int ReadIndex;
+	int64 Budget;
+	int64 GlobalBudget;
+	int64 Size; //从全局预算中预留的大小
+	int Replays; //回放次数
+
+	static FCriticalSection GlobalMutex;
+	static int64 GlobalReserved; //所有播放器已经预留的内存
+};
@@ -20,6 +20,10 @@ FFmpegPacketQueue::FFmpegPacketQueue()
     duration = 0;
     abort_request = 0;
     serial = 0;
+    head_pts = AV_NOPTS_VALUE;
+    end_pts = AV_NOPTS_VALUE;
+    mutex = nullptr;
+    cond = nullptr;
 }
 
 FFmpegPacketQueue::~FFmpegPacketQueue()
@@ -46,6 +50,15 @@ int FFmpegPacketQueue::PutPrivate(AVPacket* pkt)
     this->nb_packets++;
     this->size += pkt1.pkt->size + sizeof(pkt1);
     this->duration += pkt1.pkt->duration;
+    //空数据包(刷新解码器)没有时间戳
+    const int64_t ts = pkt->pts != AV_NOPTS_VALUE ? pkt->pts : pkt->dts;
+    if (ts != AV_NOPTS_VALUE) {
+        const int64_t end = ts + FFMAX(pkt->duration, 0);
+        if (this->end_pts == AV_NOPTS_VALUE || end > this->end_pts)
+            this->end_pts = end;
+        if (this->head_pts == AV_NOPTS_VALUE)
+            this->head_pts = ts;
+    }
     /* XXX: should duplicate packet data in DV case */
     this->cond->signal();
     return 0;
@@ -111,12 +124,16 @@ void FFmpegPacketQueue::Flush()
     this->nb_packets = 0;
     this->size = 0;
     this->duration = 0;
+    this->head_pts = AV_NOPTS_VALUE;
+    this->end_pts = AV_NOPTS_VALUE;
     this->serial++;
     this->mutex->Unlock();
 }
 
 void FFmpegPacketQueue::Destroy()
 {
+    if (!this->pkt_list || !this->mutex) //队列没有初始化(比如纯音频模式下的视频队列)
+        return;
     this->Flush();
     av_fifo_freep(&this->pkt_list);
     //SDL_DestroyMutex(q->mutex);
@@ -158,6 +175,11 @@ int FFmpegPacketQueue::Get(AVPacket* pkt, int block, int* serial_)
             this->nb_packets--;
             this->size -= pkt1.pkt->size + sizeof(pkt1);
             this->duration -= pkt1.pkt->duration;
+            //解码位置使用dts(B帧的pts不是单调递增的)
+            if (pkt1.pkt->dts != AV_NOPTS_VALUE)
+                this->head_pts = pkt1.pkt->dts;
+            else if (pkt1.pkt->pts != AV_NOPTS_VALUE)
+                this->head_pts = pkt1.pkt->pts;
             av_packet_move_ref(pkt, pkt1.pkt);
             if (serial_)
                 *serial_ = pkt1.serial;
@@ -192,4 +214,12 @@ int FFmpegPacketQueue::GetNbPackets()
     return this->nb_packets;
 }
 
+int64_t FFmpegPacketQueue::GetHeadPts() const
+{
+    return this->head_pts;
+}
 
+int64_t FFmpegPacketQueue::GetEndPts() const
+{
+    return this->end_pts;
+}
@@ -4,6 +4,7 @@
 
 #include "FFmpegCond.h"
 #include <mutex>
+#include <atomic>
 #include "CoreMinimal.h"
 extern "C" {
     #include "libavutil/fifo.h"
@@ -80,6 +81,18 @@ public:
     int GetAbortRequest();
     int GetSerial();
     int GetNbPackets();
+
+    /**
+    * 解码器最后取出的数据包的时间戳(流的time_base)，之后还没有取出数据包时为队列中第一个数据包的时间戳
+    * 不需要加锁，可以在其他线程中读取，队列刷新之后为AV_NOPTS_VALUE
+    */
+    int64_t GetHeadPts() const;
+
+    /**
+    * 队列中数据包的最大结束时间戳(pts + duration，流的time_base)
+    * 不需要加锁，可以在其他线程中读取，队列刷新之后为AV_NOPTS_VALUE
+    */
+    int64_t GetEndPts() const;
 public:
     AVFifoBuffer* pkt_list;
     int nb_packets; //当前队列中packet数量
@@ -89,4 +102,6 @@ public:
     int serial; //序列号
     FCriticalSection* mutex;
     FFmpegCond* cond;
+    std::atomic<int64_t> head_pts; //只在持有mutex时修改
+    std::atomic<int64_t> end_pts;
 };
@@ -0,0 +1,97 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "FFmpeg/FFmpegProtocolSource.h"
+#include "FFmpegMedia.h"
+extern  "C" {
+#include "libavformat/avio.h"
+#include "libavutil/error.h"
+}
+#include <stdio.h>
+
+FFmpegProtocolSource* FFmpegProtocolSource::Open(const FString& Url, const int* abort_flag)
+{
+    const char* protocol = avio_find_protocol_name(TCHAR_TO_UTF8(*Url));
+    FFmpegProtocolSource* Source = new FFmpegProtocolSource(protocol ? UTF8_TO_TCHAR(protocol) : TEXT("unknown"));
+    //中断回调之后在IO线程中使用，不能直接使用播放器的中断标记
+    AVIOInterruptCB interrupt_callback = { InterruptCallback, Source };
+    Source->OpenAbortFlag = abort_flag;
+    int ret = avio_open2(&Source->Context, TCHAR_TO_UTF8(*Url), AVIO_FLAG_READ, &interrupt_callback, nullptr);
+    Source->OpenAbortFlag = nullptr;
+    if (ret < 0) {
+        char errbuf[256] = {};
+        av_strerror(ret, errbuf, sizeof(errbuf));
+        UE_LOG(LogFFmpegMedia, Verbose, TEXT("ProtocolSource: could not open %s (%s)"), *Url, UTF8_TO_TCHAR(errbuf));
+        delete Source;
+        return nullptr;
+    }
+    Source->Size = avio_size(Source->Context); //不支持时为负数
+    return Source;
+}
+
+FFmpegProtocolSource::FFmpegProtocolSource(const FString& InProtocol)
+    : Protocol(InProtocol)
+    , AbortRequest(false)
+{
+    this->Context = nullptr;
+    this->OpenAbortFlag = nullptr;
+    this->Size = -1;
+    this->Position = 0;
+    this->BytesRead = 0;
+    this->Seeks = 0;
+}
+
+FFmpegProtocolSource::~FFmpegProtocolSource()
+{
+    avio_closep(&this->Context);
+}
+
+int FFmpegProtocolSource::Read(uint8_t* buf, int buf_size)
+{
+    int ret = avio_read(this->Context, buf, buf_size);
+    if (ret == 0) {
+        return AVERROR_EOF;
+    }
+    if (ret > 0) {
+        this->Position += ret;
+        this->BytesRead += ret;
+    }
+    return ret;
+}
+
+int64_t FFmpegProtocolSource::SeekTo(int64_t pos)
+{
+    int64_t ret = avio_seek(this->Context, pos, SEEK_SET);
+    if (ret >= 0) {
+        this->Position = ret;
+        this->Seeks++;
+    }
+    return ret;
+}
+
+int64_t FFmpegProtocolSource::GetSize() const
+{
+    return this->Size;
+}
+
+int64_t FFmpegProtocolSource::GetPosition() const
+{
+    return this->Position;
+}
+
+FString FFmpegProtocolSource::GetStats() const
+{
+    return FString::Printf(TEXT("%s, %lld / %lld bytes, read %.1f MB, %d seeks"),
+        *this->Protocol, this->Position, this->Size, this->BytesRead / (1024.0 * 1024.0), this->Seeks);
+}
+
+void FFmpegProtocolSource::Abort()
+{
+    this->AbortRequest = true;
+}
+
+int FFmpegProtocolSource::InterruptCallback(void* ctx)
+{
+    const FFmpegProtocolSource* Source = static_cast<const FFmpegProtocolSource*>(ctx);
+    return (Source->AbortRequest || (Source->OpenAbortFlag && *Source->OpenAbortFlag)) ? 1 : 0;
+}
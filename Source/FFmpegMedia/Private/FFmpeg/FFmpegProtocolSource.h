@@ -0,0 +1,47 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "FFmpegIOSource.h"
+#include <atomic>
+
+/**
+ * 通过FFmpeg协议(http、https、ftp、file等)读取的AVIO数据源
+ * 单独使用时和FFmpeg直接打开地址一样，主要用于放在FFmpegReadAheadSource后面，由读取线程之外的IO线程读取
+ */
+class FFmpegProtocolSource : public FFmpegIOSource
+{
+public:
+	/**
+	 * 打开地址
+	 * @param Url 媒体地址
+	 * @param abort_flag 打开期间使用的中断标记，不为0时中断打开
+	 * @return 无法打开时返回空
+	 */
+	static FFmpegProtocolSource* Open(const FString& Url, const int* abort_flag);
+
+	virtual ~FFmpegProtocolSource();
+
+	virtual int Read(uint8_t* buf, int buf_size) override;
+	virtual int64_t SeekTo(int64_t pos) override;
+	virtual int64_t GetSize() const override;
+	virtual int64_t GetPosition() const override;
+	virtual FString GetStats() const override;
+	virtual void Abort() override;
+
+private:
+	FFmpegProtocolSource(const FString& InProtocol);
+
+	static int InterruptCallback(void* ctx);
+
+private:
+	AVIOContext* Context;
+	std::atomic<bool> AbortRequest;
+	const int* OpenAbortFlag; //只在打开期间有效
+	FString Protocol;
+	int64 Size;
+	int64 Position;
+	int64 BytesRead;
+	int Seeks;
+};
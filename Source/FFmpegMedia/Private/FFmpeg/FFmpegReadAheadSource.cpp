@@ -0,0 +1,217 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "FFmpeg/FFmpegReadAheadSource.h"
+#include "FFmpegMedia.h"
+#include "LambdaFunctionRunnable.h"
+#include "HAL/Event.h"
+#include "HAL/PlatformProcess.h"
+extern  "C" {
+#include "libavutil/error.h"
+#include "libavutil/time.h"
+}
+
+/* 等待的超时时间(毫秒)，防止丢失通知时一直阻塞 */
+#define READ_AHEAD_WAIT_MS 10
+
+FFmpegReadAheadSource::FFmpegReadAheadSource(FFmpegIOSource* InSource, int64 InCapacity, int InChunkSize)
+    : AbortRequest(false)
+{
+    this->Source = InSource;
+    this->Capacity = FMath::Max<int64>(InCapacity, 64 * 1024);
+    this->BackSize = this->Capacity / 4;
+    this->ChunkSize = (int)FMath::Clamp<int64>(InChunkSize, 4096, this->Capacity / 4);
+    this->Size = InSource->GetSize();
+    this->Ring.SetNumUninitialized(this->Capacity);
+    this->Position = InSource->GetPosition();
+    this->WindowStart = this->Position;
+    this->WindowEnd = this->Position;
+    this->SeekRequest = -1;
+    this->Error = 0;
+    this->Stalls = 0;
+    this->StallTime = 0.0;
+    this->SeekHits = 0;
+    this->SeekMisses = 0;
+    this->DataEvent = FPlatformProcess::GetSynchEventFromPool(false);
+    this->RequestEvent = FPlatformProcess::GetSynchEventFromPool(false);
+    this->IOTid = LambdaFunctionRunnable::RunThreaded(TEXT("ReadAheadThread"), [this] {
+        IOThread();
+    });
+    if (!this->IOTid) {
+        UE_LOG(LogFFmpegMedia, Error, TEXT("ReadAheadSource: start io thread fail"));
+        this->AbortRequest = true;
+    }
+}
+
+FFmpegReadAheadSource::~FFmpegReadAheadSource()
+{
+    this->Abort();
+    if (this->IOTid) {
+        this->IOTid->WaitForCompletion();
+    }
+    FPlatformProcess::ReturnSynchEventToPool(this->DataEvent);
+    FPlatformProcess::ReturnSynchEventToPool(this->RequestEvent);
+    delete this->Source;
+}
+
+bool FFmpegReadAheadSource::GetCachedRanges(TArray<TPair<int64, int64>>& OutRanges) const
+{
+    //环形缓冲区只是短时间的缓存，只报告数据源自己的缓存
+    return this->Source->GetCachedRanges(OutRanges);
+}
+
+bool FFmpegReadAheadSource::IsLoading() const
+{
+    return this->Source->IsLoading();
+}
+
+void FFmpegReadAheadSource::Abort()
+{
+    this->AbortRequest = true;
+    this->Source->Abort(); //中断IO线程中阻塞的读取
+    this->DataEvent->Trigger();
+    this->RequestEvent->Trigger();
+}
+
+bool FFmpegReadAheadSource::IsBuffered(int64 pos) const
+{
+    //当前位置之后一个缓冲区以内的数据IO线程会按顺序填充，不需要跳转
+    return pos >= this->WindowStart && pos <= this->WindowEnd + this->Capacity / 2;
+}
+
+int FFmpegReadAheadSource::Read(uint8_t* buf, int buf_size)
+{
+    FScopeLock Lock(&this->Mutex);
+    int64_t stall_start = 0;
+    int ret;
+    for (;;) {
+        if (this->AbortRequest) {
+            ret = AVERROR_EXIT;
+            break;
+        }
+        if (this->SeekRequest < 0 && this->Position >= this->WindowStart && this->Position < this->WindowEnd) {
+            //环形缓冲区中的数据可能分成两段
+            const int64 Offset = this->Position % this->Capacity;
+            const int64 Available = FMath::Min<int64>(this->WindowEnd - this->Position, this->Capacity - Offset);
+            ret = (int)FMath::Min<int64>(buf_size, Available);
+            FMemory::Memcpy(buf, this->Ring.GetData() + Offset, ret);
+            this->Position += ret;
+            break;
+        }
+        if (this->SeekRequest < 0 && this->Position == this->WindowEnd && this->Error < 0) {
+            ret = this->Error; //读取到结尾或者出错
+            break;
+        }
+        //IO线程已经停止填充(结尾或者出错)时，缓冲区之外的位置都需要跳转
+        if (this->SeekRequest < 0 && (!this->IsBuffered(this->Position) || this->Error < 0)) {
+            this->SeekRequest = this->Position;
+            this->SeekMisses++;
+        }
+        if (stall_start == 0) {
+            stall_start = av_gettime_relative();
+            this->Stalls++;
+        }
+        this->RequestEvent->Trigger();
+        this->Mutex.Unlock();
+        this->DataEvent->Wait(READ_AHEAD_WAIT_MS);
+        this->Mutex.Lock();
+    }
+    if (stall_start > 0) {
+        this->StallTime += (av_gettime_relative() - stall_start) / 1000.0;
+    }
+    this->RequestEvent->Trigger(); //读取之后缓冲区有了空闲空间
+    return ret;
+}
+
+int64_t FFmpegReadAheadSource::SeekTo(int64_t pos)
+{
+    FScopeLock Lock(&this->Mutex);
+    if (pos == this->Position) {
+        return pos;
+    }
+    this->Position = pos;
+    if (this->SeekRequest < 0 && this->IsBuffered(pos)) {
+        this->SeekHits++;
+        this->RequestEvent->Trigger();
+    }
+    else {
+        //缓冲区之外，由IO线程跳转数据源
+        this->SeekRequest = pos;
+        this->SeekMisses++;
+        this->RequestEvent->Trigger();
+    }
+    return pos;
+}
+
+int64_t FFmpegReadAheadSource::GetSize() const
+{
+    return this->Size;
+}
+
+int64_t FFmpegReadAheadSource::GetPosition() const
+{
+    FScopeLock Lock(&this->Mutex);
+    return this->Position;
+}
+
+FString FFmpegReadAheadSource::GetStats() const
+{
+    FScopeLock Lock(&this->Mutex);
+    const int64 Ahead = FMath::Max<int64>(this->WindowEnd - this->Position, 0);
+    return FString::Printf(TEXT("read ahead %.1f / %.1f MB (%.0f%%), %d stalls (%.1f ms), seeks %d in buffer, %d to source; %s"),
+        Ahead / (1024.0 * 1024.0), (this->Capacity - this->BackSize) / (1024.0 * 1024.0), Ahead * 100.0 / (this->Capacity - this->BackSize),
+        this->Stalls, this->StallTime, this->SeekHits, this->SeekMisses, *this->Source->GetStats());
+}
+
+void FFmpegReadAheadSource::IOThread()
+{
+    FScopeLock Lock(&this->Mutex);
+    while (!this->AbortRequest) {
+        //处理跳转请求，缓冲区从新的位置开始
+        if (this->SeekRequest >= 0) {
+            const int64 pos = this->SeekRequest;
+            this->Mutex.Unlock();
+            int64_t ret = this->Source->SeekTo(pos);
+            this->Mutex.Lock();
+            if (this->SeekRequest != pos) { //跳转期间又有新的请求
+                continue;
+            }
+            this->SeekRequest = -1;
+            this->WindowStart = pos;
+            this->WindowEnd = pos;
+            this->Error = ret < 0 ? (int)ret : 0;
+            this->DataEvent->Trigger();
+            continue;
+        }
+
+        //读取到结尾或者出错之后等待跳转，当前位置之前保留BackSize的数据，缓冲区满时等待读取
+        const int64 Keep = FMath::Max<int64>(this->WindowStart, this->Position - this->BackSize);
+        const int64 Free = this->Capacity - (this->WindowEnd - Keep);
+        if (this->Error < 0 || Free <= 0 || this->Position < this->WindowStart) {
+            this->Mutex.Unlock();
+            this->RequestEvent->Wait(READ_AHEAD_WAIT_MS);
+            this->Mutex.Lock();
+            continue;
+        }
+
+        //只读取到环形缓冲区的结尾，下一次从头开始
+        const int64 FillPos = this->WindowEnd;
+        const int64 Offset = FillPos % this->Capacity;
+        const int BytesToRead = (int)FMath::Min<int64>(FMath::Min<int64>(this->ChunkSize, Free), this->Capacity - Offset);
+        this->WindowStart = FMath::Max<int64>(this->WindowStart, FillPos + BytesToRead - this->Capacity); //覆盖最早的数据
+        this->Mutex.Unlock();
+        //写入的区域不在[WindowStart, WindowEnd)中，读取线程不会访问
+        int ret = this->Source->Read(this->Ring.GetData() + Offset, BytesToRead);
+        this->Mutex.Lock();
+        if (this->SeekRequest >= 0) { //读取期间有跳转请求，丢弃读取的数据
+            continue;
+        }
+        if (ret < 0) {
+            this->Error = ret;
+        }
+        else {
+            this->WindowEnd = FillPos + ret;
+        }
+        this->DataEvent->Trigger();
+    }
+}
@@ -0,0 +1,70 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "FFmpegIOSource.h"
+#include <atomic>
+
+class FEvent;
+class FRunnableThread;
+
+/**
+ * 预读数据源
+ * 放在任意数据源和解复用器之间，单独的IO线程从数据源读取数据填充环形缓冲区，读取线程只从缓冲区中拷贝
+ * 存储或者网络的延迟不再直接阻塞av_read_frame，只有缓冲区读空时才需要等待(记为一次卡顿)
+ * 缓冲区中保留当前位置之前的一部分数据，跳转到缓冲区范围内时不需要访问数据源
+ */
+class FFmpegReadAheadSource : public FFmpegIOSource
+{
+public:
+	/**
+	 * @param InSource 实际的数据源，之后只在IO线程中访问，由本对象释放
+	 * @param Capacity 环形缓冲区大小(字节)
+	 * @param ChunkSize IO线程每次读取的最大字节数
+	 */
+	FFmpegReadAheadSource(FFmpegIOSource* InSource, int64 Capacity, int ChunkSize);
+
+	virtual ~FFmpegReadAheadSource();
+
+	virtual int Read(uint8_t* buf, int buf_size) override;
+	virtual int64_t SeekTo(int64_t pos) override;
+	virtual int64_t GetSize() const override;
+	virtual int64_t GetPosition() const override;
+	virtual FString GetStats() const override;
+	virtual bool GetCachedRanges(TArray<TPair<int64, int64>>& OutRanges) const override;
+	virtual bool IsLoading() const override;
+	virtual void Abort() override;
+
+private:
+	/** IO线程 */
+	void IOThread();
+
+	/** 在锁内判断当前位置是否在缓冲区中或者即将被填充 */
+	bool IsBuffered(int64 pos) const;
+
+private:
+	FFmpegIOSource* Source;
+	FRunnableThread* IOTid;
+	TArray64<uint8> Ring;
+	int64 Capacity;
+	int64 BackSize; //当前位置之前保留的数据大小
+	int ChunkSize;
+	int64 Size;
+
+	mutable FCriticalSection Mutex;
+	FEvent* DataEvent; //IO线程填充数据或者出错时通知读取线程
+	FEvent* RequestEvent; //读取线程读取或者跳转之后通知IO线程
+	int64 Position; //读取位置
+	int64 WindowStart; //缓冲区中数据的范围[WindowStart, WindowEnd)，只在IO线程中修改
+	int64 WindowEnd;
+	int64 SeekRequest; //请求IO线程跳转的位置，-1表示没有请求
+	int Error; //IO线程读取的错误(包括AVERROR_EOF)，0表示没有错误
+	std::atomic<bool> AbortRequest;
+
+	//统计
+	int Stalls; //读取时缓冲区为空需要等待的次数
+	double StallTime; //等待的总时间(毫秒)
+	int SeekHits; //跳转到缓冲区范围内的次数
+	int SeekMisses; //需要数据源跳转的次数
+};
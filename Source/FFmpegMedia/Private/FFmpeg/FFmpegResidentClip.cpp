@@ -0,0 +1,211 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "FFmpeg/FFmpegResidentClip.h"
+
+/* 查找时允许的误差(秒)，pts换算成秒之后可能存在精度误差 */
+#define RESIDENT_CLIP_PTS_EPSILON 0.0005
+
+FCriticalSection FFmpegResidentClip::GlobalMutex;
+int64 FFmpegResidentClip::GlobalReserved = 0;
+
+FFmpegResidentClip::FFmpegResidentClip()
+{
+    this->Recording = 0;
+    this->Ready = 0;
+    this->Reserved = 0;
+    this->Size = 0;
+}
+
+FFmpegResidentClip::~FFmpegResidentClip()
+{
+    this->Reset();
+}
+
+bool FFmpegResidentClip::Begin(int64 EstimatedBytes, int64 GlobalBudget)
+{
+    this->Reset();
+    if (EstimatedBytes <= 0) {
+        return false;
+    }
+    {
+        FScopeLock GlobalLock(&GlobalMutex);
+        if (GlobalReserved + EstimatedBytes > GlobalBudget) {
+            return false;
+        }
+        GlobalReserved += EstimatedBytes;
+    }
+    FScopeLock Lock(&Mutex);
+    this->Reserved = EstimatedBytes;
+    this->Recording = 1;
+    return true;
+}
+
+bool FFmpegResidentClip::AddVideo(double Time, double Duration, const TSharedRef<IMediaTextureSample, ESPMode::ThreadSafe>& Sample)
+{
+    {
+        FScopeLock Lock(&Mutex);
+        if (!this->Recording) {
+            return false;
+        }
+        //按照显示顺序添加，时间戳可能重复(比如暂停时重复显示的帧)
+        if (this->Video.Num() > 0 && Time < this->Video.Last().Time + RESIDENT_CLIP_PTS_EPSILON) {
+            return true;
+        }
+        if (this->Reserve((int64)Sample->GetStride() * Sample->GetDim().Y)) {
+            this->Video.Add({ Time, Duration, Sample });
+            return true;
+        }
+    }
+    this->Reset();
+    return false;
+}
+
+bool FFmpegResidentClip::AddAudio(double Time, double Duration, int64 Bytes, const TSharedRef<IMediaAudioSample, ESPMode::ThreadSafe>& Sample)
+{
+    {
+        FScopeLock Lock(&Mutex);
+        if (!this->Recording) {
+            return false;
+        }
+        if (this->Audio.Num() > 0 && Time < this->Audio.Last().Time + RESIDENT_CLIP_PTS_EPSILON) {
+            return true;
+        }
+        if (this->Reserve(Bytes)) {
+            this->Audio.Add({ Time, Duration, Sample });
+            return true;
+        }
+    }
+    this->Reset();
+    return false;
+}
+
+void FFmpegResidentClip::Finish()
+{
+    FScopeLock Lock(&Mutex);
+    if (!this->Recording) {
+        return;
+    }
+    this->Recording = 0;
+    this->Ready = this->Video.Num() > 0;
+}
+
+void FFmpegResidentClip::Reset()
+{
+    int64 Released;
+    {
+        FScopeLock Lock(&Mutex);
+        this->Video.Empty();
+        this->Audio.Empty();
+        this->Recording = 0;
+        this->Ready = 0;
+        this->Size = 0;
+        Released = this->Reserved;
+        this->Reserved = 0;
+    }
+    if (Released > 0) {
+        FScopeLock GlobalLock(&GlobalMutex);
+        GlobalReserved -= Released;
+    }
+}
+
+bool FFmpegResidentClip::IsRecording() const
+{
+    FScopeLock Lock(&Mutex);
+    return this->Recording != 0;
+}
+
+bool FFmpegResidentClip::IsReady() const
+{
+    FScopeLock Lock(&Mutex);
+    return this->Ready != 0;
+}
+
+int FFmpegResidentClip::FindVideo(double Time) const
+{
+    FScopeLock Lock(&Mutex);
+    if (this->Video.Num() == 0) {
+        return -1;
+    }
+    //二分查找最后一个 Time <= time 的帧
+    int low = 0, high = this->Video.Num() - 1, found = 0;
+    while (low <= high) {
+        int mid = (low + high) / 2;
+        if (this->Video[mid].Time <= Time + RESIDENT_CLIP_PTS_EPSILON) {
+            found = mid;
+            low = mid + 1;
+        }
+        else {
+            high = mid - 1;
+        }
+    }
+    return found;
+}
+
+TSharedPtr<IMediaTextureSample, ESPMode::ThreadSafe> FFmpegResidentClip::GetVideo(int Index, double& OutTime, double& OutDuration) const
+{
+    FScopeLock Lock(&Mutex);
+    if (!this->Video.IsValidIndex(Index)) {
+        return nullptr;
+    }
+    OutTime = this->Video[Index].Time;
+    OutDuration = this->Video[Index].Duration;
+    return this->Video[Index].Sample;
+}
+
+int FFmpegResidentClip::GetNumVideo() const
+{
+    FScopeLock Lock(&Mutex);
+    return this->Video.Num();
+}
+
+int FFmpegResidentClip::FindAudio(double Time) const
+{
+    FScopeLock Lock(&Mutex);
+    //二分查找第一个 Time >= time 的样本
+    int low = 0, high = this->Audio.Num() - 1, found = -1;
+    while (low <= high) {
+        int mid = (low + high) / 2;
+        if (this->Audio[mid].Time >= Time - RESIDENT_CLIP_PTS_EPSILON) {
+            found = mid;
+            high = mid - 1;
+        }
+        else {
+            low = mid + 1;
+        }
+    }
+    return found;
+}
+
+TSharedPtr<IMediaAudioSample, ESPMode::ThreadSafe> FFmpegResidentClip::GetAudio(int Index, double& OutTime, double& OutDuration) const
+{
+    FScopeLock Lock(&Mutex);
+    if (!this->Audio.IsValidIndex(Index)) {
+        return nullptr;
+    }
+    OutTime = this->Audio[Index].Time;
+    OutDuration = this->Audio[Index].Duration;
+    return this->Audio[Index].Sample;
+}
+
+FString FFmpegResidentClip::GetStats() const
+{
+    FScopeLock Lock(&Mutex);
+    int64 Global;
+    {
+        FScopeLock GlobalLock(&GlobalMutex);
+        Global = GlobalReserved;
+    }
+    return FString::Printf(TEXT("%s, %d video frames, %d audio samples, %.1f / %.1f MB (all players %.1f MB)"),
+        this->Ready ? TEXT("ready") : (this->Recording ? TEXT("recording") : TEXT("none")),
+        this->Video.Num(), this->Audio.Num(), this->Size / (1024.0 * 1024.0), this->Reserved / (1024.0 * 1024.0), Global / (1024.0 * 1024.0));
+}
+
+bool FFmpegResidentClip::Reserve(int64 Bytes)
+{
+    if (this->Size + Bytes > this->Reserved) {
+        return false;
+    }
+    this->Size += Bytes;
+    return true;
+}
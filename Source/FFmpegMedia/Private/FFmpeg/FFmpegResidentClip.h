@@ -0,0 +1,103 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "IMediaTextureSample.h"
+#include "IMediaAudioSample.h"
+
+/**
+ * 常驻内存的已解码循环片段
+ * 较短的循环片段第一次播放时，把视频样本(NV12格式，比BGRA节省一半以上的内存)和音频样本保存下来，之后的循环直接发送保存的样本，不再解码和转换
+ * 所有播放器共用一个全局内存预算，开始录制时按照估计的大小预留
+ */
+class FFmpegResidentClip
+{
+public:
+	FFmpegResidentClip();
+	~FFmpegResidentClip();
+public:
+	/**
+	 * 开始录制，从全局预算中预留内存
+	 * @param EstimatedBytes 估计需要的内存(字节)
+	 * @param GlobalBudget 全局内存预算(字节)
+	 * @return 预算不足时返回false
+	 */
+	bool Begin(int64 EstimatedBytes, int64 GlobalBudget);
+
+	/**
+	 * 添加视频样本，超出预留的内存时放弃录制
+	 * @param Time 媒体时间(秒)
+	 * @param Duration 帧时长(秒)
+	 */
+	bool AddVideo(double Time, double Duration, const TSharedRef<IMediaTextureSample, ESPMode::ThreadSafe>& Sample);
+
+	/**
+	 * 添加音频样本，超出预留的内存时放弃录制
+	 * @param Time 媒体时间(样本开始时间，秒)
+	 * @param Duration 样本时长(秒)
+	 * @param Bytes 样本数据大小
+	 */
+	bool AddAudio(double Time, double Duration, int64 Bytes, const TSharedRef<IMediaAudioSample, ESPMode::ThreadSafe>& Sample);
+
+	/** 完成录制 */
+	void Finish();
+
+	/** 清空样本并释放预留的内存 */
+	void Reset();
+
+	/** 是否正在录制 */
+	bool IsRecording() const;
+
+	/** 是否已经录制完成 */
+	bool IsReady() const;
+
+	/**
+	 * 查找指定时间显示的视频帧，时间在第一帧之前时返回第一帧
+	 * @param Time 媒体时间(秒)
+	 * @return 帧序号，没有视频帧时返回-1
+	 */
+	int FindVideo(double Time) const;
+
+	/** 获取视频帧 */
+	TSharedPtr<IMediaTextureSample, ESPMode::ThreadSafe> GetVideo(int Index, double& OutTime, double& OutDuration) const;
+
+	/** 视频帧数量 */
+	int GetNumVideo() const;
+
+	/**
+	 * 查找第一个开始时间不早于指定时间的音频样本
+	 * @param Time 媒体时间(秒)
+	 * @return 样本序号，已经没有样本时返回-1
+	 */
+	int FindAudio(double Time) const;
+
+	/** 获取音频样本 */
+	TSharedPtr<IMediaAudioSample, ESPMode::ThreadSafe> GetAudio(int Index, double& OutTime, double& OutDuration) const;
+
+	/** 获取统计信息 */
+	FString GetStats() const;
+private:
+	template<typename SampleType>
+	struct FEntry
+	{
+		double Time;
+		double Duration;
+		TSharedPtr<SampleType, ESPMode::ThreadSafe> Sample;
+	};
+
+	/** 超出预留内存时放弃录制 */
+	bool Reserve(int64 Bytes);
+private:
+	mutable FCriticalSection Mutex;
+	TArray<FEntry<IMediaTextureSample>> Video; //按照时间排序
+	TArray<FEntry<IMediaAudioSample>> Audio; //按照时间排序
+	int Recording;
+	int Ready;
+	int64 Reserved; //从全局预算中预留的内存
+	int64 Size; //已经使用的内存
+
+	/** 所有播放器预留的内存 */
+	static FCriticalSection GlobalMutex;
+	static int64 GlobalReserved;
+};
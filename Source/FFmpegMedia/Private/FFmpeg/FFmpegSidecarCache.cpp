@@ -0,0 +1,92 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "FFmpeg/FFmpegSidecarCache.h"
+#include "FFmpegMedia.h"
+#include "HAL/FileManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Misc/SecureHash.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+
+/* 缓存文件头标识 */
+#define SIDECAR_CACHE_MAGIC 0x534D4646 // "FFMS"
+
+FString FFmpegSidecarCache::GetLocalPath(const FString& Url)
+{
+    FString Path = Url;
+    if (Path.StartsWith(TEXT("file://"))) {
+        Path = Path.Mid(7);
+    }
+    else if (Path.Contains(TEXT("://"))) { //网络流等其他协议
+        return FString();
+    }
+    if (Path.IsEmpty() || !FPaths::FileExists(Path)) {
+        return FString();
+    }
+    return FPaths::ConvertRelativePathToFull(Path);
+}
+
+FString FFmpegSidecarCache::GetCacheFile(const FString& Category, const FString& MediaPath)
+{
+    if (MediaPath.IsEmpty()) {
+        return FString();
+    }
+    IFileManager& FileManager = IFileManager::Get();
+    int64 Size = FileManager.FileSize(*MediaPath);
+    FDateTime TimeStamp = FileManager.GetTimeStamp(*MediaPath);
+    if (Size < 0 || TimeStamp == FDateTime::MinValue()) {
+        return FString();
+    }
+    //路径 + 大小 + 修改时间 作为键值
+    FString Key = FString::Printf(TEXT("%s|%lld|%lld"), *MediaPath, Size, TimeStamp.GetTicks());
+    FString Hash = FMD5::HashAnsiString(*Key);
+    return FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("FFmpegMedia"), Category, Hash + TEXT(".bin"));
+}
+
+bool FFmpegSidecarCache::Load(const FString& Category, const FString& MediaPath, uint32 Version, TArray<uint8>& OutData)
+{
+    FString CacheFile = GetCacheFile(Category, MediaPath);
+    if (CacheFile.IsEmpty()) {
+        return false;
+    }
+    TArray<uint8> FileData;
+    if (!FFileHelper::LoadFileToArray(FileData, *CacheFile, FILEREAD_Silent)) {
+        return false;
+    }
+
+    FMemoryReader Reader(FileData);
+    uint32 Magic = 0;
+    uint32 FileVersion = 0;
+    Reader << Magic;
+    Reader << FileVersion;
+    if (Reader.IsError() || Magic != SIDECAR_CACHE_MAGIC || FileVersion != Version) {
+        UE_LOG(LogFFmpegMedia, Verbose, TEXT("SidecarCache: ignore invalid cache %s"), *CacheFile);
+        return false;
+    }
+    OutData.Reset();
+    OutData.Append(FileData.GetData() + Reader.Tell(), FileData.Num() - Reader.Tell());
+    return true;
+}
+
+bool FFmpegSidecarCache::Save(const FString& Category, const FString& MediaPath, uint32 Version, const TArray<uint8>& Data)
+{
+    FString CacheFile = GetCacheFile(Category, MediaPath);
+    if (CacheFile.IsEmpty()) {
+        return false;
+    }
+    TArray<uint8> FileData;
+    FMemoryWriter Writer(FileData);
+    uint32 Magic = SIDECAR_CACHE_MAGIC;
+    Writer << Magic;
+    Writer << Version;
+    FileData.Append(Data);
+
+    if (!FFileHelper::SaveArrayToFile(FileData, *CacheFile)) {
+        UE_LOG(LogFFmpegMedia, Warning, TEXT("SidecarCache: save cache %s fail"), *CacheFile);
+        return false;
+    }
+    UE_LOG(LogFFmpegMedia, Verbose, TEXT("SidecarCache: save cache %s (%d bytes)"), *CacheFile, FileData.Num());
+    return true;
+}
@@ -0,0 +1,40 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * 媒体文件的旁路缓存(保存在 Saved/FFmpegMedia/<Category>/ 目录下)
+ * 以文件路径、文件大小和修改时间作为键值，媒体文件被修改之后缓存自动失效
+ */
+class FFmpegSidecarCache
+{
+public:
+	/**
+	 * 获取本地文件路径
+	 * @param Url 媒体地址(file://开头或者本地路径)
+	 * @return 不是本地文件时返回空字符串
+	 */
+	static FString GetLocalPath(const FString& Url);
+
+	/**
+	 * 获取缓存文件路径
+	 * @param Category 缓存类别(子目录名称)
+	 * @param MediaPath 本地媒体文件路径
+	 * @return 媒体文件不存在时返回空字符串
+	 */
+	static FString GetCacheFile(const FString& Category, const FString& MediaPath);
+
+	/**
+	 * 读取缓存数据
+	 * @param Version 数据版本，和保存时的版本不一致时视为缓存无效
+	 */
+	static bool Load(const FString& Category, const FString& MediaPath, uint32 Version, TArray<uint8>& OutData);
+
+	/**
+	 * 保存缓存数据
+	 * @param Version 数据版本
+	 */
+	static bool Save(const FString& Category, const FString& MediaPath, uint32 Version, const TArray<uint8>& Data);
+};
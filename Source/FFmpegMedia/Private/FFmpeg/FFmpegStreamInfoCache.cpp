@@ -0,0 +1,246 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "FFmpeg/FFmpegStreamInfoCache.h"
+#include "FFmpegMedia.h"
+#include "FFmpegSidecarCache.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+extern  "C" {
+#include "libavformat/avformat.h"
+}
+
+/* 缓存类别和版本，缓存格式修改之后需要增加版本号 */
+#define STREAM_INFO_CATEGORY TEXT("StreamInfo")
+#define STREAM_INFO_VERSION 1
+
+/** 缓存的单个流信息(AVCodecParameters以及AVStream中的时间信息) */
+struct FFmpegCachedStream
+{
+    int32 CodecType = AVMEDIA_TYPE_UNKNOWN;
+    int32 CodecId = AV_CODEC_ID_NONE;
+    uint32 CodecTag = 0;
+    int32 Format = -1;
+    int64 BitRate = 0;
+    int32 BitsPerCodedSample = 0;
+    int32 BitsPerRawSample = 0;
+    int32 Profile = 0;
+    int32 Level = 0;
+    int32 Width = 0;
+    int32 Height = 0;
+    int32 SarNum = 0;
+    int32 SarDen = 1;
+    int32 FieldOrder = 0;
+    int32 ColorRange = 0;
+    int32 ColorPrimaries = 0;
+    int32 ColorTrc = 0;
+    int32 ColorSpace = 0;
+    int32 ChromaLocation = 0;
+    int32 VideoDelay = 0;
+    int32 ChannelOrder = 0;
+    int32 NbChannels = 0;
+    uint64 ChannelMask = 0;
+    int32 SampleRate = 0;
+    int32 BlockAlign = 0;
+    int32 FrameSize = 0;
+    int32 InitialPadding = 0;
+    int32 TrailingPadding = 0;
+    int32 SeekPreroll = 0;
+    TArray<uint8> Extradata;
+    //AVStream
+    int32 TimeBaseNum = 0;
+    int32 TimeBaseDen = 1;
+    int32 RFrameRateNum = 0;
+    int32 RFrameRateDen = 1;
+    int32 AvgFrameRateNum = 0;
+    int32 AvgFrameRateDen = 1;
+    int32 StreamSarNum = 0;
+    int32 StreamSarDen = 1;
+    int64 StartTime = AV_NOPTS_VALUE;
+    int64 Duration = AV_NOPTS_VALUE;
+    int64 NbFrames = 0;
+
+    friend FArchive& operator<<(FArchive& Ar, FFmpegCachedStream& S)
+    {
+        Ar << S.CodecType << S.CodecId << S.CodecTag << S.Format << S.BitRate;
+        Ar << S.BitsPerCodedSample << S.BitsPerRawSample << S.Profile << S.Level;
+        Ar << S.Width << S.Height << S.SarNum << S.SarDen << S.FieldOrder;
+        Ar << S.ColorRange << S.ColorPrimaries << S.ColorTrc << S.ColorSpace << S.ChromaLocation << S.VideoDelay;
+        Ar << S.ChannelOrder << S.NbChannels << S.ChannelMask << S.SampleRate << S.BlockAlign << S.FrameSize;
+        Ar << S.InitialPadding << S.TrailingPadding << S.SeekPreroll << S.Extradata;
+        Ar << S.TimeBaseNum << S.TimeBaseDen << S.RFrameRateNum << S.RFrameRateDen << S.AvgFrameRateNum << S.AvgFrameRateDen;
+        Ar << S.StreamSarNum << S.StreamSarDen << S.StartTime << S.Duration << S.NbFrames;
+        return Ar;
+    }
+};
+
+bool FFmpegStreamInfoCache::Apply(const FString& MediaPath, AVFormatContext* ic)
+{
+    TArray<uint8> Data;
+    if (!ic || !FFmpegSidecarCache::Load(STREAM_INFO_CATEGORY, MediaPath, STREAM_INFO_VERSION, Data)) {
+        return false;
+    }
+
+    FMemoryReader Reader(Data);
+    int64 Duration = AV_NOPTS_VALUE, StartTime = AV_NOPTS_VALUE, BitRate = 0;
+    TArray<FFmpegCachedStream> Streams;
+    Reader << Duration << StartTime << BitRate;
+    Reader << Streams;
+    if (Reader.IsError() || Streams.Num() == 0) {
+        return false;
+    }
+    //没有文件头的格式(比如TS)打开时可能还没有创建流，数量不一致时需要重新探测
+    if (Streams.Num() != (int32)ic->nb_streams) {
+        UE_LOG(LogFFmpegMedia, Verbose, TEXT("StreamInfoCache: stream count mismatch (%d, cached %d)"), ic->nb_streams, Streams.Num());
+        return false;
+    }
+    for (unsigned i = 0; i < ic->nb_streams; i++) {
+        const AVCodecParameters* par = ic->streams[i]->codecpar;
+        const FFmpegCachedStream& S = Streams[i];
+        if ((par->codec_type != AVMEDIA_TYPE_UNKNOWN && par->codec_type != S.CodecType) ||
+            (par->codec_id != AV_CODEC_ID_NONE && par->codec_id != S.CodecId)) {
+            UE_LOG(LogFFmpegMedia, Verbose, TEXT("StreamInfoCache: stream %d codec mismatch"), i);
+            return false;
+        }
+    }
+
+    for (unsigned i = 0; i < ic->nb_streams; i++) {
+        AVStream* st = ic->streams[i];
+        AVCodecParameters* par = st->codecpar;
+        const FFmpegCachedStream& S = Streams[i];
+        par->codec_type = (AVMediaType)S.CodecType;
+        par->codec_id = (AVCodecID)S.CodecId;
+        par->codec_tag = S.CodecTag;
+        par->format = S.Format;
+        par->bit_rate = S.BitRate;
+        par->bits_per_coded_sample = S.BitsPerCodedSample;
+        par->bits_per_raw_sample = S.BitsPerRawSample;
+        par->profile = S.Profile;
+        par->level = S.Level;
+        par->width = S.Width;
+        par->height = S.Height;
+        par->sample_aspect_ratio = { S.SarNum, S.SarDen };
+        par->field_order = (AVFieldOrder)S.FieldOrder;
+        par->color_range = (AVColorRange)S.ColorRange;
+        par->color_primaries = (AVColorPrimaries)S.ColorPrimaries;
+        par->color_trc = (AVColorTransferCharacteristic)S.ColorTrc;
+        par->color_space = (AVColorSpace)S.ColorSpace;
+        par->chroma_location = (AVChromaLocation)S.ChromaLocation;
+        par->video_delay = S.VideoDelay;
+        av_channel_layout_uninit(&par->ch_layout);
+        if (S.ChannelOrder == AV_CHANNEL_ORDER_NATIVE) {
+            av_channel_layout_from_mask(&par->ch_layout, S.ChannelMask);
+        }
+        else if (S.NbChannels > 0) {
+            par->ch_layout.order = AV_CHANNEL_ORDER_UNSPEC;
+            par->ch_layout.nb_channels = S.NbChannels;
+        }
+        par->sample_rate = S.SampleRate;
+        par->block_align = S.BlockAlign;
+        par->frame_size = S.FrameSize;
+        par->initial_padding = S.InitialPadding;
+        par->trailing_padding = S.TrailingPadding;
+        par->seek_preroll = S.SeekPreroll;
+        if (S.Extradata.Num() > 0) {
+            uint8_t* extradata = (uint8_t*)av_mallocz(S.Extradata.Num() + AV_INPUT_BUFFER_PADDING_SIZE);
+            if (!extradata) {
+                return false;
+            }
+            FMemory::Memcpy(extradata, S.Extradata.GetData(), S.Extradata.Num());
+            av_freep(&par->extradata);
+            par->extradata = extradata;
+            par->extradata_size = S.Extradata.Num();
+        }
+        if (S.TimeBaseNum > 0 && S.TimeBaseDen > 0) {
+            st->time_base = { S.TimeBaseNum, S.TimeBaseDen };
+        }
+        st->r_frame_rate = { S.RFrameRateNum, S.RFrameRateDen };
+        st->avg_frame_rate = { S.AvgFrameRateNum, S.AvgFrameRateDen };
+        st->sample_aspect_ratio = { S.StreamSarNum, S.StreamSarDen };
+        if (st->start_time == AV_NOPTS_VALUE) {
+            st->start_time = S.StartTime;
+        }
+        if (st->duration == AV_NOPTS_VALUE) {
+            st->duration = S.Duration;
+        }
+        if (st->nb_frames == 0) {
+            st->nb_frames = S.NbFrames;
+        }
+    }
+    if (ic->duration == AV_NOPTS_VALUE) {
+        ic->duration = Duration;
+    }
+    if (ic->start_time == AV_NOPTS_VALUE) {
+        ic->start_time = StartTime;
+    }
+    if (ic->bit_rate <= 0) {
+        ic->bit_rate = BitRate;
+    }
+    return true;
+}
+
+bool FFmpegStreamInfoCache::Save(const FString& MediaPath, const AVFormatContext* ic)
+{
+    if (!ic || ic->nb_streams == 0) {
+        return false;
+    }
+    TArray<FFmpegCachedStream> Streams;
+    for (unsigned i = 0; i < ic->nb_streams; i++) {
+        const AVStream* st = ic->streams[i];
+        const AVCodecParameters* par = st->codecpar;
+        if (par->ch_layout.order == AV_CHANNEL_ORDER_CUSTOM) { //自定义声道布局不缓存
+            return false;
+        }
+        FFmpegCachedStream& S = Streams.AddDefaulted_GetRef();
+        S.CodecType = par->codec_type;
+        S.CodecId = par->codec_id;
+        S.CodecTag = par->codec_tag;
+        S.Format = par->format;
+        S.BitRate = par->bit_rate;
+        S.BitsPerCodedSample = par->bits_per_coded_sample;
+        S.BitsPerRawSample = par->bits_per_raw_sample;
+        S.Profile = par->profile;
+        S.Level = par->level;
+        S.Width = par->width;
+        S.Height = par->height;
+        S.SarNum = par->sample_aspect_ratio.num;
+        S.SarDen = par->sample_aspect_ratio.den;
+        S.FieldOrder = par->field_order;
+        S.ColorRange = par->color_range;
+        S.ColorPrimaries = par->color_primaries;
+        S.ColorTrc = par->color_trc;
+        S.ColorSpace = par->color_space;
+        S.ChromaLocation = par->chroma_location;
+        S.VideoDelay = par->video_delay;
+        S.ChannelOrder = par->ch_layout.order;
+        S.NbChannels = par->ch_layout.nb_channels;
+        S.ChannelMask = par->ch_layout.order == AV_CHANNEL_ORDER_NATIVE ? par->ch_layout.u.mask : 0;
+        S.SampleRate = par->sample_rate;
+        S.BlockAlign = par->block_align;
+        S.FrameSize = par->frame_size;
+        S.InitialPadding = par->initial_padding;
+        S.TrailingPadding = par->trailing_padding;
+        S.SeekPreroll = par->seek_preroll;
+        if (par->extradata && par->extradata_size > 0) {
+            S.Extradata.Append(par->extradata, par->extradata_size);
+        }
+        S.TimeBaseNum = st->time_base.num;
+        S.TimeBaseDen = st->time_base.den;
+        S.RFrameRateNum = st->r_frame_rate.num;
+        S.RFrameRateDen = st->r_frame_rate.den;
+        S.AvgFrameRateNum = st->avg_frame_rate.num;
+        S.AvgFrameRateDen = st->avg_frame_rate.den;
+        S.StreamSarNum = st->sample_aspect_ratio.num;
+        S.StreamSarDen = st->sample_aspect_ratio.den;
+        S.StartTime = st->start_time;
+        S.Duration = st->duration;
+        S.NbFrames = st->nb_frames;
+    }
+
+    TArray<uint8> Data;
+    FMemoryWriter Writer(Data);
+    int64 Duration = ic->duration, StartTime = ic->start_time, BitRate = ic->bit_rate;
+    Writer << Duration << StartTime << BitRate;
+    Writer << Streams;
+    return FFmpegSidecarCache::Save(STREAM_INFO_CATEGORY, MediaPath, STREAM_INFO_VERSION, Data);
+}
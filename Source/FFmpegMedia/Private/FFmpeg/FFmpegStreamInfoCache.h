@@ -0,0 +1,32 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+struct AVFormatContext;
+
+/**
+ * 流信息缓存(avformat_find_stream_info的结果)
+ * 保存每个流的编码参数和时间信息，再次打开同一个本地文件时直接填充，跳过avformat_find_stream_info
+ * 缓存以文件路径、大小和修改时间为键值，保存在 Saved/FFmpegMedia/StreamInfo/ 目录下
+ */
+class FFmpegStreamInfoCache
+{
+public:
+	/**
+	 * 从缓存中填充流信息
+	 * 流的数量和解复用器已知的编码类型必须与缓存一致，否则视为缓存无效
+	 * @param MediaPath 本地媒体文件路径
+	 * @param ic 已经打开(avformat_open_input)的上下文
+	 * @return 填充成功时返回true，此时不需要再调用avformat_find_stream_info
+	 */
+	static bool Apply(const FString& MediaPath, AVFormatContext* ic);
+
+	/**
+	 * 保存流信息
+	 * @param MediaPath 本地媒体文件路径
+	 * @param ic 已经调用过avformat_find_stream_info的上下文
+	 */
+	static bool Save(const FString& MediaPath, const AVFormatContext* ic);
+};
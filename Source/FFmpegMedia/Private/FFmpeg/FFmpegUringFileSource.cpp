@@ -0,0 +1,472 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "FFmpeg/FFmpegUringFileSource.h"
+#include "FFmpegMedia.h"
+#include "HAL/FileManager.h"
+#include "HAL/PlatformProcess.h"
+extern  "C" {
+#include "libavutil/error.h"
+}
+//引擎没有附带liburing，直接使用系统调用(需要5.1以上的内核头文件)
+#if PLATFORM_LINUX && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#define FFMPEG_WITH_IO_URING 1
+#endif
+#endif
+#ifndef FFMPEG_WITH_IO_URING
+#define FFMPEG_WITH_IO_URING 0
+#endif
+
+/* O_DIRECT要求读取的位置、大小和内存都按照逻辑块对齐 */
+#define URING_ALIGNMENT 4096
+
+#if FFMPEG_WITH_IO_URING
+/** io_uring实例以及映射的提交队列和完成队列 */
+struct FFmpegUringFileSource::FRing
+{
+    int Fd = -1;
+    void* SqPtr = MAP_FAILED;
+    size_t SqSize = 0;
+    void* CqPtr = MAP_FAILED;
+    size_t CqSize = 0;
+    io_uring_sqe* Sqes = (io_uring_sqe*)MAP_FAILED;
+    size_t SqesSize = 0;
+    unsigned* SqTail = nullptr;
+    unsigned SqMask = 0;
+    unsigned* SqArray = nullptr;
+    unsigned* CqHead = nullptr;
+    unsigned* CqTail = nullptr;
+    unsigned CqMask = 0;
+    io_uring_cqe* Cqes = nullptr;
+    TArray<iovec> Vecs; //每个块的iovec，没有注册缓冲区时用于IORING_OP_READV
+
+    ~FRing()
+    {
+        if (Sqes != MAP_FAILED) {
+            munmap(Sqes, SqesSize);
+        }
+        if (CqPtr != MAP_FAILED && CqPtr != SqPtr) {
+            munmap(CqPtr, CqSize);
+        }
+        if (SqPtr != MAP_FAILED) {
+            munmap(SqPtr, SqSize);
+        }
+        if (Fd >= 0) {
+            close(Fd); //关闭之后注册的缓冲区自动释放
+        }
+    }
+};
+#else
+struct FFmpegUringFileSource::FRing
+{
+};
+#endif
+
+FFmpegUringFileSource* FFmpegUringFileSource::Open(const FString& Path, int BlockSize, int QueueDepth, bool bDirect)
+{
+#if FFMPEG_WITH_IO_URING
+    const FString FullPath = IFileManager::Get().ConvertToAbsolutePathForExternalAppForRead(*Path);
+    const int Flags = O_RDONLY | O_CLOEXEC;
+    //文件系统不支持O_DIRECT(比如tmpfs)时打开会失败，改为普通读取
+    int File = bDirect ? open(TCHAR_TO_UTF8(*FullPath), Flags | O_DIRECT) : -1;
+    const bool Direct = File >= 0;
+    if (File < 0) {
+        File = open(TCHAR_TO_UTF8(*FullPath), Flags);
+    }
+    if (File < 0) {
+        UE_LOG(LogFFmpegMedia, Verbose, TEXT("UringFileSource: could not open %s (%d)"), *FullPath, errno);
+        return nullptr;
+    }
+    struct stat Stat;
+    if (fstat(File, &Stat) != 0 || !S_ISREG(Stat.st_mode) || Stat.st_size <= 0) {
+        close(File);
+        return nullptr;
+    }
+    BlockSize = Align(FMath::Max(BlockSize, URING_ALIGNMENT), URING_ALIGNMENT);
+    FFmpegUringFileSource* Source = new FFmpegUringFileSource(File, Stat.st_size, BlockSize, FMath::Clamp(QueueDepth, 1, 64), Direct);
+    if (!Source->Initialize()) {
+        delete Source;
+        return nullptr;
+    }
+    return Source;
+#else
+    return nullptr;
+#endif
+}
+
+FFmpegUringFileSource::FFmpegUringFileSource(int InFile, int64 InSize, int InBlockSize, int InQueueDepth, bool InDirect)
+{
+    this->File = InFile;
+    this->Size = InSize;
+    this->Position = 0;
+    this->BlockSize = InBlockSize;
+    this->QueueDepth = InQueueDepth;
+    this->Direct = InDirect;
+    this->FixedBuffers = false;
+    this->Ring = nullptr;
+    this->Queued = 0;
+    this->Requests = 0;
+    this->Hits = 0;
+    this->Stalls = 0;
+    this->Discards = 0;
+    this->Retries = 0;
+}
+
+FFmpegUringFileSource::~FFmpegUringFileSource()
+{
+#if FFMPEG_WITH_IO_URING
+    //内核还在使用块内存，等待所有请求完成之后才能释放
+    bool Completed = true;
+    for (const FSlot& Slot : this->Slots) {
+        while (Slot.InFlight && Completed) {
+            Completed = this->Reap(true);
+        }
+    }
+    delete this->Ring;
+    if (Completed) {
+        for (FSlot& Slot : this->Slots) {
+            FMemory::Free(Slot.Buffer);
+        }
+    }
+    if (this->File >= 0) {
+        close(this->File);
+    }
+#endif
+}
+
+bool FFmpegUringFileSource::Initialize()
+{
+#if FFMPEG_WITH_IO_URING
+    //丢弃的块在请求完成之前不能复用，所以块数是队列深度的两倍
+    const int NumSlots = this->QueueDepth * 2;
+    this->Slots.SetNumZeroed(NumSlots);
+    this->Ring = new FRing();
+    FRing& R = *this->Ring;
+    R.Vecs.SetNumZeroed(NumSlots);
+    for (int i = 0; i < NumSlots; i++) {
+        FSlot& Slot = this->Slots[i];
+        Slot.Offset = -1;
+        Slot.Buffer = (uint8*)FMemory::Malloc(this->BlockSize, URING_ALIGNMENT);
+        R.Vecs[i].iov_base = Slot.Buffer;
+        R.Vecs[i].iov_len = this->BlockSize;
+    }
+
+    io_uring_params Params;
+    FMemory::Memzero(Params);
+    R.Fd = (int)syscall(__NR_io_uring_setup, NumSlots, &Params);
+    if (R.Fd < 0) {
+        //内核不支持(ENOSYS)或者被禁止(EPERM)
+        UE_LOG(LogFFmpegMedia, Verbose, TEXT("UringFileSource: io_uring_setup failed (%d)"), errno);
+        return false;
+    }
+
+    R.SqSize = Params.sq_off.array + Params.sq_entries * sizeof(unsigned);
+    R.CqSize = Params.cq_off.cqes + Params.cq_entries * sizeof(io_uring_cqe);
+    bool SingleMmap = false;
+#ifdef IORING_FEAT_SINGLE_MMAP
+    SingleMmap = (Params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+#endif
+    if (SingleMmap) {
+        R.SqSize = R.CqSize = FMath::Max(R.SqSize, R.CqSize);
+    }
+    R.SqPtr = mmap(nullptr, R.SqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, R.Fd, IORING_OFF_SQ_RING);
+    if (R.SqPtr == MAP_FAILED) {
+        return false;
+    }
+    R.CqPtr = SingleMmap ? R.SqPtr : mmap(nullptr, R.CqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, R.Fd, IORING_OFF_CQ_RING);
+    if (R.CqPtr == MAP_FAILED) {
+        return false;
+    }
+    R.SqesSize = Params.sq_entries * sizeof(io_uring_sqe);
+    R.Sqes = (io_uring_sqe*)mmap(nullptr, R.SqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, R.Fd, IORING_OFF_SQES);
+    if (R.Sqes == MAP_FAILED) {
+        return false;
+    }
+    uint8* Sq = (uint8*)R.SqPtr;
+    R.SqTail = (unsigned*)(Sq + Params.sq_off.tail);
+    R.SqMask = *(unsigned*)(Sq + Params.sq_off.ring_mask);
+    R.SqArray = (unsigned*)(Sq + Params.sq_off.array);
+    uint8* Cq = (uint8*)R.CqPtr;
+    R.CqHead = (unsigned*)(Cq + Params.cq_off.head);
+    R.CqTail = (unsigned*)(Cq + Params.cq_off.tail);
+    R.CqMask = *(unsigned*)(Cq + Params.cq_off.ring_mask);
+    R.Cqes = (io_uring_cqe*)(Cq + Params.cq_off.cqes);
+
+    //注册缓冲区需要锁定内存，超出RLIMIT_MEMLOCK时使用IORING_OP_READV
+    this->FixedBuffers = syscall(__NR_io_uring_register, R.Fd, IORING_REGISTER_BUFFERS, R.Vecs.GetData(), NumSlots) == 0;
+    if (!this->FixedBuffers) {
+        UE_LOG(LogFFmpegMedia, Verbose, TEXT("UringFileSource: could not register buffers (%d), using readv"), errno);
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+int FFmpegUringFileSource::Read(uint8_t* buf, int buf_size)
+{
+    if (this->Position >= this->Size) {
+        return AVERROR_EOF;
+    }
+    const int64 BlockOffset = this->Position / this->BlockSize * this->BlockSize;
+    this->UpdateWindow(BlockOffset);
+
+    FSlot* Slot = this->FindSlot(BlockOffset);
+    if (!Slot) {
+        return AVERROR(EIO);
+    }
+    if (Slot->InFlight) {
+        this->Reap(false);
+    }
+    if (Slot->InFlight) {
+        this->Stalls++;
+        while (Slot->InFlight) {
+            if (!this->Reap(true)) {
+                return AVERROR(EIO);
+            }
+        }
+    }
+    else {
+        this->Hits++;
+    }
+    if (Slot->Failed) {
+        UE_LOG(LogFFmpegMedia, Error, TEXT("UringFileSource: read %d bytes at %lld failed"), Slot->Size, Slot->Offset);
+        Slot->Failed = false;
+        Slot->Offset = -1; //下次读取时重新请求
+        return AVERROR(EIO);
+    }
+
+    const int64 BlockPos = this->Position - Slot->Offset;
+    if (BlockPos >= Slot->Filled) { //文件在播放时被截断
+        return AVERROR_EOF;
+    }
+    const int BytesToRead = (int)FMath::Min<int64>(buf_size, Slot->Filled - BlockPos);
+    FMemory::Memcpy(buf, Slot->Buffer + BlockPos, BytesToRead);
+    this->Position += BytesToRead;
+    return BytesToRead;
+}
+
+int64_t FFmpegUringFileSource::SeekTo(int64_t pos)
+{
+    //只记录位置，读取时再调整请求窗口，窗口内的块可以继续使用
+    this->Position = pos;
+    return pos;
+}
+
+int64_t FFmpegUringFileSource::GetSize() const
+{
+    return this->Size;
+}
+
+int64_t FFmpegUringFileSource::GetPosition() const
+{
+    return this->Position;
+}
+
+FString FFmpegUringFileSource::GetStats() const
+{
+    return FString::Printf(TEXT("io_uring%s%s, %lld / %lld bytes, block %d KB x %d, %d requests, %d hits, %d stalls, %d discarded, %d retries"),
+        this->Direct ? TEXT(" direct") : TEXT(""), this->FixedBuffers ? TEXT(" fixed") : TEXT(""),
+        this->Position, this->Size, this->BlockSize / 1024, this->QueueDepth, this->Requests, this->Hits, this->Stalls, this->Discards, this->Retries);
+}
+
+void FFmpegUringFileSource::UpdateWindow(int64 Offset)
+{
+    const int64 WindowEnd = FMath::Min<int64>(Offset + (int64)this->QueueDepth * this->BlockSize, this->Size);
+
+    //释放窗口之外的块，还在读取中的块完成之后再释放
+    for (FSlot& Slot : this->Slots) {
+        if (Slot.Offset < 0 || Slot.Stale || (Slot.Offset >= Offset && Slot.Offset < WindowEnd)) {
+            continue;
+        }
+        if (Slot.Offset > Offset || Slot.InFlight) { //还没有读取就被丢弃
+            this->Discards++;
+        }
+        if (Slot.InFlight) {
+            Slot.Stale = true;
+        }
+        else {
+            Slot.Offset = -1;
+        }
+    }
+
+    //按顺序请求窗口内缺少的块，一次提交
+    for (int64 BlockOffset = Offset; BlockOffset < WindowEnd; BlockOffset += this->BlockSize) {
+        if (this->FindSlot(BlockOffset)) {
+            continue;
+        }
+        int Index = INDEX_NONE;
+        while (Index == INDEX_NONE) {
+            Index = this->Slots.IndexOfByPredicate([](const FSlot& Slot) { return Slot.Offset < 0 && !Slot.InFlight; });
+            //没有空闲的块时等待丢弃的块完成
+            if (Index == INDEX_NONE && !this->Reap(true)) {
+                return;
+            }
+        }
+        FSlot& Slot = this->Slots[Index];
+        Slot.Offset = BlockOffset;
+        Slot.Size = (int)FMath::Min<int64>(this->BlockSize, this->Size - BlockOffset);
+        Slot.Filled = 0;
+        Slot.Failed = false;
+        this->QueueRead(Index);
+        this->Requests++;
+    }
+    this->Submit();
+}
+
+FFmpegUringFileSource::FSlot* FFmpegUringFileSource::FindSlot(int64 Offset)
+{
+    for (FSlot& Slot : this->Slots) {
+        if (Slot.Offset == Offset && !Slot.Stale) {
+            return &Slot;
+        }
+    }
+    return nullptr;
+}
+
+void FFmpegUringFileSource::QueueRead(int Index)
+{
+#if FFMPEG_WITH_IO_URING
+    FRing& R = *this->Ring;
+    FSlot& Slot = this->Slots[Index];
+    //只有当前线程写入提交队列的尾部
+    const unsigned Tail = *R.SqTail;
+    const unsigned SqIndex = Tail & R.SqMask;
+    io_uring_sqe& Sqe = R.Sqes[SqIndex];
+    FMemory::Memzero(Sqe);
+    //总是读取整块(O_DIRECT需要对齐)，文件结尾时内核返回实际读取的大小
+    const int Length = this->BlockSize - Slot.Filled;
+    if (this->FixedBuffers) {
+        Sqe.opcode = IORING_OP_READ_FIXED;
+        Sqe.addr = (uint64)(UPTRINT)(Slot.Buffer + Slot.Filled);
+        Sqe.len = Length;
+        Sqe.buf_index = Index;
+    }
+    else {
+        R.Vecs[Index].iov_base = Slot.Buffer + Slot.Filled;
+        R.Vecs[Index].iov_len = Length;
+        Sqe.opcode = IORING_OP_READV;
+        Sqe.addr = (uint64)(UPTRINT)&R.Vecs[Index];
+        Sqe.len = 1;
+    }
+    Sqe.fd = this->File;
+    Sqe.off = Slot.Offset + Slot.Filled;
+    Sqe.user_data = Index;
+    R.SqArray[SqIndex] = SqIndex;
+    __atomic_store_n(R.SqTail, Tail + 1, __ATOMIC_RELEASE);
+    Slot.InFlight = true;
+    Slot.Direct = this->Direct;
+    this->Queued++;
+#endif
+}
+
+void FFmpegUringFileSource::Submit()
+{
+#if FFMPEG_WITH_IO_URING
+    while (this->Queued > 0) {
+        const int Ret = (int)syscall(__NR_io_uring_enter, this->Ring->Fd, this->Queued, 0, 0, nullptr, 0);
+        if (Ret > 0) {
+            this->Queued -= Ret;
+        }
+        else if (Ret < 0 && (errno == EAGAIN || errno == EBUSY)) {
+            //内核暂时没有资源，稍后重试
+            FPlatformProcess::Sleep(0.001f);
+        }
+        else if (Ret < 0 && errno != EINTR) {
+            //没有提交的请求保留在队列中，下次等待时一起提交
+            UE_LOG(LogFFmpegMedia, Error, TEXT("UringFileSource: io_uring_enter failed (%d)"), errno);
+            return;
+        }
+    }
+#endif
+}
+
+bool FFmpegUringFileSource::Reap(bool bWait)
+{
+#if FFMPEG_WITH_IO_URING
+    FRing& R = *this->Ring;
+    for (;;) {
+        unsigned Head = *R.CqHead;
+        const unsigned Tail = __atomic_load_n(R.CqTail, __ATOMIC_ACQUIRE);
+        if (Head != Tail) {
+            while (Head != Tail) {
+                const io_uring_cqe& Cqe = R.Cqes[Head & R.CqMask];
+                const int Index = (int)Cqe.user_data;
+                const int Result = Cqe.res;
+                Head++;
+                __atomic_store_n(R.CqHead, Head, __ATOMIC_RELEASE);
+                this->Complete(Index, Result);
+            }
+            this->Submit(); //短读取重新提交的请求
+            return true;
+        }
+        if (!bWait) {
+            return true;
+        }
+        const int Ret = (int)syscall(__NR_io_uring_enter, R.Fd, this->Queued, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+        if (Ret > 0) {
+            this->Queued -= FMath::Min(Ret, this->Queued);
+        }
+        else if (Ret < 0 && errno != EINTR && errno != EAGAIN) {
+            UE_LOG(LogFFmpegMedia, Error, TEXT("UringFileSource: waiting for completions failed (%d)"), errno);
+            return false;
+        }
+    }
+#else
+    return false;
+#endif
+}
+
+void FFmpegUringFileSource::Complete(int Index, int Result)
+{
+#if FFMPEG_WITH_IO_URING
+    FSlot& Slot = this->Slots[Index];
+    Slot.InFlight = false;
+    if (Slot.Stale) {
+        Slot.Stale = false;
+        Slot.Offset = -1;
+        return;
+    }
+    if (Result == -EINVAL && Slot.Direct) {
+        //文件系统不支持O_DIRECT读取，改为普通读取之后重新请求(同时进行的其他请求也会失败)
+        if (this->Direct) {
+            UE_LOG(LogFFmpegMedia, Verbose, TEXT("UringFileSource: O_DIRECT not supported, falling back to buffered reads"));
+            this->Direct = false;
+            const int Flags = fcntl(this->File, F_GETFL);
+            if (Flags == -1 || fcntl(this->File, F_SETFL, Flags & ~O_DIRECT) == -1) {
+                Slot.Failed = true;
+                return;
+            }
+        }
+        this->Retries++;
+        this->QueueRead(Index);
+        return;
+    }
+    if (Result == -EINTR || Result == -EAGAIN) {
+        this->Retries++;
+        this->QueueRead(Index);
+        return;
+    }
+    if (Result < 0) {
+        Slot.Failed = true;
+        return;
+    }
+    Slot.Filled = FMath::Min(Slot.Filled + Result, Slot.Size);
+    if (Result == 0) {
+        Slot.Size = Slot.Filled; //文件在播放时被截断
+    }
+    else if (Slot.Filled < Slot.Size) {
+        this->Retries++;
+        this->QueueRead(Index);
+    }
+#endif
+}
@@ -0,0 +1,95 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "FFmpegIOSource.h"
+
+/**
+ * 通过io_uring读取本地文件的AVIO数据源(只支持Linux)
+ * 当前块之后始终保持若干个读取请求在内核队列中，多个播放器同时读取NVMe上的大文件时可以充分利用设备的队列深度
+ * 每个播放器使用自己的io_uring实例和固定的块内存，能够注册缓冲区时使用IORING_OP_READ_FIXED
+ * 可以使用O_DIRECT绕过页缓存，文件系统不支持时自动改为普通读取
+ */
+class FFmpegUringFileSource : public FFmpegIOSource
+{
+public:
+	/**
+	 * 打开文件
+	 * @param Path 本地文件路径(不能是pak中的文件)
+	 * @param BlockSize 每次读取的大小(字节)，按4KB对齐
+	 * @param QueueDepth 同时进行的读取数量(包括当前块)
+	 * @param bDirect 是否使用O_DIRECT
+	 * @return 平台不支持io_uring、内核不支持或者被禁止(比如容器的seccomp策略)以及文件无法打开时返回空，此时应该使用其他方式读取
+	 */
+	static FFmpegUringFileSource* Open(const FString& Path, int BlockSize, int QueueDepth, bool bDirect);
+
+	virtual ~FFmpegUringFileSource();
+
+	virtual int Read(uint8_t* buf, int buf_size) override;
+	virtual int64_t SeekTo(int64_t pos) override;
+	virtual int64_t GetSize() const override;
+	virtual int64_t GetPosition() const override;
+	virtual FString GetStats() const override;
+
+private:
+	struct FRing;
+
+	/** 读取块，块内存在整个生命周期内不变 */
+	struct FSlot
+	{
+		int64 Offset; //块的文件位置，空闲时为-1
+		int Size; //块的有效大小(文件结尾的块小于BlockSize)
+		int Filled; //已经读取的大小
+		uint8* Buffer;
+		bool InFlight; //请求还在内核中，完成之前不能修改内存
+		bool Stale; //请求完成之后直接释放(跳转之后已经不需要的块)
+		bool Direct; //请求是否使用O_DIRECT
+		bool Failed;
+	};
+
+	FFmpegUringFileSource(int InFile, int64 InSize, int InBlockSize, int InQueueDepth, bool InDirect);
+
+	/** 创建io_uring实例和块内存 */
+	bool Initialize();
+
+	/** 请求从Offset开始的块，丢弃窗口之外的块 */
+	void UpdateWindow(int64 Offset);
+
+	/** 查找Offset所在的块 */
+	FSlot* FindSlot(int64 Offset);
+
+	/** 把块剩余部分的读取请求放入提交队列 */
+	void QueueRead(int Index);
+
+	/** 提交队列中的请求 */
+	void Submit();
+
+	/**
+	 * 处理已经完成的请求
+	 * @param bWait 没有完成的请求时是否等待
+	 * @return io_uring出错时返回false
+	 */
+	bool Reap(bool bWait);
+
+	/** 请求完成 */
+	void Complete(int Index, int Result);
+
+private:
+	int File;
+	int64 Size;
+	int64 Position;
+	int BlockSize;
+	int QueueDepth;
+	bool Direct;
+	bool FixedBuffers; //块内存已经注册到io_uring
+	FRing* Ring;
+	TArray<FSlot> Slots;
+	int Queued; //已经放入提交队列但是还没有提交的请求数
+	//统计
+	int Requests; //读取请求数
+	int Hits; //读取时块已经完成的次数
+	int Stalls; //读取时需要等待块完成的次数
+	int Discards; //跳转时丢弃的块数
+	int Retries; //短读取或者被中断之后重新提交的次数
+};
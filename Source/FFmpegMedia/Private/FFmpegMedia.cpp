@@ -94,6 +94,55 @@ public:
 		return protocols;
 	}
 
+	/**
+	 * 暂停状态下逐帧显示
+	 */
+	virtual bool StepFrames(const TSharedPtr<IMediaPlayer, ESPMode::ThreadSafe>& Player, int32 NumFrames)
+	{
+		if (!Player.IsValid() || Player->GetPlayerPluginGUID() != FFmpegMediaPlayer::PluginGUID())
+		{
+			return false;
+		}
+		return StaticCastSharedPtr<FFmpegMediaPlayer>(Player)->StepFrames(NumFrames);
+	}
+
+	/**
+	 * 设置拖动状态
+	 */
+	virtual bool SetScrubbing(const TSharedPtr<IMediaPlayer, ESPMode::ThreadSafe>& Player, bool Scrubbing)
+	{
+		if (!Player.IsValid() || Player->GetPlayerPluginGUID() != FFmpegMediaPlayer::PluginGUID())
+		{
+			return false;
+		}
+		StaticCastSharedPtr<FFmpegMediaPlayer>(Player)->SetScrubbing(Scrubbing);
+		return true;
+	}
+
+	/**
+	 * 在后台预打开下一个媒体
+	 */
+	virtual bool PreopenNext(const TSharedPtr<IMediaPlayer, ESPMode::ThreadSafe>& Player, const FString& Url, const IMediaOptions* Options, bool Concatenate)
+	{
+		if (!Player.IsValid() || Player->GetPlayerPluginGUID() != FFmpegMediaPlayer::PluginGUID())
+		{
+			return false;
+		}
+		return StaticCastSharedPtr<FFmpegMediaPlayer>(Player)->PreopenNext(Url, FFFmpegMediaOpenOptions::FromMediaOptions(Options), Concatenate);
+	}
+
+	/**
+	 * 取消预打开的媒体
+	 */
+	virtual void CancelPreopen(const TSharedPtr<IMediaPlayer, ESPMode::ThreadSafe>& Player)
+	{
+		if (!Player.IsValid() || Player->GetPlayerPluginGUID() != FFmpegMediaPlayer::PluginGUID())
+		{
+			return;
+		}
+		StaticCastSharedPtr<FFmpegMediaPlayer>(Player)->CancelPreopen();
+	}
+
 	/** IModuleInterface implementation */
 	virtual void StartupModule() override
 	{
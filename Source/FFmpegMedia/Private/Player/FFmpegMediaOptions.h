@@ -0,0 +1,137 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "IMediaOptions.h"
+
+/**
+ * 打开媒体时的播放选项
+ * 注意IMediaOptions只在Open调用期间有效，而媒体是在异步任务中打开的，所以需要在Open中把用到的选项拷贝一份
+ */
+struct FFFmpegMediaOpenOptions
+{
+	/** 强制纯音频模式(忽略所有视频和字幕流，只保留音频以及封面图片) */
+	bool AudioOnly;
+
+	/** 为本地文件生成关键帧索引(缓存在Saved/FFmpegMedia/KeyframeIndex目录下)，用于精准seek */
+	bool KeyframeIndex;
+
+	/** 视频帧缓存大小(MB)，小于0时使用插件设置中的大小，0表示关闭 */
+	int32 FrameCacheSize;
+
+	/** 较短的循环片段第一次播放之后常驻内存，之后的循环不再解码(时长和内存预算在插件设置中配置) */
+	bool ResidentClip;
+
+	/** 循环播放时数据包缓存大小(MB)，小于0时使用插件设置中的大小，0表示关闭 */
+	int32 PacketCacheSize;
+
+	/** 探测格式和流信息最多读取的数据大小(KB)，小于0时使用插件设置中的大小，0表示使用FFmpeg默认值 */
+	int32 ProbeSize;
+
+	/** 读取流信息最多分析的时长(毫秒)，小于0时使用插件设置中的时长，0表示使用FFmpeg默认值 */
+	int32 AnalyzeDuration;
+
+	/** 缓存本地文件的流信息(缓存在Saved/FFmpegMedia/StreamInfo目录下)，再次打开时跳过avformat_find_stream_info */
+	bool StreamInfoCache;
+
+	/** 读取流信息之后在工作线程中并行打开默认轨道的解码器，不等待选择轨道 */
+	bool PrepareCodecs;
+
+	/** 读取Archive和pak中的文件时AVIO缓冲区大小(KB)，小于0时使用插件设置中的大小 */
+	int32 IOBufferSize;
+
+	/** 通过内存映射读取本地文件(插件设置中的bMapLocalFiles也需要开启) */
+	bool MappedFile;
+
+	/** 在Linux上通过io_uring读取本地文件(插件设置中的bIoUringLocalFiles也需要开启) */
+	bool IoUring;
+
+	/** 预读缓冲区大小(MB)，小于0时使用插件设置中的大小(只用于网络地址和Archive)，本地文件大于0时不再使用内存映射 */
+	int32 ReadAheadSize;
+
+	/** http(s)地址使用磁盘缓存(插件设置中的HttpCacheSizeMB为0时关闭) */
+	bool HttpCache;
+
+	/** 低延迟模式(减少探测、关闭解复用缓冲、最小的帧队列，延迟超过目标时丢弃旧的数据)，实时流在插件设置中的bLowLatencyLive开启时自动使用 */
+	bool LowLatency;
+
+	/** 实时流抖动缓冲的目标延迟(毫秒)，小于0时使用插件设置中的目标延迟，0表示关闭 */
+	int32 JitterBufferTarget;
+
+	/** 实时流断线之后自动重连(插件设置中的bReconnectLive也需要开启) */
+	bool Reconnect;
+
+	/** 与打开同一个地址且选项相同的播放器共用解复用、解码和转换(插件设置中的bShareSources开启时所有播放器都会共用) */
+	bool SharedSource;
+
+	FFFmpegMediaOpenOptions()
+		: AudioOnly(false)
+		, KeyframeIndex(true)
+		, FrameCacheSize(-1)
+		, ResidentClip(true)
+		, PacketCacheSize(-1)
+		, ProbeSize(-1)
+		, AnalyzeDuration(-1)
+		, StreamInfoCache(true)
+		, PrepareCodecs(true)
+		, IOBufferSize(-1)
+		, MappedFile(true)
+		, IoUring(true)
+		, ReadAheadSize(-1)
+		, HttpCache(true)
+		, LowLatency(false)
+		, JitterBufferTarget(-1)
+		, Reconnect(true)
+		, SharedSource(false)
+	{ }
+
+	/**
+	 * 从UE媒体选项中读取播放选项
+	 * @param Options UE媒体选项(可以为空)
+	 */
+	static FFFmpegMediaOpenOptions FromMediaOptions(const IMediaOptions* Options)
+	{
+		FFFmpegMediaOpenOptions OpenOptions;
+		if (Options != nullptr)
+		{
+			OpenOptions.AudioOnly = Options->GetMediaOption("AudioOnly", false);
+			OpenOptions.KeyframeIndex = Options->GetMediaOption("KeyframeIndex", true);
+			OpenOptions.FrameCacheSize = (int32)Options->GetMediaOption("FrameCacheSize", (int64)-1);
+			OpenOptions.ResidentClip = Options->GetMediaOption("ResidentClip", true);
+			OpenOptions.PacketCacheSize = (int32)Options->GetMediaOption("PacketCacheSize", (int64)-1);
+			OpenOptions.ProbeSize = (int32)Options->GetMediaOption("ProbeSize", (int64)-1);
+			OpenOptions.AnalyzeDuration = (int32)Options->GetMediaOption("AnalyzeDuration", (int64)-1);
+			OpenOptions.StreamInfoCache = Options->GetMediaOption("StreamInfoCache", true);
+			OpenOptions.PrepareCodecs = Options->GetMediaOption("PrepareCodecs", true);
+			OpenOptions.IOBufferSize = (int32)Options->GetMediaOption("IOBufferSize", (int64)-1);
+			OpenOptions.MappedFile = Options->GetMediaOption("MappedFile", true);
+			OpenOptions.IoUring = Options->GetMediaOption("IoUring", true);
+			OpenOptions.ReadAheadSize = (int32)Options->GetMediaOption("ReadAheadSize", (int64)-1);
+			OpenOptions.HttpCache = Options->GetMediaOption("HttpCache", true);
+			OpenOptions.LowLatency = Options->GetMediaOption("LowLatency", false);
+			OpenOptions.JitterBufferTarget = (int32)Options->GetMediaOption("JitterBufferTarget", (int64)-1);
+			OpenOptions.Reconnect = Options->GetMediaOption("Reconnect", true);
+			OpenOptions.SharedSource = Options->GetMediaOption("SharedSource", false);
+		}
+		return OpenOptions;
+	}
+
+	/**
+	 * 影响解码结果和播放行为的选项组成的键值，键值相同时打开的轨道可以互相代替(共享媒体源、交换到预打开的媒体)
+	 * 读取方式(内存映射、预读、磁盘缓存等)和探测参数只影响打开过程，不包含在内
+	 */
+	FString GetDecodeKey() const
+	{
+		return FString::Printf(TEXT("%d%d%d%d|%d|%d|%d"), (int32)AudioOnly, (int32)KeyframeIndex, (int32)ResidentClip, (int32)LowLatency,
+			FrameCacheSize, PacketCacheSize, JitterBufferTarget);
+	}
+
+	/** 是否为实时流地址(rtsp、rtmp、rtp、udp、srt，以及描述rtp流的sdp文件)，打开之后的判断见FFFmpegMediaTracks::IsLiveSource */
+	static bool IsLiveUrl(const FString& Url)
+	{
+		return Url.StartsWith(TEXT("rtsp://")) || Url.StartsWith(TEXT("rtsps://")) || Url.StartsWith(TEXT("rtmp://")) || Url.StartsWith(TEXT("rtmps://"))
+			|| Url.StartsWith(TEXT("rtp://")) || Url.StartsWith(TEXT("udp://")) || Url.StartsWith(TEXT("srt://"))
+			|| Url.EndsWith(TEXT(".sdp"), ESearchCase::IgnoreCase);
+	}
+};
@@ -4,8 +4,21 @@
 #include "Player/FFmpegMediaPlayer.h"
 #include "Async/Async.h"
 #include "FFmpegMediaTracks.h"
+#include "FFmpegMediaSharedSource.h"
+#include "MediaSamples.h"
 #include "IMediaEventSink.h"
 #include "FFmpegMediaSettings.h"
+#include "FFmpegSidecarCache.h"
+#include "FFmpegStreamInfoCache.h"
+#include "FFmpegArchiveSource.h"
+#include "FFmpegAsyncFileSource.h"
+#include "FFmpegMemorySource.h"
+#include "FFmpegMappedFileSource.h"
+#include "FFmpegUringFileSource.h"
+#include "FFmpegProtocolSource.h"
+#include "FFmpegHttpCacheSource.h"
+#include "FFmpegReadAheadSource.h"
+#include "HAL/PlatformFileManager.h"
 
 extern  "C" {
 #include "libavformat/avformat.h"
@@ -14,7 +27,9 @@ extern  "C" {
 #include "libavutil/time.h"
 }
 
-#define FF_INPUT_BUFFER_PADDING_SIZE 32
+/* 低延迟模式下没有设置时使用的探测大小(KB)和分析时长(毫秒) */
+#define LOW_LATENCY_PROBE_SIZE 32
+#define LOW_LATENCY_ANALYZE_DURATION 500
 
 FFmpegMediaPlayer::FFmpegMediaPlayer(IMediaEventSink& InEventSink)
     : EventSink(InEventSink)
@@ -22,15 +37,18 @@ FFmpegMediaPlayer::FFmpegMediaPlayer(IMediaEventSink& InEventSink)
 {
     this->abort_request = 0;
     this->ic = nullptr;
-    this->IOContext = nullptr;
+    this->PendingConcatenate = false;
+    this->PreopenSwapCount = 0;
+    this->PreopenPrimeTime = 0.0;
 }
 
 FFmpegMediaPlayer::~FFmpegMediaPlayer()
 {
+    CancelPreopen();
 }
 
 /** [Custom] 初始化播放器 */
-bool FFmpegMediaPlayer::InitializePlayer(const TSharedPtr<FArchive, ESPMode::ThreadSafe>& Archive, const FString& Url, bool Precache, const FMediaPlayerOptions* PlayerOptions)
+bool FFmpegMediaPlayer::InitializePlayer(const TSharedPtr<FArchive, ESPMode::ThreadSafe>& Archive, const FString& Url, bool Precache, const FMediaPlayerOptions* PlayerOptions, const FFFmpegMediaOpenOptions& OpenOptions)
 {
     UE_LOG(LogFFmpegMedia, Verbose, TEXT("Player %p: Initializing %s (archive = %s, precache = %s)"), this, *Url, Archive.IsValid() ? TEXT("yes") : TEXT("no"), Precache ? TEXT("yes") : TEXT("no"));
 
@@ -41,7 +59,9 @@ bool FFmpegMediaPlayer::InitializePlayer(const TSharedPtr<FArchive, ESPMode::Thr
     const EAsyncExecution Execution = Precache ? EAsyncExecution::Thread : EAsyncExecution::ThreadPool;
 
     //创建异步任务并执行，
-    TFunction <void()>  Task = [Archive, Url, Precache, PlayerOptions, TracksPtr = TWeakPtr<FFFmpegMediaTracks, ESPMode::ThreadSafe>(Tracks), ThisPtr = this]()
+    //取消中断
+    this->abort_request = 0;
+    TFunction <void()>  Task = [Archive, Url, Precache, PlayerOptions, OpenOptions, TracksPtr = TWeakPtr<FFFmpegMediaTracks, ESPMode::ThreadSafe>(Tracks), ThisPtr = this]()
     {
         //获取轨道对象Tracks的弱引用
         TSharedPtr<FFFmpegMediaTracks, ESPMode::ThreadSafe> PinnedTracks = TracksPtr.Pin();
@@ -49,10 +69,17 @@ bool FFmpegMediaPlayer::InitializePlayer(const TSharedPtr<FArchive, ESPMode::Thr
         if (PinnedTracks.IsValid())
         {
             //读取媒体信息，获取AVFormatContext 
-            AVFormatContext* context = ThisPtr->ReadContext(Archive, Url, Precache);
+            FFFmpegMediaOpenStats OpenStats;
+            AVFormatContext* context = ReadContext(Archive, Url, Precache, OpenOptions, OpenStats, &ThisPtr->abort_request, PinnedTracks.Get());
             if (context) {
+                ThisPtr->ic = context;
+                PinnedTracks->SetOpenStats(OpenStats);
                 //通过AVFormatContext初始化轨道对象
-                PinnedTracks->Initialize(context, Url, PlayerOptions);
+                PinnedTracks->Initialize(context, Url, PlayerOptions, OpenOptions);
+            }
+            else {
+                //发送媒体打开失败事件
+                ThisPtr->EventSink.ReceiveMediaEvent(EMediaEvent::MediaOpenFailed);
             }
         }
     };
@@ -61,11 +88,8 @@ bool FFmpegMediaPlayer::InitializePlayer(const TSharedPtr<FArchive, ESPMode::Thr
 }
 
 /** [Custom] 读取Content */
-AVFormatContext* FFmpegMediaPlayer::ReadContext(const TSharedPtr<FArchive, ESPMode::ThreadSafe>& Archive, const FString& Url, bool Precache)
+AVFormatContext* FFmpegMediaPlayer::ReadContext(const TSharedPtr<FArchive, ESPMode::ThreadSafe>& Archive, const FString& Url, bool Precache, const FFFmpegMediaOpenOptions& OpenOptions, FFFmpegMediaOpenStats& OutStats, int* abort_flag, const FFFmpegMediaTracks* Owner)
 {
-    //取消中断
-    this->abort_request = 0;
-
     int err, ret;
     const AVDictionaryEntry* t;
     int scan_all_pmts_set = 0;
@@ -73,132 +97,203 @@ AVFormatContext* FFmpegMediaPlayer::ReadContext(const TSharedPtr<FArchive, ESPMo
     int orig_nb_streams = 0;
     const auto Settings = GetDefault<UFFmpegMediaSettings>();
     AVDictionary* format_opts = NULL;
-
-    ic = avformat_alloc_context(); //分配上下文
-    if (!ic) {
-        UE_LOG(LogFFmpegMedia, Error, TEXT("Player %p: Could not allocate context"), this);
+    int64_t phase_start = av_gettime_relative();
+    //本地文件可以使用流信息缓存
+    const FString LocalPath = (OpenOptions.StreamInfoCache && !Archive.IsValid()) ? FFmpegSidecarCache::GetLocalPath(Url) : FString();
+    //Archive以及只存在于pak中的文件使用自定义AVIO读取
+    const FString FilePath = Url.StartsWith(TEXT("file://")) ? Url.Mid(7) : Url;
+    const int32 IOBufferSize = FMath::Max(OpenOptions.IOBufferSize >= 0 ? OpenOptions.IOBufferSize : Settings->IOBufferSizeKB, 4) * 1024;
+    //预读缓冲区大小，本地文件只在媒体选项中指定时使用(比如NAS上的文件)
+    const int32 ReadAheadSize = OpenOptions.ReadAheadSize >= 0 ? OpenOptions.ReadAheadSize : Settings->ReadAheadSizeMB;
+    const bool HttpUrl = Url.StartsWith(TEXT("http://")) || Url.StartsWith(TEXT("https://"));
+    const bool NetworkUrl = HttpUrl || Url.StartsWith(TEXT("ftp://")) || Url.StartsWith(TEXT("sftp://")) || Url.StartsWith(TEXT("smb://"));
+    //http(s)地址的磁盘缓存大小上限
+    const int64 HttpCacheSize = (OpenOptions.HttpCache && HttpUrl) ? (int64)Settings->HttpCacheSizeMB * 1024 * 1024 : 0;
+    bool ReadAhead = false;
+    FFmpegIOSource* Source = nullptr;
+    AVIOContext* pb = nullptr;
+    OutStats.StartTime = phase_start;
+
+    AVFormatContext* context = avformat_alloc_context(); //分配上下文
+    if (!context) {
+        UE_LOG(LogFFmpegMedia, Error, TEXT("Tracks %p: Could not allocate context"), Owner);
         ret = AVERROR(ENOMEM);
         goto fail;
     }
-    ic->interrupt_callback.callback = decode_interrupt_cb; // 设置超时回调
-    ic->interrupt_callback.opaque = this;
+    context->interrupt_callback.callback = decode_interrupt_cb; // 设置超时回调
+    context->interrupt_callback.opaque = abort_flag;
   
     if (!av_dict_get(format_opts, "scan_all_pmts", NULL, AV_DICT_MATCH_CASE)) {
         av_dict_set(&format_opts, "scan_all_pmts", "1", AV_DICT_DONT_OVERWRITE);
         scan_all_pmts_set = 1;
     }
+    SetFormatOptions(&format_opts, Url, OpenOptions);
+
+    if (Archive.IsValid()) {
+        //原始地址能够通过平台文件层打开时异步读取，否则同步读取Archive
+        Source = FFmpegAsyncFileSource::Open(FilePath, IOBufferSize, Settings->IOReadAheadBlocks);
+        if (!Source) {
+            Source = new FFmpegArchiveSource(Archive);
+            ReadAhead = ReadAheadSize > 0;
+        }
+    }
+    else if (Url.StartsWith(TEXT("file://")) || !Url.Contains(TEXT("://"))) {
+        //预加载整个文件到内存，文件太大时按照普通文件读取
+        if (Precache) {
+            Source = FFmpegMemorySource::Open(FilePath, (int64)Settings->PrecacheMaxSizeMB * 1024 * 1024);
+        }
+        const bool PhysicalFile = IPlatformFile::GetPlatformPhysical().FileExists(*FilePath);
+        if (!Source && PhysicalFile && OpenOptions.ReadAheadSize > 0) {
+            Source = FFmpegProtocolSource::Open(FilePath, abort_flag);
+            ReadAhead = Source != nullptr;
+        }
+        //Linux上通过io_uring保持多个读取请求，不支持时使用内存映射
+        if (!Source && PhysicalFile && OpenOptions.IoUring && Settings->bIoUringLocalFiles) {
+            Source = FFmpegUringFileSource::Open(FilePath, IOBufferSize, Settings->IoUringQueueDepth, Settings->bIoUringDirectIO);
+        }
+        //内存映射本地文件，无法映射时使用FFmpeg的file协议
+        if (!Source && PhysicalFile && OpenOptions.MappedFile && Settings->bMapLocalFiles) {
+            Source = FFmpegMappedFileSource::Open(FilePath, (int64)Settings->MappedReadAheadMB * 1024 * 1024);
+        }
+        //打包之后pak/IoStore中的文件FFmpeg无法直接打开，通过平台文件层读取
+        if (!Source && !PhysicalFile) {
+            Source = FFmpegAsyncFileSource::Open(FilePath, IOBufferSize, Settings->IOReadAheadBlocks);
+        }
+    }
+    else if (NetworkUrl && (ReadAheadSize > 0 || HttpCacheSize > 0)) {
+        //网络地址由IO线程读取，网络延迟不直接阻塞解复用
+        Source = FFmpegProtocolSource::Open(Url, abort_flag);
+        //已经缓存的范围从磁盘读取，只下载缺少的范围
+        if (Source && HttpCacheSize > 0) {
+            if (FFmpegIOSource* CacheSource = FFmpegHttpCacheSource::Open(Url, Source, HttpCacheSize, abort_flag)) {
+                Source = CacheSource;
+            }
+        }
+        ReadAhead = Source != nullptr && ReadAheadSize > 0;
+    }
+    if (ReadAhead) {
+        Source = new FFmpegReadAheadSource(Source, (int64)ReadAheadSize * 1024 * 1024, IOBufferSize);
+    }
 
-    if (!Archive.IsValid()) {//如果附件对象不可用，则获取Url
+    if (Source) {
+        UE_LOG(LogFFmpegMedia, Verbose, TEXT("Tracks %p: reading %s through custom AVIO (%s)"), Owner, *Url, *Source->GetStats());
+        pb = FFmpegIOSource::CreateContext(Source, IOBufferSize);
+        if (!pb) {
+            ret = AVERROR(ENOMEM);
+            goto fail;
+        }
+        context->pb = pb; //avformat_close_input不会释放自定义的AVIOContext
+        err = avformat_open_input(&context, TCHAR_TO_UTF8(*FilePath), NULL, &format_opts); //文件名只用于根据扩展名判断格式
+    }
+    else {
         if (Url.StartsWith(TEXT("file://")))//如果是文件开头
         {
             const char* fileName = TCHAR_TO_UTF8(&Url[7]);
             AVDictionary* opts = NULL;
-            err = avformat_open_input(&ic, fileName, NULL, &format_opts);
+            err = avformat_open_input(&context, fileName, NULL, &format_opts);
         }
         else {
-            err = avformat_open_input(&ic, TCHAR_TO_UTF8(*Url), NULL, &format_opts);
+            err = avformat_open_input(&context, TCHAR_TO_UTF8(*Url), NULL, &format_opts);
         }
     }
-    else { //如果是附件，则转化成内存文件
-        UE_LOG(LogFFmpegMedia, Error, TEXT("Player %p: Unsupport Archive..."), this);
-        return NULL;
-        CurrentArchive = Archive;
-        const int ioBufferSize = 32768;
-        unsigned char* ioBuffer = (unsigned char*)av_malloc(ioBufferSize + FF_INPUT_BUFFER_PADDING_SIZE);
-        IOContext = avio_alloc_context(ioBuffer, ioBufferSize, 0, this, ReadtStreamCallback, NULL, SeekStreamCallback);
-        ic->pb = IOContext;
-        err = avformat_open_input(&ic, "InMemoryFile", NULL, &format_opts);
-    }
 
     if (err < 0) {
         char errbuf[1024] = {};
         av_strerror(err, errbuf, 1024);
-        UE_LOG(LogFFmpegMedia, Error, TEXT("Player %p: Couldn't Open File %d(%s)"), this, err, errbuf);
+        UE_LOG(LogFFmpegMedia, Error, TEXT("Tracks %p: Couldn't Open File %d(%s)"), Owner, err, errbuf);
         ret = -1;
         goto fail;
     }
+    OutStats.OpenInput = (av_gettime_relative() - phase_start) / 1000.0;
+    phase_start = av_gettime_relative();
     if (scan_all_pmts_set)
         av_dict_set(&format_opts, "scan_all_pmts", NULL, AV_DICT_MATCH_CASE);
 
     t = av_dict_get(format_opts, "", NULL, AV_DICT_IGNORE_SUFFIX);
     if (t) {
-        UE_LOG(LogFFmpegMedia, Error, TEXT("Player %p: format_opts %s not found."), this, t->key);
+        UE_LOG(LogFFmpegMedia, Error, TEXT("Tracks %p: format_opts %s not found."), Owner, t->key);
         ret = AVERROR_OPTION_NOT_FOUND;
         goto fail;
     }
 
    
     if (genpts)
-        ic->flags |= AVFMT_FLAG_GENPTS;
-
-    av_format_inject_global_side_data(ic);
-
-    orig_nb_streams = ic->nb_streams;
-    err = avformat_find_stream_info(ic, NULL);
-    if (err < 0) {
-        UE_LOG(LogFFmpegMedia, Error, TEXT("Player %p: could not find codec parameters."), this);
-        ret = -1;
-        goto fail;
+        context->flags |= AVFMT_FLAG_GENPTS;
+
+    av_format_inject_global_side_data(context);
+
+    orig_nb_streams = context->nb_streams;
+    //缓存中有流信息时不需要再读取数据探测
+    OutStats.StreamInfoCached = !LocalPath.IsEmpty() && FFmpegStreamInfoCache::Apply(LocalPath, context);
+    if (!OutStats.StreamInfoCached) {
+        err = avformat_find_stream_info(context, NULL);
+        if (err < 0) {
+            UE_LOG(LogFFmpegMedia, Error, TEXT("Tracks %p: could not find codec parameters."), Owner);
+            ret = -1;
+            goto fail;
+        }
+        if (!LocalPath.IsEmpty()) {
+            FFmpegStreamInfoCache::Save(LocalPath, context);
+        }
     }
+    OutStats.FindStreamInfo = (av_gettime_relative() - phase_start) / 1000.0;
+    UE_LOG(LogFFmpegMedia, Verbose, TEXT("Tracks %p: open_input %.1f ms, find_stream_info %.1f ms%s"), Owner, OutStats.OpenInput, OutStats.FindStreamInfo, OutStats.StreamInfoCached ? TEXT(" (cached)") : TEXT(""));
 
-    if (ic->pb)
-        ic->pb->eof_reached = 0; // FIXME hack, ffplay maybe should not use avio_feof() to test for the end
+    if (context->pb)
+        context->pb->eof_reached = 0; // FIXME hack, ffplay maybe should not use avio_feof() to test for the end
 
-    return ic;
+    return context;
 fail:
-    if (!ic) {
-        avformat_close_input(&ic);
-    }
-    this->abort_request = 1;
-    if (ret != 0) {
-        //发送媒体打开失败事件
-        EventSink.ReceiveMediaEvent(EMediaEvent::MediaOpenFailed);
+    if (context) {
+        avformat_close_input(&context);
     }
+    FFmpegIOSource::FreeContext(&pb);
+    *abort_flag = 1;
     return NULL;
 }
 
-int FFmpegMediaPlayer::decode_interrupt_cb(void* ctx)
+void FFmpegMediaPlayer::SetFormatOptions(AVDictionary** format_opts, const FString& Url, const FFFmpegMediaOpenOptions& OpenOptions)
 {
-    FFmpegMediaPlayer* player = static_cast<FFmpegMediaPlayer*>(ctx);
-    //注意abort_request为true时，会直接返回1，导致立即取消阻塞状态，所以阻塞进程执行之前，比如avformat_open_input，一定要为false, 否则还没读取之前就会直接中断
-    return player->abort_request ? 1 : 0;
-}
-
-/** [Custom] 读取流回调 */
-int FFmpegMediaPlayer::ReadtStreamCallback(void* opaque, uint8_t* buf, int buf_size) {
-    FFmpegMediaPlayer* player = static_cast<FFmpegMediaPlayer*>(opaque);
-    int64 Position = player->CurrentArchive->Tell();
-    int64 Size = player->CurrentArchive->TotalSize();
-    int64 BytesToRead = buf_size;
-    if (BytesToRead > (int64)Size)
-    {
-        BytesToRead = Size;
+    const auto Settings = GetDefault<UFFmpegMediaSettings>();
+    //低延迟模式，和Tracks中使用同一个判断(还没有打开，只根据地址)
+    const bool LowLatency = OpenOptions.LowLatency || (Settings->bLowLatencyLive && FFFmpegMediaTracks::IsLiveSource(Url, nullptr));
+    //探测大小和分析时长，0表示使用FFmpeg默认值，低延迟模式下没有设置时使用较小的值
+    const int32 ProbeSize = OpenOptions.ProbeSize >= 0 ? OpenOptions.ProbeSize : (Settings->ProbeSizeKB == 0 && LowLatency ? LOW_LATENCY_PROBE_SIZE : Settings->ProbeSizeKB);
+    const int32 AnalyzeDuration = OpenOptions.AnalyzeDuration >= 0 ? OpenOptions.AnalyzeDuration : (Settings->AnalyzeDurationMs == 0 && LowLatency ? LOW_LATENCY_ANALYZE_DURATION : Settings->AnalyzeDurationMs);
+
+    if (ProbeSize > 0) {
+        av_dict_set_int(format_opts, "probesize", (int64_t)ProbeSize * 1024, 0);
     }
-
-    if ((Size - BytesToRead) < player->CurrentArchive->Tell())
-    {
-        BytesToRead = Size - Position;
+    if (AnalyzeDuration > 0) {
+        av_dict_set_int(format_opts, "analyzeduration", (int64_t)AnalyzeDuration * 1000, 0);
     }
-    if (BytesToRead > 0)
-    {
-        player->CurrentArchive->Serialize(buf, BytesToRead);
+    if (LowLatency) {
+        av_dict_set(format_opts, "fflags", "+nobuffer", 0); //探测时读取的数据包不缓存，直接交给解码器
     }
-
-    player->CurrentArchive->Seek(Position + BytesToRead);
-
-    return BytesToRead;
-}
-
-/** [Custom] 跳转流回调 */
-int64_t FFmpegMediaPlayer::SeekStreamCallback(void* opaque, int64_t offset, int whence) {
-    FFmpegMediaPlayer* player = static_cast<FFmpegMediaPlayer*>(opaque);
-    if (whence == AVSEEK_SIZE) {
-        return player->CurrentArchive->TotalSize();
+    if (Url.StartsWith(TEXT("rtsp://")) || Url.StartsWith(TEXT("rtsps://"))) {
+        static const char* const RtspTransports[] = { nullptr, "udp", "udp_multicast", "tcp", "http", "https" };
+        const int32 Transport = (int32)Settings->RtspTransport;
+        if (Transport > 0 && Transport < UE_ARRAY_COUNT(RtspTransports)) {
+            av_dict_set(format_opts, "rtsp_transport", RtspTransports[Transport], 0);
+        }
+    }
+    //实时流断线重连时设置读取超时，连接没有关闭但是长时间没有数据时读取返回错误，由轨道重新连接
+    if (OpenOptions.Reconnect && Settings->bReconnectLive && Settings->ReconnectTimeoutMs > 0) {
+        if (Url.StartsWith(TEXT("rtsp://")) || Url.StartsWith(TEXT("rtsps://"))) {
+            av_dict_set_int(format_opts, "timeout", (int64_t)Settings->ReconnectTimeoutMs * 1000, 0);
+        }
+        else if (Url.StartsWith(TEXT("rtmp://")) || Url.StartsWith(TEXT("rtmps://")) || Url.StartsWith(TEXT("udp://")) || Url.StartsWith(TEXT("srt://"))) {
+            av_dict_set_int(format_opts, "rw_timeout", (int64_t)Settings->ReconnectTimeoutMs * 1000, 0);
+        }
     }
-    int64_t pos = player->CurrentArchive->Tell();
-    player->CurrentArchive->Seek(pos + offset);
-    return player->CurrentArchive->Tell();
+}
 
+int FFmpegMediaPlayer::decode_interrupt_cb(void* ctx)
+{
+    //ctx是中断标记(播放器的abort_request或者预打开的标记)
+    //注意abort_request为true时，会直接返回1，导致立即取消阻塞状态，所以阻塞进程执行之前，比如avformat_open_input，一定要为false, 否则还没读取之前就会直接中断
+    const int* abort_flag = static_cast<const int*>(ctx);
+    return *abort_flag ? 1 : 0;
 }
 
 /* IMediaPlayer 接口实现 */
@@ -208,20 +303,9 @@ int64_t FFmpegMediaPlayer::SeekStreamCallback(void* opaque, int64_t offset, int
 /** [UE4 IMediaPlayer]根据Url和可选参数打开媒体源 */
 bool FFmpegMediaPlayer::Open(const FString& Url, const IMediaOptions* Options)
 {
-    //打开新媒体之前，先关闭旧媒体
-    Close();
-
-    //如果媒体地址为空，直接返回
-    if (Url.IsEmpty())
-    {
-        UE_LOG(LogFFmpegMedia, Error, TEXT("Player %p:Cannot open media from url(url is empty)"), this);
-        return false;
-    }
-    UE_LOG(LogFFmpegMedia, Log, TEXT("Player %p: Open Media Source[Url]: [%s]"), this, *Url);
-    //是否预加载(todo: 该参数无用)
+    //是否把整个文件预加载到内存(FileMediaSource的PrecacheFile选项)
     const bool Precache = (Options != nullptr) ? Options->GetMediaOption("PrecacheFile", false) : false;
-    bool ret = InitializePlayer(nullptr, Url, Precache, nullptr);
-    return ret;
+    return OpenUrl(Url, Precache, FFFmpegMediaOpenOptions::FromMediaOptions(Options));
 }
 
 bool FFmpegMediaPlayer::Open(const FString& Url, const IMediaOptions* Options, const FMediaPlayerOptions* PlayerOptions)
@@ -229,8 +313,23 @@ bool FFmpegMediaPlayer::Open(const FString& Url, const IMediaOptions* Options, c
   /*  FName name = "nnnn";
     FString dv = "";
     FString name22 = Options->GetMediaOption(name, dv);*/
+    //是否把整个文件预加载到内存(FileMediaSource的PrecacheFile选项)
+    const bool Precache = (Options != nullptr) ? Options->GetMediaOption("PrecacheFile", false) : false;
+    return OpenUrl(Url, Precache, FFFmpegMediaOpenOptions::FromMediaOptions(Options));
+}
+
+/** [Custom] 根据Url和已经读取的打开选项打开媒体源 */
+bool FFmpegMediaPlayer::OpenUrl(const FString& Url, bool Precache, const FFFmpegMediaOpenOptions& OpenOptions)
+{
+    //已经预打开了同一个媒体，直接交换
+    if (OpenPreopened(Url, OpenOptions))
+    {
+        return true;
+    }
+
     //打开新媒体之前，先关闭旧媒体
     Close();
+
     //如果媒体地址为空，直接返回
     if (Url.IsEmpty())
     {
@@ -238,9 +337,12 @@ bool FFmpegMediaPlayer::Open(const FString& Url, const IMediaOptions* Options, c
         return false;
     }
     UE_LOG(LogFFmpegMedia, Log, TEXT("Player %p: Open Media Source[Url]: [%s]"), this, *Url);
-    //是否预加载(todo: 该参数无用)
-    const bool Precache = (Options != nullptr) ? Options->GetMediaOption("PrecacheFile", false) : false;
-    bool ret = InitializePlayer(nullptr, Url, Precache, nullptr);
+    //同一个地址的多个播放器共用解复用、解码和转换
+    if (OpenOptions.SharedSource || GetDefault<UFFmpegMediaSettings>()->bShareSources)
+    {
+        return OpenShared(Url, Precache, OpenOptions);
+    }
+    bool ret = InitializePlayer(nullptr, Url, Precache, nullptr, OpenOptions);
     return ret;
 }
 
@@ -263,15 +365,38 @@ bool FFmpegMediaPlayer::Open(const TSharedRef<FArchive, ESPMode::ThreadSafe>& Ar
     }
 
     UE_LOG(LogFFmpegMedia, Log, TEXT("Player %p: Open Media Source[Archive]: %s"), this);
-    return InitializePlayer(Archive, OriginalUrl, false, nullptr);
+    return InitializePlayer(Archive, OriginalUrl, false, nullptr, FFFmpegMediaOpenOptions::FromMediaOptions(Options));
 }
 
 void FFmpegMediaPlayer::Close()
 {
     UE_LOG(LogFFmpegMedia, Log, TEXT("FFmpegMediaPlayer %p: Close ...."), this);
+    //关闭媒体时预打开的媒体也不再需要
+    CancelPreopen();
+    PendingConcatenate = false;
+    //共享的媒体源只解除附加，最后一个播放器释放时才关闭轨道
+    if (SharedSource.IsValid())
+    {
+        DetachSharedSource();
+        this->MediaUrl = FString();
+        EventSink.ReceiveMediaEvent(EMediaEvent::TracksChanged);
+        EventSink.ReceiveMediaEvent(EMediaEvent::MediaClosed);
+        return;
+    }
+    //当前媒体是预打开之后交换过来的，使用的是预打开的中断标记，仍在后台打开时由后台任务关闭轨道
+    if (ActivePreopen.IsValid() && !ActivePreopen->Cancel())
+    {
+        ActivePreopen.Reset();
+        this->Tracks = MakeShared<FFFmpegMediaTracks, ESPMode::ThreadSafe>();
+        this->MediaUrl = FString();
+        EventSink.ReceiveMediaEvent(EMediaEvent::TracksChanged);
+        EventSink.ReceiveMediaEvent(EMediaEvent::MediaClosed);
+        return;
+    }
     //如果媒体轨道对象的状态等于关闭状态，直接返回
     if (Tracks->GetState() == EMediaState::Closed)
     {
+        ActivePreopen.Reset();
         return;
     }
     
@@ -281,6 +406,7 @@ void FFmpegMediaPlayer::Close()
     this->MediaUrl = FString();
     //关闭轨道
     this->Tracks->Shutdown();
+    ActivePreopen.Reset();
 
     //清除ffmpeg资源占用
     if (ic) {
@@ -291,13 +417,6 @@ void FFmpegMediaPlayer::Close()
         ic = nullptr;
     }
 
-    //清除FFmpeg IOContext(读取内存文件时才会存在)
-    if (IOContext) {
-        av_free(IOContext->buffer);
-        av_free(IOContext);
-        IOContext = nullptr;
-    }
-
     //通知监听器
     EventSink.ReceiveMediaEvent(EMediaEvent::TracksChanged);
     EventSink.ReceiveMediaEvent(EMediaEvent::MediaClosed); 
@@ -305,11 +424,30 @@ void FFmpegMediaPlayer::Close()
 
 void FFmpegMediaPlayer::TickInput(FTimespan DeltaTime, FTimespan Timecode)
 {
+    //交换过来的媒体仍在后台打开，准备好第一帧之前不发送事件，避免收到MediaOpened之后开始播放与暂停冲突
+    if (ActivePreopen.IsValid() && !ActivePreopen->IsFinished())
+    {
+        return;
+    }
+    //记录预打开解码出第一帧的时间
+    if (Preopen.IsValid() && Preopen->PrimedTime == 0 && Preopen->IsFinished() && Preopen->Tracks->IsPrimed())
+    {
+        Preopen->PrimedTime = av_gettime_relative();
+    }
 
     bool MediaSourceChanged = false; //数据源是否变动
     bool TrackSelectionChanged = false; //轨道选择是否变动
+    TArray<EMediaEvent> OutEvents;
 
-    Tracks->GetFlags(MediaSourceChanged, TrackSelectionChanged);
+    if (SharedSink.IsValid())
+    {
+        //共享的媒体源，事件和标记由轨道分发到每个附加的播放器
+        Tracks->GetSinkEvents(*SharedSink, MediaSourceChanged, TrackSelectionChanged, OutEvents);
+    }
+    else
+    {
+        Tracks->GetFlags(MediaSourceChanged, TrackSelectionChanged);
+    }
 
     if (MediaSourceChanged)
     {
@@ -323,18 +461,43 @@ void FFmpegMediaPlayer::TickInput(FTimespan DeltaTime, FTimespan Timecode)
     }
 
     //如果修改过，则发送事件之后重置状态为false
-    if (MediaSourceChanged || TrackSelectionChanged)
+    if ((MediaSourceChanged || TrackSelectionChanged) && !SharedSink.IsValid())
     {
         Tracks->ClearFlags();
     }
 
     //将Tracks对象中的事件取出循环执行
-    TArray<EMediaEvent> OutEvents;
-    Tracks->GetEvents(OutEvents);
+    if (!SharedSink.IsValid())
+    {
+        Tracks->GetEvents(OutEvents);
+    }
+    //连续播放时，当前媒体播放结束直接交换到预打开的媒体，不发送结束事件
+    if (Preopen.IsValid() && Preopen->Concatenate && !Tracks->IsLooping() && OutEvents.Contains(EMediaEvent::PlaybackEndReached))
+    {
+        PendingConcatenate = true;
+    }
     for (const auto& Event : OutEvents)
     {
+        if (PendingConcatenate && (Event == EMediaEvent::PlaybackEndReached || Event == EMediaEvent::PlaybackSuspended))
+        {
+            continue;
+        }
         EventSink.ReceiveMediaEvent(Event);
     }
+    if (PendingConcatenate)
+    {
+        if (!Preopen.IsValid() || Preopen->HasFailed()) //预打开失败或者已经取消，正常结束
+        {
+            PendingConcatenate = false;
+            EventSink.ReceiveMediaEvent(EMediaEvent::PlaybackEndReached);
+            EventSink.ReceiveMediaEvent(EMediaEvent::PlaybackSuspended);
+        }
+        else if (Preopen->IsFinished())
+        {
+            PendingConcatenate = false;
+            SwapToPreopened(true);
+        }
+    }
 }
 
 
@@ -368,6 +531,11 @@ IMediaCache& FFmpegMediaPlayer::GetCache()
 	return *this;
 }
 
+bool FFmpegMediaPlayer::QueryCacheState(EMediaCacheState State, TRangeSet<FTimespan>& OutTimeRanges) const
+{
+	return this->Tracks->QueryCacheState(State, OutTimeRanges);
+}
+
 IMediaControls& FFmpegMediaPlayer::GetControls()
 {
     return *Tracks;
@@ -379,22 +547,240 @@ FString FFmpegMediaPlayer::GetInfo() const
 }
 
 FGuid FFmpegMediaPlayer::GetPlayerPluginGUID() const
+{
+    return PluginGUID();
+}
+
+const FGuid& FFmpegMediaPlayer::PluginGUID()
 {
     //注意此处要与FFmpegMediaFactory中的一致
     static FGuid PlayerPluginGUID(0x688ae1e8, 0x9b647f80, 0x9ce98ced, 0x9daa4ca6);
     return PlayerPluginGUID;
 }
 
+bool FFmpegMediaPlayer::StepFrames(int32 NumFrames)
+{
+    return Tracks->StepFrames(NumFrames);
+}
+
+void FFmpegMediaPlayer::SetScrubbing(bool Scrubbing)
+{
+    Tracks->SetScrubbing(Scrubbing);
+}
+
+/** [Custom] 在后台预打开下一个媒体 */
+bool FFmpegMediaPlayer::PreopenNext(const FString& Url, const FFFmpegMediaOpenOptions& OpenOptions, bool Concatenate)
+{
+    //同一时间只预打开一个媒体
+    CancelPreopen();
+
+    if (Url.IsEmpty())
+    {
+        UE_LOG(LogFFmpegMedia, Error, TEXT("Player %p: Cannot preopen media from url(url is empty)"), this);
+        return false;
+    }
+    UE_LOG(LogFFmpegMedia, Log, TEXT("Player %p: Preopen Media Source[Url]: [%s] (concatenate = %s)"), this, *Url, Concatenate ? TEXT("yes") : TEXT("no"));
+
+    TSharedPtr<FFFmpegMediaPreopen, ESPMode::ThreadSafe> NewPreopen = MakeShared<FFFmpegMediaPreopen, ESPMode::ThreadSafe>();
+    NewPreopen->Tracks = MakeShared<FFFmpegMediaTracks, ESPMode::ThreadSafe>();
+    NewPreopen->Url = Url;
+    NewPreopen->OpenOptions = OpenOptions;
+    NewPreopen->Concatenate = Concatenate;
+    NewPreopen->StartTime = av_gettime_relative();
+    if (Concatenate) { //时间轴接在当前媒体之后(当前媒体的时长已经包含了之前的偏移)
+        NewPreopen->Tracks->SetTimelineOffset(Tracks->GetDuration());
+    }
+    Preopen = NewPreopen;
+
+    //打开、读取流信息、初始化并解码出第一帧，都在后台完成
+    //任务只持有预打开的状态，不访问播放器，播放器可以在任务结束之前销毁
+    TFunction <void()> Task = [Url, OpenOptions, NewPreopen]()
+    {
+        TSharedPtr<FFFmpegMediaTracks, ESPMode::ThreadSafe> PinnedTracks = NewPreopen->Tracks;
+        FFFmpegMediaOpenStats OpenStats;
+        AVFormatContext* context = ReadContext(nullptr, Url, false, OpenOptions, OpenStats, &NewPreopen->abort_request, PinnedTracks.Get());
+        if (context) {
+            PinnedTracks->SetOpenStats(OpenStats);
+            PinnedTracks->Initialize(context, Url, nullptr, OpenOptions);
+            PinnedTracks->Prime();
+        }
+        else {
+            UE_LOG(LogFFmpegMedia, Warning, TEXT("Tracks %p: Preopen %s fail, it will be opened normally"), PinnedTracks.Get(), *Url);
+        }
+        bool Cancelled;
+        {
+            FScopeLock Lock(&NewPreopen->Mutex);
+            NewPreopen->Finished = true;
+            Cancelled = NewPreopen->Cancelled;
+        }
+        if (Cancelled && PinnedTracks->GetState() != EMediaState::Closed) { //任务期间已经取消，由任务关闭轨道
+            PinnedTracks->Shutdown();
+        }
+    };
+    Async(EAsyncExecution::ThreadPool, Task);
+    return true;
+}
+
+/** [Custom] 取消预打开的媒体 */
+void FFmpegMediaPlayer::CancelPreopen()
+{
+    if (!Preopen.IsValid())
+    {
+        return;
+    }
+    TSharedPtr<FFFmpegMediaPreopen, ESPMode::ThreadSafe> OldPreopen = Preopen;
+    Preopen.Reset();
+    if (OldPreopen->Cancel()) //任务已经结束，在后台关闭轨道
+    {
+        ShutdownInBackground(OldPreopen->Tracks, OldPreopen);
+    }
+}
+
+/** [Custom] 交换到同一个地址并且选项兼容的预打开媒体 */
+bool FFmpegMediaPlayer::OpenPreopened(const FString& Url, const FFFmpegMediaOpenOptions& OpenOptions)
+{
+    if (!Preopen.IsValid() || Preopen->Concatenate || Preopen->Url != Url || Preopen->HasFailed())
+    {
+        return false;
+    }
+    //纯音频、关键帧索引、常驻片段、低延迟以及缓存大小在打开轨道时已经生效，与预打开时不同的轨道不能直接使用
+    if (Preopen->OpenOptions.GetDecodeKey() != OpenOptions.GetDecodeKey())
+    {
+        UE_LOG(LogFFmpegMedia, Log, TEXT("Player %p: preopened %s has different options (%s, requested %s), opening normally"), this, *Url,
+            *Preopen->OpenOptions.GetDecodeKey(), *OpenOptions.GetDecodeKey());
+        CancelPreopen();
+        return false;
+    }
+    UE_LOG(LogFFmpegMedia, Log, TEXT("Player %p: Open Media Source[Url]: [%s] (preopened)"), this, *Url);
+    SwapToPreopened(false);
+    return true;
+}
+
+/** [Custom] 交换到预打开的媒体 */
+void FFmpegMediaPlayer::SwapToPreopened(bool Concatenate)
+{
+    TSharedPtr<FFFmpegMediaPreopen, ESPMode::ThreadSafe> NewPreopen = Preopen;
+    Preopen.Reset();
+    UE_LOG(LogFFmpegMedia, Log, TEXT("Player %p: Swap to preopened media %s (%s)"), this, *NewPreopen->Url, NewPreopen->PrimedTime > 0 ? TEXT("ready") : TEXT("still opening"));
+
+    //旧的轨道在后台关闭，中断标记随旧轨道一起保留到关闭完成
+    TSharedPtr<FFFmpegMediaTracks, ESPMode::ThreadSafe> OldTracks = Tracks;
+    const float OldRate = OldTracks->GetRate();
+    this->abort_request = 1;
+    //共享的媒体源只解除附加；旧媒体也是交换过来的且仍在后台打开时，由后台任务关闭
+    if (SharedSource.IsValid()) {
+        DetachSharedSource();
+    }
+    else if (!ActivePreopen.IsValid() || ActivePreopen->Cancel()) {
+        ShutdownInBackground(OldTracks, ActivePreopen);
+    }
+    ic = nullptr;
+
+    Tracks = NewPreopen->Tracks;
+    ActivePreopen = NewPreopen;
+    MediaUrl = NewPreopen->Url;
+    PreopenSwapCount++;
+    if (NewPreopen->PrimedTime > 0) {
+        PreopenPrimeTime = (NewPreopen->PrimedTime - NewPreopen->StartTime) / 1000.0;
+    }
+
+    if (Concatenate)
+    {
+        //时间轴连续，不需要重新打开，去掉预打开时产生的打开事件，按照原来的速率继续播放
+        TArray<EMediaEvent> Events;
+        Tracks->GetEvents(Events);
+        Tracks->SetRate(FMath::IsNearlyZero(OldRate) ? 1.0f : OldRate);
+        EventSink.ReceiveMediaEvent(EMediaEvent::TracksChanged);
+    }
+    else
+    {
+        //与Close一样通知监听器，预打开时产生的MediaOpened事件在TickInput中发送
+        EventSink.ReceiveMediaEvent(EMediaEvent::TracksChanged);
+        EventSink.ReceiveMediaEvent(EMediaEvent::MediaClosed);
+    }
+}
+
+/** [Custom] 在后台关闭轨道 */
+void FFmpegMediaPlayer::ShutdownInBackground(const TSharedPtr<FFFmpegMediaTracks, ESPMode::ThreadSafe>& InTracks, const TSharedPtr<FFFmpegMediaPreopen, ESPMode::ThreadSafe>& InPreopen)
+{
+    if (!InTracks.IsValid() || InTracks->GetState() == EMediaState::Closed)
+    {
+        return;
+    }
+    //InPreopen中保存着上下文使用的中断标记，需要保留到上下文关闭
+    Async(EAsyncExecution::ThreadPool, [InTracks, InPreopen]()
+    {
+        InTracks->Shutdown();
+    });
+}
+
+/** [Custom] 附加到共享的媒体源，没有可以附加的媒体源时创建并打开 */
+bool FFmpegMediaPlayer::OpenShared(const FString& Url, bool Precache, const FFFmpegMediaOpenOptions& OpenOptions)
+{
+    bool Created = false;
+    TSharedRef<FFFmpegMediaSharedSource, ESPMode::ThreadSafe> Source = FFFmpegMediaSharedSource::Acquire(Url, OpenOptions, Created);
+    SharedSource = Source;
+    Tracks = Source->Tracks;
+    SharedSink = Tracks->AddSink();
+    MediaUrl = Url;
+    if (!Created)
+    {
+        return true;
+    }
+
+    //打开任务只持有媒体源，创建媒体源的播放器关闭之后其他播放器仍然可以继续使用
+    const EAsyncExecution Execution = Precache ? EAsyncExecution::Thread : EAsyncExecution::ThreadPool;
+    TFunction <void()> Task = [Url, Precache, OpenOptions, Source]()
+    {
+        FFFmpegMediaOpenStats OpenStats;
+        AVFormatContext* context = ReadContext(nullptr, Url, Precache, OpenOptions, OpenStats, &Source->abort_request, &Source->Tracks.Get());
+        if (context) {
+            Source->Tracks->SetOpenStats(OpenStats);
+            Source->Tracks->Initialize(context, Url, nullptr, OpenOptions);
+        }
+        else {
+            Source->Tracks->NotifyOpenFailed();
+        }
+        if (Source->FinishOpen() && Source->Tracks->GetState() != EMediaState::Closed) { //打开期间所有播放器都已经释放，由打开任务关闭轨道
+            Source->Tracks->Shutdown();
+        }
+    };
+    Async(Execution, Task);
+    return true;
+}
+
+/** [Custom] 解除附加共享的媒体源 */
+void FFmpegMediaPlayer::DetachSharedSource()
+{
+    Tracks->RemoveSink(SharedSink);
+    SharedSink.Reset();
+    FFFmpegMediaSharedSource::Release(SharedSource.ToSharedRef());
+    SharedSource.Reset();
+    Tracks = MakeShared<FFFmpegMediaTracks, ESPMode::ThreadSafe>();
+}
+
 IMediaSamples& FFmpegMediaPlayer::GetSamples()
 {
+    if (SharedSink.IsValid())
+    {
+        return *SharedSink->Samples;
+    }
     return Tracks->GetSamples();
 }
 
 FString FFmpegMediaPlayer::GetStats() const
 {
-    //todo:
-    UE_LOG(LogFFmpegMedia, Log, TEXT("FFmpegMediaPlayer %p: GetStats ...."), this);
-	return FString("todo...");
+    FString Stats = Tracks->GetStats();
+    Stats += FString::Printf(TEXT("Preopen\n"));
+    if (Preopen.IsValid()) {
+        Stats += FString::Printf(TEXT("\tNext: %s (%s%s)\n"), *Preopen->Url,
+            Preopen->PrimedTime > 0 ? TEXT("ready") : TEXT("opening"), Preopen->Concatenate ? TEXT(", concatenate") : TEXT(""));
+    }
+    Stats += FString::Printf(TEXT("\tSwaps: %d, last open to first frame %.1f ms\n"), PreopenSwapCount, PreopenPrimeTime);
+    if (SharedSource.IsValid()) {
+        Stats += FString::Printf(TEXT("\tShared sources: %d registered, %d players on this source\n"), FFFmpegMediaSharedSource::GetNumSources(), SharedSource->GetNumPlayers());
+    }
+    return Stats;
 }
 
 IMediaTracks& FFmpegMediaPlayer::GetTracks()
@@ -9,8 +9,72 @@
 
 #include "FFmpegMedia.h"
 #include "FFmpegMediaTracks.h"
+#include "FFmpegMediaOptions.h"
 
 class IMediaEventSink;
+class FFFmpegMediaSharedSource;
+
+/**
+ * [Custom] 在后台预打开的下一个媒体
+ * 注意预打开的任务和取消操作可能同时发生，由Mutex保证只有一方关闭轨道
+ */
+struct FFFmpegMediaPreopen
+{
+	/** 预打开的轨道集合 */
+	TSharedPtr<FFFmpegMediaTracks, ESPMode::ThreadSafe> Tracks;
+
+	/** 媒体地址 */
+	FString Url;
+
+	/** 打开选项，Open时只有影响解码的选项相同才交换 */
+	FFFmpegMediaOpenOptions OpenOptions;
+
+	/** 是否接在当前媒体之后连续播放(时间轴连续，播放结束时自动交换) */
+	bool Concatenate = false;
+
+	/** 中断标记，用于interrupt_callback，交换之后仍然被当前媒体使用 */
+	int abort_request = 0;
+
+	/** 开始预打开的时间(微秒) */
+	int64 StartTime = 0;
+
+	/** 第一帧解码完成的时间(微秒)，0表示还没有完成 */
+	int64 PrimedTime = 0;
+
+	/** 后台任务是否已经结束 */
+	bool Finished = false;
+
+	/** 是否已经取消 */
+	bool Cancelled = false;
+
+	FCriticalSection Mutex;
+
+	/**
+	 * 取消预打开并中断正在进行的打开操作
+	 * @return 后台任务已经结束时返回true，此时需要调用者关闭轨道，否则由后台任务关闭
+	 */
+	bool Cancel()
+	{
+		FScopeLock Lock(&Mutex);
+		Cancelled = true;
+		abort_request = 1;
+		return Finished;
+	}
+
+	/** 后台任务是否已经结束 */
+	bool IsFinished()
+	{
+		FScopeLock Lock(&Mutex);
+		return Finished;
+	}
+
+	/** 预打开是否失败(失败时按照正常流程打开) */
+	bool HasFailed()
+	{
+		FScopeLock Lock(&Mutex);
+		return Finished && (Tracks->GetState() == EMediaState::Closed || Tracks->GetState() == EMediaState::Error);
+	}
+};
 
 /**
  * 实现UE播放器
@@ -63,6 +127,38 @@ public:
 	virtual bool FlushOnSeekCompleted() const override;
 	/** 根据功能标识判断播放器功能是否支持 */
 	virtual bool GetPlayerFeatureFlag(EFeatureFlag flag) const override;
+public:
+	//IMediaCache接口
+	/** 获取缓存的时间范围(预加载到内存的部分) */
+	virtual bool QueryCacheState(EMediaCacheState State, TRangeSet<FTimespan>& OutTimeRanges) const override;
+public:
+	/**
+	 * [Custom] 暂停状态下逐帧显示
+	 * @param NumFrames 显示的帧数，大于0向前，小于0向后
+	 */
+	bool StepFrames(int32 NumFrames);
+	/**
+	 * [Custom] 设置拖动状态，拖动时seek只跳转到关键帧，停止拖动时对最后的位置做一次精准seek
+	 */
+	void SetScrubbing(bool Scrubbing);
+	/** [Custom] 播放器插件的GUID，与GetPlayerPluginGUID返回的相同 */
+	static const FGuid& PluginGUID();
+	/**
+	 * [Custom] 根据Url和打开选项打开媒体源，两个Open(Url)从IMediaOptions中读取选项之后调用
+	 * 自动化测试和性能测试不经过媒体源资源，直接使用该方法
+	 * @param Precache 是否把整个文件预加载到内存
+	 */
+	bool OpenUrl(const FString& Url, bool Precache, const FFFmpegMediaOpenOptions& OpenOptions);
+	/**
+	 * [Custom] 在后台预打开下一个媒体(打开、读取流信息并解码出第一帧)
+	 * 之后用同一个地址调用Open时直接交换，连续播放模式下当前媒体播放结束时自动交换
+	 * @param Url 媒体地址
+	 * @param OpenOptions 打开选项
+	 * @param Concatenate 是否接在当前媒体之后连续播放(时间轴连续)
+	 */
+	bool PreopenNext(const FString& Url, const FFFmpegMediaOpenOptions& OpenOptions, bool Concatenate);
+	/** [Custom] 取消预打开的媒体 */
+	void CancelPreopen();
 protected:
 	/**
 	 * Initialize the native FFmpegMediaPlayer instance.
@@ -70,17 +166,54 @@ protected:
 	 * @param Archive The archive being used as a media source (optional).
 	 * @param Url The media URL being opened.
 	 * @param Precache Whether to Precache media into RAM if InURL is a local file.
+	 * @param OpenOptions 打开选项(从IMediaOptions中拷贝)
 	 * @return true on success, false otherwise.
 	 */
-	bool InitializePlayer(const TSharedPtr<FArchive, ESPMode::ThreadSafe>& Archive, const FString& Url, bool Precache, const FMediaPlayerOptions* PlayerOptions);
+	bool InitializePlayer(const TSharedPtr<FArchive, ESPMode::ThreadSafe>& Archive, const FString& Url, bool Precache, const FMediaPlayerOptions* PlayerOptions, const FFFmpegMediaOpenOptions& OpenOptions);
+
+	/**
+	 * [Custom] 设置打开媒体时的格式选项(探测大小、分析时长、低延迟、rtsp传输方式)
+	 * 实时流断线重连时轨道使用相同的选项重新打开
+	 */
+	static void SetFormatOptions(AVDictionary** format_opts, const FString& Url, const FFFmpegMediaOpenOptions& OpenOptions);
 
 private:
 	/** [Custom] 读取媒体内容
 	 * this thread gets the stream from the disk or the network
 	 * 从文件或网络上获取流信息
 	 * 参考ffplay static int read_thread(void *arg) 注意该方法并没有实现全部业务，只包含打开文件的那部分操作，其他操作则交给了FFmpegTracks类实现
+	 * @param OpenOptions 打开选项(探测大小、分析时长以及流信息缓存)
+	 * @param OutStats 打开阶段的耗时
+	 * 不访问播放器，可以在播放器销毁之后继续执行(预打开、共享媒体源)，打开失败时由调用者发送MediaOpenFailed事件
+	 * @param abort_flag 中断标记(播放器、预打开或者共享媒体源的abort_request)，失败时设置为1
+	 * @param Owner 打开的轨道，只用于日志
+	 */
+	static AVFormatContext* ReadContext(const TSharedPtr<FArchive, ESPMode::ThreadSafe>& Archive, const FString& Url, bool Precache, const FFFmpegMediaOpenOptions& OpenOptions, FFFmpegMediaOpenStats& OutStats, int* abort_flag, const FFFmpegMediaTracks* Owner);
+
+	/**
+	 * [Custom] 交换到预打开的媒体，旧的轨道在后台关闭
+	 * @param Concatenate 连续播放时不发送关闭和打开事件，并以原来的速率继续播放
+	 */
+	void SwapToPreopened(bool Concatenate);
+
+	/**
+	 * [Custom] Open时已经预打开了同一个地址并且影响解码的选项相同时交换到预打开的媒体
+	 * 选项不同时预打开的轨道不能使用，由Close取消之后正常打开
+	 * @return 是否已经交换
 	 */
-	AVFormatContext* ReadContext(const TSharedPtr<FArchive, ESPMode::ThreadSafe>& Archive, const FString& Url, bool Precache);
+	bool OpenPreopened(const FString& Url, const FFFmpegMediaOpenOptions& OpenOptions);
+
+	/**
+	 * [Custom] 附加到打开同一个地址且选项相同的共享媒体源，没有可以附加的媒体源时创建并在后台打开
+	 * 播放器使用自己的样本队列和事件，播放控制作用于共享的轨道
+	 */
+	bool OpenShared(const FString& Url, bool Precache, const FFFmpegMediaOpenOptions& OpenOptions);
+
+	/** [Custom] 解除附加共享的媒体源，最后一个播放器解除时在后台关闭轨道 */
+	void DetachSharedSource();
+
+	/** [Custom] 在后台关闭轨道，不阻塞游戏线程 */
+	static void ShutdownInBackground(const TSharedPtr<FFFmpegMediaTracks, ESPMode::ThreadSafe>& InTracks, const TSharedPtr<FFFmpegMediaPreopen, ESPMode::ThreadSafe>& InPreopen);
 
 	/** [Custom] 解码中断回调 Returns 1 when we would like to stop the application
 	 * 参考ffplay static int decode_interrupt_cb(void* ctx)
@@ -94,12 +227,6 @@ private:
 	 */
 	static int decode_interrupt_cb(void* ctx);
 
-	/** [Custom] 读取流回调 This is called when it's reading an Archive instead of an url*/
-	static int ReadtStreamCallback(void* ptr, uint8_t* buf, int buf_size);
-
-	/** [Custom] 跳转流回调 This is called when it's reading an Archive instead of an url*/
-	static int64_t SeekStreamCallback(void* opaque, int64_t offset, int whence);
-
 private:
 
 	/** 媒体事件处理器 The media event handler. */
@@ -122,8 +249,24 @@ private:
 	*/
 	AVFormatContext* ic;
 
-	//当前Archive
-	TSharedPtr<FArchive, ESPMode::ThreadSafe> CurrentArchive;
-	//读取Archive时设置值
-	AVIOContext* IOContext;
+	/** [Custom] 预打开的下一个媒体 */
+	TSharedPtr<FFFmpegMediaPreopen, ESPMode::ThreadSafe> Preopen;
+
+	/** [Custom] 从预打开交换过来的当前媒体(当前媒体的中断标记保存在其中) */
+	TSharedPtr<FFFmpegMediaPreopen, ESPMode::ThreadSafe> ActivePreopen;
+
+	/** [Custom] 连续播放时当前媒体已经结束，等待预打开的媒体完成之后交换 */
+	bool PendingConcatenate;
+
+	/** [Custom] 交换次数 */
+	int32 PreopenSwapCount;
+
+	/** [Custom] 最后一次预打开到解码出第一帧的耗时(毫秒) */
+	double PreopenPrimeTime;
+
+	/** [Custom] 附加的共享媒体源(Tracks为其中的轨道) */
+	TSharedPtr<FFFmpegMediaSharedSource, ESPMode::ThreadSafe> SharedSource;
+
+	/** [Custom] 本播放器在共享媒体源中的样本队列和事件 */
+	TSharedPtr<FFFmpegMediaTracksSink, ESPMode::ThreadSafe> SharedSink;
 };
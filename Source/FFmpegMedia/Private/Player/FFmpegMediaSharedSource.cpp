@@ -0,0 +1,114 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Player/FFmpegMediaSharedSource.h"
+#include "FFmpegMedia.h"
+#include "Async/Async.h"
+
+/** 注册的共享媒体源，键值 -> 媒体源 */
+static FCriticalSection SourcesMutex;
+static TMap<FString, TSharedPtr<FFFmpegMediaSharedSource, ESPMode::ThreadSafe>> Sources;
+
+TSharedRef<FFFmpegMediaSharedSource, ESPMode::ThreadSafe> FFFmpegMediaSharedSource::Acquire(const FString& Url, const FFFmpegMediaOpenOptions& OpenOptions, bool& bOutCreated)
+{
+    const FString Key = MakeKey(Url, OpenOptions);
+    FScopeLock Lock(&SourcesMutex);
+    TSharedPtr<FFFmpegMediaSharedSource, ESPMode::ThreadSafe>* Found = Sources.Find(Key);
+    if (Found && (*Found)->IsJoinable()) {
+        (*Found)->NumPlayers++;
+        bOutCreated = false;
+        UE_LOG(LogFFmpegMedia, Log, TEXT("SharedSource %p: %s attached (%d players)"), Found->Get(), *Url, (*Found)->NumPlayers);
+        return Found->ToSharedRef();
+    }
+
+    //不能附加的旧媒体源从注册表中移除，仍然由使用它的播放器释放
+    TSharedRef<FFFmpegMediaSharedSource, ESPMode::ThreadSafe> Source = MakeShared<FFFmpegMediaSharedSource, ESPMode::ThreadSafe>();
+    Source->Key = Key;
+    Source->NumPlayers = 1;
+    Sources.Add(Key, Source);
+    bOutCreated = true;
+    UE_LOG(LogFFmpegMedia, Log, TEXT("SharedSource %p: %s created"), &Source.Get(), *Url);
+    return Source;
+}
+
+void FFFmpegMediaSharedSource::Release(const TSharedRef<FFFmpegMediaSharedSource, ESPMode::ThreadSafe>& Source)
+{
+    {
+        FScopeLock Lock(&SourcesMutex);
+        if (--Source->NumPlayers > 0) {
+            UE_LOG(LogFFmpegMedia, Log, TEXT("SharedSource %p: detached (%d players)"), &Source.Get(), Source->NumPlayers);
+            return;
+        }
+        const TSharedPtr<FFFmpegMediaSharedSource, ESPMode::ThreadSafe>* Found = Sources.Find(Source->Key);
+        if (Found && Found->Get() == &Source.Get()) {
+            Sources.Remove(Source->Key);
+        }
+    }
+    UE_LOG(LogFFmpegMedia, Log, TEXT("SharedSource %p: released"), &Source.Get());
+
+    bool Finished;
+    {
+        FScopeLock Lock(&Source->Mutex);
+        Source->Released = true;
+        Source->abort_request = 1;
+        Finished = Source->Finished;
+    }
+    if (Finished && Source->Tracks->GetState() != EMediaState::Closed) { //打开任务已经结束，在后台关闭轨道，否则由打开任务关闭
+        //媒体源中保存着上下文使用的中断标记，需要保留到上下文关闭
+        TSharedRef<FFFmpegMediaSharedSource, ESPMode::ThreadSafe> PinnedSource = Source;
+        Async(EAsyncExecution::ThreadPool, [PinnedSource]()
+        {
+            PinnedSource->Tracks->Shutdown();
+        });
+    }
+}
+
+int32 FFFmpegMediaSharedSource::GetNumSources()
+{
+    FScopeLock Lock(&SourcesMutex);
+    return Sources.Num();
+}
+
+bool FFFmpegMediaSharedSource::FinishOpen()
+{
+    FScopeLock Lock(&this->Mutex);
+    this->Finished = true;
+    return this->Released;
+}
+
+int32 FFFmpegMediaSharedSource::GetNumPlayers() const
+{
+    FScopeLock Lock(&SourcesMutex);
+    return this->NumPlayers;
+}
+
+FString FFFmpegMediaSharedSource::MakeKey(const FString& Url, const FFFmpegMediaOpenOptions& OpenOptions)
+{
+    //只包含影响解码结果和播放行为的选项，读取方式(内存映射、预读、磁盘缓存等)由第一个播放器决定
+    return Url + TEXT("|") + OpenOptions.GetDecodeKey();
+}
+
+bool FFFmpegMediaSharedSource::IsJoinable() const
+{
+    bool OpenFinished;
+    {
+        FScopeLock Lock(&this->Mutex);
+        if (this->Released) {
+            return false;
+        }
+        OpenFinished = this->Finished;
+    }
+    const EMediaState State = this->Tracks->GetState();
+    if (State == EMediaState::Error) {
+        return false;
+    }
+    if (State == EMediaState::Closed || State == EMediaState::Preparing) { //仍在打开
+        return !OpenFinished;
+    }
+    //时间轴可以加入: 循环播放、实时流(没有时长)或者还没有播放到结尾，新附加的播放器从当前位置开始播放
+    if (this->Tracks->IsLooping()) {
+        return true;
+    }
+    const FTimespan Duration = this->Tracks->GetDuration();
+    return Duration <= FTimespan::Zero() || this->Tracks->GetTime() < Duration;
+}
@@ -0,0 +1,70 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "FFmpegMediaTracks.h"
+#include "FFmpegMediaOptions.h"
+
+/**
+ * [Custom] 多个播放器共用的媒体源
+ * 打开同一个地址且选项相同的播放器附加到同一个轨道集合，解复用、解码和图像转换只执行一次，
+ * 解码出的样本(引用计数)放入每个播放器自己的样本队列，所有播放器释放之后才回到样本池
+ * 播放控制(播放、暂停、seek、速率、轨道选择)作用于共用的轨道，所有附加的播放器同步
+ * 注意打开任务和最后一个播放器的释放可能同时发生，与预打开一样由Mutex保证只有一方关闭轨道
+ */
+class FFFmpegMediaSharedSource
+{
+public:
+	/**
+	 * 查找可以附加的共享媒体源，没有时创建新的并注册
+	 * 已经出错、或者不循环且已经播放到结尾的媒体源不能附加，此时创建新的媒体源代替
+	 * @param Url 媒体地址
+	 * @param OpenOptions 打开选项，影响解码结果的选项相同时才能共用
+	 * @param bOutCreated 是否新创建，新创建时需要调用者打开
+	 */
+	static TSharedRef<FFFmpegMediaSharedSource, ESPMode::ThreadSafe> Acquire(const FString& Url, const FFFmpegMediaOpenOptions& OpenOptions, bool& bOutCreated);
+
+	/** 播放器不再使用，最后一个播放器释放时注销并在后台关闭轨道 */
+	static void Release(const TSharedRef<FFFmpegMediaSharedSource, ESPMode::ThreadSafe>& Source);
+
+	/** 当前注册的共享媒体源数量 */
+	static int32 GetNumSources();
+
+	/**
+	 * 打开任务结束时调用
+	 * @return 所有播放器都已经释放时返回true，此时需要由打开任务关闭轨道
+	 */
+	bool FinishOpen();
+
+	/** 使用的播放器数量 */
+	int32 GetNumPlayers() const;
+
+public:
+	/** 共用的轨道集合 */
+	TSharedRef<FFFmpegMediaTracks, ESPMode::ThreadSafe> Tracks = MakeShared<FFFmpegMediaTracks, ESPMode::ThreadSafe>();
+
+	/** 中断标记，用于interrupt_callback，保留到轨道关闭 */
+	int abort_request = 0;
+
+private:
+	/** 注册表中的键值，由地址和影响解码结果的选项组成 */
+	static FString MakeKey(const FString& Url, const FFFmpegMediaOpenOptions& OpenOptions);
+
+	/** 是否可以附加新的播放器 */
+	bool IsJoinable() const;
+
+private:
+	FString Key;
+
+	/** 使用的播放器数量(由注册表的锁保护) */
+	int32 NumPlayers = 0;
+
+	/** 打开任务是否已经结束 */
+	bool Finished = false;
+
+	/** 所有播放器是否已经释放 */
+	bool Released = false;
+
+	mutable FCriticalSection Mutex;
+};
@@ -57,6 +57,26 @@ public:
 		uint32 InStride,
 		FTimespan InTime,
 		FTimespan InDuration)
+	{
+		return Initialize(InBuffer, InSize, InDim, InDim, InStride, EMediaTextureSampleFormat::CharBGRA, InTime, InDuration);
+	}
+
+	/**
+	 * [Custom] Initialize the sample with the given format.
+	 * 按照指定格式初始化样本，比如常驻片段保存的NV12样本(缓冲高度是输出高度的1.5倍，由GPU转换成RGB)
+	 * @param InDim The sample buffer's width and height (in pixels).
+	 * @param InOutputDim The width and height of the output image.
+	 * @param InFormat The sample format.
+	 */
+	bool Initialize(
+		const void* InBuffer,
+		uint32 InSize,
+		const FIntPoint& InDim,
+		const FIntPoint& InOutputDim,
+		uint32 InStride,
+		EMediaTextureSampleFormat InFormat,
+		FTimespan InTime,
+		FTimespan InDuration)
 	{
 		//校验数据是否正确
 		if ((InBuffer == nullptr) || (InSize == 0) || (InStride == 0))
@@ -77,8 +97,9 @@ public:
 		Duration = InDuration;
 		//设置高度和宽度
 		Dim = InDim;
+		OutputDim = InOutputDim;
 		//设置样本格式
-		SampleFormat = EMediaTextureSampleFormat::CharBGRA;
+		SampleFormat = InFormat;
 		//设置每行像素字节数
 		Stride = InStride;
 		//设置显示时间(pts)
@@ -115,8 +136,7 @@ public:
 	/** 获取样本输出高度和宽度 */
 	virtual FIntPoint GetOutputDim() const override
 	{
-		//todo: 当前直接返回输入的高度和宽度
-		return Dim;
+		return OutputDim;
 	}
 
 	/** 获取每行像素字节数 */
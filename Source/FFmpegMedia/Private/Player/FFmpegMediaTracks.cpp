@@ -11,7 +11,11 @@
 #include "FFmpegMediaAudioSample.h"
 #include "FFmpegMediaTextureSample.h"
 #include "FFmpegMediaSettings.h"
+#include "FFmpegSidecarCache.h"
+#include "FFmpegIOSource.h"
+#include "FFmpegMediaPlayer.h"
 #include "MediaSamples.h"
+#include "Async/Async.h"
 
  /* Minimum SDL audio buffer size, in samples. */
 #define AUDIO_MIN_BUFFER_SIZE 512
@@ -21,15 +25,13 @@
 #define AUDIO_DIFF_AVG_NB   20
  /* no AV correction is done if too big error */
 #define MAX_QUEUE_SIZE (15 * 1024 * 1024)
+ /* 低延迟模式下的帧队列深度和样本队列中的音频样本数量 */
+#define LOW_LATENCY_PICTURE_QUEUE_SIZE 2
+#define LOW_LATENCY_SAMPLE_QUEUE_SIZE 3
+#define LOW_LATENCY_AUDIO_SAMPLES 2
 #define MIN_FRAMES 25
-#define EXTERNAL_CLOCK_MIN_FRAMES 2
-#define EXTERNAL_CLOCK_MAX_FRAMES 10
  /* polls for possible required screen refresh at least this often, should be less than 1/fps */
 #define REFRESH_RATE 0.01
- /* external clock speed adjustment constants for realtime sources based on buffer fullness */
-#define EXTERNAL_CLOCK_SPEED_MIN  0.900
-#define EXTERNAL_CLOCK_SPEED_MAX  1.010
-#define EXTERNAL_CLOCK_SPEED_STEP 0.001
  /* no AV sync correction is done if below the minimum AV sync threshold */
 #define AV_SYNC_THRESHOLD_MIN 0.04
 /* AV sync correction is done if above the maximum AV sync threshold */
@@ -39,6 +41,19 @@
 #define AV_SYNC_FRAMEDUP_THRESHOLD 0.1
  /* maximum audio speed change to get correct sync */
 #define SAMPLE_CORRECTION_PERCENT_MAX 10
+ /* while scrubbing, after no seek request for this long (in seconds) an accurate seek is done to the last position */
+#define SCRUB_SETTLE_TIME 0.15
+ /* minimum interval (in seconds) between key frames shown in thinned (fast forward/rewind) playback */
+#define THINNED_FRAME_INTERVAL 0.1
+ /* audio samples of a resident clip are sent this far (in seconds) ahead of the playback position */
+#define RESIDENT_AUDIO_LEAD 0.2
+/* 第一个流打开之后，等待其他预先打开的默认轨道被选择的最长时间(微秒)，避免丢掉这些流开头的数据包 */
+#define STREAM_SELECT_GRACE 100000
+/* 断线重连失败之后第一次等待的时间(微秒)，之后每次加倍 */
+#define RECONNECT_MIN_DELAY 100000
+/* 逐帧缓冲最多保存的帧数(大约一个GOP)和内存上限(MB)，1080p时受内存上限限制 */
+#define STEP_BUFFER_FRAMES 60
+#define STEP_BUFFER_MAX_MB 256
 
 
 #define LOCTEXT_NAMESPACE "FFmpegMediaTracks"
@@ -56,8 +71,10 @@ FFFmpegMediaTracks::FFFmpegMediaTracks()
     this->SelectedVideoTrack = INDEX_NONE;
    
     this->CurrentRate = 0.0f; //当前播放速率
+    this->TimelineOffset = FTimespan::Zero();
 
     this->ShouldLoop = false; //循环播放(注意该变量不需要重置)
+    this->AudioOnly = false; //纯音频模式
 
     this->displayRunning = false;
     this->displayThread = nullptr;
@@ -91,6 +108,85 @@ FFFmpegMediaTracks::FFFmpegMediaTracks()
      this->accurate_audio_seek_flag = 0; //精准音频seek标识
      this->accurate_video_seek_flag = 0; //精准视频seek标识
      this->accurate_subtitle_seek_flag = 0; //精准字幕seek标识
+     this->seek_accurate = 1;
+     this->seek_request_time = 0;
+     this->scrub_mode = 0;
+     this->scrubbing = 0;
+     this->scrub_target = 0;
+     this->last_seek_request_time = 0;
+     this->step = 0;
+     this->seek_latency_serial = -1;
+     this->seek_latency_start = 0;
+     this->seek_count = 0;
+     this->seek_coalesced_count = 0;
+     this->scrub_seek_count = 0;
+     this->scrub_settle_count = 0;
+     this->seek_latency_last = 0.0;
+     this->seek_latency_max = 0.0;
+     this->seek_latency_total = 0.0;
+     this->seek_latency_count = 0;
+     this->step_latency_start = 0;
+     this->step_request_count = 0;
+     this->step_cache_hits = 0;
+     this->step_latency_last = 0.0;
+     this->step_latency_max = 0.0;
+     this->open_stats = FFFmpegMediaOpenStats();
+     this->poster_pending = 0;
+     this->step_latency_total = 0.0;
+     this->step_latency_count = 0;
+     this->index_tid = nullptr;
+     this->index_seek_count = 0;
+     this->index_seek_frames = 0;
+     this->displayed_pts = NAN;
+     this->prefetch_backward = 0;
+     this->deferred_seek = 0;
+     this->deferred_seek_pos = 0;
+     this->prefetch_convert_ctx = NULL;
+     this->resident_convert_ctx = NULL;
+     this->playback_mode = PLAYBACK_MODE_NORMAL;
+     this->playback_mode_request = PLAYBACK_MODE_NORMAL;
+     this->gop_rate = 1.0;
+     this->reverse_gop_end = 0.0;
+     this->gop_eof = 0;
+     this->gop_end_sent = 0;
+     this->gop_next_time = 0.0;
+     this->gop_frame_count = 0;
+     this->trick_origin_pts = 0.0;
+     this->trick_origin_time = 0.0;
+     this->trick_last_pts = 0.0;
+     this->trick_hop_count = 0;
+     this->loop_offset = 0;
+     this->loop_end_time = 0.0;
+     this->loop_duration = 0.0;
+     this->loop_splice_count = 0;
+     this->loop_presented = 0;
+     this->loop_present_time = 0.0;
+     this->loop_present_duration = 0.0;
+     this->loop_gap_last = 0.0;
+     this->loop_gap_max = 0.0;
+     this->packet_cache_budget = 0;
+     this->packet_cache_global_budget = 0;
+     this->packet_cache_at_start = 1;
+     this->packet_cache_replay = 0;
+     this->packet_cache_replay_count = 0;
+     this->demux_read_count = 0;
+     this->packet_cache_dirty = false;
+     this->resident_enabled = 0;
+     this->resident_loop = 0;
+     this->resident_next_loop = 0;
+     this->resident_playing = 0;
+     this->resident_position = 0.0;
+     this->resident_origin_time = 0.0;
+     this->resident_video_index = -1;
+     this->resident_video_loop = 0;
+     this->resident_audio_time = 0.0;
+     this->audio_sent_time = NAN;
+     this->resident_frame_count = 0;
+     this->playback_speed = 1.0;
+     this->live_speed = 1.0;
+     this->render_speed = 1.0;
+     this->jitter_serial = -1;
+     this->audio_tempo_serial = -1;
      this->queue_attachments_req = 0;
      this->eof = 0;
      this->read_pause_return = 0;
@@ -126,6 +222,28 @@ FFFmpegMediaTracks::FFFmpegMediaTracks()
      this->frame_drops_late = 0; //统计视频播放时丢弃的帧数量
      this->frame_drops_early = 0;
 
+     //低延迟
+     this->low_latency = 0;
+     this->low_latency_wait_key = 0;
+     this->low_latency_target = 0.0;
+     this->low_latency_drops = 0;
+
+     //断线重连
+     this->reconnect_enabled = 0;
+     this->player_interrupt.callback = NULL;
+     this->player_interrupt.opaque = NULL;
+     this->stale_ic = NULL;
+     this->reconnect_count = 0;
+     this->reconnect_failures = 0;
+     this->reconnect_latency_last = 0.0;
+     this->reconnect_latency_max = 0.0;
+
+     this->shared = 0;
+     this->sink_peak = 0;
+     this->shared_video_samples = 0;
+     this->shared_video_deliveries = 0;
+     this->shared_dropped_samples = 0;
+
      this->frame_last_filter_delay = 0;
      this->LastFetchVideoTime = 0;
      this->avCodecHWConfig = nullptr;
@@ -143,7 +261,7 @@ FFFmpegMediaTracks::~FFFmpegMediaTracks()
 }
 
 /** 初始化 */
-void FFFmpegMediaTracks::Initialize(AVFormatContext* ic_, const FString& Url, const FMediaPlayerOptions* PlayerOptions)
+void FFFmpegMediaTracks::Initialize(AVFormatContext* ic_, const FString& Url, const FMediaPlayerOptions* PlayerOptions, const FFFmpegMediaOpenOptions& OpenOptions)
 {
     UE_LOG(LogFFmpegMedia, Verbose, TEXT("Tracks: %p: Initializing ..."), this);
 
@@ -175,28 +293,56 @@ void FFFmpegMediaTracks::Initialize(AVFormatContext* ic_, const FString& Url, co
     int startup_volume = 100; //声音范围 set startup volume 0=min 100=max
     unsigned  i;
 
-    /* start video display */
-    if (this->pictq.Init(&this->videoq, VIDEO_PICTURE_QUEUE_SIZE, 1) < 0) {  //初始化图片解码帧队列
-        UE_LOG(LogFFmpegMedia, Error, TEXT("Tracks: %p: Initialize fail, Because pictq init fail"), this);
-        goto fail;
+    //纯音频模式: 选项强制开启，或者媒体中没有需要显示的视频流和字幕流(比如带封面的mp3)
+    this->AudioOnly = OpenOptions.AudioOnly || !this->has_visual_streams(ic_);
+    if (this->AudioOnly) {
+        UE_LOG(LogFFmpegMedia, Log, TEXT("Tracks: %p: Audio only mode enabled (%s)"), this, OpenOptions.AudioOnly ? TEXT("option") : TEXT("auto"));
     }
-    UE_LOG(LogFFmpegMedia, Verbose, TEXT("Tracks: %p: Initializing pictq frame queue success"), this);
 
-    if (this->subpq.Init(&this->subtitleq, SUBPICTURE_QUEUE_SIZE, 0) < 0) { // //初始化字幕解码帧队列
-        UE_LOG(LogFFmpegMedia, Error, TEXT("Tracks: %p: Initialize fail, Because subpq init fail"), this);
-        goto fail;
+    const bool live_source = IsLiveSource(Url, ic_);
+    double jitter_target = (OpenOptions.JitterBufferTarget >= 0 ? OpenOptions.JitterBufferTarget : GetDefault<UFFmpegMediaSettings>()->JitterBufferTargetMs) / 1000.0;
+    double jitter_max_target = 0.0;
+
+    //低延迟模式: 选项强制开启，或者设置中开启并且是直播流
+    this->low_latency = OpenOptions.LowLatency || (GetDefault<UFFmpegMediaSettings>()->bLowLatencyLive && live_source);
+    this->low_latency_target = GetDefault<UFFmpegMediaSettings>()->LowLatencyTargetMs / 1000.0;
+    if (this->low_latency) {
+        UE_LOG(LogFFmpegMedia, Log, TEXT("Tracks: %p: Low latency mode enabled, target %.0f ms"), this, this->low_latency_target * 1000.0);
+        //缓存的时长超过low_latency_target时会丢弃数据，抖动缓冲的目标延迟保持在阈值以内
+        jitter_target = FFMIN(jitter_target, this->low_latency_target * 0.5);
+        jitter_max_target = this->low_latency_target * 0.8;
+    }
+
+    //实时流的抖动缓冲
+    this->jitter_buffer.Configure(live_source || this->low_latency ? jitter_target : 0.0, jitter_max_target, GetDefault<UFFmpegMediaSettings>()->JitterBufferMaxSpeedChange);
+    if (this->jitter_buffer.IsEnabled()) {
+        UE_LOG(LogFFmpegMedia, Log, TEXT("Tracks: %p: Jitter buffer enabled, target %.0f ms"), this, jitter_target * 1000.0);
+    }
+
+    /* start video display */
+    if (!this->AudioOnly) { //纯音频模式下不需要视频和字幕的帧队列
+        if (this->pictq.Init(&this->videoq, this->low_latency ? LOW_LATENCY_PICTURE_QUEUE_SIZE : VIDEO_PICTURE_QUEUE_SIZE, 1) < 0) {  //初始化图片解码帧队列
+            UE_LOG(LogFFmpegMedia, Error, TEXT("Tracks: %p: Initialize fail, Because pictq init fail"), this);
+            goto fail;
+        }
+        UE_LOG(LogFFmpegMedia, Verbose, TEXT("Tracks: %p: Initializing pictq frame queue success"), this);
+
+        if (this->subpq.Init(&this->subtitleq, SUBPICTURE_QUEUE_SIZE, 0) < 0) { // //初始化字幕解码帧队列
+            UE_LOG(LogFFmpegMedia, Error, TEXT("Tracks: %p: Initialize fail, Because subpq init fail"), this);
+            goto fail;
+        }
+        UE_LOG(LogFFmpegMedia, Verbose, TEXT("Tracks: %p: Initializing subpq frame queue success"), this);
     }
-    UE_LOG(LogFFmpegMedia, Verbose, TEXT("Tracks: %p: Initializing subpq frame queue success"), this);
 
-    if (this->sampq.Init(&this->audioq, SAMPLE_QUEUE_SIZE, 1) < 0) {   //初始化音频解码帧队列
+    if (this->sampq.Init(&this->audioq, this->low_latency ? LOW_LATENCY_SAMPLE_QUEUE_SIZE : SAMPLE_QUEUE_SIZE, 1) < 0) {   //初始化音频解码帧队列
         UE_LOG(LogFFmpegMedia, Error, TEXT("Tracks: %p: Initialize fail, Because sampq init fail"), this);
         goto fail;
     }
     UE_LOG(LogFFmpegMedia, Verbose, TEXT("Tracks: %p: Initializing audioq frame queue success"), this);
 
-    if (this->videoq.Init() < 0 ||
-    this->audioq.Init() < 0 ||
-    this->subtitleq.Init() < 0)
+    if (this->audioq.Init() < 0)
+        goto fail;
+    if (!this->AudioOnly && (this->videoq.Init() < 0 || this->subtitleq.Init() < 0))
         goto fail;
 
     UE_LOG(LogFFmpegMedia, Verbose, TEXT("Tracks: %p: Initializing videoq audioq subtitleq packet queue success"), this);
@@ -239,10 +385,35 @@ void FFFmpegMediaTracks::Initialize(AVFormatContext* ic_, const FString& Url, co
 
     this->max_frame_duration = (ic->iformat->flags & AVFMT_TS_DISCONT) ? 10.0 : 3600.0;  ////设置帧最大时长
 
+    //不等待UE选择轨道，先在工作线程中打开默认轨道的解码器
+    if (OpenOptions.PrepareCodecs) {
+        this->prepare_codecs();
+    }
+
+    //设置帧缓存大小，纯音频模式下不需要缓存
+    {
+        int32 FrameCacheSize = OpenOptions.FrameCacheSize >= 0 ? OpenOptions.FrameCacheSize : GetDefault<UFFmpegMediaSettings>()->FrameCacheSizeMB;
+        this->frame_cache.SetBudget(this->AudioOnly ? 0 : (int64)FrameCacheSize * 1024 * 1024);
+        //较短的循环片段常驻内存
+        this->resident_enabled = OpenOptions.ResidentClip && !this->AudioOnly && GetDefault<UFFmpegMediaSettings>()->ResidentClipMaxDuration > 0.0f;
+        //循环播放的数据包缓存
+        int32 PacketCacheSize = OpenOptions.PacketCacheSize >= 0 ? OpenOptions.PacketCacheSize : GetDefault<UFFmpegMediaSettings>()->PacketCacheSizeMB;
+        this->packet_cache_budget = (int64)PacketCacheSize * 1024 * 1024;
+        this->packet_cache_global_budget = (int64)GetDefault<UFFmpegMediaSettings>()->PacketCacheBudgetMB * 1024 * 1024;
+    }
+
     //设置总时长
     //int64_t duration = ic->duration; //微秒us
     this->Duration = ic->duration *10; //转化必须乘以10，否则时间不对
     this->realtime = is_realtime(ic);
+
+    //实时流断线重连，自定义AVIO(http缓存、预读等)不支持
+    this->reconnect_enabled = OpenOptions.Reconnect && GetDefault<UFFmpegMediaSettings>()->bReconnectLive && live_source && !(ic->flags & AVFMT_FLAG_CUSTOM_IO);
+    if (this->reconnect_enabled) {
+        this->reconnect_url = Url;
+        this->reconnect_options = OpenOptions;
+        this->player_interrupt = ic->interrupt_callback;
+    }
     
     //this->MediaSamples->FlushSamples();
     DeferredEvents.Enqueue(EMediaEvent::MediaOpened); //发送事件，会触发SetRate(1.0f);
@@ -255,6 +426,9 @@ void FFFmpegMediaTracks::Initialize(AVFormatContext* ic_, const FString& Url, co
         goto fail;
     }
     UE_LOG(LogFFmpegMedia, Verbose, TEXT("Tracks: %p: start read thread[%d] success"), this, read_tid->GetThreadID());
+    if (OpenOptions.KeyframeIndex && !this->AudioOnly && !this->realtime) {
+        this->start_keyframe_index(Url);
+    }
     UE_LOG(LogFFmpegMedia, Log, TEXT("Tracks: %p: Initializing success"), this);
     return;
 fail:
@@ -270,6 +444,10 @@ void FFFmpegMediaTracks::Shutdown()
 
     /** 首选中断读取线程 */
     this->abort_request = 1;
+    //中断自定义数据源中阻塞的读取
+    if (this->ic && FFmpegIOSource::FromContext(this->ic->pb)) {
+        FFmpegIOSource::FromContext(this->ic->pb)->Abort();
+    }
     //中断displayThread线程
     this->displayRunning = false;
     //中断audioThread线程
@@ -278,6 +456,13 @@ void FFFmpegMediaTracks::Shutdown()
     if (this->read_tid != nullptr) {
         this->read_tid->WaitForCompletion();
     }
+    //关闭关键帧索引线程
+    if (this->index_tid != nullptr) {
+        this->index_tid->WaitForCompletion();
+        this->index_tid = nullptr;
+    }
+    //释放没有使用的预先打开的解码器
+    this->release_prepared_codecs();
 
     //关闭各个流
     /* close each stream */
@@ -289,25 +474,43 @@ void FFFmpegMediaTracks::Shutdown()
         this->stream_component_close(this->subtitle_stream);
 
     //avformat_close_input(&this->ic); //销毁上下文
-    if (this->ic) {
-        avformat_close_input(&ic);
-        this->ic = nullptr;
+    {
+        FScopeLock Lock(&CriticalSection); //QueryCacheState在锁内访问ic
+        if (this->ic) {
+            //自定义的AVIOContext(Archive和pak中的文件)需要单独释放
+            AVIOContext* pb = (this->ic->flags & AVFMT_FLAG_CUSTOM_IO) ? this->ic->pb : nullptr;
+            avformat_close_input(&ic);
+            this->ic = nullptr;
+            FFmpegIOSource::FreeContext(&pb);
+        }
+        if (this->stale_ic) { //重连之前的上下文
+            avformat_close_input(&this->stale_ic);
+        }
     }
 
     //销毁包队列
-    this->videoq.Destroy();
     this->audioq.Destroy();
-    this->subtitleq.Destroy();
-
     //销毁帧队列
     /* free all pictures */
-    this->pictq.Destory();
     this->sampq.Destory();
-    this->subpq.Destory();
+    if (!this->AudioOnly) { //纯音频模式下视频和字幕队列没有初始化
+        this->videoq.Destroy();
+        this->subtitleq.Destroy();
+        this->pictq.Destory();
+        this->subpq.Destory();
+    }
     if (img_convert_ctx != nullptr) {
         sws_freeContext(this->img_convert_ctx);
         this->img_convert_ctx = NULL;
     }
+    if (prefetch_convert_ctx != nullptr) {
+        sws_freeContext(this->prefetch_convert_ctx);
+        this->prefetch_convert_ctx = NULL;
+    }
+    if (resident_convert_ctx != nullptr) {
+        sws_freeContext(this->resident_convert_ctx);
+        this->resident_convert_ctx = NULL;
+    }
     //sws_freeContext(this->sub_convert_ctx);
 
     //销毁线程
@@ -320,6 +523,10 @@ void FFFmpegMediaTracks::Shutdown()
         audioRenderThread->WaitForCompletion();
         audioRenderThread = nullptr;
     }
+    //关闭倒放解码线程
+    this->gop_decoder.Stop();
+    this->gop_free_frames();
+    this->audio_tempo.Close();
 
     FScopeLock Lock(&CriticalSection);
     /************************* Player相关变量初始化 *********************************/
@@ -332,6 +539,12 @@ void FFFmpegMediaTracks::Shutdown()
     this->SelectedVideoTrack = INDEX_NONE;
 
     this->CurrentRate = 0.0f; //当前播放速率
+    this->TimelineOffset = FTimespan::Zero();
+    this->AudioOnly = false;
+    this->CoverArtSample.Reset();
+    this->frame_cache.Clear(); //缓存中的样本来自样本池，需要先释放
+    this->step_buffer.Clear();
+    this->resident_clip.Reset();
     this->AudioSamplePool->Reset();
     this->VideoSamplePool->Reset();
     this->AudioTracks.Empty();
@@ -356,6 +569,84 @@ void FFFmpegMediaTracks::Shutdown()
     this->accurate_audio_seek_flag = 0; //精准音频seek标识
     this->accurate_video_seek_flag = 0; //精准视频seek标识
     this->accurate_subtitle_seek_flag = 0; //精准字幕seek标识
+    this->seek_accurate = 1;
+    this->seek_request_time = 0;
+    this->scrub_mode = 0;
+    this->scrubbing = 0;
+    this->scrub_target = 0;
+    this->last_seek_request_time = 0;
+    this->step = 0;
+    this->seek_latency_serial = -1;
+    this->seek_latency_start = 0;
+    this->seek_count = 0;
+    this->seek_coalesced_count = 0;
+    this->scrub_seek_count = 0;
+    this->scrub_settle_count = 0;
+    this->seek_latency_last = 0.0;
+    this->seek_latency_max = 0.0;
+    this->seek_latency_total = 0.0;
+    this->seek_latency_count = 0;
+    this->step_latency_start = 0;
+    this->step_request_count = 0;
+    this->step_cache_hits = 0;
+    this->step_latency_last = 0.0;
+    this->step_latency_max = 0.0;
+    this->open_stats = FFFmpegMediaOpenStats();
+    this->poster_pending = 0;
+    this->step_latency_total = 0.0;
+    this->step_latency_count = 0;
+    this->keyframe_index.Reset();
+    this->index_seek_count = 0;
+    this->index_seek_frames = 0;
+    this->displayed_pts = NAN;
+    this->prefetch_backward = 0;
+    this->deferred_seek = 0;
+    this->deferred_seek_pos = 0;
+    this->playback_mode = PLAYBACK_MODE_NORMAL;
+    this->playback_mode_request = PLAYBACK_MODE_NORMAL;
+    this->gop_rate = 1.0;
+    this->reverse_gop_end = 0.0;
+    this->gop_eof = 0;
+    this->gop_end_sent = 0;
+    this->gop_next_time = 0.0;
+    this->gop_frame_count = 0;
+    this->trick_origin_pts = 0.0;
+    this->trick_origin_time = 0.0;
+    this->trick_last_pts = 0.0;
+    this->trick_hop_count = 0;
+    this->loop_offset = 0;
+    this->loop_end_time = 0.0;
+    this->loop_duration = 0.0;
+    this->loop_splice_count = 0;
+    this->loop_presented = 0;
+    this->loop_present_time = 0.0;
+    this->loop_present_duration = 0.0;
+    this->loop_gap_last = 0.0;
+    this->loop_gap_max = 0.0;
+    this->packet_cache_budget = 0;
+    this->packet_cache_global_budget = 0;
+    this->packet_cache_at_start = 1;
+    this->packet_cache_replay = 0;
+    this->packet_cache_replay_count = 0;
+    this->demux_read_count = 0;
+    this->packet_cache_dirty = false;
+    this->resident_enabled = 0;
+    this->resident_loop = 0;
+    this->resident_next_loop = 0;
+    this->resident_playing = 0;
+    this->resident_position = 0.0;
+    this->resident_origin_time = 0.0;
+    this->resident_video_index = -1;
+    this->resident_video_loop = 0;
+    this->resident_audio_time = 0.0;
+    this->audio_sent_time = NAN;
+    this->resident_frame_count = 0;
+    this->playback_speed = 1.0;
+    this->live_speed = 1.0;
+    this->render_speed = 1.0;
+    this->jitter_buffer.Configure(0.0, 0.0, 0.0);
+    this->jitter_serial = -1;
+    this->audio_tempo_serial = -1;
     this->queue_attachments_req = 0;
     this->eof = 0;
     this->read_pause_return = 0;
@@ -369,6 +660,22 @@ void FFFmpegMediaTracks::Shutdown()
     this->frame_drops_late = 0; //统计视频播放时丢弃的帧数量
     this->frame_drops_early = 0;
 
+    //低延迟
+    this->low_latency = 0;
+    this->low_latency_wait_key = 0;
+    this->low_latency_target = 0.0;
+    this->low_latency_drops = 0;
+
+    //断线重连
+    this->reconnect_enabled = 0;
+    this->reconnect_url = FString();
+    this->player_interrupt.callback = NULL;
+    this->player_interrupt.opaque = NULL;
+    this->reconnect_count = 0;
+    this->reconnect_failures = 0;
+    this->reconnect_latency_last = 0.0;
+    this->reconnect_latency_max = 0.0;
+
     this->frame_last_filter_delay = 0;
 
     this->last_vis_time = 0.0;
@@ -397,6 +704,14 @@ bool FFFmpegMediaTracks::AddStreamToTracks(uint32 StreamIndex, const FMediaPlaye
         return false;
     }
 
+    //纯音频模式下只保留音频流和封面图片
+    if (this->AudioOnly && MediaType != AVMEDIA_TYPE_AUDIO
+        && !(MediaType == AVMEDIA_TYPE_VIDEO && (StreamDescriptor->disposition & AV_DISPOSITION_ATTACHED_PIC))) {
+        UE_LOG(LogFFmpegMedia, Verbose, TEXT("Tracks %p: Ignore %s stream %i in audio only mode"), this, av_get_media_type_string(MediaType), StreamIndex);
+        OutInfo += TEXT("\tIgnored in audio only mode\n");
+        return false;
+    }
+
     //创建和添加轨道
     FTrack* Track = nullptr;
     int32 TrackIndex = INDEX_NONE;
@@ -452,9 +767,9 @@ bool FFFmpegMediaTracks::AddStreamToTracks(uint32 StreamIndex, const FMediaPlaye
                 (uint32)CodecParams->sample_rate, //音频采样率
                 CodecParams->ch_layout,           //音频通道布局
                 AV_SAMPLE_FMT_S16,                //音频采样格式(音频采样深度), 16bit通用标准，对于播放音频已经足够
-                (uint32)CodecParams->channels,    //音频通道数 
-                (uint32)av_samples_get_buffer_size(NULL, CodecParams->channels, 1, AV_SAMPLE_FMT_S16, 1),                                  //音频帧大小
-                (uint32)av_samples_get_buffer_size(NULL, CodecParams->channels, CodecParams->sample_rate, AV_SAMPLE_FMT_S16, 1),           //每秒字节数
+                (uint32)CodecParams->ch_layout.nb_channels, //音频通道数
+                (uint32)av_samples_get_buffer_size(NULL, CodecParams->ch_layout.nb_channels, 1, AV_SAMPLE_FMT_S16, 1),                                  //音频帧大小
+                (uint32)av_samples_get_buffer_size(NULL, CodecParams->ch_layout.nb_channels, CodecParams->sample_rate, AV_SAMPLE_FMT_S16, 1),           //每秒字节数
             },
             {0}
         };
@@ -515,6 +830,7 @@ int FFFmpegMediaTracks::DisplayThread()
     double remaining_time = 0.0; //播放下一帧需要等待的时间，单位秒
     //判断显示运行状态
     while (displayRunning) {
+        this->apply_render_speed(); //SetRate和抖动缓冲修改的速度在显示线程中生效
         //if (!this->MediaSamples->CanReceiveAudioSamples(1)) { //限制样本队列中的样本数量，防止样本过多造成内存占用率飙升
         //    av_usleep((int64_t)(REFRESH_RATE * 1000000.0)); //睡一会儿~~
         //    continue;
@@ -524,9 +840,18 @@ int FFFmpegMediaTracks::DisplayThread()
         if (remaining_time > 0.0)
             av_usleep((int64_t)(remaining_time * 1000000.0)); //睡眠一段时间，防止无意义的频繁调用
         remaining_time = REFRESH_RATE; //默认屏幕刷新率控制，REFRESH_RATE = 10ms
-        if (!this->paused || this->force_refresh) {
+        if (this->playback_mode != PLAYBACK_MODE_NORMAL) { //倒放和跳帧播放
+            gop_refresh(&remaining_time);
+        }
+        else if (this->resident_playing) { //从常驻片段播放
+            resident_refresh(&remaining_time);
+        }
+        else if (!this->paused || this->force_refresh || this->step) {
             video_refresh(&remaining_time);
         }
+        else if (this->poster_pending) { //暂停状态下先发送第一帧，不需要等到开始播放
+            video_poster();
+        }
     }
     UE_LOG(LogFFmpegMedia, Log, TEXT("Tracks: %p:  DisplayThread exit"), this);
     return 0;
@@ -536,10 +861,23 @@ int FFFmpegMediaTracks::DisplayThread()
 int FFFmpegMediaTracks::AudioRenderThread() {
     double remaining_time = 0.0;
     while (audioRunning) {
+        if (!this->displayRunning) { //没有视频时由音频渲染线程设置时钟速度
+            this->apply_render_speed();
+        }
+        if (this->playback_mode != PLAYBACK_MODE_NORMAL) { //倒放和跳帧播放时静音
+            av_usleep((int64_t)(REFRESH_RATE * 1000000.0));
+            continue;
+        }
+        if (this->resident_playing) { //从常驻片段播放时直接发送保存的样本
+            this->resident_render_audio();
+            av_usleep((int64_t)(REFRESH_RATE * 1000000.0));
+            continue;
+        }
         if (this->paused) { //添加是否停止判断
             continue;
         }
-        if (this->MediaSamples->CanReceiveAudioSamples(1)) { //限制样本队列中的样本数量，防止样本过多造成内存占用率飙升
+        if (this->can_receive_audio_samples() //限制样本队列中的样本数量，防止样本过多造成内存占用率飙升
+            && (!this->low_latency || this->num_audio_samples() < LOW_LATENCY_AUDIO_SAMPLES)) { //低延迟模式下只提前发送少量样本
             FTimespan duration = RenderAudio();
         }
         else {
@@ -579,6 +917,13 @@ FTimespan FFFmpegMediaTracks::RenderAudio()
         if (this->audio_buf != NULL) {
             FScopeLock Lock(&CriticalSection);
             const TSharedRef<FFFmpegMediaAudioSample, ESPMode::ThreadSafe> AudioSample = AudioSamplePool->AcquireShared();
+            //循环播放时转换成媒体时间(time是帧的结束时间，按照开始时间计算所在的循环)
+            double frame_start = time.GetTotalSeconds() - duration.GetTotalSeconds();
+            time -= FTimespan::FromSeconds(this->loop_index(frame_start) * this->loop_duration);
+            time += this->TimelineOffset;
+            if (!this->video_st) {
+                this->update_loop_stats(frame_start, duration.GetTotalSeconds());
+            }
             if (AudioSample->Initialize((uint8_t*)this->audio_buf, len1, audio_tgt.NumChannels, audio_tgt.SampleRate, time, duration))
             {
                 //将样本对象放入样本队列中
@@ -587,14 +932,23 @@ FTimespan FFFmpegMediaTracks::RenderAudio()
                     UE_LOG(LogFFmpegMedia, Log, TEXT("FFmpegMediaTracks%p, AudioSample Drop %s, %d, Serial:%d"), this, *AudioSample.Get().GetTime().Time.ToString(), AudioDropCounter.GetValue(), this->videoq.GetSerial());
                     return 0;
                 }*/
-                this->MediaSamples->AddAudio(AudioSample);
+                this->add_audio_sample(AudioSample);
+                if (!this->video_st) {
+                    this->update_first_frame();
+                }
+                this->audio_sent_time = frame_start + duration.GetTotalSeconds();
+                this->resident_on_audio(frame_start, duration.GetTotalSeconds(), len1, AudioSample);
+                if (!this->video_st) { //没有视频时以音频作为seek完成的标志
+                    this->update_seek_latency(this->audio_clock_serial);
+                }
                 UE_LOG(LogFFmpegMedia, VeryVerbose, TEXT("Tracks: %p, AudioSample Enqueue %s"), this, *AudioSample.Get().GetTime().Time.ToString());
             }
         }
     }
     /* Let's assume the audio driver that is used by SDL has two periods. */
     if (!isnan(this->audio_clock)) {
-        this->audclk.SetAt(this->audio_clock - (double)(2 * this->audio_hw_buf_size + this->audio_buf_size) / this->audio_tgt.BytesPerSec, this->audio_clock_serial, audio_callback_time / 1000000.0);
+        //缓存中的音频已经变速，换算成媒体时间需要乘以速率
+        this->audclk.SetAt(this->audio_clock - (double)(2 * this->audio_hw_buf_size + this->audio_buf_size) / this->audio_tgt.BytesPerSec * this->render_speed, this->audio_clock_serial, audio_callback_time / 1000000.0);
         this->extclk.SyncToSlave(&this->audclk);
     }
     return time;
@@ -629,11 +983,216 @@ void FFFmpegMediaTracks::GetEvents(TArray<EMediaEvent>& OutEvents)
     }
 }
 
+FFFmpegMediaTracksSink::FFFmpegMediaTracksSink()
+    : Samples(MakeUnique<FMediaSamples>())
+{
+}
+
+FFFmpegMediaTracksSink::~FFFmpegMediaTracksSink()
+{
+}
+
+/** 附加共享媒体源的播放器 */
+TSharedRef<FFFmpegMediaTracksSink, ESPMode::ThreadSafe> FFFmpegMediaTracks::AddSink()
+{
+    TSharedRef<FFFmpegMediaTracksSink, ESPMode::ThreadSafe> Sink = MakeShared<FFFmpegMediaTracksSink, ESPMode::ThreadSafe>();
+    bool opened;
+    {
+        FScopeLock Lock(&CriticalSection);
+        opened = this->CurrentState != EMediaState::Closed && this->CurrentState != EMediaState::Preparing && this->CurrentState != EMediaState::Error;
+    }
+
+    FScopeLock Lock(&this->SinksMutex);
+    //先把还没有取出的事件分发给已经附加的播放器，新附加的播放器只收到打开事件
+    EMediaEvent Event;
+    while (DeferredEvents.Dequeue(Event)) {
+        for (const auto& Other : this->sinks) {
+            Other->Events.Add(Event);
+        }
+    }
+    if (opened) { //已经打开，从当前位置开始播放，之后的样本直接放入新的样本队列
+        Sink->MediaSourceChanged = true;
+        Sink->SelectionChanged = true;
+        Sink->Events.Add(EMediaEvent::MediaOpened);
+    }
+    this->sinks.Add(Sink);
+    this->shared = 1;
+    this->sink_peak = FMath::Max(this->sink_peak, this->sinks.Num());
+    return Sink;
+}
+
+/** 移除附加的播放器 */
+void FFFmpegMediaTracks::RemoveSink(const TSharedPtr<FFFmpegMediaTracksSink, ESPMode::ThreadSafe>& Sink)
+{
+    FScopeLock Lock(&this->SinksMutex);
+    this->sinks.Remove(Sink);
+}
+
+int32 FFFmpegMediaTracks::GetNumSinks() const
+{
+    FScopeLock Lock(&this->SinksMutex);
+    return this->sinks.Num();
+}
+
+/** 分发并取出附加播放器的事件和标记 */
+void FFFmpegMediaTracks::GetSinkEvents(FFFmpegMediaTracksSink& Sink, bool& OutMediaSourceChanged, bool& OutSelectionChanged, TArray<EMediaEvent>& OutEvents)
+{
+    //取出标记之后再锁定SinksMutex，其他线程在CriticalSection内发送样本时也会锁定SinksMutex
+    bool source_changed, selection_changed;
+    {
+        FScopeLock Lock(&CriticalSection);
+        source_changed = this->MediaSourceChanged;
+        selection_changed = this->SelectionChanged;
+        this->MediaSourceChanged = false;
+        this->SelectionChanged = false;
+    }
+
+    FScopeLock Lock(&this->SinksMutex);
+    EMediaEvent Event;
+    while (DeferredEvents.Dequeue(Event)) {
+        for (const auto& Other : this->sinks) {
+            Other->Events.Add(Event);
+        }
+    }
+    for (const auto& Other : this->sinks) {
+        Other->MediaSourceChanged |= source_changed;
+        Other->SelectionChanged |= selection_changed;
+    }
+
+    OutMediaSourceChanged = Sink.MediaSourceChanged;
+    OutSelectionChanged = Sink.SelectionChanged;
+    Sink.MediaSourceChanged = false;
+    Sink.SelectionChanged = false;
+    OutEvents.Append(Sink.Events);
+    Sink.Events.Reset();
+}
+
+/** 共享媒体源打开失败 */
+void FFFmpegMediaTracks::NotifyOpenFailed()
+{
+    FScopeLock Lock(&CriticalSection);
+    this->CurrentState = EMediaState::Error;
+    DeferredEvents.Enqueue(EMediaEvent::MediaOpenFailed);
+}
+
+/** 发送视频样本，共享媒体源时同一个样本放入所有附加播放器的样本队列，所有播放器都释放之后才回到样本池 */
+void FFFmpegMediaTracks::add_video_sample(const TSharedRef<IMediaTextureSample, ESPMode::ThreadSafe>& Sample)
+{
+    if (!this->shared) {
+        this->MediaSamples->AddVideo(Sample);
+        return;
+    }
+    FScopeLock Lock(&this->SinksMutex);
+    for (const auto& Sink : this->sinks) {
+        //播放器没有及时取出样本(比如不再Tick)时丢弃，不等待它，其他播放器继续播放
+        if (!Sink->Samples->CanReceiveVideoSamples(1)) {
+            Sink->DroppedVideoSamples++;
+            this->shared_dropped_samples++;
+            continue;
+        }
+        Sink->Samples->AddVideo(Sample);
+        this->shared_video_deliveries++;
+    }
+    this->shared_video_samples++;
+}
+
+/** 发送音频样本 */
+void FFFmpegMediaTracks::add_audio_sample(const TSharedRef<IMediaAudioSample, ESPMode::ThreadSafe>& Sample)
+{
+    if (!this->shared) {
+        this->MediaSamples->AddAudio(Sample);
+        return;
+    }
+    FScopeLock Lock(&this->SinksMutex);
+    for (const auto& Sink : this->sinks) {
+        if (!Sink->Samples->CanReceiveAudioSamples(1)) {
+            Sink->DroppedAudioSamples++;
+            this->shared_dropped_samples++;
+            continue;
+        }
+        Sink->Samples->AddAudio(Sample);
+    }
+}
+
+int32 FFFmpegMediaTracks::num_audio_samples()
+{
+    if (!this->shared) {
+        return this->MediaSamples->NumAudio();
+    }
+    FScopeLock Lock(&this->SinksMutex);
+    int32 num = this->sinks.Num() > 0 ? MAX_int32 : 0;
+    for (const auto& Sink : this->sinks) {
+        num = FMath::Min(num, Sink->Samples->NumAudio());
+    }
+    return num;
+}
+
+int32 FFFmpegMediaTracks::num_video_samples()
+{
+    if (!this->shared) {
+        return this->MediaSamples->NumVideoSamples();
+    }
+    FScopeLock Lock(&this->SinksMutex);
+    int32 num = this->sinks.Num() > 0 ? MAX_int32 : 0;
+    for (const auto& Sink : this->sinks) {
+        num = FMath::Min(num, Sink->Samples->NumVideoSamples());
+    }
+    return num;
+}
+
+bool FFFmpegMediaTracks::can_receive_audio_samples()
+{
+    if (!this->shared) {
+        return this->MediaSamples->CanReceiveAudioSamples(1);
+    }
+    FScopeLock Lock(&this->SinksMutex);
+    //按照最快的播放器发送，样本队列已满的播放器在add_audio_sample中丢弃样本
+    for (const auto& Sink : this->sinks) {
+        if (Sink->Samples->CanReceiveAudioSamples(1)) {
+            return true;
+        }
+    }
+    return this->sinks.Num() == 0;
+}
+
 /** 设置播放速率 */
 bool FFFmpegMediaTracks::SetRate(float Rate)
 {
+    if (!FMath::IsNearlyZero(Rate) && !this->GetSupportedRates(EMediaRateThinning::Thinned).Contains(Rate)) {
+        UE_LOG(LogFFmpegMedia, Verbose, TEXT("Tracks %p: SetRate %f is not supported"), this, Rate);
+        return false;
+    }
     FScopeLock Lock(&CriticalSection);
+    //常驻播放时从当前位置重新计算，只支持正常速率
+    if (this->resident_playing) {
+        this->resident_position = this->resident_current_position();
+        this->resident_origin_time = 0.0;
+        if (!FMath::IsNearlyZero(Rate) && Rate != 1.0f) {
+            this->resident_exit();
+        }
+    }
     this->CurrentRate = Rate; //设置播放速率
+    //设置播放模式，暂停时保持原来的模式，由read_thread切换
+    if (!FMath::IsNearlyZero(Rate)) {
+        this->gop_rate = Rate;
+        if (FMath::Abs(Rate) > 4.0f) { //超过变速播放的范围，只显示关键帧
+            this->playback_mode_request = PLAYBACK_MODE_THINNED;
+        }
+        else if (Rate < 0.0f) {
+            this->playback_mode_request = PLAYBACK_MODE_REVERSE;
+        }
+        else {
+            this->playback_mode_request = PLAYBACK_MODE_NORMAL;
+        }
+        this->trick_origin_time = 0.0; //跳帧播放从最后的关键帧重新计算位置
+        if (this->continue_read_thread) {
+            this->continue_read_thread->signal();
+        }
+    }
+    //正向变速播放，时钟按照速率走，音频做变速不变调处理
+    if (Rate > 0.0f && Rate <= 4.0f && this->playback_speed != Rate) {
+        this->playback_speed = Rate; //显示线程在下一次刷新时设置时钟速度
+    }
 
     if (FMath::IsNearlyZero(Rate)) //接近于0，停止播放
     {
@@ -660,8 +1219,14 @@ bool FFFmpegMediaTracks::SetRate(float Rate)
             this->extclk.Set(this->extclk.Get(), this->extclk.GetSerial());
             UE_LOG(LogFFmpegMedia, Verbose, TEXT("Tracks %p: SetRate =1 this->paused %d"), this, 0);
             this->paused = 0;
+            this->step = 0; //播放时不需要逐帧显示
+            this->step_buffer.Clear(); //逐帧缓冲只在暂停时使用
+            if (this->deferred_seek) { //执行暂停时从缓存显示而推迟的seek
+                this->deferred_seek = 0;
+                this->stream_seek(this->deferred_seek_pos, 0, 0);
+            }
         }
-        if (this->eof) {
+        if (this->eof && Rate > 0.0f) {
             this->stream_seek(0, 0, 0);
         }
     }
@@ -923,6 +1488,23 @@ bool FFFmpegMediaTracks::SelectTrack(EMediaTrackType TrackType, int32 TrackIndex
 
     UE_LOG(LogFFmpegMedia, Verbose, TEXT("Tracks %p: Selecting %s track %i"), this, *MediaUtils::TrackTypeToString(TrackType), TrackIndex);
 
+    //预先打开的解码器还没有打开完成时先在锁外面等待，stream_component_open中取出时不再阻塞，等待期间其他线程可以访问轨道
+    {
+        int StreamIndex = INDEX_NONE;
+        {
+            FScopeLock Lock(&CriticalSection);
+            if (TrackType == EMediaTrackType::Audio && AudioTracks.IsValidIndex(TrackIndex)) {
+                StreamIndex = AudioTracks[TrackIndex].StreamIndex;
+            }
+            else if (TrackType == EMediaTrackType::Video && VideoTracks.IsValidIndex(TrackIndex)) {
+                StreamIndex = VideoTracks[TrackIndex].StreamIndex;
+            }
+        }
+        if (StreamIndex != INDEX_NONE) {
+            this->wait_prepared_codec(StreamIndex);
+        }
+    }
+
     FScopeLock Lock(&CriticalSection);
 
     int32* SelectedTrack = nullptr;
@@ -964,7 +1546,9 @@ bool FFFmpegMediaTracks::SelectTrack(EMediaTrackType TrackType, int32 TrackIndex
     if (*SelectedTrack != INDEX_NONE)
     {
         const int StreamIndex = (*Tracks)[*SelectedTrack].StreamIndex;
-        this->stream_component_close(StreamIndex);
+        if (!(this->AudioOnly && TrackType == EMediaTrackType::Video)) { //纯音频模式下封面图片没有打开解码器
+            this->stream_component_close(StreamIndex);
+        }
         UE_LOG(LogFFmpegMedia, Verbose, TEXT("Tracks %p: Disabled stream %i"), this, StreamIndex);
         *SelectedTrack = INDEX_NONE;
         SelectionChanged = true;
@@ -975,7 +1559,10 @@ bool FFFmpegMediaTracks::SelectTrack(EMediaTrackType TrackType, int32 TrackIndex
     if (TrackIndex != INDEX_NONE)
     {
         const int StreamIndex = (*Tracks)[TrackIndex].StreamIndex;
-        int ret = this->stream_component_open(StreamIndex);
+        //纯音频模式下视频轨道只有封面图片，直接解码显示，不需要解码线程和显示线程
+        int64_t open_start = av_gettime_relative();
+        int ret = (this->AudioOnly && TrackType == EMediaTrackType::Video) ? this->present_cover_art(StreamIndex) : this->stream_component_open(StreamIndex);
+        this->open_stats.CodecOpen += (av_gettime_relative() - open_start) / 1000.0;
        
         if (ret < 0)
         {
@@ -988,9 +1575,10 @@ bool FFFmpegMediaTracks::SelectTrack(EMediaTrackType TrackType, int32 TrackIndex
         *SelectedTrack = TrackIndex;
         SelectionChanged = true;
         this->currentOpenStreamNumber++;
+        this->packet_cache_dirty = true; //数据包缓存中没有新轨道的数据
         if (TrackType == EMediaTrackType::Video) {
             //开启显示线程
-            if (!displayRunning) {
+            if (!displayRunning && !this->AudioOnly) {
                 displayRunning = true;
                 displayThread = LambdaFunctionRunnable::RunThreaded("DisplayThread", [this]() {
                         DisplayThread();
@@ -1110,7 +1698,7 @@ bool FFFmpegMediaTracks::CanControl(EMediaControl Control) const
 FTimespan FFFmpegMediaTracks::GetDuration() const
 {
     //在read_thread中读取
-    return this->Duration;
+    return this->Duration + this->TimelineOffset;
 }
 
 float FFFmpegMediaTracks::GetRate() const
@@ -1134,15 +1722,24 @@ TRangeSet<float> FFFmpegMediaTracks::GetSupportedRates(EMediaRateThinning Thinni
     if (Thinning == EMediaRateThinning::Unthinned)
     {
         TRangeSet<float> Result;
-        //注意是半开半闭区间
-        Result.Add(TRange<float>(0.0f, 2.0f));
+        Result.Add(TRange<float>::Inclusive(0.0f, 0.0f)); //暂停
+        Result.Add(TRange<float>::Inclusive(0.25f, 4.0f)); //变速播放(音频变速不变调)
+        if (this->video_st && !this->AudioOnly) { //倒放
+            Result.Add(TRange<float>::Inclusive(-4.0f, -0.25f));
+        }
         return Result;
     }
     else
     {
         TRangeSet<float> Result;
-        //注意是半开半闭区间
-        Result.Add(TRange<float>(0.0f, 2.0f));
+        Result.Add(TRange<float>::Inclusive(0.0f, 0.0f)); //暂停
+        if (this->video_st && !this->AudioOnly) { //超过4倍时只显示关键帧(快进快退)
+            Result.Add(TRange<float>::Inclusive(0.25f, 64.0f));
+            Result.Add(TRange<float>::Inclusive(-64.0f, -0.25f));
+        }
+        else {
+            Result.Add(TRange<float>::Inclusive(0.25f, 4.0f));
+        }
         return Result;
     }
 }
@@ -1177,19 +1774,41 @@ bool FFFmpegMediaTracks::Seek(const FTimespan& Time)
         return false;
     }
 
-    if ((Time < FTimespan::Zero()) || (Time > Duration))
+    if ((Time < FTimespan::Zero()) || (Time > Duration + TimelineOffset))
     {
         UE_LOG(LogFFmpegMedia, Verbose, TEXT("Tracks %p: Invalid seek time %s (media duration is %s)"), this, *Time.ToString(), *Duration.ToString());
         return false;
     }
 
-    if (this->seek_req) {
-        UE_LOG(LogFFmpegMedia, Verbose, TEXT("Tracks %p: is seeking , please wait seek finish"), this);
-        return false;
+    //连续播放时只能在当前媒体内跳转，之前的媒体已经关闭
+    int64_t pos = FMath::Max(Time - TimelineOffset, FTimespan::Zero()).GetTicks() / 10; //需要跳转到位置
+    //从常驻片段播放时直接改变播放位置
+    if (this->resident_playing) {
+        int loop = this->loop_index(this->resident_current_position());
+        this->resident_position = pos / (double)AV_TIME_BASE + loop * this->loop_duration;
+        this->resident_origin_time = 0.0;
+        this->resident_audio_time = this->resident_position;
+        this->resident_show(this->resident_position, 1);
+        DeferredEvents.Enqueue(EMediaEvent::SeekCompleted);
+        return true;
     }
-
-    int64_t pos = Time.GetTicks() / 10; //需要跳转到位置
-    this->stream_seek(pos, 0, 0);
+    //暂停状态下目标帧已经在帧缓存中，直接显示
+    if (this->paused && this->serve_from_frame_cache(pos)) {
+        return true;
+    }
+    this->deferred_seek = 0;
+
+    //只有调用者通过SetScrubbing进入拖动状态时才只跳转到关键帧，停止拖动或者停顿之后再做一次精准seek
+    //程序中连续的seek请求(比如跳转到章节)仍然是精准seek
+    int accurate = 1;
+    if (this->scrub_mode) {
+        FScopeLock SeekLock(&SeekMutex);
+        this->scrubbing = 1;
+        this->scrub_target = pos;
+        this->last_seek_request_time = av_gettime_relative();
+        accurate = 0;
+    }
+    this->stream_seek(pos, 0, 0, accurate);
     if (CurrentState == EMediaState::Stopped) {
         SetRate(1.0f); //当处于停止状态时，重绕操作需要Resume
     }
@@ -1198,7 +1817,11 @@ bool FFFmpegMediaTracks::Seek(const FTimespan& Time)
 
 bool FFFmpegMediaTracks::SetLooping(bool Looping)
 {
+    FScopeLock Lock(&CriticalSection);
     this->ShouldLoop = Looping;
+    if (!Looping) { //不再循环时从当前位置继续解码，播放到结尾结束
+        this->resident_exit();
+    }
     return true;
 }
 
@@ -1230,18 +1853,30 @@ int FFFmpegMediaTracks::read_thread()
         infinite_buffer = 1; //实时流时不限制
     }
     UE_LOG(LogFFmpegMedia, Verbose, TEXT("Tracks: %p: ReadThread infinite_buffer %d"), this, infinite_buffer);
+    int64_t select_grace_end = -1; //等待其他默认轨道被选择的截止时间(微秒)，-1表示还没有流打开，0表示已经开始读取
     //循环读取数据包，并放入队列中去
     for (;;) {
         if (this->abort_request) {
             break;
         }
-        //todo: 有必要?
-        if (this->currentOpenStreamNumber < this->streamTotalNumber) {
+        //至少有一个流打开之后就开始读取，预先打开的默认轨道还没有被选择时最多再等待STREAM_SELECT_GRACE
+        if (this->currentOpenStreamNumber == 0) {
+            select_grace_end = -1;
             wait_mutex->Lock();
             continue_read_thread->waitTimeout(*wait_mutex, 10);
             wait_mutex->Unlock();
             continue;
         }
+        if (select_grace_end < 0) {
+            select_grace_end = av_gettime_relative() + STREAM_SELECT_GRACE;
+        }
+        if (select_grace_end > 0 && av_gettime_relative() < select_grace_end && this->has_prepared_codecs()) {
+            wait_mutex->Lock();
+            continue_read_thread->waitTimeout(*wait_mutex, 1);
+            wait_mutex->Unlock();
+            continue;
+        }
+        select_grace_end = 0; //只在开始读取之前等待
 
         //此处同步UE状态和ffmpeg状态，当播放器处于暂停状态和停止状态时，都将ffpemg停止状态设置成true
         //this->paused = this->CurrentState == EMediaState::Paused || this->CurrentState == EMediaState::Stopped;
@@ -1255,17 +1890,107 @@ int FFFmpegMediaTracks::read_thread()
             }
         }
 
+        //切换播放模式
+        if (this->playback_mode_request != this->playback_mode) {
+            this->playback_mode_switch();
+        }
+        if (this->playback_mode != PLAYBACK_MODE_NORMAL) { //倒放和跳帧播放时由read_thread挑选数据包交给GOP解码器
+            if (this->seek_req) { //seek之后从目标位置重新开始
+                FScopeLock SeekLock(&SeekMutex);
+                this->seek_req = 0;
+                this->scrubbing = 0;
+                this->gop_decoder.Stop();
+                this->gop_free_frames();
+                if (this->gop_decoder.Start(this->video_st, this->playback_mode == PLAYBACK_MODE_THINNED) < 0) {
+                    //与playback_mode_switch一样回到正向播放，保留seek请求，由正向播放跳转到目标位置
+                    UE_LOG(LogFFmpegMedia, Error, TEXT("Tracks %p: restart playback mode %d after seek fail"), this, this->playback_mode);
+                    this->playback_mode_request = this->playback_mode = PLAYBACK_MODE_NORMAL;
+                    this->eof = 0;
+                    this->seek_req = 1;
+                    continue;
+                }
+                double seek_time = this->seek_pos / (double)AV_TIME_BASE;
+                this->reverse_gop_end = seek_time + 0.001; //包含目标位置的帧
+                this->trick_origin_pts = seek_time;
+                this->trick_origin_time = av_gettime_relative() / 1000000.0;
+                this->trick_last_pts = this->gop_rate > 0 ? seek_time - 0.002 : seek_time + 0.002; //包含目标位置的关键帧
+                this->gop_eof = 0;
+                this->gop_end_sent = 0;
+                DeferredEvents.Enqueue(EMediaEvent::SeekCompleted);
+            }
+            if (this->playback_mode == PLAYBACK_MODE_REVERSE) {
+                ret = this->reverse_read_gop(pkt);
+            }
+            else {
+                //跳帧播放的位置跟随系统时间，暂停时不读取
+                ret = this->paused ? 0 : this->trick_read_keyframe(pkt);
+            }
+            if (ret <= 0) {
+                wait_mutex->Lock();
+                continue_read_thread->waitTimeout(*wait_mutex, 10);
+                wait_mutex->Unlock();
+            }
+            continue;
+        }
+
+        //从常驻片段播放时不需要读取
+        if (this->resident_playing && !this->seek_req) {
+            wait_mutex->Lock();
+            continue_read_thread->waitTimeout(*wait_mutex, 10);
+            wait_mutex->Unlock();
+            continue;
+        }
+
+        //停止拖动或者拖动时停顿(一段时间内没有新的seek请求)，对最后的位置做一次精准seek，不算作seek请求
+        if (this->scrubbing && !this->seek_req) {
+            FScopeLock SeekLock(&SeekMutex);
+            if (!this->seek_req && (av_gettime_relative() - this->last_seek_request_time) / 1000000.0 > SCRUB_SETTLE_TIME) {
+                this->scrubbing = 0;
+                this->scrub_settle_count++;
+                this->stream_seek(this->scrub_target, 0, 0, 1, 0);
+            }
+        }
+
         if (this->seek_req) {
-            int64_t seek_target = this->seek_pos; //seek目标位置
-            int64_t seek_min = this->seek_rel > 0 ? seek_target - this->seek_rel + 2 : INT64_MIN;
-            int64_t seek_max = this->seek_rel < 0 ? seek_target - this->seek_rel - 2 : INT64_MAX;
+            int64_t seek_target, seek_rel_, request_time;
+            int seek_flags_, accurate;
+            {
+                //取出当前请求之后立即清除标识，seek执行期间的新请求会在下次循环中执行
+                FScopeLock SeekLock(&SeekMutex);
+                seek_target = this->seek_pos; //seek目标位置
+                seek_rel_ = this->seek_rel;
+                seek_flags_ = this->seek_flags;
+                accurate = this->seek_accurate;
+                request_time = this->seek_request_time;
+                this->seek_req = 0;
+            }
+            int64_t seek_min = seek_rel_ > 0 ? seek_target - seek_rel_ + 2 : INT64_MIN;
+            int64_t seek_max = seek_rel_ < 0 ? seek_target - seek_rel_ - 2 : INT64_MAX;
             // FIXME the +-2 is due to rounding being not done in the correct direction in generation
             //      of the seek_pos/seek_rel variables
-            ret = avformat_seek_file(this->ic, -1, seek_min, seek_target, seek_max, this->seek_flags);
+            ret = AVERROR(ENOSYS);
+            if (!(seek_flags_ & AVSEEK_FLAG_BYTE)) { //优先使用关键帧索引跳转
+                ret = this->seek_by_keyframe_index(seek_target);
+            }
+            if (ret < 0) {
+                ret = avformat_seek_file(this->ic, -1, seek_min, seek_target, seek_max, seek_flags_);
+            }
             if (ret < 0) {
                 UE_LOG(LogFFmpegMedia, Error, TEXT("Tracks: %p: error while seeking"), this);
             }
             else {
+                this->loop_offset = 0; //seek之后读取的是原始时间戳
+                //seek之后从文件读取，没有录制完成的数据包缓存不完整
+                this->packet_cache_replay = 0;
+                this->packet_cache_at_start = 0;
+                if (this->packet_cache.IsRecording()) {
+                    this->packet_cache.Reset();
+                }
+                if (this->resident_clip.IsRecording()) { //录制的片段不完整，从下一次循环重新开始
+                    this->resident_clip.Reset();
+                }
+                this->resident_next_loop = 1;
+                this->resident_video_loop = 0;
                 if (this->audio_stream >= 0) {
                     this->audioq.Flush();
                 }
@@ -1276,21 +2001,32 @@ int FFFmpegMediaTracks::read_thread()
                     this->videoq.Flush();
                     //avcodec_flush_buffers(this->video_avctx);
                 }
-                if (this->seek_flags & AVSEEK_FLAG_BYTE) {
+                if (seek_flags_ & AVSEEK_FLAG_BYTE) {
                     this->extclk.Set(NAN, 0);
                 }
                 else {
                     this->extclk.Set(seek_target / (double)AV_TIME_BASE, 0);
                 }
 
-                this->accurate_seek_time = this->seek_pos / (double)AV_TIME_BASE;
-                this->accurate_audio_seek_flag = 1; //精准音频seek标识
-                this->accurate_video_seek_flag = 1; //精准视频seek标识
-                this->accurate_subtitle_seek_flag = 1; //精准字幕seek标识
+                //关键帧seek(拖动)时不丢弃目标位置之前的帧，直接显示最近的关键帧
+                this->accurate_seek_time = seek_target / (double)AV_TIME_BASE;
+                this->accurate_audio_seek_flag = accurate; //精准音频seek标识
+                this->accurate_video_seek_flag = accurate; //精准视频seek标识
+                this->accurate_subtitle_seek_flag = accurate; //精准字幕seek标识
+                if (!accurate) {
+                    this->scrub_seek_count++;
+                }
+                //暂停状态下需要显示seek之后的第一帧
+                if (this->paused && this->video_st) {
+                    this->step = 1;
+                }
+                //向后seek时缓存目标位置之前的帧，方便继续向后逐帧或者拖动
+                this->prefetch_backward = accurate && !isnan(this->displayed_pts) && this->accurate_seek_time < this->displayed_pts;
+                this->seek_latency_serial = this->video_st ? this->videoq.serial : this->audioq.serial;
+                this->seek_latency_start = request_time;
                 //this->MediaSamples->FlushSamples(); //手动清空样本
                 DeferredEvents.Enqueue(EMediaEvent::SeekCompleted); //发送Seek完成事件;
             }
-            this->seek_req = 0; //seek结束
             this->queue_attachments_req = 1;
             this->eof = 0;
         }
@@ -1329,19 +2065,22 @@ int FFFmpegMediaTracks::read_thread()
             (!this->audio_st || (this->auddec->GetFinished() == this->audioq.serial && this->sampq.NbRemaining() == 0)) &&
             (!this->video_st || (this->viddec->GetFinished() == this->videoq.serial && this->pictq.NbRemaining() == 0))) {
 
-            //等待样本读取完毕:
+            //等待样本读取完毕
+            bool drained;
             if (this->get_master_sync_type() == AV_SYNC_AUDIO_MASTER) { //音频等待读取完，音频速度快，没播放完样本数一定大于0
-                if (this->MediaSamples->NumAudio() != 0) {
-                    continue;
-                }
+                drained = this->num_audio_samples() == 0;
             }
             else {
-                if (LastFetchVideoTime < Duration.GetTotalSeconds()) { //视频等待读取完，视频速度慢，判断最后一个样本时间是否小于时长
-                    continue;
-                }
+                drained = this->num_video_samples() == 0;
+            }
+            if (!drained) {
+                wait_mutex->Lock();
+                continue_read_thread->waitTimeout(*wait_mutex, 10);
+                wait_mutex->Unlock();
+                continue;
             }
 
-            if (this->ShouldLoop) { //循环播放，直接seek
+            if (this->ShouldLoop) { //无法拼接时(比如不支持seek)，播放完毕之后再seek
                 DeferredEvents.Enqueue(EMediaEvent::PlaybackEndReached);
                 this->stream_seek(start_time != AV_NOPTS_VALUE ? start_time : 0, 0, 0);
             }
@@ -1354,9 +2093,21 @@ int FFFmpegMediaTracks::read_thread()
                 }
             }
         }
-        ret = av_read_frame(ic, pkt); //读取一个包
+        ret = this->read_packet(pkt); //读取一个包
         if (ret < 0) {
+            //实时流断线(服务器关闭连接、读取出错或者超时没有数据)时重新连接
+            if (this->reconnect_enabled && ret != AVERROR(EAGAIN) && !this->abort_request && !this->paused) {
+                if (this->reconnect(wait_mutex) == 0) {
+                    continue;
+                }
+                this->reconnect_enabled = 0; //无法重连时按照播放结束处理
+                ret = AVERROR_EOF;
+            }
             if ((ret == AVERROR_EOF || avio_feof(ic->pb)) && !this->eof) { //读取完毕处理
+                //循环播放时直接从头继续读取，队列中剩余的数据包保证播放不中断
+                if (this->ShouldLoop && infinite_buffer < 1 && this->loop_splice()) {
+                    continue;
+                }
                 if (this->video_stream >= 0)
                     this->videoq.PutNullpacket(pkt, this->video_stream);
                 if (this->audio_stream >= 0)
@@ -1385,6 +2136,26 @@ int FFFmpegMediaTracks::read_thread()
             av_q2d(ic->streams[pkt->stream_index]->time_base) -
             (double)(start_time != AV_NOPTS_VALUE ? start_time : 0) / 1000000
             <= ((double)duration / 1000000);
+        if (pkt_ts != AV_NOPTS_VALUE) {
+            AVRational tb = ic->streams[pkt->stream_index]->time_base;
+            if (this->loop_offset == 0) { //记录文件的结束时间，作为循环的时长
+                this->loop_end_time = FFMAX(this->loop_end_time, (pkt_ts + pkt->duration) * av_q2d(tb));
+            }
+            else { //循环拼接的数据包，时间戳接在上一次循环之后
+                int64_t offset = av_rescale_q(this->loop_offset, AV_TIME_BASE_Q, tb);
+                if (pkt->pts != AV_NOPTS_VALUE)
+                    pkt->pts += offset;
+                if (pkt->dts != AV_NOPTS_VALUE)
+                    pkt->dts += offset;
+            }
+        }
+        if (this->low_latency && this->low_latency_drop(pkt)) {
+            av_packet_unref(pkt);
+            continue;
+        }
+        if (this->jitter_buffer.IsEnabled()) {
+            this->update_jitter_buffer(pkt);
+        }
         if (pkt->stream_index == this->audio_stream && pkt_in_play_range) {
             this->audioq.Put(pkt);
         }
@@ -1407,61 +2178,1032 @@ int FFFmpegMediaTracks::read_thread()
 }
 
 /** seek 操作 */
-void FFFmpegMediaTracks::stream_seek(int64_t pos, int64_t rel, int by_bytes)
+void FFFmpegMediaTracks::stream_seek(int64_t pos, int64_t rel, int by_bytes, int accurate, int counted)
 {
-    if (!this->seek_req) { //判断当前是否已经存在seek操作
-        this->seek_pos = pos;
-        this->seek_rel = rel;
-        this->seek_flags &= ~AVSEEK_FLAG_BYTE;
-        if (by_bytes)
-            this->seek_flags |= AVSEEK_FLAG_BYTE;
-        this->seek_flags = AVSEEK_FLAG_BACKWARD;// 保证seek到ts一定在要精准seek时间之前，否则精准seek会出问题
-        this->seek_req = 1;
-        this->continue_read_thread->signal();
+    FScopeLock SeekLock(&SeekMutex);
+    if (counted && this->seek_req) { //已经存在未执行的seek操作，直接覆盖(后来者优先)
+        this->seek_coalesced_count++;
+    }
+    else if (counted) {
+        this->seek_count++;
     }
+    this->seek_pos = pos;
+    this->seek_rel = rel;
+    this->seek_flags = AVSEEK_FLAG_BACKWARD;// 保证seek到ts一定在要精准seek时间之前，否则精准seek会出问题
+    if (by_bytes)
+        this->seek_flags |= AVSEEK_FLAG_BYTE;
+    this->seek_accurate = accurate;
+    this->seek_request_time = av_gettime_relative();
+    this->seek_req = 1;
+    this->continue_read_thread->signal();
 }
 
-/** 打开指定的流 */
-int FFFmpegMediaTracks::stream_component_open(int stream_index)
+/** 设置拖动状态 */
+void FFFmpegMediaTracks::SetScrubbing(bool Scrubbing)
 {
-    const auto Settings = GetDefault<UFFmpegMediaSettings>(); //获取播放器配置
-
-    AVCodecContext* avctx; //codec上下文
-    const AVCodec* codec; //codec(解码器)
-    const AVDictionaryEntry* t = NULL; //键值对
-    int sample_rate; //采样率
-    AVChannelLayout ch_layout{}; //音频通道格式类型, av_channel_layout_default();
-    int ret = 0;
-    int lowres = 0; //todo 低分辨率，默认为0
-    int stream_lowres = lowres;
-    AVDictionary* opts = {};
+    FScopeLock Lock(&CriticalSection);
+    this->scrub_mode = Scrubbing ? 1 : 0;
+    if (!Scrubbing) {
+        //停止拖动时立即对最后的位置做精准seek(由read_thread执行)
+        FScopeLock SeekLock(&SeekMutex);
+        this->last_seek_request_time = 0;
+        if (this->scrubbing && this->continue_read_thread) {
+            this->continue_read_thread->signal();
+        }
+    }
+}
 
-    if (stream_index < 0 || stream_index >= (int)ic->nb_streams) //如果流索引小于0或者超过总数量，返回-1
-        return -1;
+/** 暂停状态下逐帧显示 */
+bool FFFmpegMediaTracks::StepFrames(int32 NumFrames)
+{
+    FScopeLock Lock(&CriticalSection);
+    if (!this->video_st || this->AudioOnly || !this->paused || this->playback_mode != PLAYBACK_MODE_NORMAL) {
+        UE_LOG(LogFFmpegMedia, Verbose, TEXT("Tracks %p: StepFrames is only supported while paused"), this);
+        return false;
+    }
+    if (NumFrames == 0) {
+        return true;
+    }
+    this->step_request_count++;
+    this->step_latency_start = av_gettime_relative();
+
+    //从常驻片段播放时直接显示片段中的帧
+    if (this->resident_playing) {
+        double position = this->resident_current_position();
+        int loop = this->loop_index(position);
+        int count = this->resident_clip.GetNumVideo();
+        int index = this->resident_clip.FindVideo(this->loop_media_time(position)) + NumFrames;
+        //超出片段范围时跳到相邻的循环
+        loop += (int)floor((double)index / count);
+        index = ((index % count) + count) % count;
+        double frame_time, frame_duration;
+        if (loop >= 0 && this->resident_clip.GetVideo(index, frame_time, frame_duration).IsValid()) {
+            this->resident_position = frame_time + loop * this->loop_duration;
+            this->resident_origin_time = 0.0;
+            this->resident_audio_time = this->resident_position;
+            this->resident_show(this->resident_position, 1);
+            this->step_cache_hits++;
+            this->update_step_latency();
+            return true;
+        }
+        return false;
+    }
 
-    avctx = avcodec_alloc_context3(NULL); //分配codec上下文对象
-    if (!avctx) {
-        UE_LOG(LogFFmpegMedia, VeryVerbose, TEXT("Tracks: %p: avcodec_alloc_context3 fail"), this);
-        return AVERROR(ENOMEM);
+    //向后逐帧，或者当前帧是从缓存显示的(解码器不在当前位置)，先在帧缓存和逐帧缓冲中查找目标帧
+    if (!isnan(this->displayed_pts) && (NumFrames < 0 || this->deferred_seek)) {
+        double pts;
+        TSharedPtr<IMediaTextureSample, ESPMode::ThreadSafe> Sample = this->frame_cache.FindRelative(this->displayed_pts, NumFrames, pts);
+        if (!Sample.IsValid()) {
+            //帧缓存关闭或者没有目标帧时，使用逐帧缓冲中当前GOP已经解码的帧
+            Sample = this->step_buffer.FindRelative(this->displayed_pts, NumFrames, pts);
+        }
+        if (Sample.IsValid()) {
+            this->add_video_sample(Sample.ToSharedRef());
+            this->displayed_pts = pts;
+            //解码状态仍然停留在原来的位置，恢复播放时再执行seek
+            this->deferred_seek = 1;
+            this->deferred_seek_pos = (int64_t)(pts * AV_TIME_BASE);
+            this->step_cache_hits++;
+            this->update_step_latency();
+            return true;
+        }
     }
 
-    ret = avcodec_parameters_to_context(avctx, ic->streams[stream_index]->codecpar); //从流中拷贝信息到codec上下文中
-    if (ret < 0)
-        goto fail;
-    avctx->pkt_timebase = ic->streams[stream_index]->time_base;
+    //向前逐帧时解码器已经在当前帧之后，依次取出帧队列中的帧
+    if (NumFrames > 0 && !this->deferred_seek) {
+        this->step += NumFrames;
+        return true;
+    }
 
-    codec = avcodec_find_decoder(avctx->codec_id); //查找codec
-    //此处删除了ffplay中强制指定编码器的相关代码
-    if (!codec) {
-        UE_LOG(LogFFmpegMedia, Warning, TEXT("Tracks: %p: No decoder could be found for codec %s"), this, avcodec_get_name(avctx->codec_id));
-        ret = AVERROR(EINVAL);
-        goto fail;
+    //缓存中没有目标帧，按照帧率计算目标位置做精准seek
+    //向后seek时从关键帧到目标位置之前的帧会放入逐帧缓冲(和开启的帧缓存)，之后在这个GOP中的向后逐帧可以直接显示
+    if (isnan(this->displayed_pts)) {
+        return false;
     }
+    AVRational frame_rate = av_guess_frame_rate(this->ic, this->video_st, NULL);
+    double duration = (frame_rate.num && frame_rate.den ? av_q2d({ frame_rate.den, frame_rate.num }) : 0.04);
+    double start_time = (this->ic->start_time != AV_NOPTS_VALUE ? this->ic->start_time : 0) / (double)AV_TIME_BASE;
+    //往前偏移半帧，避免时间戳误差跳过目标帧
+    double target = FFMAX(this->displayed_pts + (NumFrames - 0.5) * duration, start_time);
+    this->deferred_seek = 0;
+    this->stream_seek((int64_t)(target * AV_TIME_BASE), 0, 0);
+    return true;
+}
 
-    /**硬件编码处理开始 */
-    if (avctx->codec_type == AVMEDIA_TYPE_VIDEO && Settings->bUseHardwareAcceleratedCodecs) { //如果启用了硬件编码且是视频流
-        avCodecHWConfig = this->FindBestDeviceType(codec);
-        if (avCodecHWConfig != nullptr) {
+/** 预打开时准备第一帧 */
+bool FFFmpegMediaTracks::Prime()
+{
+    if (CurrentState == EMediaState::Error || !this->ic) {
+        return false;
+    }
+    //保持暂停，交换到播放器之后再开始播放，暂停事件不需要发送
+    this->SetRate(0.0f);
+    TArray<EMediaEvent> Events;
+    this->GetEvents(Events);
+    for (EMediaEvent Event : Events) {
+        if (Event != EMediaEvent::PlaybackSuspended) {
+            DeferredEvents.Enqueue(Event);
+        }
+    }
+    //与FMediaPlayerFacade::SelectDefaultTracks一样选择第一个音频和视频轨道，交换之后再次选择时不会重新打开
+    if (this->VideoTracks.Num() > 0) {
+        this->SelectTrack(EMediaTrackType::Video, 0);
+    }
+    if (this->AudioTracks.Num() > 0) {
+        this->SelectTrack(EMediaTrackType::Audio, 0);
+    }
+    return true;
+}
+
+/** 预打开的媒体是否已经解码出第一帧 */
+bool FFFmpegMediaTracks::IsPrimed()
+{
+    if (CurrentState == EMediaState::Error || !this->ic) {
+        return false;
+    }
+    if (this->video_st && !this->AudioOnly) {
+        return this->pictq.NbRemaining() > 0;
+    }
+    if (this->audio_st) {
+        return this->sampq.NbRemaining() > 0;
+    }
+    return this->CoverArtSample.IsValid();
+}
+
+/** 设置打开阶段的统计 */
+void FFFmpegMediaTracks::SetOpenStats(const FFFmpegMediaOpenStats& Stats)
+{
+    FScopeLock Lock(&CriticalSection);
+    this->open_stats = Stats;
+}
+
+/** 设置时间轴偏移 */
+void FFFmpegMediaTracks::SetTimelineOffset(FTimespan Offset)
+{
+    FScopeLock Lock(&CriticalSection);
+    this->TimelineOffset = Offset;
+}
+
+/** 发送视频样本 */
+void FFFmpegMediaTracks::publish_video_sample(const TSharedRef<FFFmpegMediaTextureSample, ESPMode::ThreadSafe>& Sample, double pts, double duration)
+{
+    this->add_video_sample(Sample);
+    this->update_first_frame();
+    this->poster_pending = 0;
+    if (!isnan(pts)) {
+        if (this->frame_cache_wanted()) {
+            this->frame_cache.Add(pts, duration, Sample);
+        }
+        if (this->step_buffer_wanted()) {
+            this->step_buffer.Add(pts, duration, Sample);
+        }
+        this->displayed_pts = pts;
+    }
+}
+
+/** 从帧缓存中显示目标帧 */
+bool FFFmpegMediaTracks::serve_from_frame_cache(int64_t pos)
+{
+    if (!this->video_st || !this->frame_cache.IsEnabled()) {
+        return false;
+    }
+    double time = pos / (double)AV_TIME_BASE;
+    TSharedPtr<IMediaTextureSample, ESPMode::ThreadSafe> Sample = this->frame_cache.Find(time);
+    if (!Sample.IsValid()) {
+        return false;
+    }
+    this->add_video_sample(Sample.ToSharedRef());
+    this->displayed_pts = (Sample->GetTime().Time - this->TimelineOffset).GetTotalSeconds();
+    //解码状态仍然停留在原来的位置，恢复播放时再执行seek
+    this->deferred_seek = 1;
+    this->deferred_seek_pos = pos;
+    DeferredEvents.Enqueue(EMediaEvent::SeekCompleted);
+    UE_LOG(LogFFmpegMedia, Verbose, TEXT("Tracks %p: seek to %.3f served from frame cache"), this, time);
+    return true;
+}
+
+/** 预取帧到帧缓存 */
+void FFFmpegMediaTracks::prefetch_to_frame_cache(AVFrame* frame, double pts, double duration)
+{
+    if (isnan(pts)) {
+        return;
+    }
+    bool to_cache = this->frame_cache_wanted() && !this->frame_cache.Contains(pts);
+    bool to_step = this->step_buffer_wanted() && !this->step_buffer.Contains(pts);
+    if (!to_cache && !to_step) {
+        return;
+    }
+    int pitch = 0;
+    if (convert_frame(frame, &this->prefetch_convert_ctx, this->PrefetchDataBuffer, &pitch) < 0) {
+        return;
+    }
+    const TSharedRef<FFFmpegMediaTextureSample, ESPMode::ThreadSafe> TextureSample = VideoSamplePool->AcquireShared();
+    FIntPoint Dim = { frame->width, frame->height };
+    if (TextureSample->Initialize(PrefetchDataBuffer.GetData(), PrefetchDataBuffer.Num(), Dim, pitch,
+        FTimespan::FromSeconds(pts) + this->TimelineOffset, FTimespan::FromSeconds(duration))) {
+        if (to_cache) {
+            this->frame_cache.Add(pts, duration, TextureSample);
+        }
+        if (to_step) {
+            this->step_buffer.Add(pts, duration, TextureSample);
+        }
+    }
+}
+
+/** 是否需要帧缓存 */
+bool FFFmpegMediaTracks::frame_cache_wanted() const
+{
+    return this->frame_cache.IsEnabled() && (this->paused || this->step > 0 || this->scrub_mode || this->scrubbing);
+}
+
+/** 是否需要逐帧缓冲 */
+bool FFFmpegMediaTracks::step_buffer_wanted() const
+{
+    return this->step_buffer.IsEnabled() && (this->paused || this->step > 0);
+}
+
+/** 切换播放模式 */
+void FFFmpegMediaTracks::playback_mode_switch()
+{
+    int mode = this->playback_mode_request;
+    double start_time = (this->ic->start_time != AV_NOPTS_VALUE ? this->ic->start_time : 0) / (double)AV_TIME_BASE;
+
+    //先退出倒放或者跳帧播放
+    if (this->playback_mode != PLAYBACK_MODE_NORMAL) {
+        UE_LOG(LogFFmpegMedia, Verbose, TEXT("Tracks %p: playback mode %d stop"), this, this->playback_mode);
+        this->playback_mode = PLAYBACK_MODE_NORMAL;
+        this->gop_decoder.Stop();
+        this->gop_free_frames();
+    }
+
+    if (mode != PLAYBACK_MODE_NORMAL) {
+        if (!this->video_st || this->gop_decoder.Start(this->video_st, mode == PLAYBACK_MODE_THINNED) < 0) {
+            UE_LOG(LogFFmpegMedia, Error, TEXT("Tracks %p: start playback mode %d fail"), this, mode);
+            this->playback_mode_request = mode = PLAYBACK_MODE_NORMAL;
+        }
+    }
+
+    if (mode == PLAYBACK_MODE_NORMAL) {
+        //从当前显示的帧继续正向播放
+        this->eof = 0;
+        if (!isnan(this->displayed_pts)) {
+            this->stream_seek((int64_t)(this->displayed_pts * AV_TIME_BASE), 0, 0);
+        }
+        return;
+    }
+
+    //清空正向播放的队列，序列号改变之后已经解码的帧会被丢弃
+    if (this->audio_stream >= 0) {
+        this->audioq.Flush();
+    }
+    if (this->subtitle_stream >= 0) {
+        this->subtitleq.Flush();
+    }
+    this->videoq.Flush();
+    //从当前显示的帧开始
+    double position;
+    if (!isnan(this->displayed_pts)) {
+        position = this->displayed_pts;
+    }
+    else {
+        position = this->gop_rate < 0 ? start_time + this->Duration.GetTotalSeconds() : start_time;
+    }
+    this->reverse_gop_end = position;
+    this->trick_origin_pts = position;
+    this->trick_origin_time = av_gettime_relative() / 1000000.0;
+    this->trick_last_pts = position;
+    this->gop_eof = 0;
+    this->gop_end_sent = 0;
+    this->gop_next_time = 0.0;
+    this->playback_mode = mode;
+    UE_LOG(LogFFmpegMedia, Verbose, TEXT("Tracks %p: playback mode %d start at %.3f"), this, mode, position);
+}
+
+/** 倒放时读取下一个GOP */
+int FFFmpegMediaTracks::reverse_read_gop(AVPacket* pkt)
+{
+    if (this->gop_eof || !this->gop_decoder.CanPushGop()) {
+        return 0;
+    }
+    AVRational tb = this->video_st->time_base;
+    double start_time = this->video_st->start_time != AV_NOPTS_VALUE ? this->video_st->start_time * av_q2d(tb) : 0.0;
+    double gop_end = this->reverse_gop_end;
+    if (gop_end <= start_time) {
+        this->gop_eof = 1;
+        return 0;
+    }
+
+    TArray<AVPacket*> Packets;
+    double gop_start = NAN;
+    double target = gop_end - 0.001; //GOP结束时间之前的位置
+    int ret = 0;
+    for (int retry = 0; retry < 8 && !this->abort_request; retry++) {
+        //跳转到目标位置之前的关键帧
+        FFmpegKeyframeEntry entry;
+        int frames = 0;
+        if (this->keyframe_index.IsReady() && this->keyframe_index.GetStreamIndex() == this->video_stream && this->keyframe_index.Find(target, entry, frames)) {
+            ret = avformat_seek_file(this->ic, this->video_stream, INT64_MIN, entry.Pts, entry.Pts, 0);
+        }
+        else {
+            int64_t ts = (int64_t)(target * AV_TIME_BASE);
+            ret = avformat_seek_file(this->ic, -1, INT64_MIN, ts, ts, 0);
+        }
+        if (ret < 0) {
+            break;
+        }
+
+        //读取结束时间之前的最后一个GOP
+        //开放GOP中下一个关键帧之后的B帧显示在结束时间之前(leading frames)，需要和下一个关键帧一起放入当前GOP才能解码
+        int next_gop = 0;
+        for (;;) {
+            ret = av_read_frame(this->ic, pkt);
+            if (ret < 0) {
+                ret = 0;
+                break;
+            }
+            if (pkt->stream_index != this->video_stream) {
+                av_packet_unref(pkt);
+                continue;
+            }
+            int64_t pts = pkt->pts != AV_NOPTS_VALUE ? pkt->pts : pkt->dts;
+            double t = pts != AV_NOPTS_VALUE ? pts * av_q2d(tb) : NAN;
+            if (next_gop && (isnan(t) || t >= gop_end - 0.0005)) { //下一个GOP中显示在结束时间之后的帧
+                av_packet_unref(pkt);
+                break;
+            }
+            if ((pkt->flags & AV_PKT_FLAG_KEY) && !isnan(t) && !next_gop) {
+                if (t >= gop_end - 0.0005) { //下一个GOP
+                    if (isnan(gop_start)) {
+                        av_packet_unref(pkt);
+                        break;
+                    }
+                    next_gop = 1;
+                    AVPacket* key_pkt = av_packet_alloc();
+                    av_packet_move_ref(key_pkt, pkt);
+                    Packets.Add(key_pkt);
+                    continue;
+                }
+                //seek的位置比需要的位置更靠前，丢弃前面的GOP
+                for (AVPacket*& p : Packets) {
+                    av_packet_free(&p);
+                }
+                Packets.Reset();
+                gop_start = t;
+            }
+            if (isnan(gop_start)) { //关键帧之前的数据包无法解码
+                av_packet_unref(pkt);
+                continue;
+            }
+            AVPacket* gop_pkt = av_packet_alloc();
+            av_packet_move_ref(gop_pkt, pkt);
+            Packets.Add(gop_pkt);
+        }
+        if (Packets.Num() > 0) {
+            break;
+        }
+        //seek到了结束时间之后的关键帧，往前多跳一些再试
+        gop_start = NAN;
+        if (target <= start_time) {
+            break;
+        }
+        target = FFMAX(target - (retry + 1), start_time);
+    }
+
+    if (Packets.Num() == 0) {
+        UE_LOG(LogFFmpegMedia, Verbose, TEXT("Tracks %p: reverse playback reach start (%d)"), this, ret);
+        this->gop_eof = 1;
+        return ret;
+    }
+    this->gop_decoder.PushGop(Packets, gop_start, gop_end);
+    this->reverse_gop_end = gop_start;
+    return 1;
+}
+
+/** 跳帧播放时读取下一个关键帧 */
+int FFFmpegMediaTracks::trick_read_keyframe(AVPacket* pkt)
+{
+    if (this->gop_eof || !this->gop_decoder.CanPushGop()) {
+        return 0;
+    }
+    AVRational tb = this->video_st->time_base;
+    double start_time = this->video_st->start_time != AV_NOPTS_VALUE ? this->video_st->start_time * av_q2d(tb) : 0.0;
+    double end_time = start_time + this->Duration.GetTotalSeconds();
+    int forward = this->gop_rate > 0;
+    double time = av_gettime_relative() / 1000000.0;
+
+    //速率改变或者暂停之后，从最后的关键帧重新计算位置
+    if (this->trick_origin_time <= 0.0) {
+        this->trick_origin_pts = this->trick_last_pts;
+        this->trick_origin_time = time;
+    }
+
+    //按照速率计算当前应该显示的位置，每次至少前进一个关键帧
+    double target = this->trick_origin_pts + this->gop_rate * (time - this->trick_origin_time);
+    if (forward) {
+        target = FFMAX(target, this->trick_last_pts + 0.001);
+        if (this->Duration > FTimespan::Zero() && target > end_time) {
+            this->gop_eof = 1;
+            return 0;
+        }
+    }
+    else {
+        target = FFMIN(target, this->trick_last_pts - 0.001);
+        if (this->trick_last_pts <= start_time + 0.001) {
+            this->gop_eof = 1;
+            return 0;
+        }
+        target = FFMAX(target, start_time);
+    }
+
+    //快进跳转到目标位置之后的关键帧，快退跳转到目标位置之前的关键帧
+    int ret;
+    FFmpegKeyframeEntry entry;
+    int frames = 0;
+    bool indexed = this->keyframe_index.IsReady() && this->keyframe_index.GetStreamIndex() == this->video_stream;
+    if (indexed && (forward ? this->keyframe_index.FindAfter(target, entry) : this->keyframe_index.Find(target, entry, frames))) {
+        ret = avformat_seek_file(this->ic, this->video_stream, INT64_MIN, entry.Pts, entry.Pts, 0);
+    }
+    else if (indexed && forward) { //索引中已经没有后面的关键帧
+        this->gop_eof = 1;
+        return 0;
+    }
+    else {
+        int64_t ts = (int64_t)(target * AV_TIME_BASE);
+        ret = forward ? avformat_seek_file(this->ic, -1, ts, ts, INT64_MAX, 0) : avformat_seek_file(this->ic, -1, INT64_MIN, ts, ts, 0);
+    }
+    if (ret < 0) {
+        if (forward) {
+            this->gop_eof = 1;
+        }
+        return ret;
+    }
+
+    //读取第一个满足条件的关键帧
+    double t = NAN;
+    for (;;) {
+        ret = av_read_frame(this->ic, pkt);
+        if (ret < 0) {
+            if (forward) {
+                this->gop_eof = 1;
+            }
+            return 0;
+        }
+        if (pkt->stream_index != this->video_stream || !(pkt->flags & AV_PKT_FLAG_KEY)) {
+            av_packet_unref(pkt);
+            continue;
+        }
+        int64_t pts = pkt->pts != AV_NOPTS_VALUE ? pkt->pts : pkt->dts;
+        t = pts != AV_NOPTS_VALUE ? pts * av_q2d(tb) : NAN;
+        if (isnan(t) || (forward && t < target - 0.0005)) { //seek的位置比需要的位置更靠前
+            av_packet_unref(pkt);
+            continue;
+        }
+        break;
+    }
+    if (!forward && t >= this->trick_last_pts - 0.0005) {
+        //前面没有更早的关键帧，等到目标位置继续往前之后再试
+        av_packet_unref(pkt);
+        return 0;
+    }
+
+    TArray<AVPacket*> Packets;
+    AVPacket* key_pkt = av_packet_alloc();
+    av_packet_move_ref(key_pkt, pkt);
+    Packets.Add(key_pkt);
+    this->gop_decoder.PushGop(Packets, t, t + 0.001);
+    this->trick_last_pts = t;
+    this->trick_hop_count++;
+    return 1;
+}
+
+/** 倒放和跳帧播放时显示下一帧 */
+void FFFmpegMediaTracks::gop_refresh(double* remaining_time)
+{
+    FScopeLock Lock(&GopMutex);
+    if (this->playback_mode == PLAYBACK_MODE_NORMAL || this->paused) {
+        return;
+    }
+    double time = av_gettime_relative() / 1000000.0;
+    if (time < this->gop_next_time) {
+        *remaining_time = FFMIN(*remaining_time, this->gop_next_time - time);
+        return;
+    }
+    while (this->gop_frames.Num() == 0) {
+        if (!this->gop_decoder.PopChunk(this->gop_frames)) {
+            //已经显示到开头或者结尾
+            if (this->gop_eof && this->gop_decoder.IsIdle() && !this->gop_end_sent) {
+                this->gop_end_sent = 1;
+                DeferredEvents.Enqueue(EMediaEvent::PlaybackEndReached);
+            }
+            return; //等待解码
+        }
+    }
+
+    AVFrame* frame = this->gop_frames.Pop();
+    AVRational frame_rate = av_guess_frame_rate(this->ic, this->video_st, NULL);
+    double duration = (frame_rate.num && frame_rate.den ? av_q2d({ frame_rate.den, frame_rate.num }) : 0.04);
+    double pts = frame->pts * av_q2d(this->video_st->time_base);
+    this->upload_frame(frame, pts, duration);
+    av_frame_free(&frame);
+    this->gop_frame_count++;
+
+    //落后太多时不再追赶
+    if (time - this->gop_next_time > AV_SYNC_THRESHOLD_MAX) {
+        this->gop_next_time = time;
+    }
+    if (this->playback_mode == PLAYBACK_MODE_THINNED) {
+        //跳帧播放时限制显示的帧率，CPU占用不随速率增加
+        this->gop_next_time += THINNED_FRAME_INTERVAL;
+    }
+    else {
+        this->gop_next_time += duration / FFMAX(fabs(this->gop_rate), 0.01);
+    }
+    *remaining_time = FFMIN(*remaining_time, FFMAX(this->gop_next_time - time, 0.0));
+}
+
+/** 释放正在显示的帧块 */
+void FFFmpegMediaTracks::gop_free_frames()
+{
+    FScopeLock Lock(&GopMutex);
+    for (AVFrame*& frame : this->gop_frames) {
+        av_frame_free(&frame);
+    }
+    this->gop_frames.Empty();
+}
+
+/** 循环播放时拼接文件开头 */
+bool FFFmpegMediaTracks::loop_splice()
+{
+    double start = (this->ic->start_time != AV_NOPTS_VALUE ? this->ic->start_time : 0) / (double)AV_TIME_BASE;
+    if (this->loop_duration <= 0.0) {
+        this->loop_duration = this->loop_end_time - start;
+        if (this->loop_duration <= 0.0) {
+            this->loop_duration = this->Duration.GetTotalSeconds();
+        }
+        if (this->loop_duration <= 0.0) {
+            return false;
+        }
+    }
+    if (this->packet_cache.IsRecording()) { //从文件开头读取到了结尾，数据包已经全部缓存
+        this->packet_cache.Finish();
+    }
+    if (this->packet_cache.IsReady()) { //直接从缓存回放，不再读取文件
+        this->packet_cache.Rewind();
+        this->packet_cache_replay = 1;
+        this->packet_cache_replay_count++;
+    }
+    else {
+        int64_t ts = (int64_t)(start * AV_TIME_BASE);
+        int ret = avformat_seek_file(this->ic, -1, INT64_MIN, ts, ts, 0);
+        if (ret < 0) {
+            UE_LOG(LogFFmpegMedia, Warning, TEXT("Tracks %p: loop splice seek fail (%d), fallback to seek after drain"), this, ret);
+            return false;
+        }
+        //从文件开头开始缓存数据包，之后的循环从缓存回放
+        this->packet_cache.Begin(this->packet_cache_budget, this->packet_cache_global_budget);
+    }
+    this->loop_offset += (int64_t)(this->loop_duration * AV_TIME_BASE);
+    this->loop_splice_count++;
+    UE_LOG(LogFFmpegMedia, Verbose, TEXT("Tracks %p: loop splice %d, duration %.3f"), this, this->loop_splice_count, this->loop_duration);
+    return true;
+}
+
+/** 读取数据包 */
+int FFFmpegMediaTracks::read_packet(AVPacket* pkt)
+{
+    if (this->packet_cache_dirty.exchange(false)) { //缓存中没有新选择轨道的数据包，丢弃缓存
+        this->packet_cache_at_start = 0;
+        if (this->packet_cache_replay) {
+            //从当前播放位置重新读取文件，seek在下一次循环中执行，并结束回放
+            if (!this->seek_req) {
+                this->stream_seek((int64_t)(this->loop_media_time(this->get_master_clock()) * AV_TIME_BASE), 0, 0, 1);
+            }
+            int ret = this->packet_cache.Read(pkt);
+            this->packet_cache.Reset();
+            return ret;
+        }
+        this->packet_cache.Reset();
+    }
+    if (this->packet_cache_replay) {
+        return this->packet_cache.Read(pkt);
+    }
+    if (!this->ic->pb && !(this->ic->iformat->flags & AVFMT_NOFILE)) { //重连失败之后旧的连接已经关闭
+        return AVERROR_EOF;
+    }
+    this->demux_read_count++;
+    int ret = av_read_frame(this->ic, pkt);
+    if (ret < 0) {
+        return ret;
+    }
+    if (this->packet_cache_at_start) { //打开之后从文件开头读取，已经设置循环播放时开始缓存
+        this->packet_cache_at_start = 0;
+        if (this->ShouldLoop) {
+            this->packet_cache.Begin(this->packet_cache_budget, this->packet_cache_global_budget);
+        }
+    }
+    if (this->packet_cache.IsRecording() && !this->packet_cache.Add(pkt)) {
+        UE_LOG(LogFFmpegMedia, Verbose, TEXT("Tracks %p: packet cache exceeds budget, disabled"), this);
+        this->packet_cache_budget = 0;
+    }
+    return ret;
+}
+
+/** 时间戳所在的循环 */
+int FFFmpegMediaTracks::loop_index(double pts) const
+{
+    if (this->loop_duration <= 0.0 || isnan(pts)) {
+        return 0;
+    }
+    double start = (this->ic->start_time != AV_NOPTS_VALUE ? this->ic->start_time : 0) / (double)AV_TIME_BASE;
+    //加上一点余量，避免时间戳误差导致循环开头的帧算到上一次循环中
+    return FFMAX(0, (int)floor((pts - start + 0.0005) / this->loop_duration));
+}
+
+/** 转换成媒体时间 */
+double FFFmpegMediaTracks::loop_media_time(double pts) const
+{
+    return pts - this->loop_index(pts) * this->loop_duration;
+}
+
+/** 统计循环切换 */
+void FFFmpegMediaTracks::update_loop_stats(double pts, double duration)
+{
+    if (isnan(pts)) {
+        return;
+    }
+    int loop = this->loop_index(pts);
+    double time = av_gettime_relative() / 1000000.0;
+    if (loop > this->loop_presented) {
+        //上一次循环的最后一帧显示完之后，到下一次循环的第一帧显示之间多出的间隔
+        if (this->loop_present_time > 0.0) {
+            this->loop_gap_last = FFMAX(time - this->loop_present_time - this->loop_present_duration / this->playback_speed, 0.0);
+            this->loop_gap_max = FFMAX(this->loop_gap_max, this->loop_gap_last);
+        }
+        DeferredEvents.Enqueue(EMediaEvent::PlaybackEndReached);
+        UE_LOG(LogFFmpegMedia, Verbose, TEXT("Tracks %p: loop %d presented, gap %.1f ms"), this, loop, this->loop_gap_last * 1000.0);
+    }
+    this->loop_presented = loop;
+    this->loop_present_time = time;
+    this->loop_present_duration = duration;
+}
+
+/** 是否可以使用常驻片段 */
+bool FFFmpegMediaTracks::resident_allowed() const
+{
+    return this->resident_enabled && this->ShouldLoop && this->video_st && !this->realtime
+        && this->playback_mode == PLAYBACK_MODE_NORMAL && this->playback_mode_request == PLAYBACK_MODE_NORMAL
+        && this->playback_speed == 1.0;
+}
+
+/** 开始录制常驻片段 */
+bool FFFmpegMediaTracks::resident_begin(int loop)
+{
+    const UFFmpegMediaSettings* Settings = GetDefault<UFFmpegMediaSettings>();
+    double duration = this->loop_duration > 0.0 ? this->loop_duration : this->Duration.GetTotalSeconds();
+    if (duration <= 0.0 || duration > Settings->ResidentClipMaxDuration) {
+        this->resident_next_loop = INT_MAX; //片段太长，不再尝试
+        return false;
+    }
+    int width = this->video_st->codecpar->width, height = this->video_st->codecpar->height;
+    if ((width & 1) || (height & 1)) { //NV12需要偶数的宽高
+        this->resident_next_loop = INT_MAX;
+        return false;
+    }
+    //按照保存的NV12图像(每像素1.5字节，行字节数按16对齐)和输出的音频格式估计需要的内存
+    AVRational frame_rate = av_guess_frame_rate(this->ic, this->video_st, NULL);
+    double fps = frame_rate.num && frame_rate.den ? av_q2d(frame_rate) : 25.0;
+    int64 bytes = (int64)Align(width, 16) * height * 3 / 2 * (int64)(ceil(fps * duration) + 2);
+    if (this->audio_st) {
+        bytes += (int64)(this->audio_tgt.BytesPerSec * (duration + 1.0));
+    }
+    this->resident_next_loop = loop + 1;
+    if (!this->resident_clip.Begin(bytes, (int64)Settings->ResidentClipBudgetMB * 1024 * 1024)) {
+        UE_LOG(LogFFmpegMedia, Verbose, TEXT("Tracks %p: resident clip needs %.1f MB, exceeds budget"), this, bytes / (1024.0 * 1024.0));
+        return false;
+    }
+    this->resident_loop = loop;
+    UE_LOG(LogFFmpegMedia, Verbose, TEXT("Tracks %p: resident clip recording loop %d, reserved %.1f MB"), this, loop, bytes / (1024.0 * 1024.0));
+    return true;
+}
+
+/** 把帧转换成常驻片段保存的NV12样本 */
+TSharedPtr<IMediaTextureSample, ESPMode::ThreadSafe> FFFmpegMediaTracks::resident_make_sample(AVFrame* frame, double pts, double duration)
+{
+    if (frame->width == 0 || frame->height == 0 || (frame->width & 1) || (frame->height & 1)) {
+        return nullptr;
+    }
+    this->resident_convert_ctx = sws_getCachedContext(this->resident_convert_ctx,
+        frame->width, frame->height, ConvertDeprecatedFormat((AVPixelFormat)frame->format),
+        frame->width, frame->height, AV_PIX_FMT_NV12, SWS_BICUBIC, NULL, NULL, NULL);
+    if (this->resident_convert_ctx == NULL) {
+        UE_LOG(LogFFmpegMedia, Error, TEXT("Tracks %p: cannot initialize the resident clip conversion context"), this);
+        return nullptr;
+    }
+
+    //Y平面之后紧接着交错的UV平面，缓冲高度是图像高度的1.5倍
+    int stride = Align(frame->width, 16);
+    TArray<uint8> buffer;
+    buffer.AddUninitialized(stride * frame->height * 3 / 2);
+    uint8_t* pixels[4] = { buffer.GetData(), buffer.GetData() + stride * frame->height, NULL, NULL };
+    int pitch[4] = { stride, stride, 0, 0 };
+    sws_scale(this->resident_convert_ctx, (const uint8_t* const*)frame->data, frame->linesize, 0, frame->height, pixels, pitch);
+
+    //常驻片段持有样本直到释放，不从样本池中获取
+    TSharedRef<FFFmpegMediaTextureSample, ESPMode::ThreadSafe> Sample = MakeShared<FFFmpegMediaTextureSample, ESPMode::ThreadSafe>();
+    FTimespan time = this->TimelineOffset + FTimespan::FromSeconds(this->loop_media_time(pts));
+    if (!Sample->Initialize(buffer.GetData(), buffer.Num(), FIntPoint(frame->width, frame->height * 3 / 2), FIntPoint(frame->width, frame->height),
+        stride, EMediaTextureSampleFormat::CharNV12, time, FTimespan::FromSeconds(duration))) {
+        return nullptr;
+    }
+    return Sample;
+}
+
+/** 显示视频帧之后录制常驻片段 */
+void FFFmpegMediaTracks::resident_on_video(AVFrame* frame, double pts, double duration)
+{
+    if (isnan(pts)) {
+        return;
+    }
+    int loop = this->loop_index(pts);
+    if (!this->resident_allowed()) {
+        if (this->resident_clip.IsRecording()) {
+            this->resident_clip.Reset();
+            this->resident_next_loop = loop + 1;
+        }
+        return;
+    }
+    if (this->resident_clip.IsRecording()) {
+        if (loop < this->resident_loop) { //音频已经开始录制下一次循环
+            return;
+        }
+        if (loop == this->resident_loop) {
+            TSharedPtr<IMediaTextureSample, ESPMode::ThreadSafe> Sample = this->resident_make_sample(frame, pts, duration);
+            if (!Sample.IsValid() || !this->resident_clip.AddVideo(this->loop_media_time(pts), duration, Sample.ToSharedRef())) {
+                UE_LOG(LogFFmpegMedia, Verbose, TEXT("Tracks %p: resident clip exceeds reserved memory"), this);
+                this->resident_clip.Reset();
+                this->resident_next_loop = INT_MAX;
+            }
+            return;
+        }
+        if (loop != this->resident_loop + 1 || this->loop_duration <= 0.0) {
+            this->resident_clip.Reset();
+            this->resident_next_loop = loop + 1;
+            return;
+        }
+        //显示到下一次循环，录制完成(音频领先于视频，已经录制完整)
+        this->resident_clip.Finish();
+        UE_LOG(LogFFmpegMedia, Verbose, TEXT("Tracks %p: resident clip ready, %s"), this, *this->resident_clip.GetStats());
+    }
+    if (this->resident_clip.IsReady()) {
+        //新的循环开始时切换到常驻播放，读取和解码线程空闲
+        if (loop != this->resident_video_loop) {
+            this->resident_playing = 1;
+            this->resident_position = pts;
+            this->resident_origin_time = this->paused ? 0.0 : av_gettime_relative() / 1000000.0;
+            this->resident_video_index = this->resident_clip.FindVideo(this->loop_media_time(pts));
+            this->resident_audio_time = !isnan(this->audio_sent_time) ? this->audio_sent_time : pts;
+            UE_LOG(LogFFmpegMedia, Verbose, TEXT("Tracks %p: resident playback start at loop %d"), this, loop);
+        }
+        this->resident_video_loop = loop;
+        return;
+    }
+    this->resident_video_loop = loop;
+    if (loop >= this->resident_next_loop && this->resident_begin(loop)) {
+        TSharedPtr<IMediaTextureSample, ESPMode::ThreadSafe> Sample = this->resident_make_sample(frame, pts, duration);
+        if (!Sample.IsValid() || !this->resident_clip.AddVideo(this->loop_media_time(pts), duration, Sample.ToSharedRef())) {
+            this->resident_clip.Reset();
+            this->resident_next_loop = INT_MAX;
+        }
+    }
+}
+
+/** 发送音频样本之后录制常驻片段 */
+void FFFmpegMediaTracks::resident_on_audio(double pts, double duration, int64 bytes, const TSharedRef<IMediaAudioSample, ESPMode::ThreadSafe>& Sample)
+{
+    if (isnan(pts) || !this->resident_allowed() || this->resident_clip.IsReady()) {
+        return;
+    }
+    int loop = this->loop_index(pts);
+    if (!this->resident_clip.IsRecording()) {
+        //音频领先于视频，一般由音频开始录制
+        if (loop < this->resident_next_loop || !this->resident_begin(loop)) {
+            return;
+        }
+    }
+    if (loop == this->resident_loop) {
+        this->resident_clip.AddAudio(this->loop_media_time(pts), duration, bytes, Sample);
+    }
+}
+
+/** 常驻播放的当前位置 */
+double FFFmpegMediaTracks::resident_current_position() const
+{
+    if (this->resident_origin_time <= 0.0 || this->paused) {
+        return this->resident_position;
+    }
+    return this->resident_position + av_gettime_relative() / 1000000.0 - this->resident_origin_time;
+}
+
+/** 常驻播放时显示帧 */
+void FFFmpegMediaTracks::resident_show(double position, int force)
+{
+    int loop = this->loop_index(position);
+    int index = this->resident_clip.FindVideo(this->loop_media_time(position));
+    double frame_time, frame_duration;
+    TSharedPtr<IMediaTextureSample, ESPMode::ThreadSafe> Sample = this->resident_clip.GetVideo(index, frame_time, frame_duration);
+    if (!Sample.IsValid() || (!force && index == this->resident_video_index && loop == this->resident_video_loop)) {
+        return;
+    }
+    this->add_video_sample(Sample.ToSharedRef());
+    this->displayed_pts = frame_time;
+    this->update_loop_stats(frame_time + loop * this->loop_duration, frame_duration);
+    this->resident_video_index = index;
+    this->resident_video_loop = loop;
+    this->resident_frame_count++;
+}
+
+/** 常驻播放时显示下一帧 */
+void FFFmpegMediaTracks::resident_refresh(double* remaining_time)
+{
+    FScopeLock Lock(&CriticalSection);
+    if (!this->resident_playing || this->paused) {
+        return;
+    }
+    if (this->resident_origin_time <= 0.0) {
+        this->resident_origin_time = av_gettime_relative() / 1000000.0;
+    }
+    double position = this->resident_current_position();
+    this->resident_show(position, 0);
+    //等待到下一帧的显示时间
+    double frame_time, frame_duration;
+    if (this->resident_clip.GetVideo(this->resident_video_index, frame_time, frame_duration).IsValid()) {
+        double next = frame_time + frame_duration - this->loop_media_time(position);
+        *remaining_time = FFMIN(*remaining_time, FFMAX(next, 0.0));
+    }
+}
+
+/** 常驻播放时发送音频样本 */
+void FFFmpegMediaTracks::resident_render_audio()
+{
+    FScopeLock Lock(&CriticalSection);
+    if (!this->resident_playing || this->paused || !this->audio_st || this->loop_duration <= 0.0) {
+        return;
+    }
+    double start = (this->ic->start_time != AV_NOPTS_VALUE ? this->ic->start_time : 0) / (double)AV_TIME_BASE;
+    double position = this->resident_current_position();
+    while (this->resident_audio_time <= position + RESIDENT_AUDIO_LEAD && this->can_receive_audio_samples()) {
+        int loop = this->loop_index(this->resident_audio_time);
+        int index = this->resident_clip.FindAudio(this->loop_media_time(this->resident_audio_time));
+        double sample_time, sample_duration;
+        TSharedPtr<IMediaAudioSample, ESPMode::ThreadSafe> Sample = this->resident_clip.GetAudio(index, sample_time, sample_duration);
+        if (!Sample.IsValid()) { //已经发送到片段结尾，从下一次循环的开头继续
+            this->resident_audio_time = start + (loop + 1) * this->loop_duration;
+            continue;
+        }
+        this->add_audio_sample(Sample.ToSharedRef());
+        this->resident_audio_time = sample_time + sample_duration + loop * this->loop_duration;
+    }
+}
+
+/** 退出常驻播放 */
+void FFFmpegMediaTracks::resident_exit()
+{
+    if (!this->resident_playing) {
+        return;
+    }
+    double position = this->resident_current_position();
+    this->resident_playing = 0;
+    this->resident_video_loop = 0; //seek之后从第0次循环开始计算
+    this->stream_seek((int64_t)(this->loop_media_time(position) * AV_TIME_BASE), 0, 0);
+    UE_LOG(LogFFmpegMedia, Verbose, TEXT("Tracks %p: resident playback stop at %.3f"), this, this->loop_media_time(position));
+}
+
+/** 读取或者在后台生成关键帧索引 */
+void FFFmpegMediaTracks::start_keyframe_index(const FString& Url)
+{
+    FString MediaPath = FFmpegSidecarCache::GetLocalPath(Url);
+    if (MediaPath.IsEmpty()) { //只支持本地文件
+        return;
+    }
+    this->index_tid = LambdaFunctionRunnable::RunThreaded(TEXT("KeyframeIndexThread"), [this, MediaPath] {
+        if (this->keyframe_index.Load(MediaPath)) {
+            UE_LOG(LogFFmpegMedia, Verbose, TEXT("Tracks %p: load keyframe index from cache, %d key frames"), this, this->keyframe_index.GetNum());
+            return;
+        }
+        this->keyframe_index.Build(MediaPath, &this->abort_request);
+    });
+    if (!this->index_tid) {
+        UE_LOG(LogFFmpegMedia, Warning, TEXT("Tracks %p: start keyframe index thread fail"), this);
+    }
+}
+
+/** 使用关键帧索引seek */
+int FFFmpegMediaTracks::seek_by_keyframe_index(int64_t seek_target)
+{
+    FFmpegKeyframeEntry entry;
+    int frames = 0;
+    int ret;
+    if (this->video_stream < 0 || !this->keyframe_index.IsReady() || this->keyframe_index.GetStreamIndex() != this->video_stream) {
+        return AVERROR(ENOSYS);
+    }
+    if (!this->keyframe_index.Find(seek_target / (double)AV_TIME_BASE, entry, frames)) {
+        return AVERROR(ENOSYS);
+    }
+
+    AVStream* st = this->ic->streams[this->video_stream];
+    //解复用器没有自己的索引(比如没有cues的mkv、ts)时，直接按字节位置跳转到关键帧，否则按关键帧的pts跳转
+    if (entry.Pos >= 0 && !(this->ic->iformat->flags & AVFMT_NO_BYTE_SEEK) && avformat_index_get_entries_count(st) == 0) {
+        ret = avformat_seek_file(this->ic, -1, entry.Pos, entry.Pos, entry.Pos, AVSEEK_FLAG_BYTE);
+    }
+    else {
+        ret = avformat_seek_file(this->ic, this->video_stream, INT64_MIN, entry.Pts, entry.Pts, 0);
+    }
+    if (ret < 0) {
+        UE_LOG(LogFFmpegMedia, Verbose, TEXT("Tracks %p: seek by keyframe index fail, fallback"), this);
+        return ret;
+    }
+    this->index_seek_count++;
+    this->index_seek_frames = frames;
+    UE_LOG(LogFFmpegMedia, Verbose, TEXT("Tracks %p: seek by keyframe index to %.3f, about %d frames to decode"), this, this->keyframe_index.ToSeconds(entry.Pts), frames);
+    return ret;
+}
+
+/** 统计第一帧耗时 */
+void FFFmpegMediaTracks::update_first_frame()
+{
+    if (this->open_stats.StartTime > 0 && this->open_stats.FirstFrame == 0.0) {
+        this->open_stats.FirstFrame = (av_gettime_relative() - this->open_stats.StartTime) / 1000.0;
+        UE_LOG(LogFFmpegMedia, Verbose, TEXT("Tracks %p: first frame after %.1f ms"), this, this->open_stats.FirstFrame);
+    }
+}
+
+/** 统计逐帧延迟 */
+void FFFmpegMediaTracks::update_step_latency()
+{
+    if (this->step_latency_start <= 0) {
+        return;
+    }
+    double latency = (av_gettime_relative() - this->step_latency_start) / 1000000.0;
+    this->step_latency_start = 0;
+    this->step_latency_last = latency;
+    this->step_latency_max = FFMAX(this->step_latency_max, latency);
+    this->step_latency_total += latency;
+    this->step_latency_count++;
+    UE_LOG(LogFFmpegMedia, Verbose, TEXT("Tracks %p: step to display latency %.1f ms"), this, latency * 1000.0);
+}
+
+/** 统计seek延迟 */
+void FFFmpegMediaTracks::update_seek_latency(int serial)
+{
+    if (this->seek_latency_serial < 0 || serial != this->seek_latency_serial) {
+        return;
+    }
+    double latency = (av_gettime_relative() - this->seek_latency_start) / 1000000.0;
+    this->seek_latency_serial = -1;
+    this->seek_latency_last = latency;
+    this->seek_latency_max = FFMAX(this->seek_latency_max, latency);
+    this->seek_latency_total += latency;
+    this->seek_latency_count++;
+    UE_LOG(LogFFmpegMedia, Verbose, TEXT("Tracks %p: seek to display latency %.1f ms"), this, latency * 1000.0);
+}
+
+/** 创建并打开解码器上下文(不启动解码线程，可以在工作线程中调用) */
+int FFFmpegMediaTracks::open_codec_context(const AVCodecParameters* par, AVRational time_base, AVCodecContext** out)
+{
+    const auto Settings = GetDefault<UFFmpegMediaSettings>(); //获取播放器配置
+
+    AVCodecContext* avctx; //codec上下文
+    const AVCodec* codec; //codec(解码器)
+    const AVDictionaryEntry* t = NULL; //键值对
+    int ret = 0;
+    int lowres = 0; //todo 低分辨率，默认为0
+    int stream_lowres = lowres;
+    AVDictionary* opts = {};
+
+    *out = nullptr;
+    avctx = avcodec_alloc_context3(NULL); //分配codec上下文对象
+    if (!avctx) {
+        UE_LOG(LogFFmpegMedia, VeryVerbose, TEXT("Tracks: %p: avcodec_alloc_context3 fail"), this);
+        return AVERROR(ENOMEM);
+    }
+
+    ret = avcodec_parameters_to_context(avctx, par); //从流中拷贝信息到codec上下文中
+    if (ret < 0)
+        goto fail;
+    avctx->pkt_timebase = time_base;
+
+    codec = avcodec_find_decoder(avctx->codec_id); //查找codec
+    //此处删除了ffplay中强制指定编码器的相关代码
+    if (!codec) {
+        UE_LOG(LogFFmpegMedia, Warning, TEXT("Tracks: %p: No decoder could be found for codec %s"), this, avcodec_get_name(avctx->codec_id));
+        ret = AVERROR(EINVAL);
+        goto fail;
+    }
+
+    /**硬件编码处理开始 */
+    if (avctx->codec_type == AVMEDIA_TYPE_VIDEO && Settings->bUseHardwareAcceleratedCodecs) { //如果启用了硬件编码且是视频流
+        avCodecHWConfig = this->FindBestDeviceType(codec);
+        if (avCodecHWConfig != nullptr) {
             // 硬件解码器初始化
             AVBufferRef* hw_device_ctx = nullptr;
             ret = av_hwdevice_ctx_create(&hw_device_ctx, avCodecHWConfig->device_type, nullptr, nullptr, 0);
@@ -1490,31 +3232,159 @@ int FFFmpegMediaTracks::stream_component_open(int stream_index)
             }
         }
     }
-    /**硬件编码处理结束 */
+    /**硬件编码处理结束 */
+
+    avctx->codec_id = codec->id;
+    if (stream_lowres > codec->max_lowres) { //低分辨率不能超过codec的编码器
+        UE_LOG(LogFFmpegMedia, Warning, TEXT("Tracks: %p: The maximum value for lowres supported by the decoder is %d"), this, codec->max_lowres);
+        stream_lowres = codec->max_lowres;
+    }
+    avctx->lowres = stream_lowres;
+
+    if (Settings->bAllowFast)//非标准化规范的多媒体兼容优化
+        avctx->flags2 |= AV_CODEC_FLAG2_FAST;
+
+    if (this->low_latency) { //低延迟模式: 帧级多线程会延迟若干帧输出，改为片级多线程
+        avctx->flags |= AV_CODEC_FLAG_LOW_DELAY;
+        if (!av_dict_get(opts, "thread_type", NULL, 0))
+            av_dict_set(&opts, "thread_type", "slice", 0);
+    }
+    if (!av_dict_get(opts, "threads", NULL, 0))
+        av_dict_set(&opts, "threads", "auto", 0);
+    if (stream_lowres)
+        av_dict_set_int(&opts, "lowres", stream_lowres, 0);
+    if ((ret = avcodec_open2(avctx, codec, &opts)) < 0) { //打开codec
+        goto fail;
+    }
+    t = av_dict_get(opts, "", NULL, AV_DICT_IGNORE_SUFFIX);
+    if (t) {
+        //av_log(NULL, AV_LOG_ERROR, "Option %s not found.\n", t->key);
+        UE_LOG(LogFFmpegMedia, Error, TEXT("Tracks: %p: Option %s not found"), this, t->key);
+        ret = AVERROR_OPTION_NOT_FOUND;
+        goto fail;
+    }
+
+    *out = avctx;
+    av_dict_free(&opts);
+    return 0;
+
+fail:
+    avcodec_free_context(&avctx);
+    av_dict_free(&opts);
+    return ret;
+}
+
+/** 在工作线程中并行打开默认轨道的解码器 */
+void FFFmpegMediaTracks::prepare_codecs()
+{
+    TArray<int> Streams;
+    if (!this->AudioOnly && this->VideoTracks.Num() > 0) { //纯音频模式下视频轨道只有封面图片，不需要解码器
+        Streams.Add(this->VideoTracks[0].StreamIndex);
+    }
+    if (this->AudioTracks.Num() > 0) {
+        Streams.Add(this->AudioTracks[0].StreamIndex);
+    }
+
+    FScopeLock Lock(&this->prepared_mutex);
+    for (int StreamIndex : Streams) {
+        //拷贝一份编码参数，读取线程启动之后解复用器可能会修改流中的参数
+        AVCodecParameters* par = avcodec_parameters_alloc();
+        if (!par || avcodec_parameters_copy(par, this->ic->streams[StreamIndex]->codecpar) < 0) {
+            avcodec_parameters_free(&par);
+            continue;
+        }
+        AVRational time_base = this->ic->streams[StreamIndex]->time_base;
+        int64_t prepare_start = av_gettime_relative();
+        this->prepared_codecs.Add(StreamIndex, Async(EAsyncExecution::ThreadPool, [this, par, time_base, prepare_start, StreamIndex]() mutable {
+            AVCodecContext* avctx = nullptr;
+            int ret = this->open_codec_context(par, time_base, &avctx);
+            avcodec_parameters_free(&par);
+            double elapsed = (av_gettime_relative() - prepare_start) / 1000.0;
+            {
+                FScopeLock Lock(&this->prepared_mutex);
+                this->open_stats.CodecPrepare = FFMAX(this->open_stats.CodecPrepare, elapsed);
+            }
+            UE_LOG(LogFFmpegMedia, Verbose, TEXT("Tracks %p: prepared codec for stream %d in %.1f ms (%d)"), this, StreamIndex, elapsed, ret);
+            return avctx;
+        }).Share());
+    }
+}
+
+/** 取出预先打开的解码器，还没有打开完成时等待，没有时返回空 */
+AVCodecContext* FFFmpegMediaTracks::take_prepared_codec(int stream_index)
+{
+    TSharedFuture<AVCodecContext*> Future;
+    {
+        FScopeLock Lock(&this->prepared_mutex);
+        TSharedFuture<AVCodecContext*>* Found = this->prepared_codecs.Find(stream_index);
+        if (!Found) {
+            return nullptr;
+        }
+        Future = *Found;
+        this->prepared_codecs.Remove(stream_index);
+    }
+    AVCodecContext* avctx = Future.Get();
+    if (avctx) {
+        this->open_stats.CodecsPrepared++;
+    }
+    return avctx;
+}
+
+/** 等待预先打开的解码器打开完成 */
+void FFFmpegMediaTracks::wait_prepared_codec(int stream_index)
+{
+    TSharedFuture<AVCodecContext*> Future;
+    {
+        FScopeLock Lock(&this->prepared_mutex);
+        TSharedFuture<AVCodecContext*>* Found = this->prepared_codecs.Find(stream_index);
+        if (!Found) {
+            return;
+        }
+        Future = *Found;
+    }
+    Future.Wait();
+}
 
-    avctx->codec_id = codec->id;
-    if (stream_lowres > codec->max_lowres) { //低分辨率不能超过codec的编码器
-        UE_LOG(LogFFmpegMedia, Warning, TEXT("Tracks: %p: The maximum value for lowres supported by the decoder is %d"), this, codec->max_lowres);
-        stream_lowres = codec->max_lowres;
+/** 是否还有没有被选择的预先打开的解码器 */
+bool FFFmpegMediaTracks::has_prepared_codecs()
+{
+    FScopeLock Lock(&this->prepared_mutex);
+    return this->prepared_codecs.Num() > 0;
+}
+
+/** 释放没有使用的预先打开的解码器 */
+void FFFmpegMediaTracks::release_prepared_codecs()
+{
+    TMap<int, TSharedFuture<AVCodecContext*>> Prepared;
+    {
+        FScopeLock Lock(&this->prepared_mutex);
+        Prepared = MoveTemp(this->prepared_codecs);
+        this->prepared_codecs.Reset();
     }
-    avctx->lowres = stream_lowres;
+    for (auto& Pair : Prepared) {
+        AVCodecContext* avctx = Pair.Value.Get(); //等待工作线程结束
+        avcodec_free_context(&avctx);
+    }
+}
 
-    if (Settings->bAllowFast)//非标准化规范的多媒体兼容优化
-        avctx->flags2 |= AV_CODEC_FLAG2_FAST;
+/** 打开指定的流 */
+int FFFmpegMediaTracks::stream_component_open(int stream_index)
+{
+    AVCodecContext* avctx; //codec上下文
+    int sample_rate; //采样率
+    AVChannelLayout ch_layout{}; //音频通道格式类型, av_channel_layout_default();
+    int ret = 0;
+    AVDictionary* opts = {};
 
-    if (!av_dict_get(opts, "threads", NULL, 0))
-        av_dict_set(&opts, "threads", "auto", 0);
-    if (stream_lowres)
-        av_dict_set_int(&opts, "lowres", stream_lowres, 0);
-    if ((ret = avcodec_open2(avctx, codec, &opts)) < 0) { //打开codec
-        goto fail;
-    }
-    t = av_dict_get(opts, "", NULL, AV_DICT_IGNORE_SUFFIX);
-    if (t) {
-        //av_log(NULL, AV_LOG_ERROR, "Option %s not found.\n", t->key);
-        UE_LOG(LogFFmpegMedia, Error, TEXT("Tracks: %p: Option %s not found"), this, t->key);
-        ret = AVERROR_OPTION_NOT_FOUND;
-        goto fail;
+    if (stream_index < 0 || stream_index >= (int)ic->nb_streams) //如果流索引小于0或者超过总数量，返回-1
+        return -1;
+
+    //优先使用在工作线程中预先打开的解码器
+    avctx = this->take_prepared_codec(stream_index);
+    if (!avctx) {
+        ret = this->open_codec_context(ic->streams[stream_index]->codecpar, ic->streams[stream_index]->time_base, &avctx);
+        if (ret < 0)
+            return ret;
     }
 
     this->eof = 0;
@@ -1554,6 +3424,8 @@ int FFFmpegMediaTracks::stream_component_open(int stream_index)
         this->video_avctx = avctx;
         this->video_stream = stream_index;
         this->video_st = ic->streams[stream_index];
+        //逐帧缓冲按照BGRA帧大小保存大约一个GOP
+        this->step_buffer.SetBudget(FFMIN((int64)avctx->width * avctx->height * 4 * STEP_BUFFER_FRAMES, (int64)STEP_BUFFER_MAX_MB * 1024 * 1024));
         ret = this->viddec->Init(avctx, &this->videoq, this->continue_read_thread);
         if (ret < 0)
             goto fail;
@@ -1565,6 +3437,7 @@ int FFFmpegMediaTracks::stream_component_open(int stream_index)
             goto out;
         }*/
         this->queue_attachments_req = 1;
+        this->poster_pending = 1;
         break;
     case AVMEDIA_TYPE_SUBTITLE:
         UE_LOG(LogFFmpegMedia, Verbose, TEXT("Tracks %p: Enabled stream[subtitle] %i"), this, stream_index);
@@ -1623,6 +3496,11 @@ void FFFmpegMediaTracks::stream_component_close(int stream_index)
     case AVMEDIA_TYPE_VIDEO:
         this->viddec->Abort(&this->pictq);
         this->viddec->Destroy();
+        this->frame_cache.Clear(); //缓存的帧属于当前视频流
+        this->step_buffer.Clear();
+        this->resident_playing = 0;
+        this->resident_clip.Reset();
+        this->displayed_pts = NAN;
         break;
     case AVMEDIA_TYPE_SUBTITLE:
         this->subdec->Abort(&this->subpq);
@@ -1633,6 +3511,8 @@ void FFFmpegMediaTracks::stream_component_close(int stream_index)
     }
 
     ic->streams[stream_index]->discard = AVDISCARD_ALL;
+    //queued_range在锁内读取流，解码线程已经结束，这里加锁不会等待解码线程
+    FScopeLock Lock(&CriticalSection);
     switch (codecpar->codec_type) {
     case AVMEDIA_TYPE_AUDIO:
         this->audio_st = NULL;
@@ -1736,6 +3616,9 @@ int FFFmpegMediaTracks::video_thread()
         //精准seek控制
         if (this->accurate_video_seek_flag) {
             if (pts < this->accurate_seek_time) {
+                if (this->prefetch_backward) {
+                    this->prefetch_to_frame_cache(frame, pts, duration);
+                }
                 av_frame_unref(frame);
                 continue;
             }
@@ -1807,7 +3690,12 @@ int FFFmpegMediaTracks::subtitle_thread()
 }
 
 /** 判断是否为实时流 */
-int FFFmpegMediaTracks::is_realtime(AVFormatContext* s)
+bool FFFmpegMediaTracks::IsLiveSource(const FString& Url, const AVFormatContext* ic)
+{
+    return FFFmpegMediaOpenOptions::IsLiveUrl(Url) || (ic && is_realtime(ic));
+}
+
+int FFFmpegMediaTracks::is_realtime(const AVFormatContext* s)
 {
     if (!strcmp(s->iformat->name, "rtp")
         || !strcmp(s->iformat->name, "rtsp")
@@ -1861,23 +3749,174 @@ double FFFmpegMediaTracks::get_master_clock()
     return val;
 }
 
-/** 同步外部时钟 */
-void FFFmpegMediaTracks::check_external_clock_speed()
+/** 实时流的抖动缓冲 */
+void FFFmpegMediaTracks::update_jitter_buffer(const AVPacket* pkt)
 {
-    if ((this->video_stream >= 0 && this->videoq.nb_packets <= EXTERNAL_CLOCK_MIN_FRAMES) ||
-        (this->audio_stream >= 0 && this->audioq.nb_packets <= EXTERNAL_CLOCK_MIN_FRAMES)) {
-        this->extclk.SetSpeed(FFMAX(EXTERNAL_CLOCK_SPEED_MIN, this->extclk.GetSpeed() - EXTERNAL_CLOCK_SPEED_STEP));
+    //按照主时钟对应的流计算，有音频时使用音频，否则使用视频
+    AVStream* st = this->audio_st ? this->audio_st : this->video_st;
+    FFmpegPacketQueue& q = this->audio_st ? this->audioq : this->videoq;
+    if (!st)
+        return;
+    const double time = av_gettime_relative() / 1000000.0;
+    if (q.GetSerial() != this->jitter_serial) { //seek或者清空队列之后时间戳不连续，重新估计
+        this->jitter_buffer.Reset();
+        this->jitter_serial = q.GetSerial();
     }
-    else if ((this->video_stream < 0 || this->videoq.nb_packets > EXTERNAL_CLOCK_MAX_FRAMES) &&
-        (this->audio_stream < 0 || this->audioq.nb_packets > EXTERNAL_CLOCK_MAX_FRAMES)) {
-        this->extclk.SetSpeed(FFMIN(EXTERNAL_CLOCK_SPEED_MAX, this->extclk.GetSpeed() + EXTERNAL_CLOCK_SPEED_STEP));
+    if (pkt->stream_index == st->index) {
+        const int64_t ts = pkt->pts != AV_NOPTS_VALUE ? pkt->pts : pkt->dts;
+        if (ts != AV_NOPTS_VALUE)
+            this->jitter_buffer.OnPacket(ts * av_q2d(st->time_base), time);
     }
-    else {
-        double speed = this->extclk.GetSpeed();
-        if (speed != 1.0) {
-            this->extclk.SetSpeed(speed + EXTERNAL_CLOCK_SPEED_STEP * (1.0 - speed) / fabs(1.0 - speed));
+    //已经接收但是还没有播放的时长: 队列中最新的数据减去主时钟
+    double latency = NAN;
+    const int64_t end = q.GetEndPts();
+    const double clock = this->get_master_clock();
+    if (!this->paused && end != AV_NOPTS_VALUE && !isnan(clock))
+        latency = end * av_q2d(st->time_base) - clock;
+    //时钟由显示线程更新，这里只发布目标速度，不直接修改时钟
+    this->live_speed = this->jitter_buffer.Update(latency, time);
+}
+
+/** 断线重连 */
+int FFFmpegMediaTracks::reconnect(FCriticalSection* wait_mutex)
+{
+    const auto Settings = GetDefault<UFFmpegMediaSettings>();
+    const int64_t start = av_gettime_relative();
+    int64_t delay = RECONNECT_MIN_DELAY;
+    UE_LOG(LogFFmpegMedia, Warning, TEXT("Tracks: %p: Connection lost, reconnecting %s"), this, *this->reconnect_url);
+
+    //udp在本地端口上接收，旧的连接不释放端口时新的连接无法绑定，旧的上下文还要保留(其他线程可能还在访问流)，只关闭AVIO
+    if (this->reconnect_url.StartsWith(TEXT("udp://")) && this->ic->pb && !(this->ic->flags & AVFMT_FLAG_CUSTOM_IO)) {
+        FScopeLock Lock(&CriticalSection);
+        avio_closep(&this->ic->pb);
+    }
+
+    for (int attempt = 1; !this->abort_request; attempt++) {
+        if (Settings->ReconnectMaxAttempts > 0 && attempt > Settings->ReconnectMaxAttempts) {
+            UE_LOG(LogFFmpegMedia, Error, TEXT("Tracks: %p: Reconnect failed after %d attempts"), this, attempt - 1);
+            return AVERROR(ETIMEDOUT);
+        }
+
+        AVDictionary* format_opts = NULL;
+        AVFormatContext* context = avformat_alloc_context();
+        if (!context) {
+            return AVERROR(ENOMEM);
+        }
+        context->interrupt_callback.callback = reconnect_interrupt_cb;
+        context->interrupt_callback.opaque = this;
+        FFmpegMediaPlayer::SetFormatOptions(&format_opts, this->reconnect_url, this->reconnect_options);
+        int ret = avformat_open_input(&context, TCHAR_TO_UTF8(*this->reconnect_url), NULL, &format_opts); //失败时会释放context
+        av_dict_free(&format_opts);
+        if (ret >= 0) {
+            ret = avformat_find_stream_info(context, NULL);
+            if (ret < 0)
+                avformat_close_input(&context);
+        }
+
+        if (ret >= 0) {
+            //当前打开的流在新的上下文中编码参数必须相同，否则解码器和视频线程中保存的参数都无法继续使用
+            const int streams[] = { this->audio_stream, this->video_stream, this->subtitle_stream };
+            for (int stream_index : streams) {
+                if (stream_index >= 0 && (stream_index >= (int)context->nb_streams
+                    || !same_stream_parameters(this->ic->streams[stream_index], context->streams[stream_index]))) {
+                    UE_LOG(LogFFmpegMedia, Error, TEXT("Tracks: %p: Stream %d changed after reconnect, media must be reopened"), this, stream_index);
+                    avformat_close_input(&context);
+                    this->reconnect_failures++;
+                    return AVERROR(EINVAL);
+                }
+            }
+
+            {
+                FScopeLock Lock(&CriticalSection);
+                //其他线程可能还在访问旧的上下文和流，先保留到下一次重连或者关闭
+                if (this->stale_ic) {
+                    avformat_close_input(&this->stale_ic);
+                }
+                this->stale_ic = this->ic;
+                this->ic = context;
+                for (unsigned i = 0; i < this->ic->nb_streams; i++) {
+                    this->ic->streams[i]->discard = ((int)i == this->audio_stream || (int)i == this->video_stream || (int)i == this->subtitle_stream)
+                        ? AVDISCARD_DEFAULT : AVDISCARD_ALL;
+                }
+                if (this->audio_stream >= 0)
+                    this->audio_st = this->ic->streams[this->audio_stream];
+                if (this->video_stream >= 0)
+                    this->video_st = this->ic->streams[this->video_stream];
+                if (this->subtitle_stream >= 0)
+                    this->subtitle_st = this->ic->streams[this->subtitle_stream];
+                this->max_frame_duration = (this->ic->iformat->flags & AVFMT_TS_DISCONT) ? 10.0 : 3600.0;
+
+                //时间戳重新开始，清空队列之后解码器和时钟按照新的序列号重新开始
+                this->audioq.Flush();
+                if (!this->AudioOnly) {
+                    this->videoq.Flush();
+                    this->subtitleq.Flush();
+                }
+                this->extclk.Set(NAN, 0);
+                if (this->low_latency && this->video_st && !this->AudioOnly) {
+                    this->low_latency_wait_key = 1;
+                }
+                this->eof = 0;
+                this->last_paused = 0; //暂停时对新的连接重新发送暂停
+            }
+
+            this->reconnect_count++;
+            this->reconnect_latency_last = (av_gettime_relative() - start) / 1000000.0;
+            this->reconnect_latency_max = FFMAX(this->reconnect_latency_max, this->reconnect_latency_last);
+            UE_LOG(LogFFmpegMedia, Log, TEXT("Tracks: %p: Reconnected after %d attempts, %.1f ms"), this, attempt, this->reconnect_latency_last * 1000.0);
+            return 0;
+        }
+
+        this->reconnect_failures++;
+        UE_LOG(LogFFmpegMedia, Verbose, TEXT("Tracks: %p: Reconnect attempt %d failed (%d), retry in %d ms"), this, attempt, ret, (int)(delay / 1000));
+        //退避等待，关闭时立即退出
+        const int64_t wait_end = av_gettime_relative() + delay;
+        while (!this->abort_request && av_gettime_relative() < wait_end) {
+            wait_mutex->Lock();
+            this->continue_read_thread->waitTimeout(*wait_mutex, 10);
+            wait_mutex->Unlock();
         }
+        delay = FFMIN(delay * 2, (int64_t)FFMAX(Settings->ReconnectMaxDelayMs, 100) * 1000);
     }
+    return AVERROR_EXIT;
+}
+
+bool FFFmpegMediaTracks::same_stream_parameters(const AVStream* a, const AVStream* b)
+{
+    const AVCodecParameters* pa = a->codecpar;
+    const AVCodecParameters* pb = b->codecpar;
+    if (pa->codec_type != pb->codec_type || pa->codec_id != pb->codec_id)
+        return false;
+    if (av_cmp_q(a->time_base, b->time_base) != 0) //视频线程启动时保存了时间基
+        return false;
+    if (pa->codec_type == AVMEDIA_TYPE_VIDEO && (pa->width != pb->width || pa->height != pb->height || pa->format != pb->format))
+        return false;
+    if (pa->codec_type == AVMEDIA_TYPE_AUDIO && (pa->sample_rate != pb->sample_rate || pa->ch_layout.nb_channels != pb->ch_layout.nb_channels || pa->format != pb->format))
+        return false;
+    return pa->extradata_size == pb->extradata_size
+        && (pa->extradata_size == 0 || memcmp(pa->extradata, pb->extradata, pa->extradata_size) == 0);
+}
+
+int FFFmpegMediaTracks::reconnect_interrupt_cb(void* ctx)
+{
+    const FFFmpegMediaTracks* tracks = static_cast<const FFFmpegMediaTracks*>(ctx);
+    if (tracks->abort_request)
+        return 1;
+    if (tracks->player_interrupt.callback && tracks->player_interrupt.callback(tracks->player_interrupt.opaque))
+        return 1;
+    return 0;
+}
+
+/** 设置时钟速度 */
+void FFFmpegMediaTracks::apply_render_speed()
+{
+    const double speed = this->playback_speed * this->live_speed;
+    if (speed == this->render_speed)
+        return;
+    this->render_speed = speed;
+    this->audclk.SetSpeed(speed);
+    this->vidclk.SetSpeed(speed);
+    this->extclk.SetSpeed(speed);
 }
 
 /**是否有足够的包*/
@@ -1973,6 +4012,26 @@ int FFFmpegMediaTracks::audio_decode_frame(FTimespan& time, FTimespan& duration)
         resampled_data_size = data_size;
     }
 
+    //变速播放时对音频做变速不变调处理，速率为1时直接跳过
+    //抖动缓冲调整速度时滤镜一直保留，速度通过滤镜命令修改
+    if (this->render_speed != 1.0 || (this->jitter_buffer.IsEnabled() && this->audio_tempo.IsOpen())) {
+        if (this->audio_tempo.Configure(this->render_speed, this->audio_tgt.SampleRate, &this->audio_tgt.ChannelLayout, this->audio_tgt.Format) >= 0) {
+            if (af->serial != this->audio_tempo_serial) { //seek之后清空滤镜中缓存的数据
+                this->audio_tempo.Flush();
+                this->audio_tempo_serial = af->serial;
+            }
+            int nb_samples = resampled_data_size / (this->audio_tgt.ChannelLayout.nb_channels * av_get_bytes_per_sample(this->audio_tgt.Format));
+            int tempo_size = this->audio_tempo.Process(this->audio_buf, nb_samples, this->AudioTempoBuffer);
+            if (tempo_size >= 0) {
+                this->audio_buf = this->AudioTempoBuffer.GetData();
+                resampled_data_size = tempo_size;
+            }
+        }
+    }
+    else if (this->audio_tempo.GetTempo() != 1.0) {
+        this->audio_tempo.Close();
+    }
+
     audio_clock0 = this->audio_clock;
     /* update the audio clock with the pts */
     if (!isnan(af->pts))
@@ -2037,9 +4096,6 @@ void FFFmpegMediaTracks::video_refresh(double* remaining_time)
     double rdftspeed = 0.02;
     FFmpegFrame* sp, * sp2;
 
-    if (!this->paused && this->get_master_sync_type() == AV_SYNC_EXTERNAL_CLOCK && this->realtime)
-        this->check_external_clock_speed(); //同步外部时钟
-
     //if (!display_disable && is->show_mode != SHOW_MODE_VIDEO && is->audio_st) { 显示没有关闭 且 显示模式不是视频 且音频存在
     //!display_disable && is->show_mode != SHOW_MODE_VIDEO && 
     if (this->audio_st && show_pic) {//只有显示图片且音频存在时，才会直接显示 // 
@@ -2077,12 +4133,28 @@ void FFFmpegMediaTracks::video_refresh(double* remaining_time)
             if (lastvp->GetSerial() != vp->GetSerial())
                 this->frame_timer = av_gettime_relative() / 1000000.0; //设置当前帧显示的时间
 
-            if (this->paused)//暂停状态
+            if (this->paused && !this->step)//暂停状态
+                goto display;
+
+            if (this->paused) { //暂停状态下逐帧显示，不需要计算显示时间
+                this->pictq.GetMutex()->Lock();
+                if (!isnan(vp->pts)) {
+                    this->update_video_pts(vp->pts, vp->pos, vp->serial);
+                }
+                this->pictq.GetMutex()->Unlock();
+                this->pictq.Next();
+                this->step--;
+                if (this->step > 0) { //一次显示多帧时只显示最后一帧
+                    goto retry;
+                }
+                this->force_refresh = 1;
                 goto display;
+            }
 
             /* compute nominal last_duration */
             last_duration = vp_duration(lastvp, vp); //获取上一帧需要显示的时长
             delay = compute_target_delay(last_duration); //计算上一帧还需要播放的时长
+            delay /= this->render_speed; //变速播放时按照速率缩放帧间隔
 
             time = av_gettime_relative() / 1000000.0;
             if (time < this->frame_timer + delay) { //如果当前时刻<当前画面显示完成的时间，表示画面还在显示中，计算剩余时间
@@ -2104,7 +4176,7 @@ void FFFmpegMediaTracks::video_refresh(double* remaining_time)
             int framedrop = -1;//todo:
             if (this->pictq.NbRemaining() > 1) {
                 FFmpegFrame* nextvp = this->pictq.PeekNext();
-                duration = this->vp_duration(vp, nextvp);
+                duration = this->vp_duration(vp, nextvp) / this->render_speed;
                 //重要判断time > this->frame_timer + duration，检查播放的帧是否已经过期
                 if ((framedrop > 0 || (framedrop && this->get_master_sync_type() != AV_SYNC_VIDEO_MASTER)) && time > this->frame_timer + duration) {
                     this->frame_drops_late++;
@@ -2155,8 +4227,12 @@ void FFFmpegMediaTracks::video_refresh(double* remaining_time)
         }
     display:
         /* display picture 注意retry中force_refresh的控制，决定是否显示画面*/
-        if (this->force_refresh && this->pictq.GetRindexShown())
+        if (this->force_refresh && this->pictq.GetRindexShown()) {
             video_display();
+            if (this->paused && !this->step) {
+                this->update_step_latency();
+            }
+        }
     }
     this->force_refresh = 0; //重置强制刷新状态
 }
@@ -2375,6 +4451,7 @@ void FFFmpegMediaTracks::video_image_display()
         }
         vp->uploaded = 1;
         vp->flip_v = vp->frame->linesize[0] < 0;
+        this->update_seek_latency(vp->serial);
         //av_frame_unref(vp->frame);
     }
     else {
@@ -2383,18 +4460,77 @@ void FFFmpegMediaTracks::video_image_display()
 
 /** 上传图片 */
 int FFFmpegMediaTracks::upload_texture(FFmpegFrame* vp, AVFrame* frame)
+{
+    return this->upload_frame(frame, vp->GetPts(), vp->GetDuration());
+}
+
+/** 暂停状态下发送第一帧作为封面帧 */
+void FFFmpegMediaTracks::video_poster()
+{
+    if (!this->video_st || this->pictq.NbRemaining() < 1) {
+        return;
+    }
+    //只发送不出队，开始播放之后这一帧仍然按照正常的时间显示
+    FFmpegFrame* vp = this->pictq.Peek();
+    if (vp->GetSerial() != this->videoq.GetSerial()) {
+        return;
+    }
+    if (this->upload_texture(vp, vp->GetFrame()) >= 0 && this->open_stats.StartTime > 0 && this->open_stats.Poster == 0.0) {
+        this->open_stats.Poster = (av_gettime_relative() - this->open_stats.StartTime) / 1000.0;
+        UE_LOG(LogFFmpegMedia, Verbose, TEXT("Tracks %p: poster frame after %.1f ms"), this, this->open_stats.Poster);
+    }
+    this->poster_pending = 0;
+}
+
+/** 转换帧并发送纹理样本 */
+int FFFmpegMediaTracks::upload_frame(AVFrame* frame, double pts, double duration_)
+{
+    int pitch = 0;
+    int ret = convert_frame(frame, &this->img_convert_ctx, this->ImgaeCopyDataBuffer, &pitch);
+    if (ret < 0) {
+        return ret;
+    }
+
+    {
+        FScopeLock Lock(&CriticalSection);
+        //从纹理样本池中获取一个共享对象
+        const TSharedRef<FFFmpegMediaTextureSample, ESPMode::ThreadSafe> TextureSample
+            = VideoSamplePool->AcquireShared();
+        //根据帧初始化该对象
+        FIntPoint Dim = { frame->width, frame->height };
+        FTimespan time = this->TimelineOffset;
+        if (!isnan(pts)) {
+            time += FTimespan::FromSeconds(this->loop_media_time(pts)); //循环播放时转换成媒体时间
+        }
+        FTimespan duration = FTimespan::FromSeconds(duration_);
+        if (TextureSample->Initialize(
+            ImgaeCopyDataBuffer.GetData(),
+            ImgaeCopyDataBuffer.Num(),
+            Dim,
+            pitch,
+            time, //ps: 当只有视频时，视频的该值会当做播放时间，故会产生小于总时长1秒的情况，此处将时长与pts相加 duration
+            duration))
+        {
+            // 将样本对象放入样本队列中
+            // UE_LOG(LogFFmpegMedia, Verbose, TEXT("Tracks%p: VideoSampleQueue Enqueue %s %f"), this, *TextureSample.Get().GetTime().Time.ToString(), vp->GetDuration());
+            this->publish_video_sample(TextureSample, this->loop_media_time(pts), duration_);
+            this->update_loop_stats(pts, duration_);
+            this->resident_on_video(frame, pts, duration_);
+        }
+    }
+    return ret;
+}
+
+/** 将帧转化为BGRA图像 */
+int FFFmpegMediaTracks::convert_frame(AVFrame* frame, struct SwsContext** convert_ctx, TArray<uint8>& buffer, int* stride)
 {
     if (frame->width == 0 || frame->height == 0) {
         return -1;
     }
 
-    //目标图像格式, 将帧中的像素统一转化成该格式
-    AVPixelFormat targetPixelFormat = AV_PIX_FMT_RGBA;
-    int ret = 0;
-
     //生成转化上下文
-    img_convert_ctx = sws_getCachedContext(
-        this->img_convert_ctx, //
+    *convert_ctx = sws_getCachedContext(
+        *convert_ctx, //
         frame->width,  //输入图像的宽度
         frame->height, //输入图像的宽度
         ConvertDeprecatedFormat((AVPixelFormat)frame->format), //输入图像的像素格式
@@ -2407,60 +4543,114 @@ int FFFmpegMediaTracks::upload_texture(FFmpegFrame* vp, AVFrame* frame)
         NULL, //输出图像的滤波器信息, 若不需要传NULL
         NULL); //特定缩放算法需要的参数(? )，默认为NULL
 
-    if (img_convert_ctx != NULL) {
+    if (*convert_ctx == NULL) {
+        UE_LOG(LogFFmpegMedia, Error, TEXT("Cannot initialize the conversion context"));
+        return -1;
+    }
+
+    uint8_t* pixels[4] = { 0 };
+    int pitch[4] = { 0,0,0,0 };
+    int size = av_image_get_buffer_size(AV_PIX_FMT_BGRA, frame->width, frame->height, 1);
 
-        uint8_t* pixels[4] = { 0 };
-        int pitch[4] = { 0,0,0,0 };
-        int size = av_image_get_buffer_size(AV_PIX_FMT_RGBA, frame->width, frame->height, 1);
+    buffer.Reset();
+    buffer.AddUninitialized(size);
 
-        this->ImgaeCopyDataBuffer.Reset();
-        this->ImgaeCopyDataBuffer.AddUninitialized(size);
+    av_image_fill_linesizes(pitch, AV_PIX_FMT_BGRA, frame->width); //填充每个颜色通道的行字节数
+    av_image_fill_pointers(pixels, AV_PIX_FMT_BGRA, frame->height, buffer.GetData(), pitch);
 
-        av_image_fill_linesizes(pitch, AV_PIX_FMT_BGRA, frame->width); //填充每个颜色通道的行字节数
-        av_image_fill_pointers(pixels, AV_PIX_FMT_BGRA, frame->height, ImgaeCopyDataBuffer.GetData(), pitch);
+    //视频像素格式和分辨率的转换
+    sws_scale(
+        *convert_ctx,
+        (const uint8_t* const*)frame->data, //输入图像的每个颜色通道的数据指针
+        frame->linesize, //输入图像的每个颜色通道的跨度,也就是每个通道的行字节数
+        0, //起始位置
+        frame->height, //处理多少行   0-frame->height 表示一次性处理完整个图像
+        pixels, ///输出图像的每个颜色通道的数据指针
+        pitch); ///输入图像的每个颜色通道的行字节数
 
-        //视频像素格式和分辨率的转换
-        sws_scale(
-            img_convert_ctx,
-            (const uint8_t* const*)frame->data, //输入图像的每个颜色通道的数据指针
-            frame->linesize, //输入图像的每个颜色通道的跨度,也就是每个通道的行字节数
-            0, //起始位置
-            frame->height, //处理多少行   0-frame->height 表示一次性处理完整个图像
-            pixels, ///输出图像的每个颜色通道的数据指针
-            pitch); ///输入图像的每个颜色通道的行字节数
+    *stride = pitch[0];
+    return 0;
+}
 
-        {
-            FScopeLock Lock(&CriticalSection);
-            //从纹理样本池中获取一个共享对象
-            const TSharedRef<FFFmpegMediaTextureSample, ESPMode::ThreadSafe> TextureSample
-                = VideoSamplePool->AcquireShared();
-            //根据帧初始化该对象
-            FIntPoint Dim = { frame->width, frame->height };
-            FTimespan time = FTimespan::FromSeconds(0);
-            if (!isnan(vp->GetPts())) {
-                time = FTimespan::FromSeconds(vp->GetPts());
-            }
-            FTimespan duration = FTimespan::FromSeconds(vp->GetDuration());
-            if (TextureSample->Initialize(
-                ImgaeCopyDataBuffer.GetData(),
-                ImgaeCopyDataBuffer.Num(),
-                Dim,
-                pitch[0],
-                time, //ps: 当只有视频时，视频的该值会当做播放时间，故会产生小于总时长1秒的情况，此处将时长与pts相加 duration
-                duration))
-            {
-                // 将样本对象放入样本队列中
-                // UE_LOG(LogFFmpegMedia, Verbose, TEXT("Tracks%p: VideoSampleQueue Enqueue %s %f"), this, *TextureSample.Get().GetTime().Time.ToString(), vp->GetDuration());
-                this->MediaSamples->AddVideo(TextureSample);
-            }
+/** 判断是否存在需要显示的流 */
+bool FFFmpegMediaTracks::has_visual_streams(AVFormatContext* s)
+{
+    for (unsigned i = 0; i < s->nb_streams; i++) {
+        AVStream* st = s->streams[i];
+        if (st->codecpar->codec_type == AVMEDIA_TYPE_SUBTITLE) {
+            return true;
+        }
+        //封面图片(attached_pic)不算视频流
+        if (st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO && !(st->disposition & AV_DISPOSITION_ATTACHED_PIC)) {
+            return true;
         }
-        return ret;
     }
-    else {
-        UE_LOG(LogFFmpegMedia, Error, TEXT("Cannot initialize the conversion context"));
-        ret = -1;
-        return ret;
+    return false;
+}
+
+/** 显示封面图片 */
+int FFFmpegMediaTracks::present_cover_art(int stream_index)
+{
+    if (stream_index < 0 || stream_index >= (int)ic->nb_streams)
+        return -1;
+
+    AVStream* st = ic->streams[stream_index];
+    if (!(st->disposition & AV_DISPOSITION_ATTACHED_PIC)) {
+        UE_LOG(LogFFmpegMedia, Warning, TEXT("Tracks: %p: stream %d is not a attached picture"), this, stream_index);
+        return -1;
+    }
+
+    //已经解码过，直接发送缓存的样本
+    if (!this->CoverArtSample.IsValid()) {
+        AVCodecContext* avctx = NULL;
+        AVFrame* frame = NULL;
+        struct SwsContext* convert_ctx = NULL;
+        TArray<uint8> buffer;
+        int stride = 0;
+        int ret = 0;
+        const AVCodec* codec = avcodec_find_decoder(st->codecpar->codec_id);
+        if (!codec) {
+            UE_LOG(LogFFmpegMedia, Warning, TEXT("Tracks: %p: No decoder could be found for attached picture %s"), this, avcodec_get_name(st->codecpar->codec_id));
+            return AVERROR(EINVAL);
+        }
+
+        avctx = avcodec_alloc_context3(codec);
+        frame = av_frame_alloc();
+        if (!avctx || !frame) {
+            ret = AVERROR(ENOMEM);
+            goto end;
+        }
+        if ((ret = avcodec_parameters_to_context(avctx, st->codecpar)) < 0)
+            goto end;
+        if ((ret = avcodec_open2(avctx, codec, NULL)) < 0)
+            goto end;
+        //封面只有一个包，发送之后立即发送空包取出所有帧
+        if ((ret = avcodec_send_packet(avctx, &st->attached_pic)) < 0)
+            goto end;
+        avcodec_send_packet(avctx, NULL);
+        if ((ret = avcodec_receive_frame(avctx, frame)) < 0)
+            goto end;
+        if ((ret = convert_frame(frame, &convert_ctx, buffer, &stride)) < 0)
+            goto end;
+
+        this->CoverArtSample = MakeShared<FFFmpegMediaTextureSample, ESPMode::ThreadSafe>();
+        if (!this->CoverArtSample->Initialize(buffer.GetData(), buffer.Num(), FIntPoint(frame->width, frame->height), stride, this->TimelineOffset, this->Duration)) {
+            this->CoverArtSample.Reset();
+            ret = -1;
+        }
+        UE_LOG(LogFFmpegMedia, Verbose, TEXT("Tracks: %p: decode attached picture %dx%d"), this, frame->width, frame->height);
+    end:
+        sws_freeContext(convert_ctx);
+        av_frame_free(&frame);
+        avcodec_free_context(&avctx);
+        if (ret < 0) {
+            UE_LOG(LogFFmpegMedia, Warning, TEXT("Tracks: %p: decode attached picture fail %d"), this, ret);
+            return ret;
+        }
     }
+
+    this->add_video_sample(this->CoverArtSample.ToSharedRef());
+    return 0;
 }
 
 /** 废弃格式转有效格式 */
@@ -2526,6 +4716,298 @@ bool FFFmpegMediaTracks::IsOnlyHasVideo()
 {
     return this->SelectedAudioTrack == INDEX_NONE && this->SelectedVideoTrack != INDEX_NONE;
 }
+bool FFFmpegMediaTracks::IsAudioOnly() const
+{
+    return this->AudioOnly;
+}
+
+/** 获取缓存的时间范围 */
+bool FFFmpegMediaTracks::QueryCacheState(EMediaCacheState State, TRangeSet<FTimespan>& OutTimeRanges) const
+{
+    //游戏线程调用，重连时read_thread会在锁内替换ic和流，关闭时释放ic
+    FScopeLock Lock(&CriticalSection);
+    if (!this->ic || this->Duration <= FTimespan::Zero()) {
+        return false;
+    }
+    double queued_start = 0.0, queued_end = 0.0;
+    const bool queued = this->queued_range(queued_start, queued_end);
+
+    const FFmpegIOSource* Source = FFmpegIOSource::FromContext(this->ic->pb);
+    TArray<TPair<int64, int64>> Ranges;
+    const bool cached = Source && Source->GetSize() > 0 && Source->GetCachedRanges(Ranges);
+    const double Size = cached ? (double)Source->GetSize() : 1.0;
+    auto ToTime = [this, Size](int64 Pos) {
+        return this->TimelineOffset + FTimespan((int64)(Pos / Size * this->Duration.GetTicks()));
+    };
+
+    switch (State) {
+    case EMediaCacheState::Loaded:
+        if (queued) {
+            this->add_media_range(OutTimeRanges, queued_start, queued_end);
+        }
+        return true;
+    case EMediaCacheState::Cached:
+        if (!cached) {
+            if (queued) {
+                this->add_media_range(OutTimeRanges, queued_start, queued_end);
+            }
+            return true;
+        }
+        for (const TPair<int64, int64>& Range : Ranges) {
+            OutTimeRanges.Add(TRange<FTimespan>(ToTime(Range.Key), ToTime(Range.Value)));
+        }
+        return true;
+    case EMediaCacheState::Loading:
+    case EMediaCacheState::Pending:
+    {
+        if (!cached || !Source->IsLoading()) {
+            //队列之后到结尾(循环播放时为当前循环的结尾)还没有读取
+            if (State == EMediaCacheState::Pending && queued && !this->eof) {
+                const double media_end = (this->ic->start_time != AV_NOPTS_VALUE ? this->ic->start_time / (double)AV_TIME_BASE : 0.0) + this->Duration.GetTotalSeconds();
+                const double end = media_end + this->loop_index(queued_end) * this->loop_duration;
+                if (end > queued_end) {
+                    this->add_media_range(OutTimeRanges, queued_end, end);
+                }
+            }
+            return true;
+        }
+        //缓存范围之间的空隙，第一个空隙正在加载
+        int64 GapStart = 0;
+        bool FirstGap = true;
+        Ranges.Add(TPair<int64, int64>(Source->GetSize(), Source->GetSize()));
+        for (const TPair<int64, int64>& Range : Ranges) {
+            if (Range.Key > GapStart) {
+                if (FirstGap == (State == EMediaCacheState::Loading)) {
+                    OutTimeRanges.Add(TRange<FTimespan>(ToTime(GapStart), ToTime(Range.Key)));
+                }
+                FirstGap = false;
+            }
+            GapStart = FMath::Max(GapStart, Range.Value);
+        }
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+bool FFFmpegMediaTracks::queued_range(double& start, double& end) const
+{
+    FScopeLock Lock(&CriticalSection); //可重入，QueryCacheState已经持有
+    bool valid = false;
+    start = -DBL_MAX;
+    end = DBL_MAX;
+    auto intersect = [&](const AVStream* st, const FFmpegPacketQueue& q) {
+        if (!st) {
+            return true;
+        }
+        const int64_t head = q.GetHeadPts();
+        const int64_t tail = q.GetEndPts();
+        if (head == AV_NOPTS_VALUE || tail == AV_NOPTS_VALUE) {
+            return false;
+        }
+        const double tb = av_q2d(st->time_base);
+        start = FFMAX(start, head * tb);
+        end = FFMIN(end, tail * tb);
+        valid = true;
+        return true;
+    };
+    //打开的流都有数据的部分才能播放
+    if (!intersect(this->video_st, this->videoq) || !intersect(this->audio_st, this->audioq) || !valid) {
+        return false;
+    }
+    //已经读取到结尾时队列之后没有数据
+    if (this->eof && this->loop_duration <= 0.0) {
+        end = FFMAX(end, (this->ic->start_time != AV_NOPTS_VALUE ? this->ic->start_time / (double)AV_TIME_BASE : 0.0) + this->Duration.GetTotalSeconds());
+    }
+    return end >= start;
+}
+
+void FFFmpegMediaTracks::add_media_range(TRangeSet<FTimespan>& ranges, double start, double end) const
+{
+    auto ToTime = [this](double pts) {
+        return this->TimelineOffset + FTimespan::FromSeconds(pts);
+    };
+    const int first = this->loop_index(start);
+    const int last = this->loop_index(FFMAX(start, end - 0.001)); //正好在循环结尾时不算到下一次循环
+    if (first == last || this->loop_duration <= 0.0) {
+        ranges.Add(TRange<FTimespan>(ToTime(this->loop_media_time(start)), ToTime(this->loop_media_time(start) + (end - start))));
+        return;
+    }
+    //跨越循环的部分拆分成当前循环的结尾和下一次循环的开头
+    const double media_start = this->ic->start_time != AV_NOPTS_VALUE ? this->ic->start_time / (double)AV_TIME_BASE : 0.0;
+    const double media_end = media_start + this->loop_duration;
+    if (last - first > 1) {
+        ranges.Add(TRange<FTimespan>(ToTime(media_start), ToTime(media_end)));
+        return;
+    }
+    ranges.Add(TRange<FTimespan>(ToTime(this->loop_media_time(start)), ToTime(media_end)));
+    ranges.Add(TRange<FTimespan>(ToTime(media_start), ToTime(this->loop_media_time(end))));
+}
+
+double FFFmpegMediaTracks::queued_latency(const AVStream* st, const FFmpegPacketQueue& q) const
+{
+    if (!st)
+        return 0.0;
+    const int64_t head = q.GetHeadPts();
+    const int64_t end = q.GetEndPts();
+    if (head == AV_NOPTS_VALUE || end == AV_NOPTS_VALUE || end <= head)
+        return 0.0;
+    return (end - head) * av_q2d(st->time_base);
+}
+
+bool FFFmpegMediaTracks::low_latency_drop(const AVPacket* pkt)
+{
+    const bool has_video = this->video_st && !this->AudioOnly && !(this->video_st->disposition & AV_DISPOSITION_ATTACHED_PIC);
+    if (this->low_latency_wait_key) { //关键帧之前的视频数据包无法解码，直接丢弃，音频继续播放
+        if (!has_video || pkt->stream_index != this->video_stream)
+            return false;
+        if (!(pkt->flags & AV_PKT_FLAG_KEY))
+            return true;
+        this->low_latency_wait_key = 0;
+        return false;
+    }
+    if (this->paused || this->low_latency_target <= 0.0) //暂停时缓存的数据在继续播放时处理
+        return false;
+
+    const double latency = FFMAX(this->queued_latency(this->audio_st, this->audioq), has_video ? this->queued_latency(this->video_st, this->videoq) : 0.0);
+    if (latency <= this->low_latency_target)
+        return false;
+
+    //清空队列之后序列号改变，解码器和帧队列中的旧数据会被丢弃
+    UE_LOG(LogFFmpegMedia, Verbose, TEXT("Tracks: %p: Low latency queued %.0f ms, skip to newest"), this, latency * 1000.0);
+    this->low_latency_drops++;
+    if (this->audio_st)
+        this->audioq.Flush();
+    if (has_video) {
+        this->videoq.Flush();
+        if (pkt->stream_index == this->video_stream && (pkt->flags & AV_PKT_FLAG_KEY))
+            return false;
+        this->low_latency_wait_key = 1;
+        return pkt->stream_index == this->video_stream;
+    }
+    return false;
+}
+
+/** 获取播放统计信息 */
+FString FFFmpegMediaTracks::GetStats() const
+{
+    FString Stats;
+    Stats += FString::Printf(TEXT("Open\n"));
+    Stats += FString::Printf(TEXT("\topen_input %.1f ms, find_stream_info %.1f ms%s, codec open %.1f ms, first frame %.1f ms\n"),
+        this->open_stats.OpenInput, this->open_stats.FindStreamInfo, this->open_stats.StreamInfoCached ? TEXT(" (cached)") : TEXT(""),
+        this->open_stats.CodecOpen, this->open_stats.FirstFrame);
+    Stats += FString::Printf(TEXT("\tcodec prepare %.1f ms (%d used), poster %.1f ms\n"),
+        this->open_stats.CodecPrepare, this->open_stats.CodecsPrepared, this->open_stats.Poster);
+    if (this->ic && FFmpegIOSource::FromContext(this->ic->pb)) {
+        Stats += FString::Printf(TEXT("\tIO: %s\n"), *FFmpegIOSource::FromContext(this->ic->pb)->GetStats());
+    }
+    Stats += FString::Printf(TEXT("Seek\n"));
+    Stats += FString::Printf(TEXT("\tRequests: %d (coalesced: %d, key frame: %d, scrub settle: %d)%s\n"), this->seek_count, this->seek_coalesced_count,
+        this->scrub_seek_count, this->scrub_settle_count, this->scrub_mode ? TEXT(", scrubbing") : TEXT(""));
+    Stats += FString::Printf(TEXT("\tLatency: last %.1f ms, avg %.1f ms, max %.1f ms\n"),
+        this->seek_latency_last * 1000.0,
+        this->seek_latency_count > 0 ? this->seek_latency_total / this->seek_latency_count * 1000.0 : 0.0,
+        this->seek_latency_max * 1000.0);
+    Stats += FString::Printf(TEXT("\tKeyframe index: %s, %d key frames, %d seeks, last %d frames to decode\n"),
+        this->keyframe_index.IsReady() ? TEXT("ready") : (this->index_tid ? TEXT("building") : TEXT("none")),
+        this->keyframe_index.GetNum(), this->index_seek_count, this->index_seek_frames);
+    Stats += FString::Printf(TEXT("Step\n"));
+    Stats += FString::Printf(TEXT("\tRequests: %d (from cache: %d)\n"), this->step_request_count, this->step_cache_hits);
+    Stats += FString::Printf(TEXT("\tStep buffer: %s\n"), *this->step_buffer.GetStats());
+    Stats += FString::Printf(TEXT("\tLatency: last %.1f ms, avg %.1f ms, max %.1f ms\n"),
+        this->step_latency_last * 1000.0,
+        this->step_latency_count > 0 ? this->step_latency_total / this->step_latency_count * 1000.0 : 0.0,
+        this->step_latency_max * 1000.0);
+    if (this->playback_mode != PLAYBACK_MODE_NORMAL) {
+        Stats += FString::Printf(TEXT("%s\n"), this->playback_mode == PLAYBACK_MODE_THINNED ? TEXT("Thinned") : TEXT("Reverse"));
+        Stats += FString::Printf(TEXT("\tRate: %.2f, frames: %d, key frame hops: %d, decoder: %s\n"),
+            this->gop_rate, this->gop_frame_count, this->trick_hop_count, *this->gop_decoder.GetStats());
+    }
+    Stats += FString::Printf(TEXT("Rate\n"));
+    Stats += FString::Printf(TEXT("\tSpeed: %.2f, audio tempo: %s\n"), this->playback_speed.load(), this->audio_tempo.IsOpen() ? TEXT("atempo") : TEXT("bypass"));
+    if (this->low_latency) {
+        Stats += FString::Printf(TEXT("Low latency\n"));
+        Stats += FString::Printf(TEXT("\tTarget %.0f ms, queued %.0f ms, %d drops%s\n"),
+            this->low_latency_target * 1000.0,
+            FFMAX(this->queued_latency(this->audio_st, this->audioq), this->queued_latency(this->video_st, this->videoq)) * 1000.0,
+            this->low_latency_drops, this->low_latency_wait_key ? TEXT(", waiting for key frame") : TEXT(""));
+    }
+    if (this->reconnect_enabled || this->reconnect_count > 0 || this->reconnect_failures > 0) {
+        Stats += FString::Printf(TEXT("Reconnect\n"));
+        Stats += FString::Printf(TEXT("\tReconnects: %d (failed attempts: %d), latency: last %.1f ms, max %.1f ms\n"),
+            this->reconnect_count, this->reconnect_failures, this->reconnect_latency_last * 1000.0, this->reconnect_latency_max * 1000.0);
+    }
+    if (this->jitter_buffer.IsEnabled()) {
+        Stats += FString::Printf(TEXT("Jitter buffer\n"));
+        Stats += FString::Printf(TEXT("\t%s\n"), *this->jitter_buffer.GetStats());
+    }
+    if (this->shared) {
+        //解码和转换只执行一次，样本按照附加的播放器数量放入各自的样本队列
+        Stats += FString::Printf(TEXT("Shared source\n"));
+        Stats += FString::Printf(TEXT("\tPlayers: %d (peak %d), video samples: %lld converted, %lld delivered, %lld samples dropped for lagging players\n"),
+            this->GetNumSinks(), this->sink_peak, this->shared_video_samples, this->shared_video_deliveries, this->shared_dropped_samples);
+    }
+    Stats += FString::Printf(TEXT("Loop\n"));
+    Stats += FString::Printf(TEXT("\tSplices: %d, duration %.3f s, gap: last %.1f ms, max %.1f ms\n"),
+        this->loop_splice_count, this->loop_duration, this->loop_gap_last * 1000.0, this->loop_gap_max * 1000.0);
+    Stats += FString::Printf(TEXT("\tPacket cache: %s, %d replays%s\n"), *this->packet_cache.GetStats(), this->packet_cache_replay_count, this->packet_cache_replay ? TEXT(", replaying") : TEXT(""));
+    Stats += FString::Printf(TEXT("Resident clip\n"));
+    Stats += FString::Printf(TEXT("\t%s, %s, %d frames sent\n"), *this->resident_clip.GetStats(),
+        this->resident_playing ? TEXT("playing") : TEXT("decoding"), this->resident_frame_count);
+    Stats += FString::Printf(TEXT("Frame cache\n"));
+    Stats += FString::Printf(TEXT("\t%s\n"), *this->frame_cache.GetStats());
+    return Stats;
+}
+
+/** 获取数值形式的播放统计 */
+FFFmpegMediaTracksCounters FFFmpegMediaTracks::GetCounters() const
+{
+    FScopeLock Lock(&CriticalSection);
+    FFFmpegMediaTracksCounters Counters;
+    Counters.OpenStats = this->open_stats;
+    Counters.SeekCount = this->seek_count;
+    Counters.SeekCoalescedCount = this->seek_coalesced_count;
+    Counters.ScrubSeekCount = this->scrub_seek_count;
+    Counters.ScrubSettleCount = this->scrub_settle_count;
+    Counters.SeekLatencyLast = this->seek_latency_last;
+    Counters.SeekLatencyCount = this->seek_latency_count;
+    Counters.StepRequestCount = this->step_request_count;
+    Counters.StepCacheHits = this->step_cache_hits;
+    Counters.StepLatencyLast = this->step_latency_last;
+    Counters.StepLatencyCount = this->step_latency_count;
+    Counters.GopFrameCount = this->gop_frame_count;
+    Counters.TrickHopCount = this->trick_hop_count;
+    Counters.LoopSpliceCount = this->loop_splice_count;
+    Counters.LoopPresented = this->loop_presented;
+    Counters.LoopGapLast = this->loop_gap_last;
+    Counters.LoopGapMax = this->loop_gap_max;
+    Counters.PacketCacheReplays = this->packet_cache_replay_count;
+    Counters.DemuxReads = this->demux_read_count;
+    Counters.SourceBytesRead = this->ic && this->ic->pb ? this->ic->pb->bytes_read : 0;
+    Counters.ResidentPlaying = this->resident_playing != 0;
+    Counters.LowLatency = this->low_latency != 0;
+    Counters.LowLatencyDrops = this->low_latency_drops;
+    Counters.JitterBuffer = this->jitter_buffer.IsEnabled();
+    if (Counters.JitterBuffer) {
+        const double JitterLatency = this->jitter_buffer.GetLatency();
+        Counters.JitterLatency = FMath::IsNaN(JitterLatency) ? 0.0 : JitterLatency;
+        Counters.JitterTarget = this->jitter_buffer.GetTarget();
+        Counters.JitterUnderruns = this->jitter_buffer.GetUnderruns();
+    }
+    Counters.LiveSpeed = this->live_speed;
+    Counters.ReconnectCount = this->reconnect_count;
+    Counters.ReconnectFailures = this->reconnect_failures;
+    Counters.ReconnectLatencyLast = this->reconnect_latency_last;
+    {
+        FScopeLock SinksLock(&this->SinksMutex);
+        Counters.SharedPlayers = this->shared ? this->sinks.Num() : 0;
+        Counters.SharedVideoSamples = this->shared_video_samples;
+        Counters.SharedVideoDeliveries = this->shared_video_deliveries;
+        Counters.SharedDroppedSamples = this->shared_dropped_samples;
+    }
+    return Counters;
+}
 /*******************************************************************************************************************************************/
 
 #undef LOCTEXT_NAMESPACE
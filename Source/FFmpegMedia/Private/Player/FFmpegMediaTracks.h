@@ -20,10 +20,21 @@
 #include "FFmpegPacketQueue.h"
 #include "FFmpegClock.h"
 #include "FFmpegCond.h"
+#include "FFmpegKeyframeIndex.h"
+#include "FFmpegFrameCache.h"
+#include "FFmpegResidentClip.h"
+#include "FFmpegPacketCache.h"
+#include "FFmpegGopDecoder.h"
+#include "FFmpegAudioTempo.h"
+#include "FFmpegJitterBuffer.h"
 #include "LambdaFunctionRunnable.h"
 #include "FFmpegDecoder.h"
 #include "MediaSampleQueue.h"
 #include "IMediaEventSink.h"
+#include "IMediaCache.h"
+#include "FFmpegMediaOptions.h"
+#include "Async/Future.h"
+#include <atomic>
 
 extern  "C" {
 #include "libavformat/avformat.h"
@@ -41,6 +52,7 @@ struct AVFormatContext;
 class FMediaSamples;
 class FFFmpegMediaAudioSamplePool;
 class FFFmpegMediaTextureSamplePool;
+class FFFmpegMediaTextureSample;
 
 typedef struct AudioParams {
 	int freq;
@@ -56,6 +68,92 @@ enum {
 	AV_SYNC_EXTERNAL_CLOCK, /* synchronize to an external clock */
 };
 
+/** 打开媒体各阶段的耗时，在GetStats中显示 */
+struct FFFmpegMediaOpenStats
+{
+	int64 StartTime = 0; //开始打开的时间(微秒)，0表示没有统计
+	double OpenInput = 0.0; //avformat_open_input耗时(毫秒)
+	double FindStreamInfo = 0.0; //avformat_find_stream_info耗时(毫秒)，使用缓存时为读取缓存的耗时
+	bool StreamInfoCached = false; //是否使用了流信息缓存
+	double CodecOpen = 0.0; //打开解码器的总耗时(毫秒)，预先打开的解码器只统计选择轨道时等待的时间
+	double CodecPrepare = 0.0; //在工作线程中预先打开默认轨道解码器的耗时(毫秒)，并行打开时为最长的一个
+	int CodecsPrepared = 0; //选择轨道时直接使用的预先打开的解码器数量
+	double Poster = 0.0; //从开始打开到暂停状态下发送第一帧(封面帧)的耗时(毫秒)，0表示没有发送
+	double FirstFrame = 0.0; //从开始打开到发送第一帧的耗时(毫秒)
+};
+
+/** 数值形式的播放统计，供自动化测试和性能测试读取(GetStats中是文本形式) */
+struct FFFmpegMediaTracksCounters
+{
+	FFFmpegMediaOpenStats OpenStats; //打开媒体各阶段的耗时
+	int SeekCount = 0; //seek请求次数
+	int SeekCoalescedCount = 0; //被合并(覆盖)的seek请求次数
+	int ScrubSeekCount = 0; //拖动时的关键帧seek次数
+	int ScrubSettleCount = 0; //拖动结束时的精准seek次数
+	double SeekLatencyLast = 0.0; //最后一次seek到显示的延迟(秒)
+	int SeekLatencyCount = 0; //已经显示的seek次数
+	int StepRequestCount = 0; //逐帧请求次数
+	int StepCacheHits = 0; //不需要seek，直接从帧缓存或者逐帧缓冲显示的逐帧次数
+	double StepLatencyLast = 0.0; //最后一次逐帧到显示的延迟(秒)
+	int StepLatencyCount = 0; //已经显示的逐帧次数
+	int GopFrameCount = 0; //倒放和跳帧播放时显示的帧数
+	int TrickHopCount = 0; //跳帧播放时解码的关键帧数量
+	int LoopSpliceCount = 0; //循环拼接次数
+	int LoopPresented = 0; //最后显示的帧所在的循环
+	double LoopGapLast = 0.0; //最后一次循环切换时多出的显示间隔(秒)
+	double LoopGapMax = 0.0; //循环切换时多出的最大显示间隔(秒)
+	int PacketCacheReplays = 0; //从数据包缓存回放的循环次数
+	int64 DemuxReads = 0; //从文件读取(解复用)数据包的次数，从数据包缓存回放时不增加
+	int64 SourceBytesRead = 0; //从数据源读取的字节数
+	bool ResidentPlaying = false; //是否正在从常驻片段播放
+	bool LowLatency = false; //是否使用低延迟模式
+	int LowLatencyDrops = 0; //低延迟模式下清空队列的次数
+	bool JitterBuffer = false; //是否使用抖动缓冲
+	double JitterLatency = 0.0; //抖动缓冲平滑之后的缓存时长(秒)
+	double JitterTarget = 0.0; //抖动缓冲当前的目标延迟(秒)
+	int JitterUnderruns = 0; //缓存播放完的次数
+	double LiveSpeed = 1.0; //抖动缓冲调整的播放速度
+	int ReconnectCount = 0; //重连成功的次数
+	int ReconnectFailures = 0; //重连失败的次数
+	double ReconnectLatencyLast = 0.0; //最后一次重连的耗时(秒)，从发现断线开始
+	int32 SharedPlayers = 0; //共享媒体源时附加的播放器数量
+	int64 SharedVideoSamples = 0; //共享媒体源时转换的视频样本数量
+	int64 SharedVideoDeliveries = 0; //共享媒体源时放入各个播放器样本队列的视频样本数量
+	int64 SharedDroppedSamples = 0; //共享媒体源时因为播放器的样本队列已满丢弃的音视频样本数量
+};
+
+enum {
+	PLAYBACK_MODE_NORMAL,  /* 正常播放(包括变速播放) */
+	PLAYBACK_MODE_REVERSE, /* 倒放，按照GOP从后往前解码 */
+	PLAYBACK_MODE_THINNED, /* 跳帧播放(快进快退)，只解码关键帧 */
+};
+
+/**
+ * [Custom] 共享媒体源时附加的播放器
+ * 每个播放器有自己的样本队列、事件和标记，解码出的样本(引用计数)同时放入所有附加播放器的样本队列
+ */
+struct FFFmpegMediaTracksSink
+{
+	FFFmpegMediaTracksSink();
+	~FFFmpegMediaTracksSink();
+
+	/** 播放器的样本队列 */
+	TUniquePtr<FMediaSamples> Samples;
+
+	/** 还没有被播放器取出的事件(由轨道的SinksMutex保护) */
+	TArray<EMediaEvent> Events;
+
+	/** 媒体源是否改变 */
+	bool MediaSourceChanged = false;
+
+	/** 轨道选择是否改变 */
+	bool SelectionChanged = false;
+
+	/** 样本队列已满(播放器没有及时取出)时丢弃的样本数(由轨道的SinksMutex保护) */
+	int64 DroppedVideoSamples = 0;
+	int64 DroppedAudioSamples = 0;
+};
+
 /**
  * 
  */
@@ -123,9 +221,10 @@ public:
 	 * @param IC 描述了一个媒体文件或媒体流的构成和基本信息
 	 * @param Url 媒体地址
 	 * @see PlayerOptions 播放选项
+	 * @param OpenOptions 打开选项
 	 * 参考static VideoState *stream_open(const char *filename,const AVInputFormat *iformat)
 	 */
-	void Initialize(AVFormatContext* IC, const FString & Url, const FMediaPlayerOptions * PlayerOptions);
+	void Initialize(AVFormatContext* IC, const FString & Url, const FMediaPlayerOptions * PlayerOptions, const FFFmpegMediaOpenOptions& OpenOptions);
 
 	/** 将ffmpeg流信息添加到轨道集合 */
 	bool AddStreamToTracks(uint32 StreamIndex, const FMediaPlayerTrackOptions& TrackOptions, FString& OutInfo);
@@ -171,6 +270,66 @@ public:
 	const AVCodecHWConfig* FindBestDeviceType(const AVCodec* decoder);
 	IMediaSamples& GetSamples();
 	bool IsOnlyHasVideo();
+	/** 是否处于纯音频模式 */
+	bool IsAudioOnly() const;
+	/** 获取播放统计信息 */
+	FString GetStats() const;
+	/** 获取数值形式的播放统计 */
+	FFFmpegMediaTracksCounters GetCounters() const;
+	/**
+	 * 获取缓存的时间范围
+	 * Loaded为数据包队列中已经读取、等待解码的范围(所有打开的流都有数据的部分)
+	 * Cached为数据源缓存(内存或者磁盘)的范围，由缓存的字节范围按照比例换算(码率不均匀时只是近似值)，数据源没有缓存时和Loaded相同
+	 * 数据源后台加载时Loading为正在加载的范围，Pending为之后等待加载的范围，否则Pending为队列之后还没有读取的范围
+	 */
+	bool QueryCacheState(EMediaCacheState State, TRangeSet<FTimespan>& OutTimeRanges) const;
+	/**
+	 * 设置拖动状态(比如开始和结束拖动进度条)，拖动时seek只跳转到关键帧，停止拖动或者停顿时对最后的位置做一次精准seek
+	 * 没有设置时所有seek都是精准seek
+	 */
+	void SetScrubbing(bool Scrubbing);
+	/**
+	 * 暂停状态下逐帧显示，向后逐帧时优先从帧缓存中显示
+	 * @param NumFrames 显示的帧数，大于0向前，小于0向后
+	 */
+	bool StepFrames(int32 NumFrames);
+	/**
+	 * 预打开时使用: 保持暂停并选择默认轨道，让读取线程和解码线程提前准备好第一帧
+	 * @return 初始化失败时返回false
+	 */
+	bool Prime();
+	/** 预打开的媒体是否已经解码出第一帧 */
+	bool IsPrimed();
+	/**
+	 * 设置时间轴偏移，样本时间、时长和seek时间都会加上该偏移(连续播放多个媒体时使用)
+	 * 注意需要在Initialize之前设置
+	 */
+	void SetTimelineOffset(FTimespan Offset);
+	/**
+	 * 设置打开阶段的统计(由播放器在Initialize之前设置)，解码器打开和第一帧的耗时在Tracks中统计
+	 */
+	void SetOpenStats(const FFFmpegMediaOpenStats& Stats);
+	/**
+	 * [Custom] 共享媒体源: 附加播放器，之后样本只放入附加播放器的样本队列
+	 * 媒体已经打开时新附加的播放器收到TracksChanged和MediaOpened事件，从当前位置开始播放
+	 */
+	TSharedRef<FFFmpegMediaTracksSink, ESPMode::ThreadSafe> AddSink();
+	/** [Custom] 移除附加的播放器 */
+	void RemoveSink(const TSharedPtr<FFFmpegMediaTracksSink, ESPMode::ThreadSafe>& Sink);
+	/** [Custom] 附加的播放器数量 */
+	int32 GetNumSinks() const;
+	/**
+	 * [Custom] 把轨道的事件和标记分发到所有附加的播放器，再取出指定播放器的事件和标记
+	 * 代替GetFlags、ClearFlags和GetEvents，任何一个附加的播放器都可以调用
+	 */
+	void GetSinkEvents(FFFmpegMediaTracksSink& Sink, bool& OutMediaSourceChanged, bool& OutSelectionChanged, TArray<EMediaEvent>& OutEvents);
+	/** [Custom] 共享媒体源打开失败(没有调用Initialize)，通知附加的播放器 */
+	void NotifyOpenFailed();
+	/**
+	 * 是否为实时流: 地址是实时流协议或者sdp文件，或者打开之后的格式是实时流(is_realtime)
+	 * 打开参数(FFmpegMediaPlayer::SetFormatOptions，ic为空)和轨道初始化都使用这个判断，低延迟模式保持一致
+	 */
+	static bool IsLiveSource(const FString& Url, const AVFormatContext* ic);
 public:
 	//~ IMediaTracks interface
 	/**
@@ -258,7 +417,7 @@ public:
 //ffmpeg方法
 private:
 	/** 判断是否是实时流 */
-	int is_realtime(AVFormatContext* s);
+	static int is_realtime(const AVFormatContext* s);
 	/** 读取线程 
 	* 参考ffplay的read_thread方法实现
 	*/
@@ -267,6 +426,18 @@ private:
 	int stream_has_enough_packets(AVStream* st, int stream_id, FFmpegPacketQueue* queue);
 	/** 打开指定的流 */
 	int stream_component_open(int stream_index);
+	/** 创建并打开解码器上下文(不启动解码线程，可以在工作线程中调用) */
+	int open_codec_context(const AVCodecParameters* par, AVRational time_base, AVCodecContext** out);
+	/** 在工作线程中并行打开默认轨道的解码器 */
+	void prepare_codecs();
+	/** 取出预先打开的解码器，还没有打开完成时等待，没有时返回空 */
+	AVCodecContext* take_prepared_codec(int stream_index);
+	/** 等待指定流的预先打开的解码器打开完成(不取出)，在SelectTrack锁定CriticalSection之前调用 */
+	void wait_prepared_codec(int stream_index);
+	/** 是否还有没有被选择的预先打开的解码器 */
+	bool has_prepared_codecs();
+	/** 释放没有使用的预先打开的解码器 */
+	void release_prepared_codecs();
 	/** 关闭指定的流 */
 	void stream_component_close(int stream_index);
 	/** 音频解码线程 */
@@ -289,20 +460,179 @@ private:
 	void video_display();
 	void video_image_display();
 	int upload_texture(FFmpegFrame* vp, AVFrame* frame);
+	/** 暂停状态下发送第一帧作为封面帧 */
+	void video_poster();
+	/** 转换帧并发送纹理样本 */
+	int upload_frame(AVFrame* frame, double pts, double duration);
+	/** 将帧转化为BGRA格式图像，并写入指定缓存 */
+	int convert_frame(AVFrame* frame, struct SwsContext** convert_ctx, TArray<uint8>& buffer, int* stride);
+	/** 判断上下文中是否存在需要显示的视频流或字幕流(不包含封面图片) */
+	bool has_visual_streams(AVFormatContext* s);
+
+	/** 
+	 * 读取或者在后台生成关键帧索引(只支持本地文件)
+	 * @param Url 媒体地址
+	 */
+	void start_keyframe_index(const FString& Url);
+
+	/**
+	 * 使用关键帧索引seek，索引不可用时返回AVERROR(ENOSYS)
+	 * @param seek_target 目标位置(微秒)
+	 */
+	int seek_by_keyframe_index(int64_t seek_target);
+
+	/**
+	 * 发送视频样本到样本队列，暂停、逐帧或者拖动时放入帧缓存
+	 * @param pts 帧显示时间(秒)
+	 * @param duration 帧时长(秒)
+	 */
+	void publish_video_sample(const TSharedRef<FFFmpegMediaTextureSample, ESPMode::ThreadSafe>& Sample, double pts, double duration);
+
+	/**
+	 * 暂停状态下从帧缓存中显示目标帧，真正的seek推迟到恢复播放时执行
+	 * @param pos 目标位置(微秒)
+	 * @return 缓存命中时返回true
+	 */
+	bool serve_from_frame_cache(int64_t pos);
+
+	/** 向后seek时，把精准seek丢弃的目标位置之前的帧转换并放入帧缓存和逐帧缓冲 */
+	void prefetch_to_frame_cache(AVFrame* frame, double pts, double duration);
+
+	/** 是否处于需要帧缓存的状态(暂停、逐帧或者拖动)，正常播放时显示的帧不放入缓存 */
+	bool frame_cache_wanted() const;
+
+	/** 是否处于需要逐帧缓冲的状态(暂停或者逐帧) */
+	bool step_buffer_wanted() const;
+
+	/** 在read_thread中切换播放模式 */
+	void playback_mode_switch();
+
+	/** 倒放时读取下一个(往前的)GOP，并提交给GOP解码器 */
+	int reverse_read_gop(AVPacket* pkt);
+
+	/** 跳帧播放时读取下一个关键帧，并提交给GOP解码器 */
+	int trick_read_keyframe(AVPacket* pkt);
+
+	/** 倒放和跳帧播放时显示下一帧，相当于video_refresh */
+	void gop_refresh(double* remaining_time);
+
+	/** 释放正在显示的帧块 */
+	void gop_free_frames();
+
+	/** 循环播放时，在文件结尾直接跳回开头继续读取，数据包加上时间偏移拼接到队列之后(不清空队列) */
+	bool loop_splice();
+
+	/** 读取数据包，循环播放时从数据包缓存回放，不读取文件 */
+	int read_packet(AVPacket* pkt);
+
+	/** 循环播放时，拼接后连续的时间戳所在的循环 */
+	int loop_index(double pts) const;
+
+	/** 循环播放时，把拼接后连续的时间戳转换成媒体时间 */
+	double loop_media_time(double pts) const;
+
+	/**
+	 * 数据包队列中已经读取的时间范围(秒，拼接后连续的时间戳)，从解码位置到所有打开的流中最早的队列结尾
+	 * 只读取队列中的原子变量，不锁定队列；调用时需要持有CriticalSection(打开、关闭流和重连时在锁内修改video_st、audio_st和ic)
+	 * @return 没有打开的流或者队列中还没有数据时返回false
+	 */
+	bool queued_range(double& start, double& end) const;
+
+	/** 把拼接后连续的时间范围(秒)转换成媒体时间范围，跨越循环时拆分 */
+	void add_media_range(TRangeSet<FTimespan>& ranges, double start, double end) const;
+
+	/** 数据包队列中缓存的时长(秒)，只读取队列中的原子变量 */
+	double queued_latency(const AVStream* st, const FFmpegPacketQueue& q) const;
+
+	/**
+	 * 低延迟模式下读取数据包之后调用，队列中缓存的时长超过目标延迟时清空音视频队列(跳到最新的数据)
+	 * 清空之后丢弃视频关键帧之前的数据包
+	 * @return 需要丢弃当前数据包时返回true
+	 */
+	bool low_latency_drop(const AVPacket* pkt);
+
+	/** 统计循环切换时的显示间隔，进入下一次循环时发送播放结束事件 */
+	void update_loop_stats(double pts, double duration);
+
+	/** 是否可以录制常驻片段或者从常驻片段播放 */
+	bool resident_allowed() const;
+
+	/** 开始录制常驻片段，时长超过设置或者内存预算不足时返回false */
+	bool resident_begin(int loop);
+
+	/** 显示视频帧之后调用，录制常驻片段或者在新的循环开始时切换到常驻播放，pts为拼接后连续的时间戳 */
+	void resident_on_video(AVFrame* frame, double pts, double duration);
+
+	/** 把帧转换成常驻片段保存的NV12样本(每像素1.5字节)，宽高不是偶数时失败 */
+	TSharedPtr<IMediaTextureSample, ESPMode::ThreadSafe> resident_make_sample(AVFrame* frame, double pts, double duration);
+
+	/** 发送音频样本之后调用，录制常驻片段 */
+	void resident_on_audio(double pts, double duration, int64 bytes, const TSharedRef<IMediaAudioSample, ESPMode::ThreadSafe>& Sample);
+
+	/** 常驻播放的当前位置(连续时间戳，秒) */
+	double resident_current_position() const;
+
+	/** 常驻播放时显示指定位置的帧，force为0时只在帧改变时发送 */
+	void resident_show(double position, int force);
+
+	/** 常驻播放时显示下一帧，相当于video_refresh */
+	void resident_refresh(double* remaining_time);
+
+	/** 常驻播放时发送音频样本 */
+	void resident_render_audio();
+
+	/** 退出常驻播放，从当前位置继续解码 */
+	void resident_exit();
+
+	/** 纯音频模式下显示封面图片，只会解码一次 */
+	int present_cover_art(int stream_index);
 	/** 更新视频pts */
 	void update_video_pts(double pts, int64_t pos, int serial);
 	/* pause or resume the video */
 	void stream_toggle_pause();
-	/* seek in the stream */
-	void stream_seek(int64_t pos, int64_t rel, int by_bytes);
+	/* seek in the stream
+	 * 多次请求时只保留最后一次(后来者优先)
+	 * accurate 为0时只跳转到关键帧，不丢弃目标位置之前的帧(拖动时使用)
+	 * counted 为0时不计入seek请求次数(拖动结束时的精准seek)
+	 */
+	void stream_seek(int64_t pos, int64_t rel, int by_bytes, int accurate = 1, int counted = 1);
+	/** 统计seek到显示的延迟, serial为显示帧的序列号 */
+	void update_seek_latency(int serial);
+	/** 统计逐帧请求到显示的延迟 */
+	void update_step_latency();
+	/** 统计从开始打开到发送第一帧的耗时 */
+	void update_first_frame();
 	/** 计算时长 */
 	double vp_duration(FFmpegFrame* vp, FFmpegFrame* nextvp);
 	/** 计算延迟 */
 	double compute_target_delay(double delay);
-	/** 同步外部时钟 */
-	void check_external_clock_speed();
+	/** 实时流的抖动缓冲: 记录数据包的到达时间，按照缓存的时长计算播放速度，只发布到live_speed(读取线程调用) */
+	void update_jitter_buffer(const AVPacket* pkt);
+	/**
+	 * 按照playback_speed和live_speed设置时钟速度
+	 * 只在更新时钟的线程中调用(显示线程，没有显示线程时为音频渲染线程)，其他线程只修改目标速度
+	 */
+	void apply_render_speed();
+	/**
+	 * 实时流断线重连: 按照退避时间重新打开AVFormatContext，编码参数不变时替换当前的上下文
+	 * 清空数据包队列之后原来的解码器和线程继续使用(解码器在序列号改变时清空)
+	 * @return 重连成功返回0，编码参数改变、超过重连次数或者中断时返回负数
+	 */
+	int reconnect(FCriticalSection* wait_mutex);
+	/** 重新打开的流和当前打开的流编码参数是否相同 */
+	static bool same_stream_parameters(const AVStream* a, const AVStream* b);
+	/** 重连时打开上下文的中断回调，轨道关闭或者播放器关闭时中断 */
+	static int reconnect_interrupt_cb(void* ctx);
 	/** 音视频同步 */
 	int synchronize_audio(int nb_samples);
+	/** 样本放入样本队列，共享媒体源时放入所有附加播放器的样本队列，样本队列已满的播放器(落后的播放器)丢弃该样本 */
+	void add_video_sample(const TSharedRef<IMediaTextureSample, ESPMode::ThreadSafe>& Sample);
+	void add_audio_sample(const TSharedRef<IMediaAudioSample, ESPMode::ThreadSafe>& Sample);
+	/** 样本队列中的样本数量，共享媒体源时取最少的附加播放器(最快的播放器决定解码的速度，落后的播放器不阻塞其他播放器) */
+	int32 num_audio_samples();
+	int32 num_video_samples();
+	/** 样本队列是否还能放入音频样本，共享媒体源时任意一个附加的播放器能放入就返回true */
+	bool can_receive_audio_samples();
 private:
 
 	/** 当前播放状态 Media playback state.  */
@@ -342,10 +672,21 @@ private:
 
 	FTimespan Duration; //总时长
 
+	FTimespan TimelineOffset; //时间轴偏移(连续播放多个媒体时，之前所有媒体的总时长)
+
 	double CurrentRate;//当前播放速率
 
 	bool ShouldLoop;//循环播放
 
+	/**
+	 * 纯音频模式(Initialize时根据选项或者流信息确定)
+	 * 该模式下不会初始化视频和字幕的包队列和帧队列，也不会启动显示线程，封面图片只在选择视频轨道时解码一次
+	 */
+	bool AudioOnly;
+
+	/** 纯音频模式下解码得到的封面图片样本 */
+	TSharedPtr<FFFmpegMediaTextureSample, ESPMode::ThreadSafe> CoverArtSample;
+
 	//视频是否播放中
 	bool             displayRunning;
 	FRunnableThread* displayThread;
@@ -367,7 +708,7 @@ private:
 
 	FFormat::AudioFormat         audio_src; //源音频格式
 	FFormat::AudioFormat         audio_tgt; //目标音频格式（当前好像总是一致）
-	int currentOpenStreamNumber; //当前打开视频流数目，很重要，因为与ffplay中不同，UE中open stream和read是在两个线程中，需要保证所有流都开启之后，再读取
+	int currentOpenStreamNumber; //当前打开视频流数目，很重要，因为与ffplay中不同，UE中open stream和read是在两个线程中，至少有一个流开启之后才开始读取
 	int streamTotalNumber; //流总数 
 	double LastFetchVideoTime = 0; //最后视频包时间
 	TUniquePtr<FMediaSamples> MediaSamples;
@@ -396,6 +737,21 @@ private:
 
 	double  max_frame_duration; //帧最大时长
 	int realtime; //是否是实时流
+	int low_latency; //低延迟模式
+	int low_latency_wait_key; //清空队列之后等待视频关键帧
+	double low_latency_target; //目标延迟(秒)，队列中缓存的时长超过时跳到最新的数据
+	int low_latency_drops; //统计清空队列的次数
+
+	//断线重连
+	int reconnect_enabled; //实时流断线之后自动重连
+	FString reconnect_url; //重连时打开的地址
+	FFFmpegMediaOpenOptions reconnect_options; //重连时使用的打开选项
+	AVIOInterruptCB player_interrupt; //播放器设置的中断回调
+	AVFormatContext* stale_ic; //重连之前的上下文，其他线程可能还在访问，下一次重连或者关闭时释放
+	int reconnect_count; //重连成功的次数
+	int reconnect_failures; //重连失败的次数
+	double reconnect_latency_last; //最后一次重连的耗时(秒)
+	double reconnect_latency_max;
 
 	double audio_clock; // 音频时钟
 	int audio_clock_serial; // 音频时钟序列
@@ -428,6 +784,134 @@ private:
 	int accurate_audio_seek_flag; //精准音频seek标识
 	int accurate_video_seek_flag; //精准视频seek标识
 	int accurate_subtitle_seek_flag; //精准字幕seek标识
+	int seek_accurate; //当前seek请求是否为精准seek
+	int64_t seek_request_time; //当前seek请求的时间(微秒)
+	FCriticalSection SeekMutex; //保护seek请求参数，read_thread执行seek期间可能会有新的请求进来
+
+	//拖动(scrub)相关参数
+	int scrub_mode; //调用者通过SetScrubbing设置的拖动状态，拖动时只做关键帧seek
+	int scrubbing; //拖动时做过关键帧seek，还需要对最后的位置做一次精准seek
+	int64_t scrub_target; //拖动的最后位置，拖动结束后对该位置做一次精准seek
+	int64_t last_seek_request_time; //拖动时上一次seek请求的时间(微秒)，停顿超过SCRUB_SETTLE_TIME之后做精准seek
+	int step; //暂停状态下还需要显示的帧数(暂停时seek需要显示目标帧，逐帧显示时为剩余的帧数)
+
+	//seek统计
+	int seek_latency_serial; //等待显示的seek序列号，-1表示没有等待
+	int64_t seek_latency_start; //等待显示的seek请求时间(微秒)
+	int seek_count; //seek次数
+	int seek_coalesced_count; //被合并(覆盖)的seek请求次数
+	int scrub_seek_count; //关键帧seek次数
+	int scrub_settle_count; //拖动结束时的精准seek次数(不计入seek_count)
+	double seek_latency_last; //最后一次seek到显示的延迟(秒)
+	double seek_latency_max; //最大seek到显示的延迟(秒)
+	double seek_latency_total; //seek到显示的延迟总和(秒)
+	int seek_latency_count; //统计的seek次数
+
+	//逐帧统计
+	int64_t step_latency_start; //等待显示的逐帧请求时间(微秒)，0表示没有等待
+	int step_request_count; //逐帧请求次数
+	int step_cache_hits; //直接从帧缓存或者逐帧缓冲显示的逐帧次数
+	double step_latency_last; //最后一次逐帧到显示的延迟(秒)
+	double step_latency_max; //最大逐帧到显示的延迟(秒)
+	double step_latency_total; //逐帧到显示的延迟总和(秒)
+	int step_latency_count; //统计的逐帧次数
+
+	FFFmpegMediaOpenStats open_stats; //打开媒体各阶段的耗时
+
+	//共享媒体源
+	TArray<TSharedPtr<FFFmpegMediaTracksSink, ESPMode::ThreadSafe>> sinks; //附加的播放器
+	mutable FCriticalSection SinksMutex; //保护sinks以及附加播放器的事件和标记
+	int shared; //是否附加过播放器，之后不再使用自己的样本队列
+	int sink_peak; //同时附加的播放器数量的最大值
+	int64 shared_video_samples; //发送的视频样本数量(只转换一次)
+	int64 shared_video_deliveries; //放入附加播放器样本队列的视频样本数量
+	int64 shared_dropped_samples; //附加播放器的样本队列已满时丢弃的音视频样本数量
+
+	//预先打开的解码器
+	TMap<int, TSharedFuture<AVCodecContext*>> prepared_codecs; //流索引 -> 在工作线程中打开的解码器上下文(共享，可以在prepared_mutex之外等待)
+	FCriticalSection prepared_mutex; //保护prepared_codecs
+	int poster_pending; //视频流打开之后还没有发送过视频帧，暂停状态下需要发送封面帧
+
+	//关键帧索引
+	FFmpegKeyframeIndex keyframe_index; //关键帧索引，seek时直接跳转到最近的关键帧
+	FRunnableThread* index_tid; //生成关键帧索引的线程
+	int index_seek_count; //使用关键帧索引的seek次数
+	int index_seek_frames; //最后一次使用索引seek时，估计需要解码的帧数
+
+	//帧缓存
+	FFmpegFrameCache frame_cache; //已转换视频帧的缓存，回退和重复拖动时直接从缓存中显示
+	double displayed_pts; //最后发送的视频帧时间(秒)，用于判断seek方向
+	int prefetch_backward; //当前seek是否向后，向后seek时缓存目标位置之前的帧
+	int deferred_seek; //是否存在推迟执行的seek(暂停时从缓存显示)
+	int64_t deferred_seek_pos; //推迟执行的seek位置(微秒)
+	struct SwsContext* prefetch_convert_ctx; //预取帧的图像转换上下文(在解码线程中使用)
+	TArray<uint8> PrefetchDataBuffer; //预取帧的图像转换缓存
+	FFmpegFrameCache step_buffer; //逐帧缓冲，暂停和逐帧时保存当前GOP中已经解码的帧，不受帧缓存预算(FrameCacheSizeMB)限制，恢复播放时清空
+
+	//倒放和跳帧播放，都通过GOP解码器解码并直接显示，不经过正常的解码和显示流程
+	FFmpegGopDecoder gop_decoder; //解码GOP(独立的解码器上下文)
+	int playback_mode; //当前播放模式PLAYBACK_MODE_XXX(只在read_thread中切换)
+	int playback_mode_request; //请求的播放模式
+	double gop_rate; //倒放和跳帧播放的速率(带方向)
+	double reverse_gop_end; //倒放时下一个需要读取的GOP的结束时间(秒)
+	int gop_eof; //已经读取到开头(倒放、快退)或者结尾(快进)
+	int gop_end_sent; //是否已经发送播放结束事件
+	double gop_next_time; //下一帧的显示时间(系统时间，秒)
+	int gop_frame_count; //显示的帧数
+	TArray<AVFrame*> gop_frames; //当前正在显示的帧块(按照pts升序，从末尾往前显示)
+	FCriticalSection GopMutex; //保护gop_frames
+
+	//跳帧播放
+	double trick_origin_pts; //开始跳帧播放时的位置(秒)
+	double trick_origin_time; //开始跳帧播放时的系统时间(秒)，为0时从最后的关键帧重新开始计算
+	double trick_last_pts; //最后读取的关键帧位置(秒)
+	int trick_hop_count; //跳转的关键帧数量
+
+	//无缝循环播放
+	int64_t loop_offset; //拼接到队列中的数据包的时间偏移(微秒)，seek之后重置
+	double loop_end_time; //读取到的数据包的最大结束时间(秒)
+	double loop_duration; //一次循环的时长(秒)，第一次读取到文件结尾时确定
+	int loop_splice_count; //拼接次数
+	int loop_presented; //最后显示的帧所在的循环
+	double loop_present_time; //最后显示帧的系统时间(秒)
+	double loop_present_duration; //最后显示帧的时长(秒)
+	double loop_gap_last; //最后一次循环切换时多出的显示间隔(秒)
+	double loop_gap_max; //循环切换时多出的最大显示间隔(秒)
+
+	//循环播放的数据包缓存(只在read_thread中使用)
+	FFmpegPacketCache packet_cache; //从文件开头到结尾的所有数据包
+	int64 packet_cache_budget; //内存预算(字节)，超出预算之后设置为0，不再尝试
+	int64 packet_cache_global_budget; //所有播放器共用的内存预算(字节)
+	int packet_cache_at_start; //还没有读取过数据包(从文件开头读取)
+	int packet_cache_replay; //是否正在从缓存回放
+	int packet_cache_replay_count; //从缓存回放的循环次数
+	int64 demux_read_count; //从文件读取(解复用)数据包的次数
+	std::atomic<bool> packet_cache_dirty; //选择的轨道改变，缓存中没有新轨道的数据包(在SelectTrack中设置，在read_thread中读取)
+
+	//常驻内存的循环片段
+	FFmpegResidentClip resident_clip; //第一次循环时录制的视频和音频样本
+	int resident_enabled; //是否开启(打开选项和插件设置)
+	int resident_loop; //正在录制的循环
+	int resident_next_loop; //可以开始录制的循环，打开时为0，seek之后从下一次循环开始
+	int resident_playing; //是否正在从常驻片段播放，此时不读取和解码
+	double resident_position; //开始计算播放位置时的位置(连续时间戳，秒)
+	double resident_origin_time; //开始计算播放位置的系统时间(秒)，为0时从resident_position重新开始计算
+	int resident_video_index; //最后发送的视频帧
+	int resident_video_loop; //最后显示的视频帧所在的循环
+	double resident_audio_time; //下一个需要发送的音频样本的开始时间(连续时间戳，秒)
+	double audio_sent_time; //最后发送的音频样本的结束时间(连续时间戳，秒)
+	int resident_frame_count; //从常驻片段发送的视频帧数
+	struct SwsContext* resident_convert_ctx; //录制常驻片段时转换NV12图像的上下文(在显示线程中使用)
+
+	//变速播放
+	std::atomic<double> playback_speed; //正向播放速率，时钟速度和视频帧间隔都按照该速率缩放(SetRate修改)
+	std::atomic<double> live_speed; //抖动缓冲调整的播放速度，只用于实时流(读取线程修改)
+	std::atomic<double> render_speed; //实际的时钟速度和音频变速速率(playback_speed * live_speed)，由apply_render_speed修改
+	FFmpegJitterBuffer jitter_buffer; //实时流的抖动缓冲
+	int jitter_serial; //抖动缓冲对应的播放序列，seek或者清空队列之后重新估计
+	FFmpegAudioTempo audio_tempo; //音频变速不变调，速率为1并且没有使用抖动缓冲时不使用
+	TArray<uint8> AudioTempoBuffer; //变速之后的音频数据
+	int audio_tempo_serial; //音频变速滤镜对应的播放序列，seek之后需要清空滤镜
 
 	int video_stream;	 //当前打开的视频流(索引)
 	int subtitle_stream; //当前打开的字幕流(索引)
@@ -0,0 +1,172 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Tests/FFmpegMediaTestUtils.h"
+#include "FFmpegMedia.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "FFmpegArchiveSource.h"
+#include "FFmpegAsyncFileSource.h"
+#include "HAL/FileManager.h"
+#include "Misc/FileHelper.h"
+#include "Math/RandomStream.h"
+
+extern  "C" {
+#include "libavformat/avformat.h"
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FFFmpegMediaArchiveReadTest, "FFmpegMedia.IO.Archive", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+/* 测试读取时每次请求的大小，不是块大小的整数倍，读取会跨过块的边界 */
+#define ARCHIVE_TEST_READ_SIZE 7919
+/* 异步读取数据源的块大小 */
+#define ARCHIVE_TEST_BLOCK_SIZE (64 * 1024)
+
+/**
+ * 解复用整个文件，MakeSource为空时由FFmpeg的file协议读取
+ * @return 读取的数据包数量，失败时返回-1
+ */
+static int64 DemuxPackets(const FString& Path, TFunction<FFmpegIOSource*()> MakeSource, int64& OutBytes)
+{
+    int64 packets = -1;
+    int ret = 0;
+    AVIOContext* pb = nullptr;
+    AVPacket* pkt = av_packet_alloc();
+    AVFormatContext* ic = avformat_alloc_context();
+    OutBytes = 0;
+    if (!pkt || !ic) {
+        goto out;
+    }
+    if (MakeSource) {
+        FFmpegIOSource* Source = MakeSource();
+        pb = Source ? FFmpegIOSource::CreateContext(Source, ARCHIVE_TEST_BLOCK_SIZE) : nullptr;
+        if (!pb) {
+            goto out;
+        }
+        ic->pb = pb;
+    }
+    if (avformat_open_input(&ic, TCHAR_TO_UTF8(*Path), NULL, NULL) < 0) {
+        goto out;
+    }
+    packets = 0;
+    while ((ret = av_read_frame(ic, pkt)) >= 0) {
+        packets++;
+        OutBytes += pkt->size;
+        av_packet_unref(pkt);
+    }
+    if (ret != AVERROR_EOF) {
+        packets = -1;
+    }
+out:
+    avformat_close_input(&ic);
+    FFmpegIOSource::FreeContext(&pb);
+    av_packet_free(&pkt);
+    return packets;
+}
+
+/**
+ * 通过FArchive(FFmpegArchiveSource)和平台文件层的异步读取(FFmpegAsyncFileSource)读取测试片段
+ * 顺序读取和随机跳转之后读取的数据与文件内容一致，结尾之后返回AVERROR_EOF
+ * 其他对象移动了FArchive的位置之后仍然从数据源自己的位置读取
+ * 通过数据源解复用得到的数据包与FFmpeg的file协议相同
+ */
+bool FFFmpegMediaArchiveReadTest::RunTest(const FString& Parameters)
+{
+    FFFmpegMediaTestClip Clip;
+    Clip.Name = TEXT("archive");
+    const FString Path = FFFmpegMediaTestUtils::GetClip(Clip);
+    TArray<uint8> Expected;
+    if (!TestFalse(TEXT("Test clip is generated"), Path.IsEmpty()) || !TestTrue(TEXT("Test clip is loaded"), FFileHelper::LoadFileToArray(Expected, *Path))) {
+        return false;
+    }
+    const int64 Size = Expected.Num();
+
+    TSharedPtr<FArchive, ESPMode::ThreadSafe> Archive;
+    struct FSourceCase
+    {
+        const TCHAR* Name;
+        TFunction<FFmpegIOSource*()> MakeSource;
+    };
+    const FSourceCase Cases[] = {
+        { TEXT("archive"), [&Path, &Archive]() -> FFmpegIOSource* {
+            Archive = MakeShareable(IFileManager::Get().CreateFileReader(*Path));
+            return Archive.IsValid() ? new FFmpegArchiveSource(Archive) : nullptr;
+        } },
+        { TEXT("async file"), [&Path]() -> FFmpegIOSource* {
+            return FFmpegAsyncFileSource::Open(Path, ARCHIVE_TEST_BLOCK_SIZE, 4);
+        } },
+    };
+    for (const FSourceCase& Case : Cases) {
+        TUniquePtr<FFmpegIOSource> Source(Case.MakeSource());
+        if (!TestNotNull(FString::Printf(TEXT("%s: source is created"), Case.Name), Source.Get())) {
+            continue;
+        }
+        TestEqual(FString::Printf(TEXT("%s: size"), Case.Name), (int64)Source->GetSize(), Size);
+
+        //顺序读取整个文件
+        TArray<uint8> Buffer;
+        Buffer.SetNumUninitialized(ARCHIVE_TEST_READ_SIZE);
+        int64 Position = 0;
+        int32 Mismatches = 0;
+        for (;;) {
+            const int Read = Source->Read(Buffer.GetData(), Buffer.Num());
+            if (Read <= 0) {
+                TestEqual(FString::Printf(TEXT("%s: sequential read ends with AVERROR_EOF"), Case.Name), Read, (int)AVERROR_EOF);
+                break;
+            }
+            if (Position + Read > Size || FMemory::Memcmp(Buffer.GetData(), Expected.GetData() + Position, Read) != 0) {
+                Mismatches++;
+            }
+            Position += Read;
+        }
+        TestEqual(FString::Printf(TEXT("%s: sequential read returns the whole file"), Case.Name), Position, Size);
+        TestEqual(FString::Printf(TEXT("%s: sequential data matches the file"), Case.Name), Mismatches, 0);
+
+        //随机跳转之后读取(包括向后跳转和跨过块边界)
+        FRandomStream Random(1234);
+        Mismatches = 0;
+        for (int32 i = 0; i < 64; i++) {
+            const int64 Offset = (int64)(Random.GetFraction() * (Size - 1));
+            if (Source->SeekTo(Offset) != Offset) {
+                Mismatches++;
+                continue;
+            }
+            if (Archive.IsValid() && (i % 4) == 0) {
+                Archive->Seek(0); //FArchive被其他对象读取过
+            }
+            const int Wanted = (int)FMath::Min<int64>(Buffer.Num(), Size - Offset);
+            int Read = 0;
+            while (Read < Wanted) {
+                const int Ret = Source->Read(Buffer.GetData() + Read, Wanted - Read);
+                if (Ret <= 0) {
+                    break;
+                }
+                Read += Ret;
+            }
+            if (Read != Wanted || FMemory::Memcmp(Buffer.GetData(), Expected.GetData() + Offset, Read) != 0) {
+                Mismatches++;
+                AddError(FString::Printf(TEXT("%s: read of %d bytes at %lld does not match the file"), Case.Name, Wanted, Offset));
+            }
+        }
+        TestEqual(FString::Printf(TEXT("%s: data after seeks matches the file"), Case.Name), Mismatches, 0);
+
+        Source->SeekTo(Size);
+        TestEqual(FString::Printf(TEXT("%s: read at the end returns AVERROR_EOF"), Case.Name), Source->Read(Buffer.GetData(), Buffer.Num()), (int)AVERROR_EOF);
+        FFFmpegMediaTestUtils::Report(*this, FString::Printf(TEXT("%s: %s"), Case.Name, *Source->GetStats()));
+        Source.Reset();
+        Archive.Reset();
+
+        //通过数据源解复用
+        int64 FileBytes = 0, SourceBytes = 0;
+        const int64 FilePackets = DemuxPackets(Path, nullptr, FileBytes);
+        const int64 SourcePackets = DemuxPackets(Path, Case.MakeSource, SourceBytes);
+        Archive.Reset();
+        TestTrue(FString::Printf(TEXT("%s: demuxes the whole file"), Case.Name), SourcePackets > 0);
+        TestEqual(FString::Printf(TEXT("%s: same packets as the file protocol"), Case.Name), SourcePackets, FilePackets);
+        TestEqual(FString::Printf(TEXT("%s: same packet bytes as the file protocol"), Case.Name), SourceBytes, FileBytes);
+    }
+    return true;
+}
+
+#endif //WITH_DEV_AUTOMATION_TESTS
@@ -0,0 +1,913 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Tests/FFmpegMediaTestUtils.h"
+#include "FFmpegMedia.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "Async/Async.h"
+#include "FFmpegMediaSettings.h"
+#include "FFmpegMappedFileSource.h"
+#include "FFmpegUringFileSource.h"
+#include "FFmpegProtocolSource.h"
+#include "FFmpegReadAheadSource.h"
+#include "FFmpegHttpCacheSource.h"
+#include "HAL/FileManager.h"
+#include "IMediaTextureSample.h"
+
+extern  "C" {
+#include "libavformat/avformat.h"
+}
+
+/* 只解复用时AVIO缓冲区大小 */
+#define DEMUX_IO_BUFFER_SIZE (64 * 1024)
+
+/**
+ * 性能测试，结果通过AddInfo和日志(LogFFmpegMedia: Display)输出
+ * 默认使用生成的mpeg4片段，-FFmpegMediaBenchmarkClip=<path>可以指定实际使用的文件
+ * Automation RunTests FFmpegMedia.Benchmark
+ */
+
+/** 打开一次并等到第一个视频样本，返回打开各阶段的耗时 */
+static bool MeasureOpen(const FString& Path, const FFFmpegMediaOpenOptions& OpenOptions, FFFmpegMediaOpenStats& OutStats, double& OutFirstVideo)
+{
+    FFFmpegMediaTestPlayer Player;
+    if (!Player.Open(Path, OpenOptions)) {
+        return false;
+    }
+    Player.TickUntil([&]() { return Player.FirstVideoTime >= 0.0 || Player.NumEvents(EMediaEvent::MediaOpenFailed) > 0; }, 10.0);
+    if (Player.FirstVideoTime < 0.0) {
+        return false;
+    }
+    OutStats = Player.GetTracks().GetCounters().OpenStats;
+    OutFirstVideo = Player.FirstVideoTime;
+    return true;
+}
+
+/** 多次打开的平均耗时(毫秒) */
+struct FOpenTimes
+{
+    double OpenInput = 0.0;
+    double FindStreamInfo = 0.0;
+    double CodecOpen = 0.0;
+    double FirstFrame = 0.0;
+    int32 Runs = 0;
+    int32 Cached = 0;
+
+    void Add(const FFFmpegMediaOpenStats& Stats)
+    {
+        OpenInput += Stats.OpenInput;
+        FindStreamInfo += Stats.FindStreamInfo;
+        CodecOpen += Stats.CodecOpen;
+        FirstFrame += Stats.FirstFrame;
+        Cached += Stats.StreamInfoCached ? 1 : 0;
+        Runs++;
+    }
+
+    FString ToString() const
+    {
+        const double Num = FMath::Max(Runs, 1);
+        return FString::Printf(TEXT("open_input %.1f ms, find_stream_info %.1f ms, codec open %.1f ms, first frame %.1f ms (%d runs, %d cached)"),
+            OpenInput / Num, FindStreamInfo / Num, CodecOpen / Num, FirstFrame / Num, Runs, Cached);
+    }
+};
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FFFmpegMediaOpenBenchmark, "FFmpegMedia.Benchmark.Open", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::PerfFilter)
+
+/**
+ * 打开阶段的耗时: FFmpeg默认的探测大小和时长、减小探测大小和时长、使用流信息缓存
+ * TS和MKV各打开5次取平均值
+ */
+bool FFFmpegMediaOpenBenchmark::RunTest(const FString& Parameters)
+{
+    const int32 NumRuns = 5;
+    for (const TCHAR* Format : { TEXT("ts"), TEXT("mkv") }) {
+        FFFmpegMediaTestClip Clip;
+        Clip.Name = TEXT("open");
+        Clip.Format = Format;
+        Clip.Width = 1920;
+        Clip.Height = 1080;
+        Clip.Duration = 4.0;
+        Clip.BitRate = 8000;
+        const FString Path = FFFmpegMediaTestUtils::GetClip(Clip);
+        if (!TestFalse(FString::Printf(TEXT("%s clip is generated"), Format), Path.IsEmpty())) {
+            continue;
+        }
+
+        struct FOpenCase
+        {
+            const TCHAR* Name;
+            int32 ProbeSize;
+            int32 AnalyzeDuration;
+            bool StreamInfoCache;
+        };
+        const FOpenCase Cases[] = {
+            { TEXT("ffmpeg default probing"), 0, 0, false },
+            { TEXT("probe 128 KB / 200 ms"), 128, 200, false },
+            { TEXT("stream info cache"), -1, -1, true },
+        };
+        for (const FOpenCase& Case : Cases) {
+            FFFmpegMediaOpenOptions OpenOptions;
+            OpenOptions.ProbeSize = Case.ProbeSize;
+            OpenOptions.AnalyzeDuration = Case.AnalyzeDuration;
+            OpenOptions.StreamInfoCache = Case.StreamInfoCache;
+            //第一次打开预热文件缓存(以及写入流信息缓存)，不计入结果
+            FFFmpegMediaOpenStats Stats;
+            double FirstVideo = 0.0;
+            if (!TestTrue(FString::Printf(TEXT("%s %s: open"), Format, Case.Name), MeasureOpen(Path, OpenOptions, Stats, FirstVideo))) {
+                continue;
+            }
+            FOpenTimes Times;
+            for (int32 Run = 0; Run < NumRuns; Run++) {
+                if (MeasureOpen(Path, OpenOptions, Stats, FirstVideo)) {
+                    Times.Add(Stats);
+                }
+            }
+            TestEqual(FString::Printf(TEXT("%s %s: all runs opened"), Format, Case.Name), Times.Runs, NumRuns);
+            if (Case.StreamInfoCache) {
+                TestEqual(FString::Printf(TEXT("%s %s: stream info read from cache"), Format, Case.Name), Times.Cached, Times.Runs);
+            }
+            FFFmpegMediaTestUtils::Report(*this, FString::Printf(TEXT("%s %s: %s"), Format, Case.Name, *Times.ToString()));
+        }
+    }
+    return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FFFmpegMediaFirstFrameBenchmark, "FFmpegMedia.Benchmark.FirstFrame", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::PerfFilter)
+
+/**
+ * 第一帧的时间(TTFF): 选择轨道时才打开解码器(PrepareCodecs关闭)与在工作线程中预先打开解码器对比
+ * 两种方式交替打开10次，减少文件缓存和CPU频率变化的影响
+ * 预先打开解码器时第一帧的时间大约减少一半，加速比至少需要达到MinSpeedup
+ */
+bool FFFmpegMediaFirstFrameBenchmark::RunTest(const FString& Parameters)
+{
+    FFFmpegMediaTestClip Clip;
+    Clip.Name = TEXT("ttff");
+    Clip.Width = 1920;
+    Clip.Height = 1080;
+    Clip.Duration = 4.0;
+    Clip.BitRate = 8000;
+    const FString Path = FFFmpegMediaTestUtils::GetBenchmarkClip(Clip);
+    if (!TestFalse(TEXT("Benchmark clip is available"), Path.IsEmpty())) {
+        return false;
+    }
+
+    const int32 NumRuns = 10;
+    const double MinSpeedup = 1.5; //预期大约2倍，留出测量误差
+    FOpenTimes Times[2];
+    double FirstVideo[2] = { 0.0, 0.0 };
+    double CodecPrepare[2] = { 0.0, 0.0 };
+    FFFmpegMediaOpenStats Stats;
+    double FirstVideoTime = 0.0;
+    for (int32 Run = -1; Run < NumRuns; Run++) {
+        for (int32 Prepare = 0; Prepare < 2; Prepare++) {
+            FFFmpegMediaOpenOptions OpenOptions;
+            OpenOptions.PrepareCodecs = Prepare != 0;
+            if (!MeasureOpen(Path, OpenOptions, Stats, FirstVideoTime) || Run < 0) { //第一轮预热文件缓存和流信息缓存
+                continue;
+            }
+            Times[Prepare].Add(Stats);
+            FirstVideo[Prepare] += FirstVideoTime * 1000.0;
+            CodecPrepare[Prepare] += Stats.CodecPrepare;
+        }
+    }
+
+    const TCHAR* Names[2] = { TEXT("open codecs on select"), TEXT("prepared codecs") };
+    for (int32 Prepare = 0; Prepare < 2; Prepare++) {
+        TestEqual(FString::Printf(TEXT("%s: all runs opened"), Names[Prepare]), Times[Prepare].Runs, NumRuns);
+        const double Num = FMath::Max(Times[Prepare].Runs, 1);
+        FFFmpegMediaTestUtils::Report(*this, FString::Printf(TEXT("%s: %s, codec prepare %.1f ms, first sample fetched %.1f ms"),
+            Names[Prepare], *Times[Prepare].ToString(), CodecPrepare[Prepare] / Num, FirstVideo[Prepare] / Num));
+    }
+    if (Times[0].Runs > 0 && Times[1].Runs > 0 && Times[1].FirstFrame > 0.0) {
+        const double Ratio = (Times[0].FirstFrame / Times[0].Runs) / (Times[1].FirstFrame / Times[1].Runs);
+        TestTrue(FString::Printf(TEXT("first frame speedup %.2fx is at least %.1fx"), Ratio, MinSpeedup), Ratio >= MinSpeedup);
+        FFFmpegMediaTestUtils::Report(*this, FString::Printf(TEXT("first frame speedup %.2fx"), Ratio));
+    }
+    return true;
+}
+
+/** 创建读取文件的数据源，为空时由FFmpeg直接打开文件(file协议) */
+typedef TFunction<FFmpegIOSource*(const FString& Path)> FFFmpegSourceFactory;
+
+/**
+ * 只解复用(不解码)读取整个文件，相当于播放器的读取线程
+ * @param OnFinished 读取完成之后、释放数据源之前调用，用于读取数据源的统计
+ * @return 读取的数据包字节数，失败时返回-1
+ */
+static int64 DemuxFile(const FString& Path, const FFFmpegSourceFactory& MakeSource, TFunction<void(const FFmpegIOSource&)> OnFinished = nullptr)
+{
+    int64 bytes = 0;
+    int ret = 0;
+    FFmpegIOSource* Source = nullptr;
+    AVIOContext* pb = nullptr;
+    AVPacket* pkt = av_packet_alloc();
+    AVFormatContext* ic = avformat_alloc_context();
+    if (!pkt || !ic) {
+        goto fail;
+    }
+    if (MakeSource) {
+        Source = MakeSource(Path);
+        if (!Source) {
+            UE_LOG(LogFFmpegMedia, Error, TEXT("Benchmark: could not create source for %s"), *Path);
+            goto fail;
+        }
+        pb = FFmpegIOSource::CreateContext(Source, DEMUX_IO_BUFFER_SIZE);
+        if (!pb) {
+            goto fail;
+        }
+        ic->pb = pb;
+    }
+    ret = avformat_open_input(&ic, TCHAR_TO_UTF8(*Path), NULL, NULL);
+    if (ret < 0) {
+        goto fail;
+    }
+    while ((ret = av_read_frame(ic, pkt)) >= 0) {
+        bytes += pkt->size;
+        av_packet_unref(pkt);
+    }
+    if (ret != AVERROR_EOF) {
+        goto fail;
+    }
+    if (OnFinished && pb) {
+        OnFinished(*FFmpegIOSource::FromContext(pb));
+    }
+    avformat_close_input(&ic);
+    FFmpegIOSource::FreeContext(&pb);
+    av_packet_free(&pkt);
+    return bytes;
+fail:
+    avformat_close_input(&ic);
+    FFmpegIOSource::FreeContext(&pb);
+    av_packet_free(&pkt);
+    return -1;
+}
+
+/** 多个读取线程同时读取的结果 */
+struct FReadResult
+{
+    int32 NumReaders = 0;
+    int32 Failed = 0;
+    int64 Bytes = 0;
+    double Seconds = 0.0;
+    double CpuSeconds = 0.0;
+
+    FString ToString() const
+    {
+        const double MB = Bytes / (1024.0 * 1024.0);
+        return FString::Printf(TEXT("%d readers, %.0f MB/s total, %.1f MB/s per reader, cpu %.2f s (%.2f ms per MB)%s"),
+            NumReaders, MB / FMath::Max(Seconds, 1e-6), MB / FMath::Max(Seconds, 1e-6) / FMath::Max(NumReaders, 1), CpuSeconds,
+            CpuSeconds * 1000.0 / FMath::Max(MB, 1e-6), Failed > 0 ? *FString::Printf(TEXT(", %d failed"), Failed) : TEXT(""));
+    }
+};
+
+/** 多个线程同时解复用同一个文件，返回总的吞吐量和进程的CPU时间 */
+static FReadResult RunReaders(const FString& Path, int32 NumReaders, const FFFmpegSourceFactory& MakeSource)
+{
+    FReadResult Result;
+    Result.NumReaders = NumReaders;
+    TArray<TFuture<int64>> Readers;
+    const double CpuStart = FFFmpegMediaTestUtils::GetCpuSeconds();
+    const double Start = FPlatformTime::Seconds();
+    for (int32 i = 0; i < NumReaders; i++) {
+        Readers.Add(Async(EAsyncExecution::Thread, [Path, MakeSource]() { return DemuxFile(Path, MakeSource); }));
+    }
+    for (TFuture<int64>& Reader : Readers) {
+        const int64 Bytes = Reader.Get();
+        if (Bytes < 0) {
+            Result.Failed++;
+        }
+        else {
+            Result.Bytes += Bytes;
+        }
+    }
+    Result.Seconds = FPlatformTime::Seconds() - Start;
+    Result.CpuSeconds = FFFmpegMediaTestUtils::GetCpuSeconds() - CpuStart;
+    return Result;
+}
+
+/** 读取性能测试使用的片段，较大的码率使读取而不是解析成为主要开销 */
+static FString GetReadClip()
+{
+    FFFmpegMediaTestClip Clip;
+    Clip.Name = TEXT("read");
+    Clip.Width = 1280;
+    Clip.Height = 720;
+    Clip.Duration = 30.0;
+    Clip.BitRate = 20000;
+    Clip.Audio = false;
+    return FFFmpegMediaTestUtils::GetBenchmarkClip(Clip);
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FFFmpegMediaMappedFileBenchmark, "FFmpegMedia.Benchmark.MappedFile", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::PerfFilter)
+
+/**
+ * FFmpeg的file协议与内存映射读取本地文件对比，1/8/32个读取线程同时解复用同一个文件
+ * 每种方式先读取一遍使文件进入页缓存，测试的是多个播放器读取已经缓存的文件时的吞吐量和CPU开销
+ */
+bool FFFmpegMediaMappedFileBenchmark::RunTest(const FString& Parameters)
+{
+    const FString Path = GetReadClip();
+    if (!TestFalse(TEXT("Benchmark clip is available"), Path.IsEmpty())) {
+        return false;
+    }
+    const int64 ReadAhead = (int64)GetDefault<UFFmpegMediaSettings>()->MappedReadAheadMB * 1024 * 1024;
+    const FFFmpegSourceFactory FileProtocol;
+    const FFFmpegSourceFactory MappedFile = [ReadAhead](const FString& InPath) -> FFmpegIOSource* { return FFmpegMappedFileSource::Open(InPath, ReadAhead); };
+
+    if (!TestTrue(TEXT("File protocol reads the clip"), DemuxFile(Path, FileProtocol) > 0)
+        || !TestTrue(TEXT("Mapped file reads the clip"), DemuxFile(Path, MappedFile) > 0)) {
+        return false;
+    }
+    for (int32 NumReaders : { 1, 8, 32 }) {
+        const FReadResult File = RunReaders(Path, NumReaders, FileProtocol);
+        const FReadResult Mapped = RunReaders(Path, NumReaders, MappedFile);
+        TestEqual(FString::Printf(TEXT("%d readers: file protocol failures"), NumReaders), File.Failed, 0);
+        TestEqual(FString::Printf(TEXT("%d readers: mapped file failures"), NumReaders), Mapped.Failed, 0);
+        FFFmpegMediaTestUtils::Report(*this, FString::Printf(TEXT("file protocol: %s"), *File.ToString()));
+        FFFmpegMediaTestUtils::Report(*this, FString::Printf(TEXT("mapped file: %s"), *Mapped.ToString()));
+    }
+    return true;
+}
+
+/**
+ * 模拟较慢的存储或者网络(比如NAS)
+ * 每次请求有固定的延迟，传输受带宽限制，每隔若干次请求出现一次较长的停顿
+ */
+class FFFmpegSlowSource : public FFmpegIOSource
+{
+public:
+    FFFmpegSlowSource(FFmpegIOSource* InSource, double InLatency, double InBandwidth, int32 InHiccupInterval, double InHiccup)
+        : Source(InSource)
+        , Latency(InLatency)
+        , Bandwidth(InBandwidth)
+        , HiccupInterval(InHiccupInterval)
+        , Hiccup(InHiccup)
+        , Requests(0)
+    { }
+
+    virtual ~FFFmpegSlowSource()
+    {
+        delete this->Source;
+    }
+
+    virtual int Read(uint8_t* buf, int buf_size) override
+    {
+        int ret = this->Source->Read(buf, buf_size);
+        this->Delay(ret > 0 ? ret : 0);
+        return ret;
+    }
+
+    virtual int64_t SeekTo(int64_t pos) override
+    {
+        this->Delay(0);
+        return this->Source->SeekTo(pos);
+    }
+
+    virtual int64_t GetSize() const override { return this->Source->GetSize(); }
+    virtual int64_t GetPosition() const override { return this->Source->GetPosition(); }
+    virtual FString GetStats() const override { return FString::Printf(TEXT("slow source: %d requests; %s"), this->Requests, *this->Source->GetStats()); }
+    virtual void Abort() override { this->Source->Abort(); }
+
+private:
+    void Delay(int Bytes)
+    {
+        this->Requests++;
+        double Seconds = this->Latency + Bytes / this->Bandwidth;
+        if (this->HiccupInterval > 0 && this->Requests % this->HiccupInterval == 0) {
+            Seconds += this->Hiccup;
+        }
+        FPlatformProcess::Sleep((float)Seconds);
+    }
+
+private:
+    FFmpegIOSource* Source;
+    double Latency; //每次请求的延迟(秒)
+    double Bandwidth; //带宽(字节/秒)
+    int32 HiccupInterval; //每隔多少次请求停顿一次
+    double Hiccup; //停顿时长(秒)
+    int32 Requests;
+};
+
+/** 按照实时速度读取的结果 */
+struct FPacedResult
+{
+    bool Failed = false;
+    int32 Packets = 0;
+    int32 Stalls = 0;
+    double StallTime = 0.0;
+    double MaxStall = 0.0;
+    FString SourceStats;
+
+    FString ToString() const
+    {
+        return FString::Printf(TEXT("%d packets, %d stalls, stalled %.0f ms (max %.0f ms)%s; %s"),
+            Packets, Stalls, StallTime * 1000.0, MaxStall * 1000.0, Failed ? TEXT(", failed") : TEXT(""), *SourceStats);
+    }
+};
+
+/**
+ * 按照实时速度解复用，相当于播放器的读取线程和数据包队列
+ * 读取线程最多提前Buffer秒读取，数据包在显示时间之后才读到时记为一次卡顿，之后的时间轴顺延
+ * @param Source 数据源，由本函数释放
+ * @param Duration 读取的媒体时长(秒)
+ */
+static FPacedResult DemuxPaced(const FString& Path, FFmpegIOSource* Source, int BufferSize, double Duration, double Buffer)
+{
+    FPacedResult Result;
+    int ret = 0;
+    double first_pts = -1.0;
+    double start = 0.0;
+    AVIOContext* pb = FFmpegIOSource::CreateContext(Source, BufferSize);
+    AVPacket* pkt = av_packet_alloc();
+    AVFormatContext* ic = avformat_alloc_context();
+    if (!pb || !pkt || !ic) {
+        goto fail;
+    }
+    ic->pb = pb;
+    ret = avformat_open_input(&ic, TCHAR_TO_UTF8(*Path), NULL, NULL);
+    if (ret < 0) {
+        goto fail;
+    }
+    start = FPlatformTime::Seconds();
+    while ((ret = av_read_frame(ic, pkt)) >= 0) {
+        const int64_t ts = pkt->pts != AV_NOPTS_VALUE ? pkt->pts : pkt->dts;
+        if (ts == AV_NOPTS_VALUE) {
+            av_packet_unref(pkt);
+            continue;
+        }
+        const double pts = ts * av_q2d(ic->streams[pkt->stream_index]->time_base);
+        av_packet_unref(pkt);
+        Result.Packets++;
+        if (first_pts < 0.0) {
+            first_pts = pts;
+            start = FPlatformTime::Seconds();
+        }
+        if (pts - first_pts >= Duration) {
+            break;
+        }
+        //到达时已经超过显示时间，播放卡顿，之后的显示时间顺延
+        const double now = FPlatformTime::Seconds();
+        const double late = now - (start + pts - first_pts);
+        if (late > 0.0) {
+            Result.Stalls++;
+            Result.StallTime += late;
+            Result.MaxStall = FMath::Max(Result.MaxStall, late);
+            start += late;
+        }
+        //数据包队列已满时等待
+        const double wait = (start + pts - first_pts - Buffer) - now;
+        if (wait > 0.0) {
+            FPlatformProcess::Sleep((float)wait);
+        }
+    }
+    if (ret < 0 && ret != AVERROR_EOF) {
+        goto fail;
+    }
+    Result.SourceStats = FFmpegIOSource::FromContext(pb)->GetStats();
+    avformat_close_input(&ic);
+    FFmpegIOSource::FreeContext(&pb);
+    av_packet_free(&pkt);
+    return Result;
+fail:
+    if (pb) {
+        Result.SourceStats = FFmpegIOSource::FromContext(pb)->GetStats();
+    }
+    Result.Failed = true;
+    avformat_close_input(&ic);
+    FFmpegIOSource::FreeContext(&pb);
+    av_packet_free(&pkt);
+    return Result;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FFFmpegMediaReadAheadBenchmark, "FFmpegMedia.Benchmark.ReadAhead", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::PerfFilter)
+
+/**
+ * 较慢的数据源(每次请求30ms，8MB/s，每32次请求停顿1.5秒)直接读取与经过预读缓冲区读取对比
+ * 按照实时速度读取20秒，数据包队列最多提前1秒，输出卡顿次数和时长
+ */
+bool FFFmpegMediaReadAheadBenchmark::RunTest(const FString& Parameters)
+{
+    const FString Path = GetReadClip();
+    if (!TestFalse(TEXT("Benchmark clip is available"), Path.IsEmpty())) {
+        return false;
+    }
+    const auto Settings = GetDefault<UFFmpegMediaSettings>();
+    const int BufferSize = FMath::Max(Settings->IOBufferSizeKB, 4) * 1024;
+    const int64 ReadAheadSize = (int64)FMath::Max(Settings->ReadAheadSizeMB, 1) * 1024 * 1024;
+    const double Duration = 20.0;
+    const double Buffer = 1.0;
+
+    for (int32 ReadAhead = 0; ReadAhead < 2; ReadAhead++) {
+        const int abort_flag = 0;
+        FFmpegIOSource* Source = FFmpegProtocolSource::Open(Path, &abort_flag);
+        if (!TestNotNull(TEXT("Clip opened through the file protocol"), Source)) {
+            return false;
+        }
+        Source = new FFFmpegSlowSource(Source, 0.03, 8.0 * 1024 * 1024, 32, 1.5);
+        if (ReadAhead) {
+            Source = new FFmpegReadAheadSource(Source, ReadAheadSize, BufferSize);
+        }
+        const FPacedResult Result = DemuxPaced(Path, Source, BufferSize, Duration, Buffer);
+        TestFalse(FString::Printf(TEXT("%s: read without errors"), ReadAhead ? TEXT("read-ahead") : TEXT("direct")), Result.Failed);
+        FFFmpegMediaTestUtils::Report(*this, FString::Printf(TEXT("%s: %s"), ReadAhead ? TEXT("read-ahead") : TEXT("direct"), *Result.ToString()));
+    }
+    return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FFFmpegMediaIoUringBenchmark, "FFmpegMedia.Benchmark.IoUring", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::PerfFilter)
+
+/**
+ * io_uring(页缓存和O_DIRECT)与内存映射读取本地文件对比，1/8/32/64个读取线程同时解复用同一个文件
+ * 只在Linux上并且内核支持io_uring时运行，O_DIRECT读取不经过页缓存，吞吐量受存储设备限制
+ */
+bool FFFmpegMediaIoUringBenchmark::RunTest(const FString& Parameters)
+{
+    const FString Path = GetReadClip();
+    if (!TestFalse(TEXT("Benchmark clip is available"), Path.IsEmpty())) {
+        return false;
+    }
+    const auto Settings = GetDefault<UFFmpegMediaSettings>();
+    const int BlockSize = FMath::Max(Settings->IOBufferSizeKB, 4) * 1024;
+    const int QueueDepth = Settings->IoUringQueueDepth;
+    const int64 ReadAhead = (int64)Settings->MappedReadAheadMB * 1024 * 1024;
+
+    //检查io_uring是否可用(非Linux平台、内核不支持或者被seccomp禁止时返回空)
+    if (FFmpegIOSource* Probe = FFmpegUringFileSource::Open(Path, BlockSize, QueueDepth, false)) {
+        delete Probe;
+    }
+    else {
+        FFFmpegMediaTestUtils::Report(*this, TEXT("io_uring is not available on this platform, skipped"));
+        return true;
+    }
+
+    const FFFmpegSourceFactory MappedFile = [ReadAhead](const FString& InPath) -> FFmpegIOSource* { return FFmpegMappedFileSource::Open(InPath, ReadAhead); };
+    const FFFmpegSourceFactory IoUring = [BlockSize, QueueDepth](const FString& InPath) -> FFmpegIOSource* { return FFmpegUringFileSource::Open(InPath, BlockSize, QueueDepth, false); };
+    const FFFmpegSourceFactory IoUringDirect = [BlockSize, QueueDepth](const FString& InPath) -> FFmpegIOSource* { return FFmpegUringFileSource::Open(InPath, BlockSize, QueueDepth, true); };
+    if (!TestTrue(TEXT("Mapped file reads the clip"), DemuxFile(Path, MappedFile) > 0)
+        || !TestTrue(TEXT("io_uring reads the clip"), DemuxFile(Path, IoUring) > 0)
+        || !TestTrue(TEXT("io_uring with O_DIRECT reads the clip"), DemuxFile(Path, IoUringDirect) > 0)) {
+        return false;
+    }
+    FFFmpegMediaTestUtils::Report(*this, FString::Printf(TEXT("block %d KB, queue depth %d"), BlockSize / 1024, QueueDepth));
+    for (int32 NumReaders : { 1, 8, 32, 64 }) {
+        const FReadResult Mapped = RunReaders(Path, NumReaders, MappedFile);
+        const FReadResult Uring = RunReaders(Path, NumReaders, IoUring);
+        const FReadResult UringDirect = RunReaders(Path, NumReaders, IoUringDirect);
+        TestEqual(FString::Printf(TEXT("%d readers: mapped file failures"), NumReaders), Mapped.Failed, 0);
+        TestEqual(FString::Printf(TEXT("%d readers: io_uring failures"), NumReaders), Uring.Failed, 0);
+        TestEqual(FString::Printf(TEXT("%d readers: io_uring O_DIRECT failures"), NumReaders), UringDirect.Failed, 0);
+        FFFmpegMediaTestUtils::Report(*this, FString::Printf(TEXT("mapped file: %s"), *Mapped.ToString()));
+        FFFmpegMediaTestUtils::Report(*this, FString::Printf(TEXT("io_uring: %s"), *Uring.ToString()));
+        FFFmpegMediaTestUtils::Report(*this, FString::Printf(TEXT("io_uring O_DIRECT: %s"), *UringDirect.ToString()));
+    }
+    return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FFFmpegMediaHttpCacheBenchmark, "FFmpegMedia.Benchmark.HttpCache", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::PerfFilter)
+
+/**
+ * 从本地http服务器读取两次同一个文件，第一次读取之后整个文件都在磁盘缓存中，第二次读取不需要访问网络
+ * 地址中加入随机参数，每次运行使用新的缓存
+ */
+bool FFFmpegMediaHttpCacheBenchmark::RunTest(const FString& Parameters)
+{
+    FFFmpegMediaTestClip Clip;
+    Clip.Name = TEXT("http");
+    Clip.Duration = 10.0;
+    const FString Path = FFFmpegMediaTestUtils::GetClip(Clip);
+    if (!TestFalse(TEXT("Test clip is generated"), Path.IsEmpty())) {
+        return false;
+    }
+    FFFmpegMediaTestHttpServer Server;
+    if (!TestTrue(TEXT("Http server started"), Server.Start(Path))) {
+        return false;
+    }
+    const FString Url = Server.GetUrl() + TEXT("?run=") + FGuid::NewGuid().ToString();
+    const int64 FileSize = IFileManager::Get().FileSize(*Path);
+    const int64 MaxCacheSize = (int64)FMath::Max(GetDefault<UFFmpegMediaSettings>()->HttpCacheSizeMB, 64) * 1024 * 1024;
+    const int abort_flag = 0;
+    const FFFmpegSourceFactory HttpCache = [MaxCacheSize, &abort_flag](const FString& InUrl) -> FFmpegIOSource* {
+        FFmpegIOSource* Network = FFmpegProtocolSource::Open(InUrl, &abort_flag);
+        if (!Network) {
+            return nullptr;
+        }
+        FFmpegIOSource* Cache = FFmpegHttpCacheSource::Open(InUrl, Network, MaxCacheSize, &abort_flag);
+        if (!Cache) {
+            delete Network;
+        }
+        return Cache;
+    };
+
+    for (int32 Pass = 0; Pass < 2; Pass++) {
+        const TCHAR* Name = Pass == 0 ? TEXT("first play") : TEXT("second play");
+        const int32 RequestsBefore = Server.GetNumRequests();
+        const int64 SentBefore = Server.GetBytesSent();
+        int64 NetworkBytes = -1;
+        int64 DiskBytes = -1;
+        TArray<TPair<int64, int64>> Ranges;
+        const double Start = FPlatformTime::Seconds();
+        const int64 Bytes = DemuxFile(Url, HttpCache, [&](const FFmpegIOSource& Source) {
+            const FFmpegHttpCacheSource& Cache = static_cast<const FFmpegHttpCacheSource&>(Source);
+            NetworkBytes = Cache.GetNetworkBytes();
+            DiskBytes = Cache.GetDiskBytes();
+            Cache.GetCachedRanges(Ranges);
+        });
+        const double Elapsed = FPlatformTime::Seconds() - Start;
+        if (!TestTrue(FString::Printf(TEXT("%s: read through the http cache"), Name), Bytes > 0)) {
+            return false;
+        }
+        FFFmpegMediaTestUtils::Report(*this, FString::Printf(TEXT("%s: %.1f ms, network %lld bytes, disk %lld bytes, server sent %lld bytes in %d requests, %d cached ranges"),
+            Name, Elapsed * 1000.0, NetworkBytes, DiskBytes, Server.GetBytesSent() - SentBefore, Server.GetNumRequests() - RequestsBefore, Ranges.Num()));
+        if (Pass == 0) {
+            TestTrue(TEXT("first play: whole file is cached"), Ranges.Num() == 1 && Ranges[0].Key == 0 && Ranges[0].Value == FileSize);
+        }
+        else {
+            TestEqual(TEXT("second play: no bytes read from the network"), NetworkBytes, (int64)0);
+            TestTrue(TEXT("second play: read from the disk cache"), DiskBytes > 0);
+        }
+    }
+    return true;
+}
+
+/** 实时流测试使用的TS片段，关键帧间隔0.5秒，加入时很快能够解码 */
+static FString GetLiveClip()
+{
+    FFFmpegMediaTestClip Clip;
+    Clip.Name = TEXT("live");
+    Clip.Format = TEXT("ts");
+    Clip.Duration = 10.0;
+    Clip.GopSize = 15;
+    return FFFmpegMediaTestUtils::GetClip(Clip);
+}
+
+/** 播放实时流的结果 */
+struct FLiveResult
+{
+    /** 每个视频样本从发送到取出的延迟(秒) */
+    TArray<double> Latencies;
+
+    /** 取出视频样本的间隔超过2.5帧的次数 */
+    int32 Stalls = 0;
+
+    /** 取出视频样本的最大间隔(秒) */
+    double MaxGap = 0.0;
+
+    /** 延迟的平均值、95%分位数和最大值，卡顿次数 */
+    FString ToString() const
+    {
+        if (Latencies.Num() == 0) {
+            return TEXT("no samples");
+        }
+        TArray<double> Sorted = Latencies;
+        Sorted.Sort();
+        double Sum = 0.0;
+        for (double Latency : Sorted) {
+            Sum += Latency;
+        }
+        return FString::Printf(TEXT("latency avg %.0f ms, p95 %.0f ms, max %.0f ms (%d samples), %d stalls, max gap %.0f ms"), Sum / Sorted.Num() * 1000.0,
+            Sorted[FMath::Min(Sorted.Num() * 95 / 100, Sorted.Num() - 1)] * 1000.0, Sorted.Last() * 1000.0, Sorted.Num(), Stalls, MaxGap * 1000.0);
+    }
+};
+
+/**
+ * 打开实时流并在第一帧之后播放一段时间，测量发送到取出视频样本的延迟和卡顿
+ * @param OnTick 播放期间每次Tick之后调用(比如重启发送端)，返回false时结束
+ * @return 播放器没有收到第一帧时返回false
+ */
+static bool PlayLive(FFFmpegMediaTestPlayer& Player, const FFFmpegMediaTestUdpStreamer& Streamer, const FFFmpegMediaOpenOptions& OpenOptions,
+    double PlayTime, FLiveResult& OutResult, TFunctionRef<bool()> OnTick)
+{
+    const double FrameInterval = 1.0 / FFFmpegMediaTestClip().FrameRate;
+    double LastFetch = -1.0;
+    Player.OnVideoSample = [&Streamer, &OutResult, &LastFetch, FrameInterval](const IMediaTextureSample& Sample) {
+        const double Now = FPlatformTime::Seconds();
+        const double SendTime = Streamer.GetSendTime(Sample.GetTime().Time.GetTotalSeconds());
+        if (SendTime >= 0.0) {
+            OutResult.Latencies.Add(Now - SendTime);
+        }
+        if (LastFetch >= 0.0) {
+            OutResult.MaxGap = FMath::Max(OutResult.MaxGap, Now - LastFetch);
+            OutResult.Stalls += Now - LastFetch > FrameInterval * 2.5 ? 1 : 0;
+        }
+        LastFetch = Now;
+    };
+    if (!Player.Open(Streamer.GetUrl(), OpenOptions)
+        || !Player.TickUntil([&Player]() { return Player.FirstVideoTime >= 0.0; }, 10.0)) {
+        Player.OnVideoSample = nullptr;
+        return false;
+    }
+    //加入时打开期间缓存的数据会集中取出，从第一帧之后开始统计
+    OutResult = FLiveResult();
+    const double EndTime = FPlatformTime::Seconds() + PlayTime;
+    Player.TickUntil([&]() { return FPlatformTime::Seconds() >= EndTime || !OnTick(); }, PlayTime + 1.0);
+    Player.OnVideoSample = nullptr;
+    return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FFFmpegMediaLowLatencyBenchmark, "FFmpegMedia.Benchmark.LowLatency", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::PerfFilter)
+
+/**
+ * 本地UDP发送的TS实时流，普通模式与低延迟模式对比
+ * 输出加入时间(打开到第一帧)、发送到取出视频样本的延迟和低延迟模式下清空队列的次数
+ */
+bool FFFmpegMediaLowLatencyBenchmark::RunTest(const FString& Parameters)
+{
+    const FString Path = GetLiveClip();
+    if (!TestFalse(TEXT("Test clip is generated"), Path.IsEmpty())) {
+        return false;
+    }
+    for (int32 LowLatency = 0; LowLatency < 2; LowLatency++) {
+        const TCHAR* Name = LowLatency ? TEXT("low latency") : TEXT("default");
+        FFFmpegMediaTestUdpStreamer Streamer;
+        if (!TestTrue(FString::Printf(TEXT("%s: streamer started"), Name), Streamer.Start(Path))) {
+            return false;
+        }
+        FFFmpegMediaOpenOptions OpenOptions;
+        OpenOptions.LowLatency = LowLatency != 0;
+        FFFmpegMediaTestPlayer Player;
+        FLiveResult Result;
+        if (!TestTrue(FString::Printf(TEXT("%s: first frame received"), Name), PlayLive(Player, Streamer, OpenOptions, 10.0, Result, []() { return true; }))) {
+            continue;
+        }
+        const FFFmpegMediaTracksCounters Counters = Player.GetTracks().GetCounters();
+        TestTrue(FString::Printf(TEXT("%s: low latency mode is %s"), Name, LowLatency ? TEXT("on") : TEXT("off")), Counters.LowLatency == (LowLatency != 0));
+        FFFmpegMediaTestUtils::Report(*this, FString::Printf(TEXT("%s: join %.0f ms, %s, %d low latency drops"),
+            Name, Player.FirstVideoTime * 1000.0, *Result.ToString(), Counters.LowLatencyDrops));
+    }
+    return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FFFmpegMediaJitterBufferBenchmark, "FFmpegMedia.Benchmark.JitterBuffer", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::PerfFilter)
+
+/**
+ * 本地UDP发送的TS实时流，发送端随机停顿最多200ms，关闭和开启抖动缓冲对比
+ * 播放20秒，输出延迟、卡顿次数以及抖动缓冲的缓存时长、目标延迟、速度和缓存播放完的次数
+ */
+bool FFFmpegMediaJitterBufferBenchmark::RunTest(const FString& Parameters)
+{
+    const FString Path = GetLiveClip();
+    if (!TestFalse(TEXT("Test clip is generated"), Path.IsEmpty())) {
+        return false;
+    }
+    for (int32 Jitter = 0; Jitter < 2; Jitter++) {
+        const TCHAR* Name = Jitter ? TEXT("jitter buffer") : TEXT("no jitter buffer");
+        FFFmpegMediaTestUdpStreamer Streamer;
+        if (!TestTrue(FString::Printf(TEXT("%s: streamer started"), Name), Streamer.Start(Path, 0, 0.2))) {
+            return false;
+        }
+        FFFmpegMediaOpenOptions OpenOptions;
+        OpenOptions.JitterBufferTarget = Jitter ? 1000 : 0; //插件设置中默认关闭
+        FFFmpegMediaTestPlayer Player;
+        FLiveResult Result;
+        if (!TestTrue(FString::Printf(TEXT("%s: first frame received"), Name), PlayLive(Player, Streamer, OpenOptions, 20.0, Result, []() { return true; }))) {
+            continue;
+        }
+        const FFFmpegMediaTracksCounters Counters = Player.GetTracks().GetCounters();
+        TestTrue(FString::Printf(TEXT("%s: jitter buffer is %s"), Name, Jitter ? TEXT("on") : TEXT("off")), Counters.JitterBuffer == (Jitter != 0));
+        FFFmpegMediaTestUtils::Report(*this, FString::Printf(TEXT("%s: %s; buffered %.0f ms, target %.0f ms, speed %.3f, %d underruns"),
+            Name, *Result.ToString(), Counters.JitterLatency * 1000.0, Counters.JitterTarget * 1000.0, Counters.LiveSpeed, Counters.JitterUnderruns));
+    }
+    return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FFFmpegMediaReconnectBenchmark, "FFmpegMedia.Benchmark.Reconnect", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::PerfFilter)
+
+/**
+ * 本地UDP实时流播放3秒之后停止发送端，超过读取超时(ReconnectTimeoutMs)2秒之后在同一个端口重新开始发送
+ * 播放器需要自动重连并继续播放，输出重连次数、重连耗时和发送端恢复到重新取出视频样本的时间
+ */
+bool FFFmpegMediaReconnectBenchmark::RunTest(const FString& Parameters)
+{
+    const FString Path = GetLiveClip();
+    if (!TestFalse(TEXT("Test clip is generated"), Path.IsEmpty())) {
+        return false;
+    }
+    const auto Settings = GetDefault<UFFmpegMediaSettings>();
+    if (!Settings->bReconnectLive || Settings->ReconnectTimeoutMs <= 0) {
+        FFFmpegMediaTestUtils::Report(*this, TEXT("bReconnectLive is off or ReconnectTimeoutMs is 0, skipped"));
+        return true;
+    }
+    const double Downtime = Settings->ReconnectTimeoutMs / 1000.0 + 2.0;
+
+    FFFmpegMediaTestUdpStreamer Streamer;
+    if (!TestTrue(TEXT("Streamer started"), Streamer.Start(Path))) {
+        return false;
+    }
+    FFFmpegMediaTestPlayer Player;
+    FLiveResult Result;
+    double PlayStart = -1.0;
+    double StopTime = -1.0;
+    double RestartTime = -1.0;
+    double ResumeTime = -1.0;
+    int64 SamplesAtRestart = 0;
+    const bool Played = PlayLive(Player, Streamer, FFFmpegMediaOpenOptions(), 3.0 + Downtime + 15.0, Result, [&]() {
+        const double Now = FPlatformTime::Seconds();
+        if (PlayStart < 0.0) {
+            PlayStart = Now;
+        }
+        if (StopTime < 0.0 && Now >= PlayStart + 3.0) {
+            Streamer.Close();
+            StopTime = Now;
+        }
+        else if (StopTime >= 0.0 && RestartTime < 0.0 && Now >= StopTime + Downtime) {
+            Streamer.Start(Path, Streamer.GetPort());
+            RestartTime = Now;
+            SamplesAtRestart = Player.NumVideoSamples;
+        }
+        else if (RestartTime >= 0.0 && ResumeTime < 0.0 && Player.NumVideoSamples > SamplesAtRestart) {
+            ResumeTime = Now;
+        }
+        //恢复之后再播放3秒
+        return ResumeTime < 0.0 || Now < ResumeTime + 3.0;
+    });
+    if (!TestTrue(TEXT("First frame received"), Played)) {
+        return false;
+    }
+    const FFFmpegMediaTracksCounters Counters = Player.GetTracks().GetCounters();
+    TestTrue(TEXT("Streamer was restarted"), RestartTime >= 0.0);
+    TestTrue(TEXT("Reconnected"), Counters.ReconnectCount >= 1);
+    TestTrue(TEXT("Playback resumed after the streamer restarted"), ResumeTime >= 0.0);
+    FFFmpegMediaTestUtils::Report(*this, FString::Printf(TEXT("sender down %.1f s, %d reconnects, %d failed attempts, last reconnect %.0f ms, first sample %.0f ms after restart; %s"),
+        Downtime, Counters.ReconnectCount, Counters.ReconnectFailures, Counters.ReconnectLatencyLast * 1000.0,
+        ResumeTime >= 0.0 ? (ResumeTime - RestartTime) * 1000.0 : -1.0, *Result.ToString()));
+    return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FFFmpegMediaSharedSourceBenchmark, "FFmpegMedia.Benchmark.SharedSource", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::PerfFilter)
+
+/**
+ * 1、4、8、24个播放器同时循环播放同一个720p文件，共享媒体源与每个播放器单独解码对比
+ * 所有播放器都收到第一帧之后播放5秒，输出进程的CPU时间、每个播放器取出的视频样本数以及共享时转换和分发的样本数
+ */
+bool FFFmpegMediaSharedSourceBenchmark::RunTest(const FString& Parameters)
+{
+    FFFmpegMediaTestClip Clip;
+    Clip.Name = TEXT("shared");
+    Clip.Width = 1280;
+    Clip.Height = 720;
+    Clip.Duration = 10.0;
+    Clip.BitRate = 4000;
+    Clip.Audio = false;
+    const FString Path = FFFmpegMediaTestUtils::GetBenchmarkClip(Clip);
+    if (!TestFalse(TEXT("Benchmark clip is available"), Path.IsEmpty())) {
+        return false;
+    }
+
+    const double PlayTime = 5.0;
+    const int32 PlayerCounts[] = { 1, 4, 8, 24 };
+    for (int32 NumPlayers : PlayerCounts) {
+        for (int32 Shared = 1; Shared >= 0; Shared--) {
+            if (!Shared && GetDefault<UFFmpegMediaSettings>()->bShareSources) { //插件设置开启时所有播放器都会共用
+                continue;
+            }
+            const FString Name = FString::Printf(TEXT("%d players, %s"), NumPlayers, Shared ? TEXT("shared") : TEXT("separate"));
+            FFFmpegMediaOpenOptions OpenOptions;
+            OpenOptions.SharedSource = Shared != 0;
+            TArray<TUniquePtr<FFFmpegMediaTestPlayer>> Players;
+            TArray<FFFmpegMediaTestPlayer*> PlayerPtrs;
+            for (int32 i = 0; i < NumPlayers; i++) {
+                Players.Add(MakeUnique<FFFmpegMediaTestPlayer>());
+                PlayerPtrs.Add(Players.Last().Get());
+                TestTrue(FString::Printf(TEXT("%s: player %d opened"), *Name, i), Players.Last()->Open(Path, OpenOptions, true));
+            }
+            const bool Started = FFFmpegMediaTestPlayer::TickUntil(PlayerPtrs, [&]() {
+                return !PlayerPtrs.ContainsByPredicate([](const FFFmpegMediaTestPlayer* Player) { return Player->FirstVideoTime < 0.0; });
+            }, 20.0);
+            if (!TestTrue(FString::Printf(TEXT("%s: all players received the first frame"), *Name), Started)) {
+                continue;
+            }
+
+            const FFFmpegMediaTracksCounters StartCounters = Players[0]->GetTracks().GetCounters();
+            int64 StartSamples = 0;
+            for (const FFFmpegMediaTestPlayer* Player : PlayerPtrs) {
+                StartSamples += Player->NumVideoSamples;
+            }
+            const double CpuStart = FFFmpegMediaTestUtils::GetCpuSeconds();
+            const double EndTime = FPlatformTime::Seconds() + PlayTime;
+            FFFmpegMediaTestPlayer::TickUntil(PlayerPtrs, [&]() { return FPlatformTime::Seconds() >= EndTime; }, PlayTime + 1.0);
+            const double CpuSeconds = FFFmpegMediaTestUtils::GetCpuSeconds() - CpuStart;
+            const FFFmpegMediaTracksCounters Counters = Players[0]->GetTracks().GetCounters();
+            int64 Samples = -StartSamples;
+            for (const FFFmpegMediaTestPlayer* Player : PlayerPtrs) {
+                Samples += Player->NumVideoSamples;
+            }
+
+            FString Line = FString::Printf(TEXT("%s: cpu %.2f s (%.0f%% of one core), %.1f video samples/s per player"),
+                *Name, CpuSeconds, CpuSeconds / PlayTime * 100.0, Samples / PlayTime / NumPlayers);
+            if (Shared) {
+                const int64 Converted = Counters.SharedVideoSamples - StartCounters.SharedVideoSamples;
+                const int64 Delivered = Counters.SharedVideoDeliveries - StartCounters.SharedVideoDeliveries;
+                TestEqual(FString::Printf(TEXT("%s: all players share one source"), *Name), Counters.SharedPlayers, NumPlayers);
+                Line += FString::Printf(TEXT(", %lld samples converted, %lld delivered (%.1f per converted sample)"),
+                    Converted, Delivered, Delivered / FMath::Max<double>(Converted, 1.0));
+            }
+            FFFmpegMediaTestUtils::Report(*this, Line);
+        }
+    }
+    return true;
+}
+
+#endif //WITH_DEV_AUTOMATION_TESTS
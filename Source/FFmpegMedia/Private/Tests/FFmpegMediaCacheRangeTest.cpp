@@ -0,0 +1,99 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Tests/FFmpegMediaTestUtils.h"
+#include "FFmpegMedia.h"
+#include "IMediaTextureSample.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FFFmpegMediaCacheRangeTest, "FFmpegMedia.Cache.Ranges", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+/**
+ * 播放和seek时QueryCacheState报告的范围
+ * Loaded从当前播放位置之后开始(已经解码的帧不在队列中)，Pending从Loaded的结尾到媒体结尾，读取到结尾之后Loaded延伸到结尾并且没有Pending
+ */
+bool FFFmpegMediaCacheRangeTest::RunTest(const FString& Parameters)
+{
+    FFFmpegMediaTestClip Clip;
+    Clip.Name = TEXT("cacherange");
+    Clip.Duration = 6.0;
+    const FString Path = FFFmpegMediaTestUtils::GetClip(Clip);
+    if (!TestFalse(TEXT("Test clip is generated"), Path.IsEmpty())) {
+        return false;
+    }
+    const double FrameInterval = 1.0 / Clip.FrameRate;
+    const double MaxDecoded = 1.0; //帧队列和音频样本队列中已经解码的时长上限
+    const double SeekTarget = 5.2; //之后不到2秒(队列上限之内)，seek之后会读取到结尾
+
+    FFFmpegMediaOpenOptions OpenOptions;
+    OpenOptions.KeyframeIndex = false;
+    FFFmpegMediaTestPlayer Player;
+    double VideoTime = -1.0;
+    Player.OnVideoSample = [&VideoTime](const IMediaTextureSample& Sample) {
+        VideoTime = Sample.GetTime().Time.GetTotalSeconds();
+    };
+    if (!TestTrue(TEXT("Open"), Player.Open(Path, OpenOptions))
+        || !TestTrue(TEXT("First video sample"), Player.TickUntil([&]() { return VideoTime >= 0.0; }, 10.0))) {
+        return false;
+    }
+    FFFmpegMediaTracks& Tracks = Player.GetTracks();
+    const double Duration = Tracks.GetDuration().GetTotalSeconds();
+    Player.TickUntil([]() { return false; }, 0.5);
+
+    auto Query = [&Tracks](EMediaCacheState State) {
+        TRangeSet<FTimespan> RangeSet;
+        Tracks.QueryCacheState(State, RangeSet);
+        TArray<TRange<FTimespan>> Ranges;
+        RangeSet.GetRanges(Ranges);
+        return Ranges;
+    };
+    auto ToString = [](const TArray<TRange<FTimespan>>& Ranges) {
+        FString Result;
+        for (const TRange<FTimespan>& Range : Ranges) {
+            Result += FString::Printf(TEXT("[%.3f, %.3f) "), Range.GetLowerBoundValue().GetTotalSeconds(), Range.GetUpperBoundValue().GetTotalSeconds());
+        }
+        return Result.IsEmpty() ? FString(TEXT("none")) : Result;
+    };
+
+    //播放中: 一个Loaded范围在播放位置之后，Pending接在后面直到结尾
+    TArray<TRange<FTimespan>> Loaded = Query(EMediaCacheState::Loaded);
+    TArray<TRange<FTimespan>> Pending = Query(EMediaCacheState::Pending);
+    const double Position = VideoTime;
+    if (TestEqual(FString::Printf(TEXT("playing at %.3f s: one loaded range %s"), Position, *ToString(Loaded)), Loaded.Num(), 1)) {
+        const double Start = Loaded[0].GetLowerBoundValue().GetTotalSeconds();
+        const double End = Loaded[0].GetUpperBoundValue().GetTotalSeconds();
+        TestTrue(FString::Printf(TEXT("loaded range starts after the playback position %.3f s"), Position),
+            Start >= Position - FrameInterval && Start <= Position + MaxDecoded);
+        TestTrue(TEXT("loaded range is not empty and within the duration"), End > Start && End <= Duration + FrameInterval);
+        if (End < Duration - FrameInterval) {
+            TestTrue(FString::Printf(TEXT("pending range %s continues the loaded range to the end"), *ToString(Pending)),
+                Pending.Num() == 1 && FMath::Abs(Pending[0].GetLowerBoundValue().GetTotalSeconds() - End) <= FrameInterval
+                && FMath::Abs(Pending[0].GetUpperBoundValue().GetTotalSeconds() - Duration) <= FrameInterval);
+        }
+    }
+    FFFmpegMediaTestUtils::Report(*this, FString::Printf(TEXT("playing at %.3f s: loaded %s, pending %s"), Position, *ToString(Loaded), *ToString(Pending)));
+
+    //暂停之后seek: 队列清空之后从目标位置之前的关键帧重新读取，读取到结尾之后Loaded到结尾
+    Tracks.SetRate(0.0f);
+    const int32 Displayed = Tracks.GetCounters().SeekLatencyCount;
+    Tracks.Seek(FTimespan::FromSeconds(SeekTarget));
+    TestTrue(TEXT("seek is displayed"), Player.TickUntil([&]() { return Tracks.GetCounters().SeekLatencyCount > Displayed; }, 5.0));
+    const bool ReachedEnd = Player.TickUntil([&]() {
+        Loaded = Query(EMediaCacheState::Loaded);
+        return Loaded.Num() == 1 && Loaded[0].GetUpperBoundValue().GetTotalSeconds() >= Duration - FrameInterval;
+    }, 5.0);
+    Pending = Query(EMediaCacheState::Pending);
+    TestTrue(FString::Printf(TEXT("after the seek the loaded range %s reaches the end %.3f s"), *ToString(Loaded), Duration), ReachedEnd);
+    if (Loaded.Num() == 1) {
+        const double Start = Loaded[0].GetLowerBoundValue().GetTotalSeconds();
+        const double KeyFrame = FMath::FloorToDouble(SeekTarget * Clip.FrameRate / Clip.GopSize) * Clip.GopSize / Clip.FrameRate;
+        TestTrue(FString::Printf(TEXT("after the seek the loaded range starts between the key frame %.3f s and the end"), KeyFrame),
+            Start >= KeyFrame - FrameInterval && Start < Duration);
+    }
+    TestEqual(FString::Printf(TEXT("nothing is pending after reading to the end %s"), *ToString(Pending)), Pending.Num(), 0);
+    FFFmpegMediaTestUtils::Report(*this, FString::Printf(TEXT("paused after seek to %.1f s: loaded %s, pending %s"), SeekTarget, *ToString(Loaded), *ToString(Pending)));
+    return true;
+}
+
+#endif //WITH_DEV_AUTOMATION_TESTS
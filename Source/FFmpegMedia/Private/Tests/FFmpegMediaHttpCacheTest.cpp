@@ -0,0 +1,113 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Tests/FFmpegMediaTestUtils.h"
+#include "FFmpegMedia.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "FFmpegHttpCacheSource.h"
+#include "FFmpegProtocolSource.h"
+#include "FFmpegMediaSettings.h"
+#include "Misc/FileHelper.h"
+
+extern  "C" {
+#include "libavutil/error.h"
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FFFmpegMediaHttpCacheRevalidateTest, "FFmpegMedia.IO.HttpCache", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+/** 一次读取的结果 */
+struct FHttpCacheRead
+{
+    TArray<uint8> Data;
+    int64 DiskBytes = -1;
+    int64 NetworkBytes = -1;
+};
+
+/** 通过磁盘缓存顺序读取整个文件，打开失败时返回false */
+static bool ReadThroughCache(const FString& Url, int64 MaxCacheSize, FHttpCacheRead& OutRead)
+{
+    const int abort_flag = 0;
+    FFmpegIOSource* Network = FFmpegProtocolSource::Open(Url, &abort_flag);
+    if (!Network) {
+        return false;
+    }
+    FFmpegHttpCacheSource* Cache = FFmpegHttpCacheSource::Open(Url, Network, MaxCacheSize, &abort_flag);
+    if (!Cache) {
+        delete Network;
+        return false;
+    }
+    uint8 Buffer[32 * 1024];
+    int ret = 0;
+    while ((ret = Cache->Read(Buffer, sizeof(Buffer))) > 0) {
+        OutRead.Data.Append(Buffer, ret);
+    }
+    OutRead.DiskBytes = Cache->GetDiskBytes();
+    OutRead.NetworkBytes = Cache->GetNetworkBytes();
+    delete Cache; //保存索引
+    return ret == AVERROR_EOF;
+}
+
+/**
+ * 服务器上的文件大小不变但是内容被修改时，再次打开不能使用旧的缓存
+ * 分别测试服务器只返回ETag和只返回Last-Modified的情况，验证头没有变化时第二次读取全部来自磁盘
+ */
+bool FFFmpegMediaHttpCacheRevalidateTest::RunTest(const FString& Parameters)
+{
+    FFFmpegMediaTestClip Clip;
+    Clip.Name = TEXT("httpcache");
+    const FString Path = FFFmpegMediaTestUtils::GetClip(Clip);
+    TArray<uint8> Original;
+    if (!TestFalse(TEXT("Test clip is generated"), Path.IsEmpty()) || !TestTrue(TEXT("Test clip is loaded"), FFileHelper::LoadFileToArray(Original, *Path))) {
+        return false;
+    }
+    //大小相同内容不同的新版本
+    TArray<uint8> Modified = Original;
+    for (uint8& Byte : Modified) {
+        Byte = ~Byte;
+    }
+    FFFmpegMediaTestHttpServer Server;
+    if (!TestTrue(TEXT("Http server started"), Server.Start(Path))) {
+        return false;
+    }
+    const int64 MaxCacheSize = (int64)FMath::Max(GetDefault<UFFmpegMediaSettings>()->HttpCacheSizeMB, 64) * 1024 * 1024;
+    const FDateTime Now = FDateTime::UtcNow();
+
+    struct FRevalidateCase
+    {
+        const TCHAR* Name;
+        FString OldETag, NewETag;
+        FString OldLastModified, NewLastModified;
+    };
+    const FRevalidateCase Cases[] = {
+        { TEXT("ETag"), TEXT("\"v1\""), TEXT("\"v2\""), FString(), FString() },
+        { TEXT("Last-Modified"), FString(), FString(), (Now - FTimespan::FromDays(1)).ToHttpDate(), Now.ToHttpDate() },
+    };
+    for (const FRevalidateCase& Case : Cases) {
+        //每次运行使用新的地址，不受之前运行留下的缓存影响
+        const FString Url = Server.GetUrl() + TEXT("?run=") + FGuid::NewGuid().ToString();
+        Server.SetContent(Original, Case.OldETag, Case.OldLastModified);
+
+        FHttpCacheRead First, Second, Changed;
+        if (!TestTrue(FString::Printf(TEXT("%s: first read"), Case.Name), ReadThroughCache(Url, MaxCacheSize, First))
+            || !TestTrue(FString::Printf(TEXT("%s: second read"), Case.Name), ReadThroughCache(Url, MaxCacheSize, Second))) {
+            continue;
+        }
+        TestTrue(FString::Printf(TEXT("%s: first read matches the file"), Case.Name), First.Data == Original);
+        TestTrue(FString::Printf(TEXT("%s: second read matches the file"), Case.Name), Second.Data == Original);
+        TestEqual(FString::Printf(TEXT("%s: unchanged file is read from the disk cache"), Case.Name), Second.NetworkBytes, (int64)0);
+
+        Server.SetContent(Modified, Case.NewETag, Case.NewLastModified);
+        if (!TestTrue(FString::Printf(TEXT("%s: read after the file changed"), Case.Name), ReadThroughCache(Url, MaxCacheSize, Changed))) {
+            continue;
+        }
+        TestTrue(FString::Printf(TEXT("%s: changed file is not served from the stale cache"), Case.Name), Changed.Data == Modified);
+        TestEqual(FString::Printf(TEXT("%s: stale cache is dropped"), Case.Name), Changed.DiskBytes, (int64)0);
+        FFFmpegMediaTestUtils::Report(*this, FString::Printf(TEXT("%s: second read %lld disk / %lld network bytes, after change %lld disk / %lld network bytes"),
+            Case.Name, Second.DiskBytes, Second.NetworkBytes, Changed.DiskBytes, Changed.NetworkBytes));
+    }
+    return true;
+}
+
+#endif //WITH_DEV_AUTOMATION_TESTS
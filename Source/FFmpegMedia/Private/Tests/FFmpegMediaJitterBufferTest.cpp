@@ -0,0 +1,101 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Tests/FFmpegMediaTestUtils.h"
+#include "FFmpegMedia.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "FFmpegJitterBuffer.h"
+#include "Math/RandomStream.h"
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FFFmpegMediaJitterBufferTest, "FFmpegMedia.JitterBuffer.Converge", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+/**
+ * 模拟60秒的实时流: 30fps，网络延迟50ms，随机出现50~200ms的停顿，停顿期间发送的数据包在停顿结束时一起到达
+ * 播放从第一个数据包到达时开始(没有缓存)，抖动缓冲需要减速把缓存时长提高到目标延迟，后30秒不再卡顿，速度调整不超过上限
+ * 使用固定的随机种子，结果是确定的
+ */
+bool FFFmpegMediaJitterBufferTest::RunTest(const FString& Parameters)
+{
+    const double Target = 0.3;
+    const double MaxTarget = 1.0;
+    const double MaxSpeedChange = 0.05;
+    const double FrameInterval = 1.0 / 30.0;
+    const double NetworkDelay = 0.05;
+    const double Step = 0.01;
+    const int32 NumSteps = 6000;
+
+    //关闭时速度始终为1
+    FFmpegJitterBuffer Disabled;
+    Disabled.Configure(0.0, MaxTarget, MaxSpeedChange);
+    TestEqual(TEXT("Disabled jitter buffer keeps normal speed"), Disabled.Update(0.0, 1.0), 1.0);
+
+    //时间戳 -> 到达时间
+    TArray<TPair<double, double>> Packets;
+    FRandomStream Random(42);
+    double HoldUntil = 0.0;
+    for (int32 i = 0; i * FrameInterval < NumSteps * Step + 1.0; i++) {
+        const double Pts = i * FrameInterval;
+        if (Pts >= HoldUntil && Random.FRand() < 0.02f) {
+            HoldUntil = Pts + Random.FRandRange(0.05f, 0.2f);
+        }
+        Packets.Emplace(Pts, FMath::Max(Pts, HoldUntil) + NetworkDelay);
+    }
+
+    FFmpegJitterBuffer Buffer;
+    Buffer.Configure(Target, MaxTarget, MaxSpeedChange);
+    int32 Next = 0;
+    double Newest = NAN;
+    double Clock = NAN;
+    bool Stalled = false;
+    int32 Stalls = 0;
+    int32 LateStalls = 0;
+    double MinSpeed = 1.0;
+    double MaxSpeed = 1.0;
+    for (int32 i = 0; i < NumSteps; i++) {
+        const double Time = i * Step;
+        while (Next < Packets.Num() && Packets[Next].Value <= Time) {
+            Buffer.OnPacket(Packets[Next].Key, Packets[Next].Value);
+            Newest = Packets[Next].Key;
+            Next++;
+        }
+        if (FMath::IsNaN(Newest)) {
+            continue;
+        }
+        if (FMath::IsNaN(Clock)) {
+            Clock = Newest;
+        }
+        const double Speed = Buffer.Update(Newest - Clock, Time);
+        MinSpeed = FMath::Min(MinSpeed, Speed);
+        MaxSpeed = FMath::Max(MaxSpeed, Speed);
+
+        //已经播放到最新的数据包时停下来等待，记为一次卡顿
+        Clock += Speed * Step;
+        if (Clock > Newest) {
+            Clock = Newest;
+            if (!Stalled) {
+                Stalls++;
+                LateStalls += i >= NumSteps / 2 ? 1 : 0;
+            }
+            Stalled = true;
+        }
+        else {
+            Stalled = false;
+        }
+        if ((i + 1) % 500 == 0) {
+            FFFmpegMediaTestUtils::Report(*this, FString::Printf(TEXT("%2.0f s: buffered %.0f ms, smoothed %.0f ms, target %.0f ms, speed %.3f, %d stalls"),
+                Time + Step, (Newest - Clock) * 1000.0, Buffer.GetLatency() * 1000.0, Buffer.GetTarget() * 1000.0, Speed, Stalls));
+        }
+    }
+
+    TestEqual(TEXT("No stalls in the second half"), LateStalls, 0);
+    TestTrue(FString::Printf(TEXT("Speed stays within %.2f ~ %.2f (%.3f ~ %.3f)"), 1.0 - MaxSpeedChange, 1.0 + MaxSpeedChange, MinSpeed, MaxSpeed),
+        MinSpeed >= 1.0 - MaxSpeedChange - 1e-6 && MaxSpeed <= 1.0 + MaxSpeedChange + 1e-6);
+    TestTrue(FString::Printf(TEXT("Buffered time converges to the target (%.0f ms, target %.0f ms)"), Buffer.GetLatency() * 1000.0, Buffer.GetTarget() * 1000.0),
+        FMath::Abs(Buffer.GetLatency() - Buffer.GetTarget()) <= Buffer.GetTarget() * 0.35);
+    FFFmpegMediaTestUtils::Report(*this, FString::Printf(TEXT("%d stalls, %d in the second half, speed %.3f ~ %.3f; %s"), Stalls, LateStalls, MinSpeed, MaxSpeed, *Buffer.GetStats()));
+    return true;
+}
+
+#endif //WITH_DEV_AUTOMATION_TESTS
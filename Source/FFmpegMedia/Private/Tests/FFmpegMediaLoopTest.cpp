@@ -0,0 +1,83 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Tests/FFmpegMediaTestUtils.h"
+#include "FFmpegMedia.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FFFmpegMediaLoopGapTest, "FFmpegMedia.Loop.Gap", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+/**
+ * 循环播放一个1秒的片段，每次循环切换时多出的显示间隔(loop_gap_last)都需要小于一帧
+ * 分别测试拼接解码、数据包缓存回放和常驻片段三种循环方式，并检查实际使用的是这种方式
+ * 常驻片段不使用数据包缓存，第一次循环拼接解码
+ */
+bool FFFmpegMediaLoopGapTest::RunTest(const FString& Parameters)
+{
+    FFFmpegMediaTestClip Clip;
+    Clip.Name = TEXT("loop");
+    Clip.Duration = 1.0;
+    const FString Path = FFFmpegMediaTestUtils::GetClip(Clip);
+    if (!TestFalse(TEXT("Test clip is generated"), Path.IsEmpty())) {
+        return false;
+    }
+    const double FrameInterval = 1.0 / Clip.FrameRate;
+    const int32 NumLoops = 5;
+
+    struct FLoopCase
+    {
+        const TCHAR* Name;
+        bool ResidentClip;
+        int32 PacketCacheSize;
+        bool bReplays; //之后的循环从数据包缓存回放
+        bool bResident; //之后的循环从常驻片段播放
+    };
+    const FLoopCase Cases[] = {
+        { TEXT("splice"), false, 0, false, false },
+        { TEXT("packet cache"), false, -1, true, false },
+        { TEXT("resident clip"), true, 0, false, true },
+    };
+    for (const FLoopCase& Case : Cases) {
+        FFFmpegMediaOpenOptions OpenOptions;
+        OpenOptions.ResidentClip = Case.ResidentClip;
+        OpenOptions.PacketCacheSize = Case.PacketCacheSize;
+        FFFmpegMediaTestPlayer Player;
+        if (!TestTrue(FString::Printf(TEXT("%s: open"), Case.Name), Player.Open(Path, OpenOptions, true))) {
+            continue;
+        }
+
+        //每次显示到新的循环时检查这次切换多出的间隔
+        int32 LastLoop = 0;
+        int32 NumChecked = 0;
+        const bool Finished = Player.TickUntil([&]() {
+            const FFFmpegMediaTracksCounters Counters = Player.GetTracks().GetCounters();
+            if (Counters.LoopPresented > LastLoop) {
+                LastLoop = Counters.LoopPresented;
+                NumChecked++;
+                TestTrue(FString::Printf(TEXT("%s: gap at loop %d is %.2f ms, below one frame (%.2f ms)"), Case.Name, LastLoop, Counters.LoopGapLast * 1000.0, FrameInterval * 1000.0),
+                    Counters.LoopGapLast < FrameInterval);
+            }
+            return NumChecked >= NumLoops;
+        }, NumLoops * Clip.Duration + 10.0);
+        TestTrue(FString::Printf(TEXT("%s: played %d loops"), Case.Name, NumLoops), Finished);
+        TestEqual(FString::Printf(TEXT("%s: no open failure"), Case.Name), Player.NumEvents(EMediaEvent::MediaOpenFailed), 0);
+
+        const FFFmpegMediaTracksCounters Counters = Player.GetTracks().GetCounters();
+        TestTrue(FString::Printf(TEXT("%s: loops are spliced"), Case.Name), Counters.LoopSpliceCount > 0);
+        if (Case.bReplays) {
+            //第一次循环读取文件并缓存，之后的每次循环都从缓存回放
+            TestTrue(FString::Printf(TEXT("%s: %d loops replayed from the packet cache"), Case.Name, Counters.PacketCacheReplays), Counters.PacketCacheReplays >= NumLoops - 1);
+        }
+        else {
+            TestEqual(FString::Printf(TEXT("%s: no packet cache replay"), Case.Name), Counters.PacketCacheReplays, 0);
+        }
+        TestEqual(FString::Printf(TEXT("%s: playing from the resident clip"), Case.Name), Counters.ResidentPlaying, Case.bResident);
+        FFFmpegMediaTestUtils::Report(*this, FString::Printf(TEXT("%s: %d loops, %d splices, %d packet cache replays, resident %s, gap last %.2f ms, max %.2f ms, %lld video samples"),
+            Case.Name, LastLoop, Counters.LoopSpliceCount, Counters.PacketCacheReplays, Counters.ResidentPlaying ? TEXT("yes") : TEXT("no"),
+            Counters.LoopGapLast * 1000.0, Counters.LoopGapMax * 1000.0, Player.NumVideoSamples));
+    }
+    return true;
+}
+
+#endif //WITH_DEV_AUTOMATION_TESTS
@@ -0,0 +1,52 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Tests/FFmpegMediaTestUtils.h"
+#include "FFmpegMedia.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FFFmpegMediaPacketCacheReplayTest, "FFmpegMedia.Loop.PacketCache", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+/**
+ * 循环播放一个1秒的片段(关闭常驻片段)，第一次循环之后从数据包缓存回放
+ * 第二次循环开始显示之后，数据源不再读取任何数据，也不再调用解复用读取数据包
+ */
+bool FFFmpegMediaPacketCacheReplayTest::RunTest(const FString& Parameters)
+{
+    FFFmpegMediaTestClip Clip;
+    Clip.Name = TEXT("loop");
+    Clip.Duration = 1.0;
+    const FString Path = FFFmpegMediaTestUtils::GetClip(Clip);
+    if (!TestFalse(TEXT("Test clip is generated"), Path.IsEmpty())) {
+        return false;
+    }
+    const int32 NumLoops = 5;
+
+    FFFmpegMediaOpenOptions OpenOptions;
+    OpenOptions.ResidentClip = false;
+    OpenOptions.KeyframeIndex = false; //索引线程单独读取文件
+    FFFmpegMediaTestPlayer Player;
+    if (!TestTrue(TEXT("Open"), Player.Open(Path, OpenOptions, true))) {
+        return false;
+    }
+    FFFmpegMediaTracks& Tracks = Player.GetTracks();
+    //第一次循环读取到文件结尾时数据包已经全部缓存，第二次循环开始显示时已经在回放
+    if (!TestTrue(TEXT("Second loop is shown"), Player.TickUntil([&]() { return Tracks.GetCounters().LoopPresented >= 1; }, Clip.Duration + 10.0))) {
+        return false;
+    }
+    const FFFmpegMediaTracksCounters Before = Tracks.GetCounters();
+    const bool Finished = Player.TickUntil([&]() { return Tracks.GetCounters().LoopPresented >= NumLoops; }, NumLoops * Clip.Duration + 10.0);
+    const FFFmpegMediaTracksCounters After = Tracks.GetCounters();
+
+    TestTrue(FString::Printf(TEXT("played %d loops"), NumLoops), Finished);
+    TestTrue(TEXT("loops are replayed from the packet cache"), Before.PacketCacheReplays > 0 && After.PacketCacheReplays > Before.PacketCacheReplays);
+    TestEqual(TEXT("no demux read after the first loop"), After.DemuxReads - Before.DemuxReads, (int64)0);
+    TestEqual(TEXT("no source read after the first loop"), After.SourceBytesRead - Before.SourceBytesRead, (int64)0);
+    FFFmpegMediaTestUtils::Report(*this, FString::Printf(TEXT("first loop: %lld demux reads, %lld bytes read; loops %d to %d: %d replays, %lld demux reads, %lld bytes read"),
+        Before.DemuxReads, Before.SourceBytesRead, Before.LoopPresented, After.LoopPresented, After.PacketCacheReplays - Before.PacketCacheReplays,
+        After.DemuxReads - Before.DemuxReads, After.SourceBytesRead - Before.SourceBytesRead));
+    return true;
+}
+
+#endif //WITH_DEV_AUTOMATION_TESTS
@@ -0,0 +1,84 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Tests/FFmpegMediaTestUtils.h"
+#include "FFmpegMedia.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "HAL/FileManager.h"
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FFFmpegMediaPrecacheTest, "FFmpegMedia.IO.Precache", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+/**
+ * PrecacheFile打开片段的副本，加载完成之后删除副本，继续播放和seek
+ * 加载完成之后还读取磁盘(或者没有关闭文件)时删除失败或者播放出错
+ */
+bool FFFmpegMediaPrecacheTest::RunTest(const FString& Parameters)
+{
+    FFFmpegMediaTestClip Clip;
+    Clip.Name = TEXT("precache");
+    Clip.Duration = 4.0;
+    const FString Source = FFFmpegMediaTestUtils::GetClip(Clip);
+    if (!TestFalse(TEXT("Test clip is generated"), Source.IsEmpty())) {
+        return false;
+    }
+    const FString Path = FPaths::GetPath(Source) / TEXT("precache_copy.mp4");
+    if (!TestEqual(TEXT("Copy of the clip is written"), (int32)IFileManager::Get().Copy(*Path, *Source), (int32)COPY_OK)) {
+        return false;
+    }
+    const double Targets[] = { 3.0, 0.5, 2.2, 1.0 };
+
+    FFFmpegMediaOpenOptions OpenOptions;
+    OpenOptions.KeyframeIndex = false; //索引线程单独打开文件
+    OpenOptions.StreamInfoCache = false;
+    FFFmpegMediaTestPlayer Player;
+    Player.bPrecache = true;
+    //循环播放，seek时不会已经播放到结尾
+    if (!TestTrue(TEXT("Open"), Player.Open(Path, OpenOptions, true))
+        || !TestTrue(TEXT("First video sample"), Player.TickUntil([&]() { return Player.NumVideoSamples > 0; }, 10.0))) {
+        IFileManager::Get().Delete(*Path);
+        return false;
+    }
+    FFFmpegMediaTracks& Tracks = Player.GetTracks();
+
+    //等待加载完成，加载的范围覆盖整个时长
+    TRangeSet<FTimespan> Loading, Cached;
+    const bool Loaded = Player.TickUntil([&]() {
+        Loading.Empty();
+        return Tracks.QueryCacheState(EMediaCacheState::Loading, Loading) && Loading.IsEmpty();
+    }, 10.0);
+    Tracks.QueryCacheState(EMediaCacheState::Cached, Cached);
+    const FTimespan Duration = Tracks.GetDuration();
+    TestTrue(TEXT("file is loaded into memory"), Loaded);
+    TestTrue(TEXT("cached range covers the whole duration"), Cached.Contains(FTimespan::Zero()) && Cached.Contains(Duration - FTimespan::FromMilliseconds(1)));
+
+    //加载线程已经关闭文件，之后的读取都来自内存
+    const bool Deleted = IFileManager::Get().Delete(*Path);
+    TestTrue(TEXT("file is closed after loading and can be deleted"), Deleted);
+    TestFalse(TEXT("file is gone"), IFileManager::Get().FileExists(*Path));
+
+    const FFFmpegMediaTracksCounters Before = Tracks.GetCounters();
+    int32 Shown = 0;
+    for (double Target : Targets) {
+        const int32 Displayed = Tracks.GetCounters().SeekLatencyCount;
+        Tracks.Seek(FTimespan::FromSeconds(Target));
+        if (Player.TickUntil([&]() { return Tracks.GetCounters().SeekLatencyCount > Displayed; }, 5.0)) {
+            Shown++;
+        }
+        Player.TickUntil([]() { return false; }, 0.2);
+    }
+    const FFFmpegMediaTracksCounters After = Tracks.GetCounters();
+    TestEqual(TEXT("every seek after the file is deleted is displayed"), Shown, (int32)UE_ARRAY_COUNT(Targets));
+    TestTrue(TEXT("demuxer keeps reading from memory"), After.SourceBytesRead > Before.SourceBytesRead);
+    TestEqual(TEXT("no open or playback errors"), Player.NumEvents(EMediaEvent::MediaOpenFailed), 0);
+    FFFmpegMediaTestUtils::Report(*this, FString::Printf(TEXT("%d / %d seeks displayed after deleting the file, %lld bytes read from memory"),
+        Shown, (int32)UE_ARRAY_COUNT(Targets), After.SourceBytesRead - Before.SourceBytesRead));
+
+    if (!Deleted) {
+        IFileManager::Get().Delete(*Path);
+    }
+    return true;
+}
+
+#endif //WITH_DEV_AUTOMATION_TESTS
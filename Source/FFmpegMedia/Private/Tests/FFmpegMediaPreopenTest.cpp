@@ -0,0 +1,95 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Tests/FFmpegMediaTestUtils.h"
+#include "FFmpegMedia.h"
+#include "IMediaTextureSample.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FFFmpegMediaPreopenGapTest, "FFmpegMedia.Preopen.Gap", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+/**
+ * 播放列表切换时，测量上一个媒体最后一个视频样本到下一个媒体第一个视频样本的间隔
+ * 播放结束之后用同一个地址打开预打开的媒体，间隔不超过3帧；连续播放(Concatenate)时自动切换，多出的间隔小于一帧，并且不发送结束和打开事件
+ * 不预打开时正常打开的间隔只输出，作为对比
+ */
+bool FFFmpegMediaPreopenGapTest::RunTest(const FString& Parameters)
+{
+    FFFmpegMediaTestClip ClipA;
+    ClipA.Name = TEXT("preopen_a");
+    FFFmpegMediaTestClip ClipB;
+    ClipB.Name = TEXT("preopen_b");
+    const FString PathA = FFFmpegMediaTestUtils::GetClip(ClipA);
+    const FString PathB = FFFmpegMediaTestUtils::GetClip(ClipB);
+    if (!TestFalse(TEXT("Test clips are generated"), PathA.IsEmpty() || PathB.IsEmpty())) {
+        return false;
+    }
+    const double FrameInterval = 1.0 / ClipA.FrameRate;
+
+    enum class ESwitch
+    {
+        Open,        //播放结束之后正常打开
+        Preopened,   //播放结束之后打开预打开的媒体
+        Concatenate, //连续播放，播放结束时自动切换
+    };
+    struct FGapCase
+    {
+        const TCHAR* Name;
+        ESwitch Switch;
+        double MaxGap; //最后一个样本到第一个样本的最大间隔(秒)，0表示只输出
+    };
+    const FGapCase Cases[] = {
+        { TEXT("open"), ESwitch::Open, 0.0 },
+        { TEXT("preopened"), ESwitch::Preopened, FrameInterval * 3.0 },
+        { TEXT("concatenate"), ESwitch::Concatenate, FrameInterval * 2.0 },
+    };
+    for (const FGapCase& Case : Cases) {
+        FFFmpegMediaOpenOptions OpenOptions;
+        FFFmpegMediaTestPlayer Player;
+        double LastTime = -1.0;
+        double LastWall = 0.0;
+        double Gap = -1.0;
+        //连续播放时下一个媒体的时间接在当前媒体之后，否则从0开始
+        Player.OnVideoSample = [&](const IMediaTextureSample& Sample) {
+            const double Time = Sample.GetTime().Time.GetTotalSeconds();
+            const double Now = FPlatformTime::Seconds();
+            const bool Switched = Case.Switch == ESwitch::Concatenate ? Time >= ClipA.Duration - FrameInterval * 0.5 : Time < LastTime - 0.5;
+            if (Gap < 0.0 && LastTime >= 0.0 && Switched) {
+                Gap = Now - LastWall;
+            }
+            LastTime = Time;
+            LastWall = Now;
+        };
+        if (!TestTrue(FString::Printf(TEXT("%s: open"), Case.Name), Player.Open(PathA, OpenOptions))
+            || !TestTrue(FString::Printf(TEXT("%s: first video sample"), Case.Name), Player.TickUntil([&]() { return Player.NumVideoSamples > 0; }, 10.0))) {
+            continue;
+        }
+        if (Case.Switch != ESwitch::Open) {
+            TestTrue(FString::Printf(TEXT("%s: preopen"), Case.Name), Player.GetPlayer().PreopenNext(PathB, OpenOptions, Case.Switch == ESwitch::Concatenate));
+        }
+        if (Case.Switch != ESwitch::Concatenate) {
+            //与播放列表一样，收到播放结束事件之后打开下一个媒体
+            if (!TestTrue(FString::Printf(TEXT("%s: first media ends"), Case.Name), Player.TickUntil([&]() { return Player.NumEvents(EMediaEvent::PlaybackEndReached) > 0; }, ClipA.Duration + 10.0))) {
+                continue;
+            }
+            Player.Open(PathB, OpenOptions);
+        }
+        const bool Switched = Player.TickUntil([&]() { return Gap >= 0.0; }, ClipA.Duration + 10.0);
+        if (!TestTrue(FString::Printf(TEXT("%s: second media is shown"), Case.Name), Switched)) {
+            continue;
+        }
+        if (Case.MaxGap > 0.0) {
+            TestTrue(FString::Printf(TEXT("%s: gap between items %.1f ms is below %.1f ms"), Case.Name, Gap * 1000.0, Case.MaxGap * 1000.0), Gap < Case.MaxGap);
+        }
+        if (Case.Switch == ESwitch::Concatenate) {
+            TestEqual(FString::Printf(TEXT("%s: no end event"), Case.Name), Player.NumEvents(EMediaEvent::PlaybackEndReached), 0);
+            TestEqual(FString::Printf(TEXT("%s: no second open event"), Case.Name), Player.NumEvents(EMediaEvent::MediaOpened), 1);
+        }
+        FFFmpegMediaTestUtils::Report(*this, FString::Printf(TEXT("%s: gap between items %.1f ms (frame interval %.1f ms)"),
+            Case.Name, Gap * 1000.0, FrameInterval * 1000.0));
+    }
+    return true;
+}
+
+#endif //WITH_DEV_AUTOMATION_TESTS
@@ -0,0 +1,71 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Tests/FFmpegMediaTestUtils.h"
+#include "FFmpegMedia.h"
+#include "IMediaTextureSample.h"
+#include "IMediaAudioSample.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FFFmpegMediaRateSpeedTest, "FFmpegMedia.Rate.Speed", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+/**
+ * 按照0.5倍、1倍和2倍速播放，音频按照实时速度取出(模拟音频设备)
+ * 视频样本时间的前进速度(时钟速度)等于速率；音频变速不变调，每秒媒体时间输出的音频时长等于1/速率
+ */
+bool FFFmpegMediaRateSpeedTest::RunTest(const FString& Parameters)
+{
+    FFFmpegMediaTestClip Clip;
+    Clip.Name = TEXT("rate");
+    Clip.Duration = 10.0;
+    const FString Path = FFFmpegMediaTestUtils::GetClip(Clip);
+    if (!TestFalse(TEXT("Test clip is generated"), Path.IsEmpty())) {
+        return false;
+    }
+    const double Tolerance = 0.1;
+    const double Window = 2.0; //测量时长(秒)
+
+    const float Rates[] = { 0.5f, 1.0f, 2.0f };
+    for (float Rate : Rates) {
+        FFFmpegMediaOpenOptions OpenOptions;
+        FFFmpegMediaTestPlayer Player;
+        Player.bPaceAudio = true;
+        double VideoTime = -1.0;
+        double AudioTime = -1.0;
+        Player.OnVideoSample = [&VideoTime](const IMediaTextureSample& Sample) {
+            VideoTime = Sample.GetTime().Time.GetTotalSeconds();
+        };
+        Player.OnAudioSample = [&AudioTime](const IMediaAudioSample& Sample) {
+            AudioTime = Sample.GetTime().Time.GetTotalSeconds();
+        };
+        if (!TestTrue(FString::Printf(TEXT("%.1fx: open"), Rate), Player.Open(Path, OpenOptions))
+            || !TestTrue(FString::Printf(TEXT("%.1fx: first video sample"), Rate), Player.TickUntil([&]() { return VideoTime >= 0.0 && AudioTime >= 0.0; }, 10.0))) {
+            continue;
+        }
+        TestTrue(FString::Printf(TEXT("%.1fx: rate is accepted"), Rate), Player.GetTracks().SetRate(Rate));
+        //等待速率改变之前已经在队列中的样本播放完
+        Player.TickUntil([]() { return false; }, 0.5);
+
+        const double StartWall = FPlatformTime::Seconds();
+        const double StartVideo = VideoTime;
+        const double StartAudio = AudioTime;
+        const double StartAudioDuration = Player.AudioDuration;
+        Player.TickUntil([]() { return false; }, Window);
+        const double Wall = FPlatformTime::Seconds() - StartWall;
+
+        const double ClockSpeed = (VideoTime - StartVideo) / Wall;
+        const double AudioMedia = AudioTime - StartAudio;
+        const double AudioOutput = Player.AudioDuration - StartAudioDuration;
+        const double AudioStretch = AudioMedia > 0.0 ? AudioOutput / AudioMedia : 0.0;
+        TestTrue(FString::Printf(TEXT("%.1fx: clock speed %.3f is within %.0f%% of the rate"), Rate, ClockSpeed, Tolerance * 100.0),
+            FMath::Abs(ClockSpeed - Rate) <= Rate * Tolerance);
+        TestTrue(FString::Printf(TEXT("%.1fx: audio output per media second %.3f is within %.0f%% of %.3f"), Rate, AudioStretch, Tolerance * 100.0, 1.0 / Rate),
+            FMath::Abs(AudioStretch - 1.0 / Rate) <= Tolerance / Rate);
+        FFFmpegMediaTestUtils::Report(*this, FString::Printf(TEXT("%.1fx: video %.3f s and audio %.3f s of media in %.3f s, clock speed %.3f, audio output %.3f s (%.3f per media second)"),
+            Rate, VideoTime - StartVideo, AudioMedia, Wall, ClockSpeed, AudioOutput, AudioStretch));
+    }
+    return true;
+}
+
+#endif //WITH_DEV_AUTOMATION_TESTS
@@ -0,0 +1,85 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Tests/FFmpegMediaTestUtils.h"
+#include "FFmpegMedia.h"
+#include "IMediaTextureSample.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FFFmpegMediaReverseOrderTest, "FFmpegMedia.Reverse.Order", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+/**
+ * 从片段结尾附近倒放到开头，视频样本的时间严格递减，每一帧都只显示一次
+ * 分别测试没有B帧的片段和开放GOP的片段(关键帧之后的B帧显示在关键帧之前)
+ */
+bool FFFmpegMediaReverseOrderTest::RunTest(const FString& Parameters)
+{
+    struct FReverseCase
+    {
+        const TCHAR* Name;
+        int32 BFrames;
+    };
+    const FReverseCase Cases[] = {
+        { TEXT("closed GOP"), 0 },
+        { TEXT("open GOP"), 2 },
+    };
+    for (const FReverseCase& Case : Cases) {
+        FFFmpegMediaTestClip Clip;
+        Clip.Name = TEXT("reverse");
+        Clip.Duration = 3.0;
+        Clip.BFrames = Case.BFrames;
+        Clip.Audio = false;
+        const FString Path = FFFmpegMediaTestUtils::GetClip(Clip);
+        if (!TestFalse(FString::Printf(TEXT("%s: test clip is generated"), Case.Name), Path.IsEmpty())) {
+            continue;
+        }
+        const double FrameInterval = 1.0 / Clip.FrameRate;
+
+        FFFmpegMediaOpenOptions OpenOptions;
+        FFFmpegMediaTestPlayer Player;
+        if (!TestTrue(FString::Printf(TEXT("%s: open"), Case.Name), Player.Open(Path, OpenOptions))
+            || !TestTrue(FString::Printf(TEXT("%s: first video sample"), Case.Name), Player.TickUntil([&]() { return Player.NumVideoSamples > 0; }, 10.0))) {
+            continue;
+        }
+
+        //暂停之后跳到结尾附近，显示目标帧之后开始倒放
+        FFFmpegMediaTracks& Tracks = Player.GetTracks();
+        Tracks.SetRate(0.0f);
+        const int32 Displayed = Tracks.GetCounters().SeekLatencyCount;
+        Tracks.Seek(FTimespan::FromSeconds(Clip.Duration - 0.2));
+        Player.TickUntil([&]() { return Tracks.GetCounters().SeekLatencyCount > Displayed; }, 5.0);
+        Player.Tick(); //取出seek显示的帧
+
+        TArray<double> Times;
+        Player.OnVideoSample = [&Times](const IMediaTextureSample& Sample) {
+            Times.Add(Sample.GetTime().Time.GetTotalSeconds());
+        };
+        const int32 Ended = Player.NumEvents(EMediaEvent::PlaybackEndReached);
+        Tracks.SetRate(-2.0f);
+        const bool Finished = Player.TickUntil([&]() { return Player.NumEvents(EMediaEvent::PlaybackEndReached) > Ended; }, 10.0);
+        Player.OnVideoSample = nullptr;
+        TestTrue(FString::Printf(TEXT("%s: reverse playback reaches the start"), Case.Name), Finished);
+        if (!TestTrue(FString::Printf(TEXT("%s: reverse playback shows frames"), Case.Name), Times.Num() > 0)) {
+            continue;
+        }
+
+        int32 OutOfOrder = 0;
+        for (int32 i = 1; i < Times.Num(); i++) {
+            //时间相同表示同一帧显示了两次
+            if (Times[i] > Times[i - 1] - FrameInterval * 0.5) {
+                OutOfOrder++;
+                AddError(FString::Printf(TEXT("%s: frame %.3f s after %.3f s"), Case.Name, Times[i], Times[i - 1]));
+            }
+        }
+        TestEqual(FString::Printf(TEXT("%s: frames are in reverse order without duplicates"), Case.Name), OutOfOrder, 0);
+        //从第一帧到开头的每一帧都需要显示(开放GOP的B帧不能丢失)
+        const int32 Expected = FMath::RoundToInt(Times[0] / FrameInterval) + 1;
+        TestEqual(FString::Printf(TEXT("%s: every frame from %.3f s to the start is shown"), Case.Name, Times[0]), Times.Num(), Expected);
+        FFFmpegMediaTestUtils::Report(*this, FString::Printf(TEXT("%s: %d frames from %.3f s to %.3f s, expected %d"),
+            Case.Name, Times.Num(), Times[0], Times.Last(), Expected));
+    }
+    return true;
+}
+
+#endif //WITH_DEV_AUTOMATION_TESTS
@@ -0,0 +1,84 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Tests/FFmpegMediaTestUtils.h"
+#include "FFmpegMedia.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FFFmpegMediaSeekLatencyTest, "FFmpegMedia.Seek.Latency", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+/**
+ * 暂停状态下seek到不同的位置，测量seek请求到显示目标帧的延迟
+ * 程序中连续的seek请求(间隔小于一帧)都是精准seek；只有SetScrubbing之后才做关键帧seek，停止拖动时的精准seek不计入seek请求次数
+ */
+bool FFFmpegMediaSeekLatencyTest::RunTest(const FString& Parameters)
+{
+    FFFmpegMediaTestClip Clip;
+    Clip.Name = TEXT("seek");
+    Clip.Duration = 6.0;
+    const FString Path = FFFmpegMediaTestUtils::GetClip(Clip);
+    if (!TestFalse(TEXT("Test clip is generated"), Path.IsEmpty())) {
+        return false;
+    }
+    const double MaxLatency = 0.5; //640x360的片段最多解码一个GOP(1秒)
+    const double Targets[] = { 4.5, 1.2, 3.0, 0.5, 5.2, 2.7 };
+
+    FFFmpegMediaOpenOptions OpenOptions;
+    OpenOptions.KeyframeIndex = false; //索引在后台生成，结果不稳定
+    FFFmpegMediaTestPlayer Player;
+    if (!TestTrue(TEXT("Open"), Player.Open(Path, OpenOptions))) {
+        return false;
+    }
+    if (!TestTrue(TEXT("First video sample"), Player.TickUntil([&]() { return Player.NumVideoSamples > 0; }, 10.0))) {
+        return false;
+    }
+    FFFmpegMediaTracks& Tracks = Player.GetTracks();
+    Tracks.SetRate(0.0f);
+
+    //逐个seek，等待显示之后再seek下一个位置
+    double Total = 0.0, Max = 0.0;
+    for (double Target : Targets) {
+        const int32 Displayed = Tracks.GetCounters().SeekLatencyCount;
+        Tracks.Seek(FTimespan::FromSeconds(Target));
+        const bool Shown = Player.TickUntil([&]() { return Tracks.GetCounters().SeekLatencyCount > Displayed; }, 5.0);
+        const double Latency = Tracks.GetCounters().SeekLatencyLast;
+        TestTrue(FString::Printf(TEXT("seek to %.1f s is displayed in %.1f ms (limit %.0f ms)"), Target, Latency * 1000.0, MaxLatency * 1000.0),
+            Shown && Latency < MaxLatency);
+        Total += Latency;
+        Max = FMath::Max(Max, Latency);
+    }
+    FFFmpegMediaTestUtils::Report(*this, FString::Printf(TEXT("paused seek to display: avg %.1f ms, max %.1f ms over %d seeks"),
+        Total / UE_ARRAY_COUNT(Targets) * 1000.0, Max * 1000.0, (int32)UE_ARRAY_COUNT(Targets)));
+
+    //程序中连续的seek请求不当作拖动
+    FFFmpegMediaTracksCounters Before = Tracks.GetCounters();
+    for (double Target : Targets) {
+        Tracks.Seek(FTimespan::FromSeconds(Target));
+        Player.Tick();
+    }
+    Player.TickUntil([&]() { return Tracks.GetCounters().SeekLatencyCount > Before.SeekLatencyCount; }, 5.0);
+    FFFmpegMediaTracksCounters After = Tracks.GetCounters();
+    TestEqual(TEXT("back-to-back programmatic seeks are accurate"), After.ScrubSeekCount, Before.ScrubSeekCount);
+    TestEqual(TEXT("every programmatic seek is counted once"), (After.SeekCount + After.SeekCoalescedCount) - (Before.SeekCount + Before.SeekCoalescedCount), (int32)UE_ARRAY_COUNT(Targets));
+
+    //拖动时只做关键帧seek，停止拖动之后对最后的位置做一次不计数的精准seek
+    Before = After;
+    Tracks.SetScrubbing(true);
+    for (double Target : Targets) {
+        Tracks.Seek(FTimespan::FromSeconds(Target));
+        Player.TickUntil([]() { return false; }, 0.05);
+    }
+    Tracks.SetScrubbing(false);
+    const bool Settled = Player.TickUntil([&]() { return Tracks.GetCounters().ScrubSettleCount > Before.ScrubSettleCount; }, 5.0);
+    Player.TickUntil([]() { return false; }, 0.5);
+    After = Tracks.GetCounters();
+    TestTrue(TEXT("scrubbing uses key frame seeks"), After.ScrubSeekCount > Before.ScrubSeekCount);
+    TestTrue(TEXT("accurate seek after scrubbing ends"), Settled);
+    TestEqual(TEXT("settle seek is not counted as a request"), (After.SeekCount + After.SeekCoalescedCount) - (Before.SeekCount + Before.SeekCoalescedCount), (int32)UE_ARRAY_COUNT(Targets));
+    FFFmpegMediaTestUtils::Report(*this, FString::Printf(TEXT("scrub: %d key frame seeks, %d settle seeks, last latency %.1f ms"),
+        After.ScrubSeekCount - Before.ScrubSeekCount, After.ScrubSettleCount - Before.ScrubSettleCount, After.SeekLatencyLast * 1000.0));
+    return true;
+}
+
+#endif //WITH_DEV_AUTOMATION_TESTS
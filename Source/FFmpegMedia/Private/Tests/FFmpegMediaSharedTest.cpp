@@ -0,0 +1,64 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Tests/FFmpegMediaTestUtils.h"
+#include "FFmpegMedia.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FFFmpegMediaSharedLaggingTest, "FFmpegMedia.Shared.Lagging", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+/**
+ * 两个播放器共享媒体源，其中一个停止Tick(不再取出样本)
+ * 另一个播放器按照正常速度继续播放，停止的播放器的样本被丢弃；恢复Tick之后重新收到样本
+ */
+bool FFFmpegMediaSharedLaggingTest::RunTest(const FString& Parameters)
+{
+    FFFmpegMediaTestClip Clip;
+    Clip.Name = TEXT("shared");
+    Clip.Duration = 4.0;
+    const FString Path = FFFmpegMediaTestUtils::GetClip(Clip);
+    if (!TestFalse(TEXT("Test clip is generated"), Path.IsEmpty())) {
+        return false;
+    }
+    const double Window = 2.0;
+    const double MinRate = 0.8; //停止的播放器不影响时，取出的视频样本不少于帧率的80%
+
+    FFFmpegMediaOpenOptions OpenOptions;
+    OpenOptions.SharedSource = true;
+    FFFmpegMediaTestPlayer Active, Lagging;
+    FFFmpegMediaTestPlayer* const Both[] = { &Active, &Lagging };
+    if (!TestTrue(TEXT("Open active player"), Active.Open(Path, OpenOptions, true))
+        || !TestTrue(TEXT("Open lagging player"), Lagging.Open(Path, OpenOptions, true))
+        || !TestTrue(TEXT("Both players receive the first frame"), FFFmpegMediaTestPlayer::TickUntil(Both, [&]() { return Active.NumVideoSamples > 0 && Lagging.NumVideoSamples > 0; }, 10.0))) {
+        return false;
+    }
+    FFFmpegMediaTracks& Tracks = Active.GetTracks();
+    if (!TestEqual(TEXT("players share one source"), Tracks.GetCounters().SharedPlayers, 2)) {
+        return false;
+    }
+
+    //只驱动一个播放器，另一个播放器的样本队列很快会满
+    const FFFmpegMediaTracksCounters Before = Tracks.GetCounters();
+    const int64 ActiveBefore = Active.NumVideoSamples;
+    const double Start = FPlatformTime::Seconds();
+    Active.TickUntil([]() { return false; }, Window);
+    const double Wall = FPlatformTime::Seconds() - Start;
+    const FFFmpegMediaTracksCounters After = Tracks.GetCounters();
+    const double Rate = (Active.NumVideoSamples - ActiveBefore) / Wall;
+    TestTrue(FString::Printf(TEXT("active player keeps playing at %.1f frames/s (at least %.0f%% of %d)"), Rate, MinRate * 100.0, Clip.FrameRate),
+        Rate >= Clip.FrameRate * MinRate);
+    TestTrue(TEXT("samples for the lagging player are dropped"), After.SharedDroppedSamples > Before.SharedDroppedSamples);
+
+    //恢复驱动之后落后的播放器重新收到样本
+    const int64 LaggingBefore = Lagging.NumVideoSamples;
+    Lagging.Tick(); //取出队列中保留的样本
+    const int64 Queued = Lagging.NumVideoSamples - LaggingBefore;
+    const bool Resumed = FFFmpegMediaTestPlayer::TickUntil(Both, [&]() { return Lagging.NumVideoSamples > LaggingBefore + Queued; }, 2.0);
+    TestTrue(TEXT("lagging player receives samples again after it resumes"), Resumed);
+    FFFmpegMediaTestUtils::Report(*this, FString::Printf(TEXT("active %.1f frames/s while the other player is stalled, %lld samples dropped, %lld samples were queued for the stalled player"),
+        Rate, After.SharedDroppedSamples - Before.SharedDroppedSamples, Queued));
+    return true;
+}
+
+#endif //WITH_DEV_AUTOMATION_TESTS
@@ -0,0 +1,85 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Tests/FFmpegMediaTestUtils.h"
+#include "FFmpegMedia.h"
+#include "IMediaTextureSample.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FFFmpegMediaStepLatencyTest, "FFmpegMedia.Step.Latency", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+/**
+ * 关闭帧缓存(FrameCacheSize为0)，暂停之后在同一个GOP中逐帧后退和前进
+ * 第一次后退需要seek并把GOP中目标位置之前的帧放入逐帧缓冲，之后每次逐帧到显示的延迟都小于一帧的时长，并且显示的是相邻的帧
+ */
+bool FFFmpegMediaStepLatencyTest::RunTest(const FString& Parameters)
+{
+    FFFmpegMediaTestClip Clip;
+    Clip.Name = TEXT("step");
+    Clip.Duration = 4.0;
+    Clip.Audio = false;
+    const FString Path = FFFmpegMediaTestUtils::GetClip(Clip);
+    if (!TestFalse(TEXT("Test clip is generated"), Path.IsEmpty())) {
+        return false;
+    }
+    const double FrameInterval = 1.0 / Clip.FrameRate;
+    const double Start = 2.8; //GOP为1秒，从2.8秒后退10帧、前进5帧都在同一个GOP中
+    const int32 BackSteps = 10;
+    const int32 ForwardSteps = 5;
+
+    FFFmpegMediaOpenOptions OpenOptions;
+    OpenOptions.FrameCacheSize = 0;
+    OpenOptions.KeyframeIndex = false;
+    FFFmpegMediaTestPlayer Player;
+    double VideoTime = -1.0;
+    Player.OnVideoSample = [&VideoTime](const IMediaTextureSample& Sample) {
+        VideoTime = Sample.GetTime().Time.GetTotalSeconds();
+    };
+    if (!TestTrue(TEXT("Open"), Player.Open(Path, OpenOptions))) {
+        return false;
+    }
+    if (!TestTrue(TEXT("First video sample"), Player.TickUntil([&]() { return Player.NumVideoSamples > 0; }, 10.0))) {
+        return false;
+    }
+    FFFmpegMediaTracks& Tracks = Player.GetTracks();
+    Tracks.SetRate(0.0f);
+    const int32 Displayed = Tracks.GetCounters().SeekLatencyCount;
+    Tracks.Seek(FTimespan::FromSeconds(Start));
+    if (!TestTrue(TEXT("Paused seek is displayed"), Player.TickUntil([&]() { return Tracks.GetCounters().SeekLatencyCount > Displayed; }, 5.0))) {
+        return false;
+    }
+    Player.Tick(); //取出seek显示的帧
+
+    //逐帧并等待显示，返回显示的帧是否是相邻的帧
+    auto Step = [&](int32 NumFrames) {
+        const int32 Count = Tracks.GetCounters().StepLatencyCount;
+        const double Before = VideoTime;
+        Tracks.StepFrames(NumFrames);
+        const bool Shown = Player.TickUntil([&]() { return Tracks.GetCounters().StepLatencyCount > Count && VideoTime != Before; }, 5.0);
+        return Shown && FMath::Abs(VideoTime - (Before + NumFrames * FrameInterval)) < FrameInterval * 0.5;
+    };
+
+    //第一次后退时逐帧缓冲中只有当前帧，需要seek
+    TestTrue(TEXT("first step back shows the previous frame"), Step(-1));
+    const FFFmpegMediaTracksCounters First = Tracks.GetCounters();
+
+    double Max = 0.0;
+    for (int32 i = 0; i < BackSteps + ForwardSteps; i++) {
+        const int32 NumFrames = i < BackSteps ? -1 : 1;
+        const bool Adjacent = Step(NumFrames);
+        const double Latency = Tracks.GetCounters().StepLatencyLast;
+        TestTrue(FString::Printf(TEXT("step %+d to %.3f s shows the adjacent frame"), NumFrames, VideoTime), Adjacent);
+        TestTrue(FString::Printf(TEXT("step %+d to %.3f s is displayed in %.2f ms (limit %.2f ms)"), NumFrames, VideoTime, Latency * 1000.0, FrameInterval * 1000.0),
+            Latency < FrameInterval);
+        Max = FMath::Max(Max, Latency);
+    }
+    const FFFmpegMediaTracksCounters After = Tracks.GetCounters();
+    TestEqual(TEXT("steps inside the GOP do not seek"), After.SeekCount - First.SeekCount, 0);
+    TestEqual(TEXT("steps inside the GOP are served from the step buffer"), After.StepCacheHits - First.StepCacheHits, BackSteps + ForwardSteps);
+    FFFmpegMediaTestUtils::Report(*this, FString::Printf(TEXT("first step back %.1f ms, %d steps after it max %.2f ms, frame interval %.2f ms"),
+        First.StepLatencyLast * 1000.0, BackSteps + ForwardSteps, Max * 1000.0, FrameInterval * 1000.0));
+    return true;
+}
+
+#endif //WITH_DEV_AUTOMATION_TESTS
@@ -0,0 +1,733 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Tests/FFmpegMediaTestUtils.h"
+#include "FFmpegMedia.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "HAL/FileManager.h"
+#include "Misc/Paths.h"
+#include "Misc/CommandLine.h"
+#include "Misc/Parse.h"
+#include "IMediaSamples.h"
+#include "IMediaTextureSample.h"
+#include "IMediaAudioSample.h"
+#include "Async/Async.h"
+#include "HAL/RunnableThread.h"
+#include "Misc/FileHelper.h"
+#include "Sockets.h"
+#include "SocketSubsystem.h"
+#include "IPAddress.h"
+
+#if PLATFORM_WINDOWS
+#include "Windows/AllowWindowsPlatformTypes.h"
+#include <windows.h>
+#include "Windows/HideWindowsPlatformTypes.h"
+#else
+#include <sys/resource.h>
+#endif
+
+/** 编码一帧(为空时清空编码器)并写入输出的数据包 */
+static int write_encoded(AVFormatContext* oc, AVCodecContext* enc, AVStream* st, AVFrame* frame, AVPacket* pkt)
+{
+    int ret = avcodec_send_frame(enc, frame);
+    while (ret >= 0) {
+        ret = avcodec_receive_packet(enc, pkt);
+        if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
+            return 0;
+        }
+        if (ret < 0) {
+            return ret;
+        }
+        av_packet_rescale_ts(pkt, enc->time_base, st->time_base);
+        pkt->stream_index = st->index;
+        ret = av_interleaved_write_frame(oc, pkt);
+    }
+    return ret;
+}
+
+/** 创建编码器和对应的输出流 */
+static AVCodecContext* open_encoder(AVFormatContext* oc, const FFFmpegMediaTestClip& Clip, bool video, AVStream** out_st)
+{
+    const AVCodec* codec = avcodec_find_encoder(video ? AV_CODEC_ID_MPEG4 : AV_CODEC_ID_MP2);
+    AVCodecContext* enc = codec ? avcodec_alloc_context3(codec) : NULL;
+    if (!enc) {
+        return NULL;
+    }
+    if (video) {
+        enc->width = Clip.Width;
+        enc->height = Clip.Height;
+        enc->pix_fmt = AV_PIX_FMT_YUV420P;
+        enc->time_base = { 1, Clip.FrameRate };
+        enc->framerate = { Clip.FrameRate, 1 };
+        enc->gop_size = Clip.GopSize;
+        enc->max_b_frames = Clip.BFrames;
+        enc->bit_rate = (int64_t)Clip.BitRate * 1000;
+    }
+    else {
+        enc->sample_fmt = AV_SAMPLE_FMT_S16;
+        enc->sample_rate = 48000;
+        av_channel_layout_default(&enc->ch_layout, 2);
+        enc->time_base = { 1, enc->sample_rate };
+        enc->bit_rate = 192000;
+    }
+    if (oc->oformat->flags & AVFMT_GLOBALHEADER) {
+        enc->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+    }
+    AVStream* st = avcodec_open2(enc, codec, NULL) >= 0 ? avformat_new_stream(oc, NULL) : NULL;
+    if (!st || avcodec_parameters_from_context(st->codecpar, enc) < 0) {
+        avcodec_free_context(&enc);
+        return NULL;
+    }
+    st->time_base = enc->time_base;
+    *out_st = st;
+    return enc;
+}
+
+/** 画一帧移动的测试图像，每一帧都不同 */
+static void fill_video_frame(AVFrame* frame, int index)
+{
+    const int bar = (index * 8) % frame->width;
+    for (int y = 0; y < frame->height; y++) {
+        uint8_t* row = frame->data[0] + y * frame->linesize[0];
+        for (int x = 0; x < frame->width; x++) {
+            row[x] = (x >= bar && x < bar + 16) ? 235 : (uint8_t)((x + y + index * 4) & 0xff);
+        }
+    }
+    for (int y = 0; y < frame->height / 2; y++) {
+        memset(frame->data[1] + y * frame->linesize[1], 128 + (index & 0x3f), frame->width / 2);
+        memset(frame->data[2] + y * frame->linesize[2], 128 - (y & 0x3f), frame->width / 2);
+    }
+}
+
+/** 生成440Hz的正弦波 */
+static void fill_audio_frame(AVFrame* frame, int64_t first_sample)
+{
+    int16_t* samples = (int16_t*)frame->data[0];
+    for (int i = 0; i < frame->nb_samples; i++) {
+        int16_t value = (int16_t)(8000.0 * sin(2.0 * PI * 440.0 * (first_sample + i) / frame->sample_rate));
+        samples[2 * i] = value;
+        samples[2 * i + 1] = value;
+    }
+}
+
+FString FFFmpegMediaTestUtils::GetClip(const FFFmpegMediaTestClip& Clip)
+{
+    //参数不同的片段使用不同的文件
+    const FString FileName = FString::Printf(TEXT("%s_%dx%d_%d_%.1fs_g%d%s_%dk%s.%s"), *Clip.Name, Clip.Width, Clip.Height, Clip.FrameRate,
+        Clip.Duration, Clip.GopSize, Clip.BFrames > 0 ? *FString::Printf(TEXT("b%d"), Clip.BFrames) : TEXT(""), Clip.BitRate,
+        Clip.Audio ? TEXT("") : TEXT("_noaudio"), *Clip.Format);
+    const FString Path = FPaths::ConvertRelativePathToFull(FPaths::ProjectSavedDir() / TEXT("FFmpegMedia/Tests") / FileName);
+    if (IFileManager::Get().FileSize(*Path) > 0) {
+        return Path;
+    }
+    if (!WriteClip(Path, Clip)) {
+        UE_LOG(LogFFmpegMedia, Error, TEXT("Tests: failed to write clip %s"), *Path);
+        IFileManager::Get().Delete(*Path);
+        return FString();
+    }
+    return Path;
+}
+
+FString FFFmpegMediaTestUtils::GetBenchmarkClip(const FFFmpegMediaTestClip& Default)
+{
+    FString Path;
+    if (FParse::Value(FCommandLine::Get(), TEXT("FFmpegMediaBenchmarkClip="), Path) && !Path.IsEmpty()) {
+        return FPaths::ConvertRelativePathToFull(Path);
+    }
+    return GetClip(Default);
+}
+
+bool FFFmpegMediaTestUtils::WriteClip(const FString& Path, const FFFmpegMediaTestClip& Clip)
+{
+    IFileManager::Get().MakeDirectory(*FPaths::GetPath(Path), true);
+    FTCHARToUTF8 FileName(*Path);
+    AVFormatContext* oc = NULL;
+    AVCodecContext* venc = NULL;
+    AVCodecContext* aenc = NULL;
+    AVStream* vst = NULL;
+    AVStream* ast = NULL;
+    AVFrame* vframe = av_frame_alloc();
+    AVFrame* aframe = av_frame_alloc();
+    AVPacket* pkt = av_packet_alloc();
+    const int frames = FMath::Max((int)(Clip.Duration * Clip.FrameRate + 0.5), 1);
+    const int64_t total_samples = (int64_t)(Clip.Duration * 48000);
+    int64_t next_sample = 0;
+    int next_frame = 0;
+    int ret = -1;
+
+    if (!vframe || !aframe || !pkt || avformat_alloc_output_context2(&oc, NULL, NULL, FileName.Get()) < 0) {
+        goto fail;
+    }
+    venc = open_encoder(oc, Clip, true, &vst);
+    aenc = Clip.Audio ? open_encoder(oc, Clip, false, &ast) : NULL;
+    if (!venc || (Clip.Audio && !aenc)) {
+        goto fail;
+    }
+    vframe->format = venc->pix_fmt;
+    vframe->width = venc->width;
+    vframe->height = venc->height;
+    if (av_frame_get_buffer(vframe, 0) < 0) {
+        goto fail;
+    }
+    if (aenc) {
+        aframe->format = aenc->sample_fmt;
+        aframe->sample_rate = aenc->sample_rate;
+        aframe->nb_samples = aenc->frame_size;
+        av_channel_layout_copy(&aframe->ch_layout, &aenc->ch_layout);
+        if (av_frame_get_buffer(aframe, 0) < 0) {
+            goto fail;
+        }
+    }
+    if (!(oc->oformat->flags & AVFMT_NOFILE) && avio_open(&oc->pb, FileName.Get(), AVIO_FLAG_WRITE) < 0) {
+        goto fail;
+    }
+    if (avformat_write_header(oc, NULL) < 0) {
+        goto fail;
+    }
+
+    //按照时间交错写入视频和音频
+    while (next_frame < frames || (aenc && next_sample < total_samples)) {
+        const bool write_video = next_frame < frames
+            && (!aenc || next_sample >= total_samples || av_compare_ts(next_frame, venc->time_base, next_sample, aenc->time_base) <= 0);
+        if (write_video) {
+            if (av_frame_make_writable(vframe) < 0) {
+                goto fail;
+            }
+            fill_video_frame(vframe, next_frame);
+            vframe->pts = next_frame++;
+            if (write_encoded(oc, venc, vst, vframe, pkt) < 0) {
+                goto fail;
+            }
+        }
+        else {
+            if (av_frame_make_writable(aframe) < 0) {
+                goto fail;
+            }
+            fill_audio_frame(aframe, next_sample);
+            aframe->pts = next_sample;
+            next_sample += aframe->nb_samples;
+            if (write_encoded(oc, aenc, ast, aframe, pkt) < 0) {
+                goto fail;
+            }
+        }
+    }
+    if (write_encoded(oc, venc, vst, NULL, pkt) < 0 || (aenc && write_encoded(oc, aenc, ast, NULL, pkt) < 0)) {
+        goto fail;
+    }
+    ret = av_write_trailer(oc);
+fail:
+    avcodec_free_context(&venc);
+    avcodec_free_context(&aenc);
+    av_frame_free(&vframe);
+    av_frame_free(&aframe);
+    av_packet_free(&pkt);
+    if (oc) {
+        if (!(oc->oformat->flags & AVFMT_NOFILE)) {
+            avio_closep(&oc->pb);
+        }
+        avformat_free_context(oc);
+    }
+    return ret >= 0;
+}
+
+double FFFmpegMediaTestUtils::GetCpuSeconds()
+{
+#if PLATFORM_WINDOWS
+    FILETIME CreationTime, ExitTime, KernelTime, UserTime;
+    if (!::GetProcessTimes(::GetCurrentProcess(), &CreationTime, &ExitTime, &KernelTime, &UserTime)) {
+        return 0.0;
+    }
+    const uint64 Kernel = ((uint64)KernelTime.dwHighDateTime << 32) | KernelTime.dwLowDateTime;
+    const uint64 User = ((uint64)UserTime.dwHighDateTime << 32) | UserTime.dwLowDateTime;
+    return (Kernel + User) / 10000000.0; //100纳秒
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0.0;
+    }
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000000.0;
+#endif
+}
+
+void FFFmpegMediaTestUtils::Report(FAutomationTestBase& Test, const FString& Line)
+{
+    Test.AddInfo(Line);
+    UE_LOG(LogFFmpegMedia, Display, TEXT("%s: %s"), *Test.GetTestName(), *Line);
+}
+
+FFFmpegMediaTestPlayer::FFFmpegMediaTestPlayer()
+{
+    this->Player = MakeShared<FFmpegMediaPlayer, ESPMode::ThreadSafe>(*this);
+}
+
+FFFmpegMediaTestPlayer::~FFFmpegMediaTestPlayer()
+{
+    //播放器持有事件接收器的引用，需要先关闭
+    this->Player->Close();
+    this->Player.Reset();
+}
+
+bool FFFmpegMediaTestPlayer::Open(const FString& Url, const FFFmpegMediaOpenOptions& OpenOptions, bool bInLooping)
+{
+    this->bLooping = bInLooping;
+    this->OpenTime = FPlatformTime::Seconds();
+    this->FirstVideoTime = -1.0;
+    this->AudioStartTime = -1.0;
+    this->AudioDuration = 0.0;
+    return this->Player->OpenUrl(Url, this->bPrecache, OpenOptions);
+}
+
+void FFFmpegMediaTestPlayer::Tick()
+{
+    const double Now = FPlatformTime::Seconds();
+    const FTimespan DeltaTime = FTimespan::FromSeconds(this->LastTickTime > 0.0 ? Now - this->LastTickTime : 0.0);
+    this->LastTickTime = Now;
+    this->Player->TickInput(DeltaTime, FTimespan::FromSeconds(Now));
+
+    TArray<EMediaEvent> NewEvents;
+    {
+        FScopeLock Lock(&this->EventsMutex);
+        for (int32 i = this->NumHandledEvents; i < this->Events.Num(); i++) {
+            NewEvents.Add(this->Events[i]);
+        }
+        this->NumHandledEvents = this->Events.Num();
+    }
+    for (EMediaEvent Event : NewEvents) {
+        if (Event == EMediaEvent::MediaOpened) {
+            this->StartPlayback();
+        }
+    }
+
+    //没有媒体纹理和音频输出，取出所有样本，否则队列满了之后解码会停下来
+    IMediaSamples& Samples = this->Player->GetSamples();
+    TSharedPtr<IMediaTextureSample, ESPMode::ThreadSafe> VideoSample;
+    while (Samples.FetchVideo(TRange<FTimespan>::All(), VideoSample)) {
+        if (this->FirstVideoTime < 0.0) {
+            this->FirstVideoTime = FPlatformTime::Seconds() - this->OpenTime;
+        }
+        this->NumVideoSamples++;
+        if (this->OnVideoSample) {
+            this->OnVideoSample(*VideoSample);
+        }
+    }
+    TSharedPtr<IMediaAudioSample, ESPMode::ThreadSafe> AudioSample;
+    for (;;) {
+        //模拟音频设备时只取出到当前时间为止需要播放的样本(提前100毫秒)
+        if (this->bPaceAudio && this->AudioStartTime >= 0.0 && this->AudioDuration > FPlatformTime::Seconds() - this->AudioStartTime + 0.1) {
+            break;
+        }
+        if (!Samples.FetchAudio(TRange<FTimespan>::All(), AudioSample)) {
+            break;
+        }
+        if (this->AudioStartTime < 0.0) {
+            this->AudioStartTime = FPlatformTime::Seconds();
+        }
+        this->NumAudioSamples++;
+        if (AudioSample->GetSampleRate() > 0) {
+            this->AudioDuration += (double)AudioSample->GetFrames() / AudioSample->GetSampleRate();
+        }
+        if (this->OnAudioSample) {
+            this->OnAudioSample(*AudioSample);
+        }
+    }
+}
+
+bool FFFmpegMediaTestPlayer::TickUntil(TFunctionRef<bool()> Condition, double Timeout)
+{
+    FFFmpegMediaTestPlayer* Self = this;
+    return TickUntil(MakeArrayView(&Self, 1), Condition, Timeout);
+}
+
+bool FFFmpegMediaTestPlayer::TickUntil(TArrayView<FFFmpegMediaTestPlayer* const> Players, TFunctionRef<bool()> Condition, double Timeout)
+{
+    const double EndTime = FPlatformTime::Seconds() + Timeout;
+    while (FPlatformTime::Seconds() < EndTime) {
+        for (FFFmpegMediaTestPlayer* TestPlayer : Players) {
+            TestPlayer->Tick();
+        }
+        if (Condition()) {
+            return true;
+        }
+        FPlatformProcess::Sleep(0.002f);
+    }
+    return false;
+}
+
+int32 FFFmpegMediaTestPlayer::NumEvents(EMediaEvent Event) const
+{
+    FScopeLock Lock(&this->EventsMutex);
+    int32 Num = 0;
+    for (EMediaEvent Received : this->Events) {
+        Num += Received == Event ? 1 : 0;
+    }
+    return Num;
+}
+
+FFmpegMediaPlayer& FFFmpegMediaTestPlayer::GetPlayer()
+{
+    return *this->Player;
+}
+
+FFFmpegMediaTracks& FFFmpegMediaTestPlayer::GetTracks()
+{
+    return static_cast<FFFmpegMediaTracks&>(this->Player->GetTracks());
+}
+
+void FFFmpegMediaTestPlayer::ReceiveMediaEvent(EMediaEvent Event)
+{
+    FScopeLock Lock(&this->EventsMutex);
+    this->Events.Add(Event);
+}
+
+void FFFmpegMediaTestPlayer::StartPlayback()
+{
+    //与FMediaPlayerFacade::SelectDefaultTracks一样选择第一个音频和视频轨道
+    FFFmpegMediaTracks& Tracks = this->GetTracks();
+    if (Tracks.GetNumTracks(EMediaTrackType::Audio) > 0 && Tracks.GetSelectedTrack(EMediaTrackType::Audio) == INDEX_NONE) {
+        Tracks.SelectTrack(EMediaTrackType::Audio, 0);
+    }
+    if (Tracks.GetNumTracks(EMediaTrackType::Video) > 0 && Tracks.GetSelectedTrack(EMediaTrackType::Video) == INDEX_NONE) {
+        Tracks.SelectTrack(EMediaTrackType::Video, 0);
+    }
+    Tracks.SetLooping(this->bLooping);
+    Tracks.SetRate(1.0f);
+}
+
+FFFmpegMediaTestHttpServer::FFFmpegMediaTestHttpServer()
+    : Listener(nullptr)
+    , Port(0)
+    , Thread(nullptr)
+    , StopRequest(false)
+    , NumRequests(0)
+    , BytesSent(0)
+{
+}
+
+FFFmpegMediaTestHttpServer::~FFFmpegMediaTestHttpServer()
+{
+    this->Close();
+}
+
+bool FFFmpegMediaTestHttpServer::Start(const FString& Path)
+{
+    if (!FFileHelper::LoadFileToArray(this->Data, *Path)) {
+        return false;
+    }
+    this->FileName = FPaths::GetCleanFilename(Path);
+    this->ETag = FString::Printf(TEXT("\"%08x\""), FCrc::MemCrc32(this->Data.GetData(), this->Data.Num()));
+    this->LastModified = IFileManager::Get().GetTimeStamp(*Path).ToHttpDate();
+
+    ISocketSubsystem* SocketSubsystem = ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM);
+    TSharedRef<FInternetAddr> Addr = SocketSubsystem->CreateInternetAddr();
+    bool bValid = false;
+    Addr->SetIp(TEXT("127.0.0.1"), bValid);
+    Addr->SetPort(0); //使用空闲端口
+    this->Listener = SocketSubsystem->CreateSocket(NAME_Stream, TEXT("FFmpegMediaTestHttpServer"), Addr->GetProtocolType());
+    if (!this->Listener || !this->Listener->Bind(*Addr) || !this->Listener->Listen(16)) {
+        this->Close();
+        return false;
+    }
+    this->Listener->GetAddress(*Addr);
+    this->Port = Addr->GetPort();
+    this->StopRequest = false;
+    this->Thread = FRunnableThread::Create(this, TEXT("FFmpegMediaTestHttpServer"));
+    return this->Thread != nullptr;
+}
+
+void FFFmpegMediaTestHttpServer::Close()
+{
+    if (this->Thread) {
+        this->Thread->Kill(true);
+        delete this->Thread;
+        this->Thread = nullptr;
+    }
+    this->StopRequest = true;
+    for (TFuture<void>& Connection : this->Connections) {
+        Connection.Wait();
+    }
+    this->Connections.Reset();
+    if (this->Listener) {
+        this->Listener->Close();
+        ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM)->DestroySocket(this->Listener);
+        this->Listener = nullptr;
+    }
+}
+
+FString FFFmpegMediaTestHttpServer::GetUrl() const
+{
+    return FString::Printf(TEXT("http://127.0.0.1:%d/%s"), this->Port, *this->FileName);
+}
+
+void FFFmpegMediaTestHttpServer::SetContent(const TArray<uint8>& InData, const FString& InETag, const FString& InLastModified)
+{
+    this->Data = InData;
+    this->ETag = InETag;
+    this->LastModified = InLastModified;
+}
+
+uint32 FFFmpegMediaTestHttpServer::Run()
+{
+    while (!this->StopRequest) {
+        bool bPending = false;
+        if (!this->Listener->WaitForPendingConnection(bPending, FTimespan::FromMilliseconds(50))) {
+            break;
+        }
+        if (!bPending) {
+            continue;
+        }
+        FSocket* Client = this->Listener->Accept(TEXT("FFmpegMediaTestHttpConnection"));
+        if (Client) {
+            this->Connections.Add(Async(EAsyncExecution::Thread, [this, Client]() { this->HandleConnection(Client); }));
+        }
+    }
+    return 0;
+}
+
+void FFFmpegMediaTestHttpServer::Stop()
+{
+    this->StopRequest = true;
+}
+
+void FFFmpegMediaTestHttpServer::HandleConnection(FSocket* Client)
+{
+    //读取请求头，客户端5秒内没有发送完整的请求时关闭连接
+    FString Request;
+    uint8 Chunk[4096];
+    const double Timeout = FPlatformTime::Seconds() + 5.0;
+    while (!this->StopRequest && !Request.Contains(TEXT("\r\n\r\n")) && FPlatformTime::Seconds() < Timeout) {
+        if (!Client->Wait(ESocketWaitConditions::WaitForRead, FTimespan::FromMilliseconds(50))) {
+            continue;
+        }
+        int32 BytesRead = 0;
+        if (!Client->Recv(Chunk, sizeof(Chunk), BytesRead) || BytesRead <= 0) {
+            break;
+        }
+        Request += FString(BytesRead, (const ANSICHAR*)Chunk);
+    }
+
+    const int64 Size = this->Data.Num();
+    FString Header;
+    int64 Start = 0;
+    int64 End = Size - 1;
+    if (Request.Contains(TEXT("\r\n\r\n"))) {
+        this->NumRequests++;
+        //只支持单个范围"Range: bytes=start-[end]"
+        const int32 RangeIndex = Request.Find(TEXT("\r\nRange: bytes="), ESearchCase::IgnoreCase);
+        if (RangeIndex != INDEX_NONE) {
+            FString Value = Request.Mid(RangeIndex + 15);
+            Value.LeftInline(Value.Find(TEXT("\r\n")));
+            FString First, Last;
+            Value.Split(TEXT("-"), &First, &Last);
+            Start = FCString::Atoi64(*First);
+            if (!Last.IsEmpty()) {
+                End = FMath::Min(FCString::Atoi64(*Last), Size - 1);
+            }
+            if (Start >= Size || Start > End) {
+                Header = FString::Printf(TEXT("HTTP/1.1 416 Range Not Satisfiable\r\nContent-Range: bytes */%lld\r\nContent-Length: 0\r\nConnection: close\r\n\r\n"), Size);
+                End = Start - 1;
+            }
+            else {
+                Header = FString::Printf(TEXT("HTTP/1.1 206 Partial Content\r\nContent-Range: bytes %lld-%lld/%lld\r\n"), Start, End, Size);
+            }
+        }
+        else {
+            Header = TEXT("HTTP/1.1 200 OK\r\n");
+        }
+        if (Start <= End) {
+            if (!this->ETag.IsEmpty()) {
+                Header += FString::Printf(TEXT("ETag: %s\r\n"), *this->ETag);
+            }
+            if (!this->LastModified.IsEmpty()) {
+                Header += FString::Printf(TEXT("Last-Modified: %s\r\n"), *this->LastModified);
+            }
+            Header += FString::Printf(TEXT("Content-Length: %lld\r\nContent-Type: application/octet-stream\r\nAccept-Ranges: bytes\r\nConnection: close\r\n\r\n"), End - Start + 1);
+        }
+        //HEAD请求只发送响应头
+        if (Request.StartsWith(TEXT("HEAD "))) {
+            End = Start - 1;
+        }
+
+        int32 Sent = 0;
+        FTCHARToUTF8 Converted(*Header);
+        bool bConnected = Client->Send((const uint8*)Converted.Get(), Converted.Length(), Sent);
+        //客户端关闭连接(跳转或者读取结束)时发送失败
+        int64 Position = Start;
+        while (bConnected && !this->StopRequest && Position <= End) {
+            const int32 Count = (int32)FMath::Min<int64>(End + 1 - Position, 64 * 1024);
+            bConnected = Client->Send(this->Data.GetData() + Position, Count, Sent) && Sent > 0;
+            if (bConnected) {
+                Position += Sent;
+                this->BytesSent += Sent;
+            }
+        }
+    }
+    Client->Close();
+    ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM)->DestroySocket(Client);
+}
+
+FFFmpegMediaTestUdpStreamer::FFFmpegMediaTestUdpStreamer()
+    : Port(0)
+    , Jitter(0.0)
+    , Thread(nullptr)
+    , StopRequest(false)
+    , PacketsSent(0)
+{
+}
+
+FFFmpegMediaTestUdpStreamer::~FFFmpegMediaTestUdpStreamer()
+{
+    this->Close();
+}
+
+bool FFFmpegMediaTestUdpStreamer::Start(const FString& InPath, int32 InPort, double InJitter)
+{
+    this->Close();
+    this->Path = InPath;
+    this->Port = InPort > 0 ? InPort : FMath::RandRange(20000, 40000);
+    this->Jitter = InJitter;
+    this->StopRequest = false;
+    {
+        FScopeLock Lock(&this->SendTimesMutex);
+        this->SendTimes.Reset();
+    }
+    this->Thread = FRunnableThread::Create(this, TEXT("FFmpegMediaTestUdpStreamer"));
+    return this->Thread != nullptr;
+}
+
+void FFFmpegMediaTestUdpStreamer::Close()
+{
+    if (this->Thread) {
+        this->Thread->Kill(true);
+        delete this->Thread;
+        this->Thread = nullptr;
+    }
+}
+
+FString FFFmpegMediaTestUdpStreamer::GetUrl() const
+{
+    return FString::Printf(TEXT("udp://127.0.0.1:%d?overrun_nonfatal=1"), this->Port);
+}
+
+double FFFmpegMediaTestUdpStreamer::GetSendTime(double Pts) const
+{
+    FScopeLock Lock(&this->SendTimesMutex);
+    const double* Found = this->SendTimes.Find(FMath::RoundToInt64(Pts * 90000.0));
+    return Found ? *Found : -1.0;
+}
+
+void FFFmpegMediaTestUdpStreamer::Stop()
+{
+    this->StopRequest = true;
+}
+
+uint32 FFFmpegMediaTestUdpStreamer::Run()
+{
+    const FString OutUrl = FString::Printf(TEXT("udp://127.0.0.1:%d?pkt_size=1316"), this->Port);
+    AVFormatContext* ic = NULL;
+    AVFormatContext* oc = NULL;
+    AVPacket* pkt = av_packet_alloc();
+    int64_t loop_start = AV_NOPTS_VALUE; //一次循环的时间范围(微秒)
+    int64_t loop_end = AV_NOPTS_VALUE;
+    int64_t offset = 0; //当前循环的时间戳偏移(微秒)
+    int64_t first_ts = AV_NOPTS_VALUE;
+    double start_time = 0.0;
+    int ret = 0;
+
+    if (!pkt || avformat_open_input(&ic, TCHAR_TO_UTF8(*this->Path), NULL, NULL) < 0 || avformat_find_stream_info(ic, NULL) < 0) {
+        goto fail;
+    }
+    if (avformat_alloc_output_context2(&oc, NULL, "mpegts", TCHAR_TO_UTF8(*OutUrl)) < 0) {
+        goto fail;
+    }
+    for (unsigned i = 0; i < ic->nb_streams; i++) {
+        AVStream* st = avformat_new_stream(oc, NULL);
+        if (!st || avcodec_parameters_copy(st->codecpar, ic->streams[i]->codecpar) < 0) {
+            goto fail;
+        }
+        st->codecpar->codec_tag = 0;
+        st->time_base = ic->streams[i]->time_base;
+    }
+    if (avio_open(&oc->pb, TCHAR_TO_UTF8(*OutUrl), AVIO_FLAG_WRITE) < 0) {
+        goto fail;
+    }
+    oc->flags |= AVFMT_FLAG_FLUSH_PACKETS; //每个数据包立即发送
+    if (avformat_write_header(oc, NULL) < 0) {
+        goto fail;
+    }
+
+    while (!this->StopRequest) {
+        ret = av_read_frame(ic, pkt);
+        if (ret == AVERROR_EOF) {
+            //重新打开文件开始下一次循环，时间戳接在上一次循环之后
+            offset += loop_end - loop_start;
+            avformat_close_input(&ic);
+            if (avformat_open_input(&ic, TCHAR_TO_UTF8(*this->Path), NULL, NULL) < 0 || avformat_find_stream_info(ic, NULL) < 0) {
+                goto fail;
+            }
+            continue;
+        }
+        if (ret < 0) {
+            goto fail;
+        }
+        const AVRational in_tb = ic->streams[pkt->stream_index]->time_base;
+        const int64_t ts = pkt->dts != AV_NOPTS_VALUE ? pkt->dts : pkt->pts;
+        if (ts == AV_NOPTS_VALUE || pkt->stream_index >= (int)oc->nb_streams) {
+            av_packet_unref(pkt);
+            continue;
+        }
+        const int64_t ts_us = av_rescale_q(ts, in_tb, AV_TIME_BASE_Q);
+        if (loop_start == AV_NOPTS_VALUE) {
+            loop_start = ts_us;
+        }
+        loop_end = FFMAX(loop_end, av_rescale_q(ts + pkt->duration, in_tb, AV_TIME_BASE_Q));
+
+        //加上循环的偏移之后转换到输出的时间基
+        const int64_t shift = av_rescale_q(offset, AV_TIME_BASE_Q, in_tb);
+        if (pkt->pts != AV_NOPTS_VALUE)
+            pkt->pts += shift;
+        if (pkt->dts != AV_NOPTS_VALUE)
+            pkt->dts += shift;
+        const bool video = ic->streams[pkt->stream_index]->codecpar->codec_type == AVMEDIA_TYPE_VIDEO;
+        av_packet_rescale_ts(pkt, in_tb, oc->streams[pkt->stream_index]->time_base);
+
+        //按照实时速度发送，模拟抖动时随机停顿，之后按照原来的时间表集中发送
+        const int64_t send_ts = ts_us + offset;
+        if (first_ts == AV_NOPTS_VALUE) {
+            first_ts = send_ts;
+            start_time = FPlatformTime::Seconds();
+        }
+        if (this->Jitter > 0.0 && FMath::FRand() < 0.1f) {
+            FPlatformProcess::Sleep((float)FMath::FRandRange(0.0, this->Jitter));
+        }
+        const double wait = start_time + (send_ts - first_ts) / 1000000.0 - FPlatformTime::Seconds();
+        if (wait > 0.0) {
+            FPlatformProcess::Sleep((float)wait);
+        }
+
+        const int64_t pts = pkt->pts;
+        const AVRational out_tb = oc->streams[pkt->stream_index]->time_base;
+        //没有接收端时发送失败不影响之后的发送
+        if (av_write_frame(oc, pkt) >= 0) {
+            this->PacketsSent++;
+            if (video && pts != AV_NOPTS_VALUE) {
+                const double Now = FPlatformTime::Seconds();
+                FScopeLock Lock(&this->SendTimesMutex);
+                this->SendTimes.Add(av_rescale_q(pts, out_tb, AVRational{ 1, 90000 }), Now);
+            }
+        }
+        av_packet_unref(pkt);
+    }
+    av_write_trailer(oc);
+fail:
+    if (oc) {
+        avio_closep(&oc->pb);
+        avformat_free_context(oc);
+    }
+    avformat_close_input(&ic);
+    av_packet_free(&pkt);
+    return 0;
+}
+
+#endif //WITH_DEV_AUTOMATION_TESTS
@@ -0,0 +1,285 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "IMediaEventSink.h"
+#include "HAL/Runnable.h"
+#include "Async/Future.h"
+#include "FFmpegMediaPlayer.h"
+#include "FFmpegMediaTracks.h"
+#include <atomic>
+
+class FSocket;
+class IMediaTextureSample;
+class IMediaAudioSample;
+class FRunnableThread;
+
+/**
+ * 自动化测试使用的片段参数
+ * 片段用mpeg4和mp2编码生成，默认没有B帧，保存在Saved/FFmpegMedia/Tests目录下，参数相同时直接使用已经生成的文件
+ */
+struct FFFmpegMediaTestClip
+{
+	/** 文件名前缀 */
+	FString Name = TEXT("clip");
+
+	/** 容器格式(文件扩展名)，比如mkv、ts */
+	FString Format = TEXT("mkv");
+
+	/** 时长(秒) */
+	double Duration = 2.0;
+
+	int32 Width = 640;
+	int32 Height = 360;
+	int32 FrameRate = 30;
+
+	/** 关键帧间隔(帧) */
+	int32 GopSize = 30;
+
+	/** 连续B帧的最大数量，大于0时GOP是开放的(关键帧之后的B帧显示在关键帧之前) */
+	int32 BFrames = 0;
+
+	/** 视频码率(kbps) */
+	int32 BitRate = 2000;
+
+	/** 是否包含音频(48kHz立体声) */
+	bool Audio = true;
+};
+
+/** 自动化测试和性能测试共用的工具 */
+class FFFmpegMediaTestUtils
+{
+public:
+	/**
+	 * 获取测试片段，不存在时生成
+	 * @return 文件的完整路径，生成失败时为空
+	 */
+	static FString GetClip(const FFFmpegMediaTestClip& Clip);
+
+	/**
+	 * 获取性能测试使用的片段，命令行中-FFmpegMediaBenchmarkClip=<path>指定时使用该文件(比如实际使用的1080p h264文件)
+	 * 否则生成默认的片段
+	 */
+	static FString GetBenchmarkClip(const FFFmpegMediaTestClip& Default);
+
+	/** 把测试片段写入指定的文件 */
+	static bool WriteClip(const FString& Path, const FFFmpegMediaTestClip& Clip);
+
+	/** 进程所有线程占用的CPU时间(秒) */
+	static double GetCpuSeconds();
+
+	/** 输出一行测试结果，同时写入日志，从命令行运行时可以在日志中收集 */
+	static void Report(FAutomationTestBase& Test, const FString& Line);
+};
+
+/**
+ * 测试用的播放器
+ * 代替FMediaPlayerFacade接收事件、选择默认轨道并开始播放，没有媒体纹理和音频输出，样本由Tick取出并计数
+ */
+class FFFmpegMediaTestPlayer : public IMediaEventSink
+{
+public:
+	FFFmpegMediaTestPlayer();
+	virtual ~FFFmpegMediaTestPlayer();
+
+	/**
+	 * 打开媒体，打开之后自动开始播放
+	 * @param bLooping 是否循环播放
+	 */
+	bool Open(const FString& Url, const FFFmpegMediaOpenOptions& OpenOptions, bool bLooping = false);
+
+	/** 驱动播放器(TickInput)，处理事件并取出所有样本 */
+	void Tick();
+
+	/**
+	 * 驱动播放器直到条件满足
+	 * @param Timeout 超时(秒)
+	 * @return 超时之前条件满足时返回true
+	 */
+	bool TickUntil(TFunctionRef<bool()> Condition, double Timeout);
+
+	/** 同时驱动多个播放器直到条件满足 */
+	static bool TickUntil(TArrayView<FFFmpegMediaTestPlayer* const> Players, TFunctionRef<bool()> Condition, double Timeout);
+
+	/** 收到的指定事件数量 */
+	int32 NumEvents(EMediaEvent Event) const;
+
+	FFmpegMediaPlayer& GetPlayer();
+
+	/** 播放器当前使用的轨道集合(共享媒体源时为共享的轨道) */
+	FFFmpegMediaTracks& GetTracks();
+
+	/** 取出的视频样本数 */
+	int64 NumVideoSamples = 0;
+
+	/** 取出的音频样本数 */
+	int64 NumAudioSamples = 0;
+
+	/** 从Open到取出第一个视频样本的时间(秒)，小于0表示还没有 */
+	double FirstVideoTime = -1.0;
+
+	/** 取出视频样本时调用(可以为空)，用于测量延迟 */
+	TFunction<void(const IMediaTextureSample&)> OnVideoSample;
+
+	/** 取出音频样本时调用(可以为空) */
+	TFunction<void(const IMediaAudioSample&)> OnAudioSample;
+
+	/**
+	 * 按照实时速度取出音频样本(模拟音频设备)，样本队列满了之后音频线程等待，音频时钟按照实际速度前进
+	 * 否则所有样本都立即取出，音频解码不受限制
+	 */
+	bool bPaceAudio = false;
+
+	/** 取出的音频样本的总时长(秒，按照样本帧数计算，变速播放时为变速之后的时长) */
+	double AudioDuration = 0.0;
+
+	/** Open时把整个文件预加载到内存(FileMediaSource的PrecacheFile选项) */
+	bool bPrecache = false;
+
+public:
+	//~ IMediaEventSink interface
+	virtual void ReceiveMediaEvent(EMediaEvent Event) override;
+
+private:
+	/** 媒体打开之后代替FMediaPlayerFacade选择默认轨道并开始播放 */
+	void StartPlayback();
+
+private:
+	TSharedPtr<FFmpegMediaPlayer, ESPMode::ThreadSafe> Player;
+
+	/** 收到的事件(打开失败事件可能在打开任务中发送) */
+	TArray<EMediaEvent> Events;
+	mutable FCriticalSection EventsMutex;
+
+	/** Tick已经处理的事件数 */
+	int32 NumHandledEvents = 0;
+
+	bool bLooping = false;
+	double OpenTime = 0.0;
+	double LastTickTime = 0.0;
+
+	/** 按照实时速度取出音频时，取出第一个音频样本的时间 */
+	double AudioStartTime = -1.0;
+};
+
+/**
+ * 测试用的本地http服务器
+ * 在127.0.0.1的空闲端口上提供一个文件，支持Range请求
+ * 每个连接使用单独的线程，FFmpeg跳转时会在关闭旧连接之前建立新连接
+ */
+class FFFmpegMediaTestHttpServer : public FRunnable
+{
+public:
+	FFFmpegMediaTestHttpServer();
+	virtual ~FFFmpegMediaTestHttpServer();
+
+	/** 读取文件并开始监听 */
+	bool Start(const FString& Path);
+
+	/** 停止监听并等待所有连接结束 */
+	void Close();
+
+	/** 文件的地址 */
+	FString GetUrl() const;
+
+	/**
+	 * 替换文件内容和验证头(模拟服务器上的文件被修改)，只在没有正在处理的请求时调用
+	 * Start之后ETag为文件内容的CRC，Last-Modified为文件的修改时间
+	 * @param InETag 为空时不发送ETag
+	 * @param InLastModified 为空时不发送Last-Modified
+	 */
+	void SetContent(const TArray<uint8>& InData, const FString& InETag, const FString& InLastModified);
+
+	/** 收到的请求数 */
+	int32 GetNumRequests() const { return this->NumRequests; }
+
+	/** 发送的文件数据大小(字节) */
+	int64 GetBytesSent() const { return this->BytesSent; }
+
+public:
+	//~ FRunnable interface
+	virtual uint32 Run() override;
+	virtual void Stop() override;
+
+private:
+	/** 处理一个连接中的请求，发送完成之后关闭连接 */
+	void HandleConnection(FSocket* Client);
+
+private:
+	TArray<uint8> Data;
+	FString FileName;
+	FString ETag;
+	FString LastModified;
+	FSocket* Listener;
+	int32 Port;
+	FRunnableThread* Thread;
+
+	/** 连接的处理线程，只在监听线程中添加 */
+	TArray<TFuture<void>> Connections;
+
+	std::atomic<bool> StopRequest;
+	std::atomic<int32> NumRequests;
+	std::atomic<int64> BytesSent;
+};
+
+/**
+ * 测试用的实时流发送端
+ * 按照实时速度把文件循环转封装成TS发送到udp://127.0.0.1，时间戳在循环之间保持连续
+ * 可以模拟网络抖动: 发送时随机停顿，之后按照原来的时间表集中发送
+ */
+class FFFmpegMediaTestUdpStreamer : public FRunnable
+{
+public:
+	FFFmpegMediaTestUdpStreamer();
+	virtual ~FFFmpegMediaTestUdpStreamer();
+
+	/**
+	 * 开始发送
+	 * @param Path 发送的文件
+	 * @param InPort 接收端口，0表示随机选择
+	 * @param InJitter 随机停顿的最大时长(秒)，0表示不停顿
+	 */
+	bool Start(const FString& Path, int32 InPort = 0, double InJitter = 0.0);
+
+	/** 停止发送 */
+	void Close();
+
+	/** 播放器打开的地址 */
+	FString GetUrl() const;
+
+	int32 GetPort() const { return this->Port; }
+
+	/**
+	 * 视频数据包的发送时间
+	 * @param Pts 时间戳(秒)，与视频样本的时间相同
+	 * @return FPlatformTime::Seconds()的时间，没有发送过时返回负数
+	 */
+	double GetSendTime(double Pts) const;
+
+	/** 已经发送的数据包数 */
+	int64 GetPacketsSent() const { return this->PacketsSent; }
+
+public:
+	//~ FRunnable interface
+	virtual uint32 Run() override;
+	virtual void Stop() override;
+
+private:
+	FString Path;
+	int32 Port;
+	double Jitter;
+	FRunnableThread* Thread;
+	std::atomic<bool> StopRequest;
+	std::atomic<int64> PacketsSent;
+
+	/** 视频数据包的时间戳(90kHz) -> 发送时间 */
+	TMap<int64, double> SendTimes;
+	mutable FCriticalSection SendTimesMutex;
+};
+
+#endif //WITH_DEV_AUTOMATION_TESTS
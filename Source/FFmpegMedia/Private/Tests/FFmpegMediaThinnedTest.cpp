@@ -0,0 +1,69 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Tests/FFmpegMediaTestUtils.h"
+#include "FFmpegMedia.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FFFmpegMediaThinnedCostTest, "FFmpegMedia.Rate.Thinned", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+/**
+ * 按照8、16、32、64倍速跳帧播放，每秒解码的关键帧数量和显示的帧数不随速率增加
+ * CPU时间只输出，不作为判断条件(自动化测试时其他线程也会占用CPU)
+ */
+bool FFFmpegMediaThinnedCostTest::RunTest(const FString& Parameters)
+{
+    FFFmpegMediaTestClip Clip;
+    Clip.Name = TEXT("thinned");
+    Clip.Duration = 120.0;
+    Clip.Width = 320;
+    Clip.Height = 180;
+    Clip.GopSize = 15; //每0.5秒一个关键帧，64倍速时每秒有128个关键帧可以显示
+    Clip.BitRate = 500;
+    Clip.Audio = false;
+    const FString Path = FFFmpegMediaTestUtils::GetClip(Clip);
+    if (!TestFalse(TEXT("Test clip is generated"), Path.IsEmpty())) {
+        return false;
+    }
+    const double Window = 1.0;
+
+    const float Rates[] = { 8.0f, 16.0f, 32.0f, 64.0f };
+    double BaseDecoded = 0.0;
+    for (float Rate : Rates) {
+        FFFmpegMediaOpenOptions OpenOptions;
+        FFFmpegMediaTestPlayer Player;
+        if (!TestTrue(FString::Printf(TEXT("%.0fx: open"), Rate), Player.Open(Path, OpenOptions))
+            || !TestTrue(FString::Printf(TEXT("%.0fx: first video sample"), Rate), Player.TickUntil([&]() { return Player.NumVideoSamples > 0; }, 10.0))) {
+            continue;
+        }
+        FFFmpegMediaTracks& Tracks = Player.GetTracks();
+        TestTrue(FString::Printf(TEXT("%.0fx: rate is accepted"), Rate), Tracks.SetRate(Rate));
+        Player.TickUntil([]() { return false; }, 0.3); //切换播放模式
+
+        const FFFmpegMediaTracksCounters Before = Tracks.GetCounters();
+        const double StartCpu = FFFmpegMediaTestUtils::GetCpuSeconds();
+        const double StartWall = FPlatformTime::Seconds();
+        Player.TickUntil([]() { return false; }, Window);
+        const double Wall = FPlatformTime::Seconds() - StartWall;
+        const double Cpu = FFFmpegMediaTestUtils::GetCpuSeconds() - StartCpu;
+        const FFFmpegMediaTracksCounters After = Tracks.GetCounters();
+
+        const double Decoded = (After.TrickHopCount - Before.TrickHopCount) / Wall;
+        const double Shown = (After.GopFrameCount - Before.GopFrameCount) / Wall;
+        TestTrue(FString::Printf(TEXT("%.0fx: shows key frames"), Rate), Shown > 0.0);
+        if (BaseDecoded <= 0.0) {
+            BaseDecoded = Decoded;
+        }
+        else {
+            //显示帧率固定，解码的关键帧数量只比显示的多出等待显示的块
+            TestTrue(FString::Printf(TEXT("%.0fx: %.1f key frames decoded per second, not more than 1.5x of %.1f at %.0fx"), Rate, Decoded, BaseDecoded, Rates[0]),
+                Decoded <= BaseDecoded * 1.5 + 2.0);
+        }
+        FFFmpegMediaTestUtils::Report(*this, FString::Printf(TEXT("%.0fx: %.1f key frames decoded/s, %.1f frames shown/s, CPU %.1f%%"),
+            Rate, Decoded, Shown, Wall > 0.0 ? Cpu / Wall * 100.0 : 0.0));
+    }
+    return true;
+}
+
+#endif //WITH_DEV_AUTOMATION_TESTS
@@ -5,6 +5,7 @@
 #include "Modules/ModuleManager.h"
 #include "IMediaModule.h"
 #include "IMediaOptions.h"
+#include "IMediaPlayer.h"
 #include "IMediaPlayerFactory.h"
 #include "Logging/LogMacros.h"
 
@@ -25,6 +26,38 @@ public:
 
 	virtual TArray<FString> GetSupportedUriSchemes() = 0;
 
+	/**
+	 * 暂停状态下逐帧显示(UMediaPlayer可以通过GetPlayerFacade()->GetPlayer()获取播放器)
+	 * @param Player FFmpegMedia创建的播放器，其他播放器返回false
+	 * @param NumFrames 显示的帧数，大于0向前，小于0向后
+	 * @return 播放器未暂停或者不支持时返回false
+	 */
+	virtual bool StepFrames(const TSharedPtr<IMediaPlayer, ESPMode::ThreadSafe>& Player, int32 NumFrames) = 0;
+
+	/**
+	 * 设置拖动状态(比如开始和结束拖动进度条)，拖动时seek只跳转到关键帧，停止拖动或者停顿时对最后的位置做一次精准seek
+	 * 没有设置时所有seek都是精准seek
+	 * @param Player FFmpegMedia创建的播放器，其他播放器返回false
+	 * @param Scrubbing 是否处于拖动状态
+	 */
+	virtual bool SetScrubbing(const TSharedPtr<IMediaPlayer, ESPMode::ThreadSafe>& Player, bool Scrubbing) = 0;
+
+	/**
+	 * 在后台预打开下一个媒体(打开、读取流信息并解码出第一帧)，之后用同一个地址打开时直接切换，没有黑屏间隔
+	 * 连续播放模式下当前媒体播放结束时自动切换，时间轴接在当前媒体之后
+	 * @param Player FFmpegMedia创建的播放器，其他播放器返回false
+	 * @param Url 下一个媒体的地址
+	 * @param Options 打开选项(可以为空)
+	 * @param Concatenate 是否接在当前媒体之后连续播放
+	 */
+	virtual bool PreopenNext(const TSharedPtr<IMediaPlayer, ESPMode::ThreadSafe>& Player, const FString& Url, const IMediaOptions* Options, bool Concatenate) = 0;
+
+	/**
+	 * 取消预打开的媒体
+	 * @param Player FFmpegMedia创建的播放器
+	 */
+	virtual void CancelPreopen(const TSharedPtr<IMediaPlayer, ESPMode::ThreadSafe>& Player) = 0;
+
 public:
 
 	/** Virtual destructor. */
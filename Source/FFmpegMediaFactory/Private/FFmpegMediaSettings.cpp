@@ -10,10 +10,36 @@ UFFmpegMediaSettings::UFFmpegMediaSettings()
 	//, FrameDropStrategy(FrameDropStrategy::Default)
 	//, AudioVolume(100)
 	, bAllowFast(false)
+	, FrameCacheSizeMB(0)
+	, ResidentClipMaxDuration(10.0f)
+	, ResidentClipBudgetMB(1024)
+	, PacketCacheSizeMB(256)
+	, PacketCacheBudgetMB(1024)
+	, ProbeSizeKB(0)
+	, AnalyzeDurationMs(0)
+	, IOBufferSizeKB(1024)
+	, IOReadAheadBlocks(4)
+	, PrecacheMaxSizeMB(1024)
+	, bMapLocalFiles(false)
+	, MappedReadAheadMB(8)
+	, bIoUringLocalFiles(false)
+	, IoUringQueueDepth(8)
+	, bIoUringDirectIO(false)
+	, ReadAheadSizeMB(16)
+	, HttpCacheSizeMB(2048)
+	, RtspTransport(ERtspTransport::Default)
+	, bLowLatencyLive(false)
+	, LowLatencyTargetMs(500)
+	, JitterBufferTargetMs(0)
+	, JitterBufferMaxSpeedChange(0.05f)
+	, bReconnectLive(true)
+	, ReconnectTimeoutMs(5000)
+	, ReconnectMaxDelayMs(5000)
+	, ReconnectMaxAttempts(10)
+	, bShareSources(false)
 	//, DecoderReorderPtsStrategy(DecoderReorderPtsStrategy::Auto)
 	//, DisableAudio(false)
 	//, DisableVideo(false)
 	//, AudioThreadsCount(0)
 	//, VideoThreadsCount(0)
-	//, RtspTransport(ERtspTransport::Default)
 { }
\ No newline at end of file
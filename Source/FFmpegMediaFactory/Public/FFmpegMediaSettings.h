@@ -62,6 +62,87 @@ public:
 	UPROPERTY(config, EditAnywhere, Category = Media, meta = (ToolTip = "非标准化规范的多媒体兼容优化"))
 	bool bAllowFast;
 
+	UPROPERTY(config, EditAnywhere, Category = Media, meta = (ClampMin = 0, ToolTip = "已解码视频帧缓存大小(MB)，用于回退和重复拖动时直接显示，0表示关闭(默认)。只缓存暂停、逐帧和拖动时显示的帧，审片等工具可以通过FrameCacheSize媒体选项单独开启"))
+	int32 FrameCacheSizeMB;
+
+	UPROPERTY(config, EditAnywhere, Category = Media, meta = (ClampMin = 0, ToolTip = "常驻内存的循环片段最大时长(秒)，不超过该时长的循环片段只解码一次，0表示关闭"))
+	float ResidentClipMaxDuration;
+
+	UPROPERTY(config, EditAnywhere, Category = Media, meta = (ClampMin = 0, ToolTip = "所有播放器常驻内存的循环片段总共可以使用的内存(MB)，视频帧按NV12保存(每像素1.5字节)，默认值可以容纳一个10秒的1080p30片段"))
+	int32 ResidentClipBudgetMB;
+
+	UPROPERTY(config, EditAnywhere, Category = Media, meta = (ClampMin = 0, ToolTip = "循环播放时缓存完整数据包的内存预算(MB)，文件小于该大小时之后的循环不再读取文件，0表示关闭"))
+	int32 PacketCacheSizeMB;
+
+	UPROPERTY(config, EditAnywhere, Category = Media, meta = (ClampMin = 0, ToolTip = "所有播放器的数据包缓存总共可以使用的内存(MB)，超出时新的缓存放弃录制，循环时重新读取文件"))
+	int32 PacketCacheBudgetMB;
+
+	UPROPERTY(config, EditAnywhere, Category = Media, meta = (ClampMin = 0, ToolTip = "打开媒体时探测格式和流信息最多读取的数据大小(KB)，0表示使用FFmpeg默认值(5000KB)"))
+	int32 ProbeSizeKB;
+
+	UPROPERTY(config, EditAnywhere, Category = Media, meta = (ClampMin = 0, ToolTip = "打开媒体时读取流信息最多分析的时长(毫秒)，0表示使用FFmpeg默认值(5000毫秒)"))
+	int32 AnalyzeDurationMs;
+
+	UPROPERTY(config, EditAnywhere, Category = Media, meta = (ClampMin = 4, ToolTip = "读取Archive和pak中的文件时AVIO缓冲区以及每次异步读取的大小(KB)"))
+	int32 IOBufferSizeKB;
+
+	UPROPERTY(config, EditAnywhere, Category = Media, meta = (ClampMin = 0, ToolTip = "读取pak中的文件时，当前读取位置之后同时进行的异步读取数量"))
+	int32 IOReadAheadBlocks;
+
+	UPROPERTY(config, EditAnywhere, Category = Media, meta = (ClampMin = 0, ToolTip = "PrecacheFile选项预加载到内存的最大文件大小(MB)，超过时按照普通文件读取"))
+	int32 PrecacheMaxSizeMB;
+
+	UPROPERTY(config, EditAnywhere, Category = Media, meta = (ToolTip = "通过内存映射读取本地文件，多个播放器读取同一个文件时共用系统页缓存，无法映射时使用FFmpeg的file协议。默认关闭: 播放期间文件被截短或替换时，Linux/Mac/Android上会因为SIGBUS崩溃"))
+	bool bMapLocalFiles;
+
+	UPROPERTY(config, EditAnywhere, Category = Media, meta = (ClampMin = 0, ToolTip = "内存映射读取时提示系统预读的大小(MB)，只在支持madvise的平台上有效"))
+	int32 MappedReadAheadMB;
+
+	UPROPERTY(config, EditAnywhere, Category = Media, meta = (ToolTip = "在Linux上通过io_uring读取本地文件，每个播放器同时保持多个读取请求，内核不支持时使用内存映射(开启bMapLocalFiles时)或者FFmpeg的file协议"))
+	bool bIoUringLocalFiles;
+
+	UPROPERTY(config, EditAnywhere, Category = Media, meta = (ClampMin = 1, ClampMax = 64, ToolTip = "io_uring每个播放器同时进行的读取数量，每个读取的大小为IOBufferSizeKB"))
+	int32 IoUringQueueDepth;
+
+	UPROPERTY(config, EditAnywhere, Category = Media, meta = (ToolTip = "io_uring读取时使用O_DIRECT绕过页缓存，文件系统不支持时自动改为普通读取"))
+	bool bIoUringDirectIO;
+
+	UPROPERTY(config, EditAnywhere, Category = Media, meta = (ClampMin = 0, ToolTip = "网络地址(http、https、ftp等)和Archive的预读缓冲区大小(MB)，由单独的IO线程填充，0表示关闭"))
+	int32 ReadAheadSizeMB;
+
+	UPROPERTY(config, EditAnywhere, Category = Media, meta = (ClampMin = 0, ToolTip = "http(s)地址磁盘缓存(Saved/FFmpegMedia/HttpCache)的大小上限(MB)，超出时删除最久未使用的缓存，0表示关闭"))
+	int32 HttpCacheSizeMB;
+
+	UPROPERTY(config, EditAnywhere, Category = Media, meta = (ToolTip = "rtsp协议的传输方式，Default时由FFmpeg依次尝试udp、tcp"))
+	ERtspTransport RtspTransport;
+
+	UPROPERTY(config, EditAnywhere, Category = Media, meta = (ToolTip = "实时流(rtsp、rtmp、rtp、udp、srt)自动使用低延迟模式，也可以通过LowLatency媒体选项单独开启"))
+	bool bLowLatencyLive;
+
+	UPROPERTY(config, EditAnywhere, Category = Media, meta = (ClampMin = 50, ToolTip = "低延迟模式的目标延迟(毫秒)，队列中缓存的数据超过该时长时丢弃旧的数据，从最新的数据开始播放"))
+	int32 LowLatencyTargetMs;
+
+	UPROPERTY(config, EditAnywhere, Category = Media, meta = (ClampMin = 0, ToolTip = "实时流抖动缓冲的目标延迟(毫秒)，0表示关闭(默认关闭，开启之后实时流增加相应的延迟)。缓存的时长偏离目标时小幅调整播放速度追赶或者放慢，网络抖动较大时目标延迟自动增加"))
+	int32 JitterBufferTargetMs;
+
+	UPROPERTY(config, EditAnywhere, Category = Media, meta = (ClampMin = 0.0, ClampMax = 0.25, ToolTip = "抖动缓冲调整播放速度的最大幅度，比如0.05表示在0.95 ~ 1.05倍之间调整(音频变速不变调)"))
+	float JitterBufferMaxSpeedChange;
+
+	UPROPERTY(config, EditAnywhere, Category = Media, meta = (ToolTip = "实时流(rtsp、rtmp、rtp、udp、srt)断线之后自动重连，编码参数不变时只重新打开连接，继续使用原来的解码器"))
+	bool bReconnectLive;
+
+	UPROPERTY(config, EditAnywhere, Category = Media, meta = (ClampMin = 500, ToolTip = "实时流超过该时长(毫秒)没有收到数据时认为已经断线"))
+	int32 ReconnectTimeoutMs;
+
+	UPROPERTY(config, EditAnywhere, Category = Media, meta = (ClampMin = 100, ToolTip = "重连失败之后的最长等待时间(毫秒)，等待时间从100毫秒开始每次加倍"))
+	int32 ReconnectMaxDelayMs;
+
+	UPROPERTY(config, EditAnywhere, Category = Media, meta = (ClampMin = 0, ToolTip = "最多重连的次数，超过之后按照播放结束处理，0表示不限制"))
+	int32 ReconnectMaxAttempts;
+
+	UPROPERTY(config, EditAnywhere, Category = Media, meta = (ToolTip = "打开同一个地址且选项相同的播放器共用一个解复用、解码和转换管线，多个屏幕播放同一个视频时只解码一次。播放控制作用于所有共用的播放器，也可以通过SharedSource媒体选项单独开启"))
+	bool bShareSources;
+
 	//UPROPERTY(config, EditAnywhere, Category = Media)
 	//ESynchronizationType SyncType; //同步类型
 
@@ -88,7 +169,4 @@ public:
 
 	//UPROPERTY(config, EditAnywhere, Category = Media, meta = (UIMin = 0, UIMax = 16))
 	//uint16 VideoThreadsCount; //视频解码线程数
-
-	//UPROPERTY(config, EditAnywhere, Category = Media)
-	//ERtspTransport RtspTransport; //rtsp协议
 };